@@ -63,10 +63,19 @@ namespace android {
 #define TVOUT_FB_G0     10
 #define TVOUT_FB_G1     11
 
-#define HDMI_FIMC_OUTPUT_BUF_NUM 3
+// FIMC output buffers used to mirror UI frames on the video layer.
+// each buffer takes HDMI_FIMC_OUTPUT_BUF_SIZE of the FIMC reserved memory.
+// how many are used is set in libhdmi, the class layout stays the same.
+#define HDMI_FIMC_OUTPUT_BUF_MAX  8
+#define HDMI_FIMC_OUTPUT_BUF_SIZE (2 << 20)
 
 #define ALIGN(x, a)    (((x) + (a) - 1) & ~((a) - 1))
 
+// video frames flush() counts before it reports the content rate
+#define HDMI_CONTENT_FPS_FRAMES   (30)
+// a longer gap between two video frames is a pause, the count restarts
+#define HDMI_CONTENT_PAUSE_MS     (250)
+
 #if defined(STD_NTSC_M)
     #define DEFAULT_OUPUT_MODE            (COMPOSITE_OUTPUT_MODE)
     #define DEFAULT_HDMI_RESOLUTION_VALUE (1080960) // 1080P_60
@@ -136,6 +145,7 @@ enum hdmi_layer
 };
 
 int tvout_init(v4l2_std_id std_id);
+int tvout_deinit();
 int tvout_v4l2_querycap(int fp);
 int tvout_v4l2_g_std(int fp, v4l2_std_id *std_id);
 int tvout_v4l2_s_std(int fp, v4l2_std_id std_id);
@@ -152,7 +162,8 @@ int tvout_v4l2_s_crop(int fp, unsigned int type, struct v4l2_rect *rect);
 int tvout_v4l2_start_overlay(int fp);
 int tvout_v4l2_stop_overlay(int fp);
 
-
+int hdmi_init_layer(int layer);
+int hdmi_deinit_layer(int layer);
 int hdmi_set_v_param(int layer,
         int src_w, int src_h, int colorFormat,
         unsigned int src_y_address, unsigned int src_c_address,
@@ -167,7 +178,6 @@ int hdmi_outputmode_2_v4l2_output_type(int output_mode);
 int hdmi_v4l2_output_type_2_outputmode(int output_mode);
 static int composite_std_2_v4l2_std_id(int std);
 static int hdmi_check_output_mode();
-static int hdmi_check_resolution(v4l2_std_id std_id);
 int hdmi_resolution_2_std_id(unsigned int resolution, int * w, int * h, v4l2_std_id * std_id);
 int hdmi_enable_hdcp(unsigned int hdcp_en);
 
@@ -190,39 +200,124 @@ public :
     };
 
 private :
-    class CECThread: public Thread
+    class EventThread: public Thread
     {
-        public:
-            bool                mFlagRunning;
-
         private:
-            sp<SecHdmi>         mSecHdmi;
-            Mutex               mThreadLoopLock;
+            SecHdmi            *mSecHdmi;
             Mutex               mThreadControlLock;
+            int                 mEpollFd;
+            int                 mUeventFd;
+            int                 mCtrlPipe[2];
+            volatile int32_t    mHpdState;
             virtual bool        threadLoop();
+
+            bool                m_addFd(int fd);
+            void                m_closeFds(void);
+            void                m_handleUevent(void);
+
+#if defined(BOARD_USES_CEC)
+            typedef int (EventThread::*cec_handler_func)(unsigned char *buffer, unsigned char lsrc);
+
+            struct cec_handler
+            {
+                unsigned char    opcode;
+                cec_handler_func handler; // NULL : no reply
+            };
+            static const struct cec_handler mCECHandlers[];
+
+            Mutex               mCECLock;
+            bool                mFlagCEC;
             enum CECDeviceType  mDevtype;
             int                 mLaddr;
             int                 mPaddr;
 
+            void                m_handleCEC(void);
+            int                 m_cecFeatureAbort(unsigned char *buffer, unsigned char ldst,
+                                                  unsigned char opcode, unsigned char reason);
+            int                 m_cecGivePhysicalAddress(unsigned char *buffer, unsigned char lsrc);
+            int                 m_cecRequestActiveSource(unsigned char *buffer, unsigned char lsrc);
+            int                 m_cecGetCECVersion(unsigned char *buffer, unsigned char lsrc);
+            int                 m_cecGivePowerStatus(unsigned char *buffer, unsigned char lsrc);
+            int                 m_cecAbort(unsigned char *buffer, unsigned char lsrc);
+#else
+            void                m_handleCEC(void) {};
+#endif
+
         public:
-            CECThread(sp<SecHdmi> secHdmi)
+            EventThread(SecHdmi *secHdmi)
                 :Thread(false),
-                mFlagRunning(false),
                 mSecHdmi(secHdmi),
+                mEpollFd(-1),
+                mUeventFd(-1),
+                mHpdState(HPD_CABLE_OUT)
+#if defined(BOARD_USES_CEC)
+                ,mFlagCEC(false),
                 mDevtype(CEC_DEVICE_PLAYER),
                 mLaddr(0),
-                mPaddr(0){
+                mPaddr(0)
+#endif
+            {
+                mCtrlPipe[0] = mCtrlPipe[1] = -1;
+            };
+            virtual ~EventThread();
+
+            bool start();
+            bool stop();
+
+            //! last cable state seen on a hotplug uevent, -1 if unknown
+            int  hpdState(void);
+
+#if defined(BOARD_USES_CEC)
+            bool startCEC(void);
+            //! use fd (e.g. one end of a socketpair) instead of the CEC device
+            bool startCEC(int fd, int laddr, int paddr);
+            bool stopCEC(void);
+#endif
+    };
+
+    class VsyncThread: public Thread
+    {
+        private:
+            SecHdmi            *mSecHdmi;
+            int                 mFd;
+            virtual bool        threadLoop();
+
+        public:
+            VsyncThread(SecHdmi *secHdmi)
+                :Thread(false),
+                mSecHdmi(secHdmi),
+                mFd(-1){
             };
-            virtual ~CECThread();
+            virtual ~VsyncThread();
 
             bool start();
             bool stop();
+    };
 
+    enum FIMC_OUT_BUF_STATE
+    {
+        FIMC_OUT_BUF_FREE = 0,  // can be used as FIMC destination
+        FIMC_OUT_BUF_FIMC,      // FIMC is writing it
+        FIMC_OUT_BUF_QUEUED,    // given to the mixer, not latched yet
+        FIMC_OUT_BUF_ON_SCREEN, // scanned out by the mixer
+    };
+
+    struct fimc_out_buf
+    {
+        int          state;
+        unsigned int seq;         // queue order
+        unsigned int queueVsync;  // vsync count when queued
+        nsecs_t      queueTime;
+
+        unsigned int frames;      // latched frames
+        nsecs_t      latencySum;  // queue -> on screen
+        nsecs_t      latencyMax;
     };
 
     Mutex        mLock;
 
-    sp<CECThread>               mCECThread;
+    sp<EventThread>             mEventThread;
+    sp<VsyncThread>             mVsyncThread;
 
     bool         mFlagCreate;
     bool         mFlagConnected;
@@ -241,13 +336,25 @@ private :
     unsigned int mHdmiSrcCbCrAddr;
 
     int          mHdmiOutputMode;
-    unsigned int mHdmiResolutionValue;
+    unsigned int mHdmiResolutionValue;     // mode on the wire
+    unsigned int mHdmiUserResolutionValue; // mode asked by setHdmiResolution()
     v4l2_std_id  mHdmiStdId;
     unsigned int mCompositeStd;
     bool         mHdcpMode;
     int          mAudioMode;
     unsigned int mUIRotVal;
 
+    // video shown on HDMI, 0 when only the UI is mirrored
+    int          mContentWidth;
+    int          mContentHeight;
+    int          mContentFps;
+    // rate measurement of the video frames given to flush()
+    int          mContentFrameWidth;
+    int          mContentFrameHeight;
+    int          mContentFrames;
+    nsecs_t      mContentFrameStart;
+    nsecs_t      mContentLastFrame;
+
     int          mCurrentHdmiOutputMode;
     unsigned int mCurrentHdmiResolutionValue;
     bool         mCurrentHdcpMode;
@@ -256,8 +363,19 @@ private :
 
     bool         mFlagFimcStart;
     int          mFimcDstColorFormat;
-    unsigned int mFimcReservedMem[HDMI_FIMC_OUTPUT_BUF_NUM];
+    int          mFimcOutBufNum;
+    unsigned int mFimcReservedMem[HDMI_FIMC_OUTPUT_BUF_MAX];
     unsigned int mFimcCurrentOutBufIndex;
+
+    Mutex        mFimcOutBufLock;
+    Condition    mFimcOutBufCondition;
+    fimc_out_buf mFimcOutBuf[HDMI_FIMC_OUTPUT_BUF_MAX];
+    bool         mFlagVsync;
+    unsigned int mVsyncCount;
+    unsigned int mFimcOutBufSeq;
+    unsigned int mFimcOutBufQueued;
+    unsigned int mFimcOutBufStalls;
+    unsigned int mFimcOutBufReplaced;
     SecFimc      mSecFimc;
 
     unsigned int mHdmiResolutionValueList[11];
@@ -294,6 +412,16 @@ public :
     bool        setHdcpMode(bool hdcpMode, bool forceRun = false);
     bool        setUIRotation(unsigned int rotVal);
 
+    // lets the resolution policy pick the mode that needs the least scaling
+    bool        setHdmiContent(int contentW, int contentH, int contentFps);
+
+#if defined(BOARD_USES_CEC)
+    // test seam : runs the CEC handlers on fd (e.g. one end of a socketpair)
+    // with fixed addresses instead of the device and EDID. after create()
+    bool        startCEC(int fd, int laddr, int paddr);
+    bool        stopCEC(void);
+#endif
+
 private:
 
     bool        m_reset(int w, int h, int colorFormat, int hdmiLayer);
@@ -303,10 +431,20 @@ private:
     bool        m_setHdmiOutputMode(int hdmiOutputMode);
     bool        m_setHdmiResolution(unsigned int hdmiResolutionValue);
     bool        m_setCompositeResolution(unsigned int compositeStdId);
+    void        m_calibrateHdmiResolution(void);
+    void        m_setHdmiContent(int contentW, int contentH, int contentFps);
+    void        m_trackHdmiContent(int srcW, int srcH);
     bool        m_setHdcpMode(bool hdcpMode);
     bool        m_setAudioMode(int audioMode);
 
 
+    void        m_resetFimcOutBuf(void);
+    int         m_getFimcOutBuf(void);
+    void        m_queueFimcOutBuf(int index);
+    void        m_putFimcOutBuf(int index);
+    void        m_handleVsync(bool flagVsync);
+    void        m_dumpFimcOutBuf(void);
+
     int         m_resolutionValueIndex(unsigned int ResolutionValue);
 
     bool        m_flagHWConnected(void);    
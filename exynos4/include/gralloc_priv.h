@@ -77,6 +77,7 @@ struct private_handle_t
 		PRIV_FLAGS_FRAMEBUFFER = 0x00000001,
 		PRIV_FLAGS_USES_UMP    = 0x00000002,
 		PRIV_FLAGS_USES_IOCTL  = 0x00000004,
+		PRIV_FLAGS_USES_CACHE  = 0x00000008,
 	};
 
 	enum
@@ -104,9 +105,14 @@ struct private_handle_t
 	// Following members is for framebuffer only
 	int     offset;
 
+	// Following members are for cached UMP memory only
+	int     stride_bytes;   // 0 : unknown, cache ops cover the whole buffer
+	int     dirty_offset;   // cpu-written range since the last clean
+	int     dirty_size;
+
 
 #ifdef __cplusplus
-	static const int sNumInts = 11;
+	static const int sNumInts = 14;
 	static const int sNumFds = 0;
 	static const int sMagic = 0x3141592;
 
@@ -121,8 +127,10 @@ struct private_handle_t
 		pid(getpid()),
 		ump_id((int)secure_id),
 		ump_mem_handle((int)handle),
-		offset(0)
-
+		offset(0),
+		stride_bytes(0),
+		dirty_offset(0),
+		dirty_size(0)
 	{
 		version = sizeof(native_handle);
 		numFds = sNumFds;
@@ -140,7 +148,10 @@ struct private_handle_t
 		pid(getpid()),
 		ump_id(0),
 		ump_mem_handle(-1),
-		offset(fb_offset)
+		offset(fb_offset),
+		stride_bytes(0),
+		dirty_offset(0),
+		dirty_size(0)
 	{
 		version = sizeof(native_handle);
 		numFds = sNumFds;
@@ -116,28 +116,64 @@ struct jpeg_args{
 	struct jpeg_enc_param	*enc_param;
 };
 
-struct jpeg_lib {
-	int  jpeg_fd;
-	struct jpeg_args args;
-};
+/*
+ * The driver maps the same reserved region for every open and codes from
+ * fixed in/out addresses in it, so the in/out buffers of every context,
+ * in every process, are the same memory. A context holds them between
+ * api_jpeg_lock() and api_jpeg_unlock() : from filling the input until
+ * the output is read back, nobody else runs the codec or touches them.
+ * The lock is flock() on the device, so it works across processes and
+ * between the contexts of one process; a thread must not wait for a
+ * second context while holding one. Exe / queue calls outside of a lock
+ * only keep the parameters and the run together.
+ * A context is used by one thread at a time, and its buffers belong to
+ * the codec from an exe / queue call until it returns / api_jpeg_wait()
+ * does.
+ */
+struct jpeg_lib;
+
+/* called from the queue thread when a queued request is done */
+typedef void (*jpeg_done_cb)(struct jpeg_lib *ctx, enum jpeg_ret_type ret, void *cookie);
 
 #ifdef __cplusplus 
 extern "C" { 
 #endif
-int api_jpeg_decode_init();
-int api_jpeg_encode_init();
-int api_jpeg_decode_deinit(int dev_fd);
-int api_jpeg_encode_deinit(int dev_fd);
-void *api_jpeg_get_decode_in_buf(int dev_fd, unsigned int size);
-void *api_jpeg_get_encode_in_buf(int dev_fd, unsigned int size);
-void *api_jpeg_get_decode_out_buf(int dev_fd);
-void *api_jpeg_get_encode_out_buf(int dev_fd);
-void api_jpeg_set_decode_param(struct jpeg_dec_param *param);
-void api_jpeg_set_encode_param(struct jpeg_enc_param *param);
-enum jpeg_ret_type api_jpeg_decode_exe(int dev_fd,
+struct jpeg_lib *api_jpeg_decode_init(void);
+struct jpeg_lib *api_jpeg_encode_init(void);
+int api_jpeg_decode_deinit(struct jpeg_lib *ctx);
+int api_jpeg_encode_deinit(struct jpeg_lib *ctx);
+int api_jpeg_get_fd(struct jpeg_lib *ctx);
+void *api_jpeg_get_decode_in_buf(struct jpeg_lib *ctx, unsigned int size);
+void *api_jpeg_get_encode_in_buf(struct jpeg_lib *ctx, unsigned int size);
+void *api_jpeg_get_decode_out_buf(struct jpeg_lib *ctx);
+void *api_jpeg_get_encode_out_buf(struct jpeg_lib *ctx);
+/* start of the in/out buffer mapping, NULL when the buffers are not mmapped */
+void *api_jpeg_get_encode_base(struct jpeg_lib *ctx);
+/* blocks until no other open holds the device, 0 on success */
+int api_jpeg_lock(struct jpeg_lib *ctx);
+/* waits for a queued request first */
+void api_jpeg_unlock(struct jpeg_lib *ctx);
+void api_jpeg_set_decode_param(struct jpeg_lib *ctx, struct jpeg_dec_param *param);
+void api_jpeg_set_encode_param(struct jpeg_lib *ctx, struct jpeg_enc_param *param);
+enum jpeg_ret_type api_jpeg_decode_exe(struct jpeg_lib *ctx,
 					struct jpeg_dec_param *dec_param);
-enum jpeg_ret_type api_jpeg_encode_exe(int dev_fd,
+enum jpeg_ret_type api_jpeg_encode_exe(struct jpeg_lib *ctx,
 					struct jpeg_enc_param *enc_param);
+
+/*
+ * Request queue : requests run in order on one thread, so the caller can
+ * do other work, e.g. scale a thumbnail, while its picture is coded.
+ * The device still codes one picture at a time, and a context has at
+ * most one request in flight; its result comes back through done (may
+ * be NULL) and api_jpeg_wait().
+ */
+int api_jpeg_queue_encode(struct jpeg_lib *ctx, struct jpeg_enc_param *enc_param,
+					jpeg_done_cb done, void *cookie);
+int api_jpeg_queue_decode(struct jpeg_lib *ctx, struct jpeg_dec_param *dec_param,
+					jpeg_done_cb done, void *cookie);
+enum jpeg_ret_type api_jpeg_wait(struct jpeg_lib *ctx);
+/* stream size of the last encode on ctx, queued or not */
+unsigned int api_jpeg_get_encode_size(struct jpeg_lib *ctx);
 #ifdef __cplusplus 
 }
 #endif
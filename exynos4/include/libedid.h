@@ -34,6 +34,8 @@ extern "C" {
 
 int EDIDOpen();
 int EDIDRead();
+int EDIDLoad(const unsigned char* const data, const int size);
+int EDIDLoadFile(const char* const path);
 void EDIDReset();
 /*
 int EDIDHDMIModeSupport(const struct HDMIVideoParameter const *video);
@@ -0,0 +1,163 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Syscall shim for the V4L2 / framebuffer / G2D users of this tree.
+ *
+ * With BOARD_USES_V4L2_SHIM defined, including this header as the LAST
+ * include of a translation unit routes open/close/ioctl/mmap/munmap/poll/
+ * flock of that file through libv4l2shim. The calls go to the real syscalls
+ * unless other ops are installed, e.g. the userspace device emulator,
+ * and every ioctl can be recorded by the trace recorder.
+ * Without BOARD_USES_V4L2_SHIM the header only declares the API.
+ */
+
+#ifndef __SEC_V4L2_SHIM_H__
+#define __SEC_V4L2_SHIM_H__
+
+// pull the real prototypes in before they are redirected below
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/file.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! syscalls seen by the shimmed libraries
+struct sec_v4l2_shim_ops
+{
+    int   (*open)  (const char *path, int flags, int mode);
+    int   (*close) (int fd);
+    int   (*ioctl) (int fd, int request, void *arg);
+    void *(*mmap)  (void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+    int   (*munmap)(void *addr, size_t len);
+    int   (*poll)  (struct pollfd *fds, nfds_t nfds, int timeout);
+    int   (*flock) (int fd, int operation);
+};
+
+//! install ops, NULL restores the real syscalls
+void sec_v4l2_shim_set_ops(const struct sec_v4l2_shim_ops *ops);
+const struct sec_v4l2_shim_ops *sec_v4l2_shim_real_ops(void);
+
+int   sec_v4l2_shim_open  (const char *path, int flags, ...);
+int   sec_v4l2_shim_close (int fd);
+int   sec_v4l2_shim_ioctl (int fd, int request, ...);
+void *sec_v4l2_shim_mmap  (void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+int   sec_v4l2_shim_munmap(void *addr, size_t len);
+int   sec_v4l2_shim_poll  (struct pollfd *fds, nfds_t nfds, int timeout);
+int   sec_v4l2_shim_flock (int fd, int operation);
+
+/*
+ * ioctl trace recorder
+ *
+ * Counts calls and wall time per ioctl request, in total and for the
+ * current frame. sec_v4l2_shim_trace_frame() closes a frame and keeps
+ * the worst frame seen, so per-frame budgets can be checked after a run.
+ */
+#define SEC_V4L2_SHIM_TRACE_MAX_REQUESTS (64)
+
+struct sec_v4l2_shim_trace_entry
+{
+    int          request;
+    unsigned int calls;
+    unsigned int errors;
+    long long    total_us;
+    long long    max_us;
+    unsigned int frame_calls;     // in the current frame
+    unsigned int frame_calls_max; // worst frame
+};
+
+struct sec_v4l2_shim_trace
+{
+    unsigned int frames;
+    unsigned int frame_calls;     // all requests, current frame
+    long long    frame_us;
+    unsigned int frame_calls_max; // all requests, worst frame
+    long long    frame_us_max;
+    unsigned int opens;
+    unsigned int mmaps;
+    unsigned int polls;
+    int          num_entries;
+    struct sec_v4l2_shim_trace_entry entries[SEC_V4L2_SHIM_TRACE_MAX_REQUESTS];
+};
+
+void sec_v4l2_shim_trace_enable(int enable);
+void sec_v4l2_shim_trace_reset(void);
+void sec_v4l2_shim_trace_frame(void);
+void sec_v4l2_shim_trace_get(struct sec_v4l2_shim_trace *trace);
+void sec_v4l2_shim_trace_dump(void);
+//! 0 if the worst frame stayed within max_calls ioctls and max_us, -1 otherwise (<= 0 : no limit)
+int  sec_v4l2_shim_trace_check_budget(unsigned int max_calls, long long max_us);
+
+/*
+ * Userspace device emulator
+ *
+ * Nodes are registered by path; opening a registered path returns an
+ * emulated fd, every other path goes to the real open().
+ */
+enum SEC_V4L2_EMUL_NODE
+{
+    SEC_V4L2_EMUL_CAPTURE = 0, // camera : V4L2 capture, mmap buffers
+    SEC_V4L2_EMUL_OUTPUT,      // FIMC, tvout video : V4L2 output
+    SEC_V4L2_EMUL_FB,          // fimd, tvout graphic layers : S3CFB / S5PTVFB
+    SEC_V4L2_EMUL_G2D,         // /dev/fimg2d
+    SEC_V4L2_EMUL_HPD,         // /dev/HPD
+    SEC_V4L2_EMUL_JPEG,        // /dev/s5p-jpeg : IOCTL_JPEG_*, software stand-in codec
+};
+
+struct sec_v4l2_emul_config
+{
+    int          ioctl_latency_us; // added to every ioctl
+    int          frame_interval_us;// DQBUF and vsync pacing, jpeg coding time, 0 : no wait
+    int          width;            // fb resolution, default format
+    int          height;
+    int          bpp;
+    unsigned int phys_base;        // fake physical addresses start here
+};
+
+//! install the emulator ops (sec_v4l2_shim_set_ops)
+void sec_v4l2_emul_install(void);
+void sec_v4l2_emul_uninstall(void);
+
+int  sec_v4l2_emul_add_node(const char *path, enum SEC_V4L2_EMUL_NODE type,
+                            const struct sec_v4l2_emul_config *config);
+void sec_v4l2_emul_remove_all(void);
+
+//! value returned by VIDIOC_G_CTRL(id) until the library sets it
+int  sec_v4l2_emul_set_ctrl(const char *path, unsigned int id, int value);
+//! state returned by HPD_GET_STATE
+void sec_v4l2_emul_set_hpd(int state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(BOARD_USES_V4L2_SHIM)
+#define open(...)    sec_v4l2_shim_open(__VA_ARGS__)
+#define close(fd)    sec_v4l2_shim_close(fd)
+#define ioctl(...)   sec_v4l2_shim_ioctl(__VA_ARGS__)
+#define mmap(...)    sec_v4l2_shim_mmap(__VA_ARGS__)
+#define munmap(...)  sec_v4l2_shim_munmap(__VA_ARGS__)
+#define poll(...)    sec_v4l2_shim_poll(__VA_ARGS__)
+#define flock(...)   sec_v4l2_shim_flock(__VA_ARGS__)
+#endif
+
+#endif // __SEC_V4L2_SHIM_H__
@@ -1,9 +1,10 @@
 # When zero we link against libqcamera; when 1, we dlopen libqcamera.
+LOCAL_PATH:= $(call my-dir)
+
 ifeq ($(BOARD_CAMERA_LIBRARIES),libcamera)
 
 DLOPEN_LIBSECCAMERA:=1
 
-LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_CFLAGS:=-fno-short-enums
@@ -17,12 +18,15 @@ endif
 
 LOCAL_SRC_FILES:= \
 	SecCamera.cpp \
+	SecCameraPostProc.cpp \
+	SecCameraConvert.cpp \
 	SecCameraHWInterface.cpp
 
 LOCAL_CFLAGS += -DSLSI_S5PC210
 
-LOCAL_SHARED_LIBRARIES:= libutils libui liblog libbinder
+LOCAL_SHARED_LIBRARIES:= libutils libcutils libui liblog libbinder
 LOCAL_SHARED_LIBRARIES+= libcamera_client
+LOCAL_SHARED_LIBRARIES+= libfimc
 ifeq ($(BOARD_SUPPORT_SYSMMU),true)
 LOCAL_SHARED_LIBRARIES+= libMali
 endif
@@ -35,6 +39,11 @@ ifeq ($(BOARD_SUPPORT_SYSMMU),true)
 LOCAL_CFLAGS+=-DBOARD_SUPPORT_SYSMMU
 endif
 
+# preview callback conversion kernels
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_CFLAGS += -mfpu=neon
+endif
+
 ifeq ($(BOARD_USES_CAMERA_OVERLAY),true)
 LOCAL_CFLAGS += -DBOARD_USES_CAMERA_OVERLAY
 endif
@@ -51,6 +60,11 @@ ifeq ($(BOARD_SUPPORT_SYSMMU),true)
 LOCAL_C_INCLUDES += device/sec/sec_proprietary/include
 endif
 
+ifeq ($(BOARD_USES_V4L2_SHIM),true)
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM
+LOCAL_SHARED_LIBRARIES += libv4l2shim
+endif
+
 LOCAL_MODULE_TAGS := eng
 
 LOCAL_MODULE:= libcamera
@@ -59,3 +73,4 @@ include $(BUILD_SHARED_LIBRARY)
 
 endif
 
+include $(call all-makefiles-under,$(LOCAL_PATH))
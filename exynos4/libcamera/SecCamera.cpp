@@ -26,6 +26,7 @@
 #define LOG_TAG "SecCamera"
 #include <utils/Log.h>
 #include "SecCamera.h"
+#include "sec_v4l2_shim.h"
 
 #define CHECK(return_value)                                        \
                 if((return_value) < 0)                               \
@@ -422,6 +423,36 @@ static int fimc_v4l2_querybuf(int fp, struct fimc_buffer *buffers, enum v4l2_buf
     return 0;
 }
 
+// same as fimc_v4l2_querybuf(), but every buffer is mapped
+static int fimc_v4l2_querybuf_map(int fp, struct fimc_buffer *buffers, enum v4l2_buf_type type, int nr_frames)
+{
+    struct v4l2_buffer v4l2_buf;
+    int i, ret;
+
+    for(i = 0; i < nr_frames; i++) {
+        v4l2_buf.type = type;
+        v4l2_buf.memory = V4L2_MEMORY_MMAP;
+        v4l2_buf.index = i;
+
+        ret = ioctl(fp, VIDIOC_QUERYBUF, &v4l2_buf);
+        if(ret < 0) {
+            LOGE("ERR(%s):VIDIOC_QUERYBUF failed\n", __FUNCTION__);
+            return -1;
+        }
+
+        buffers[i].length = v4l2_buf.length;
+        buffers[i].start  = (char *)mmap(0, v4l2_buf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                         fp, v4l2_buf.m.offset);
+        if (buffers[i].start == MAP_FAILED) {
+            LOGE("%s %d] mmap() failed\n",__func__, __LINE__);
+            buffers[i].start = NULL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 static int fimc_v4l2_streamon(int fp)
 {
     enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -485,38 +516,74 @@ static int fimc_v4l2_dqbuf(int fp)
     return v4l2_buf.index;
 }
 
-static int fimc_v4l2_blk_dqbuf(int fp, struct pollfd *events)
+static int fimc_v4l2_dqbuf_time(int fp, struct timeval *timestamp)
 {
     struct v4l2_buffer v4l2_buf;
-    int index;
-    int ret = 0;
+    int ret;
 
     v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     v4l2_buf.memory = V4L2_MEMORY_MMAP;
 
     ret = ioctl(fp, VIDIOC_DQBUF, &v4l2_buf);
     if (ret < 0) {
-        LOGV("VIDIOC_DQBUF first is empty") ;
-        fimc_poll(events);
-        return fimc_v4l2_dqbuf(fp);
-    } else {
-        index = v4l2_buf.index;
-        while(ret == 0)
-        {
-            ret = ioctl(fp, VIDIOC_DQBUF, &v4l2_buf);
-            if (ret == 0) {
-                LOGV("VIDIOC_DQBUF is not still empty %d",v4l2_buf.index);
-                fimc_v4l2_qbuf(fp, index);
-                index = v4l2_buf.index;
-            } else {
-                LOGV("VIDIOC_DQBUF is empty now %d ",index);
-                return index;
-            }
-        }
+        LOGE("ERR(%s):VIDIOC_DQBUF failed\n", __FUNCTION__);
+        return ret;
     }
+
+    *timestamp = v4l2_buf.timestamp;
     return v4l2_buf.index;
 }
 
+// the driver stamps frames with the wall clock, move the stamp to
+// SYSTEM_TIME_MONOTONIC. a missing or odd stamp gives the current time.
+static nsecs_t fimc_frame_time(const struct timeval *tv)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t age = systemTime(SYSTEM_TIME_REALTIME) - s2ns(tv->tv_sec) - us2ns(tv->tv_usec);
+
+    if (tv->tv_sec != 0 && 0 <= age && age < s2ns(1))
+        return now - age;
+
+    return now;
+}
+
+// waits for a frame and takes the newest one completed. older frames go
+// straight back to the driver and are counted in *skipped.
+static int fimc_v4l2_blk_dqbuf(int fp, struct pollfd *events,
+                               struct timeval *timestamp, int *skipped)
+{
+    struct v4l2_buffer v4l2_buf;
+    int index;
+
+    *skipped = 0;
+
+    if (fimc_poll(events) <= 0)
+        return -1;
+
+    v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    v4l2_buf.memory = V4L2_MEMORY_MMAP;
+
+    if (ioctl(fp, VIDIOC_DQBUF, &v4l2_buf) < 0) {
+        LOGE("ERR(%s):VIDIOC_DQBUF failed\n", __FUNCTION__);
+        return -1;
+    }
+    index      = v4l2_buf.index;
+    *timestamp = v4l2_buf.timestamp;
+
+    while (poll(events, 1, 0) > 0) {
+        if (ioctl(fp, VIDIOC_DQBUF, &v4l2_buf) < 0)
+            break;
+
+        LOGV("VIDIOC_DQBUF is not still empty %d", v4l2_buf.index);
+        fimc_v4l2_qbuf(fp, index);
+        (*skipped)++;
+        index      = v4l2_buf.index;
+        *timestamp = v4l2_buf.timestamp;
+    }
+
+    return index;
+}
+
 static int fimc_v4l2_g_ctrl(int fp, unsigned int id)
 {
     struct v4l2_control ctrl;
@@ -637,10 +704,19 @@ SecCamera::SecCamera() :
         m_sharpness            (SHARPNESS_NOMAL),
         m_saturation           (SATURATION_NOMAL),
         m_zoom                 (ZOOM_BASE),
+        m_zoom_request_time    (0),
+        m_zoom_frames          (0),
+        m_zoom_latency         (0),
+        m_zoom_latency_max     (0),
         m_angle                (0),
         m_af_mode              (AF_MODE_AUTO),
         m_flag_preview_start    (FLAG_OFF),
         m_flag_current_info_changed(FLAG_ON),
+        m_flag_ctrl_changed    (FLAG_OFF),
+        m_ctrl_count           (0),
+        m_flag_ext_ctrls       (FLAG_ON),
+        m_ctrl_writes          (0),
+        m_ctrl_ioctls          (0),
         m_current_camera_id    (-1),
         m_current_frame_rate   (-1),
         m_current_scene_mode   (SCENE_MODE_AUTO),
@@ -652,15 +728,57 @@ SecCamera::SecCamera() :
         m_current_saturation   (SATURATION_NOMAL),
         m_current_zoom         (ZOOM_BASE),
         m_current_af_mode      (AF_MODE_BASE),
+        m_jpeg_ctx             (NULL),
+        m_jpeg_in_buf          (NULL),
+        m_jpeg_out_buf         (NULL),
+        m_jpeg_shots           (0),
+        m_jpeg_copy_bytes      (0),
+        m_snapshot_phys        (0),
+#ifdef INCLUDE_JPEG_THUMBNAIL
+        m_jpeg_thumb_in_buf    (NULL),
+        m_jpeg_pic_buf         (NULL),
+        m_exif_buf             (NULL),
+        m_jpeg_hw_thumbs       (0),
+#endif
         m_jpeg_thumbnail_width (0),
         m_jpeg_thumbnail_height(0),
+        m_jpeg_thumbnail_quality(100),
         m_jpeg_quality         (99),
+        m_gps_enabled          (0),
         m_gps_latitude         (0.0f),
         m_gps_longitude        (0.0f),
         m_gps_timestamp        (0),
         m_gps_altitude         (169),
-        m_nframe                (1)
+        m_nframe                (1),
+#ifdef ZERO_SHUTTER_LAG
+        m_cam_fd_zsl            (-1),
+        m_zsl_input             (0),
+        m_flag_zsl              (FLAG_OFF),
+        m_flag_zsl_start        (FLAG_OFF),
+        m_zsl_nframe            (ZSL_DEFAULT_BUFFERS),
+        m_zsl_width             (0),
+        m_zsl_height            (0),
+        m_zsl_v4lformat         (-1),
+        m_zsl_pick              (-1),
+#endif
+#ifdef BURST_CAPTURE
+        m_flag_burst_start      (FLAG_OFF),
+        m_burst_nframe          (0),
+#endif
+        m_shutter_time          (0),
+        m_last_shutter_time     (0),
+        m_shutter_lag           (0),
+        m_shot_to_shot          (0)
 {
+#ifdef ZERO_SHUTTER_LAG
+    memset(m_buffers_zsl, 0, sizeof(m_buffers_zsl));
+#endif
+#ifdef DUAL_PORT_RECORDING
+    memset(m_record_refs, 0, sizeof(m_record_refs));
+    m_record_gen = 0;
+#endif
+    memset(m_jpeg_stage_time,     0, sizeof(m_jpeg_stage_time));
+    memset(m_jpeg_stage_time_max, 0, sizeof(m_jpeg_stage_time_max));
     LOGV("%s()", __FUNCTION__);
 
 //    if(this->Create() < 0)
@@ -679,10 +797,8 @@ void SecCamera::releaseframe(int i)
     LOGV("releaseframe : (%d)",i);
 
 #ifdef DUAL_PORT_RECORDING
-    int ret = fimc_v4l2_qbuf(m_cam_fd2, i);
+    releaseRecordFrame(i, m_record_gen);
 #endif
- //  CHECK(ret);
-
 }
 
 int SecCamera::Create(int cameraId)
@@ -731,7 +847,17 @@ int SecCamera::Create(int cameraId)
         ret = fimc_v4l2_s_input(m_cam_fd2, index);
         CHECK(ret);
 #endif
+
+#ifdef ZERO_SHUTTER_LAG
+        // the port is only taken by m_startZsl()
+        m_zsl_input = camera_index;
+#endif
         m_camera_id = index;
+
+        // the encoder session lives as long as the camera
+        LOGE_IF(openJpeg() < 0,
+                "ERR(%s):Fail on openJpeg(), retried at the first picture\n", __FUNCTION__);
+
         m_flag_create = FLAG_ON;
     }
     return 0;
@@ -749,12 +875,15 @@ void SecCamera::Destroy()
         stopRecord();
 #endif
 
+#ifdef ZERO_SHUTTER_LAG
+        m_stopZsl();
+#endif
+
+#ifdef BURST_CAPTURE
+        stopBurst();
+#endif
 
-        if(m_jpeg_fd > 0) {
-            LOGE_IF(api_jpeg_encode_deinit(m_jpeg_fd) != JPEG_OK,
-                    "ERR(%s):Fail on api_jpeg_encode_deinit\n", __FUNCTION__);
-            m_jpeg_fd = 0;
-        }
+        closeJpeg();
 
         LOGV("m_cam_fd(%d)", m_cam_fd);
         if(m_cam_fd > 0) {
@@ -804,6 +933,14 @@ int SecCamera::startPreview(void)
 
     int ret = 0;
 
+#ifdef BURST_CAPTURE
+    // the burst stream holds the capture port
+    stopBurst();
+#endif
+
+    // preview overwrites the last snapshot
+    m_snapshot_phys = 0;
+
     memset(&m_events_c, 0, sizeof(m_events_c));
     m_events_c.fd = m_cam_fd;
     m_events_c.events = POLLIN | POLLERR;
@@ -844,6 +981,23 @@ int SecCamera::startPreview(void)
     CHECK(ret);
 
     m_flag_preview_start = FLAG_ON;
+
+#ifdef ZERO_SHUTTER_LAG
+    // the ring follows the snapshot size / format and stays within the
+    // preview, restart it if they changed
+    if (m_flag_zsl_start == FLAG_ON
+        && (m_zsl_width     != m_snapshot_width
+         || m_zsl_height    != m_snapshot_height
+         || m_zsl_v4lformat != m_snapshot_v4lformat
+         || m_preview_width  < m_zsl_width
+         || m_preview_height < m_zsl_height))
+        m_stopZsl();
+
+    if (m_flag_zsl == FLAG_ON && m_flag_zsl_start == FLAG_OFF)
+        LOGE_IF(m_startZsl() < 0,
+                "ERR(%s):m_startZsl() fail, snapshots restart the sensor\n", __FUNCTION__);
+#endif
+
     LOGI("--%s() \n", __FUNCTION__);
 
     return 0;
@@ -866,6 +1020,10 @@ int SecCamera::stopPreview(void)
     int ret = fimc_v4l2_streamoff(m_cam_fd);
 
     m_flag_preview_start = FLAG_OFF; //Kamat check
+#ifdef ZERO_SHUTTER_LAG
+    // the sensor keeps streaming into the zsl ring, its settings stay valid
+    if (m_flag_zsl_start == FLAG_OFF)
+#endif
     m_flag_current_info_changed = FLAG_ON;
     CHECK(ret);
 
@@ -897,11 +1055,17 @@ int SecCamera::startRecord(void)
         return -1;
     }
 
+#ifdef ZERO_SHUTTER_LAG
+    // the ring runs on this port, snapshots restart the sensor until stopRecord()
+    m_stopZsl();
+#endif
+
     memset(&m_events_c2, 0, sizeof(m_events_c2));
     m_events_c2.fd = m_cam_fd2;
     m_events_c2.events = POLLIN | POLLERR;
 
-    int color_format = V4L2_PIX_FMT_NV12;
+    // MFC takes tiled frames straight from FIMC
+    int color_format = RECORD_V4L2_FORMAT;
 
     ret = fimc_v4l2_enum_fmt(m_cam_fd2,color_format);
     CHECK(ret);
@@ -909,6 +1073,10 @@ int SecCamera::startRecord(void)
 
     ret = fimc_v4l2_s_fmt(m_cam_fd2, m_preview_width, m_preview_height, color_format, 0);
     CHECK(ret);
+#ifdef USE_SEC_CROP_ZOOM
+    // the same field of view as the preview
+    m_setCrop(m_cam_fd2, m_zoom, m_preview_width, m_preview_height);
+#endif
 /*
     if(m_resetCamera() < 0) {
         LOGE("ERR(%s):m_resetCamera() fail\n", __FUNCTION__);
@@ -940,7 +1108,16 @@ int SecCamera::startRecord(void)
     ret = fimc_v4l2_qbuf(m_cam_fd2, index);
     CHECK(ret);
 
-    m_flag_record_start = FLAG_ON;
+    {
+        Mutex::Autolock lock(m_record_lock);
+
+        // the encoder may still hold frames of the last session, they
+        // are refused by the generation when they come back
+        for (int i = 0; i < MAX_BUFFERS; i++)
+            m_record_refs[i] = 0;
+        m_record_gen++;
+        m_flag_record_start = FLAG_ON;
+    }
 
     LOGI("--%s() \n", __FUNCTION__);
 
@@ -962,11 +1139,20 @@ int SecCamera::stopRecord(void)
         return -1;
     }
 
+    Mutex::Autolock lock(m_record_lock);
+
+    // frames still held by the encoder are not queued again
     int ret = fimc_v4l2_streamoff(m_cam_fd2);
 
     m_flag_record_start = FLAG_OFF; //Kamat check
     CHECK(ret);
 
+#ifdef ZERO_SHUTTER_LAG
+    if (m_flag_zsl == FLAG_ON && m_flag_preview_start == FLAG_ON)
+        LOGE_IF(m_startZsl() < 0,
+                "ERR(%s):m_startZsl() fail, snapshots restart the sensor\n", __FUNCTION__);
+#endif
+
     LOGI("--%s() \n", __FUNCTION__);
 
     return 0;
@@ -1012,9 +1198,15 @@ void SecCamera::pausePreview()
     fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_STREAM_PAUSE, 0);
 }
 
-int SecCamera::getPreview()
+// the frame stays out of the driver until releasePreviewFrame(). timestamp
+// is the capture time on SYSTEM_TIME_MONOTONIC, skipped the frames that
+// completed behind it and went back unseen.
+int SecCamera::getPreviewFrame(nsecs_t *timestamp, int *skipped)
 {
     int index;
+    struct timeval tv = { 0, 0 };
+
+    *skipped = 0;
 
     if(m_resetCamera() < 0) {
         LOGE("ERR(%s):m_resetCamera() fail\n", __FUNCTION__);
@@ -1027,7 +1219,7 @@ int SecCamera::getPreview()
     LOG_TIME_DEFINE(1)
 
     LOG_TIME_START(0)
-    //    fimc_poll(&m_events_c);
+    fimc_poll(&m_events_c);
     LOG_TIME_END(0)
     LOG_CAMERA("fimc_poll interval: %lu us", LOG_TIME(0));
 
@@ -1037,26 +1229,83 @@ int SecCamera::getPreview()
     LOG_CAMERA("fimc_dqbuf interval: %lu us", LOG_TIME(1));
 
 #else
-//    fimc_poll(&m_events_c);
-//    index = fimc_v4l2_dqbuf(m_cam_fd);
-    index = fimc_v4l2_blk_dqbuf(m_cam_fd, &m_events_c);
+    index = fimc_v4l2_blk_dqbuf(m_cam_fd, &m_events_c, &tv, skipped);
 #endif
     if(!(0 <= index && index < MAX_BUFFERS)) {
         LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
         return -1;
     }
 
-    int ret = fimc_v4l2_qbuf(m_cam_fd, index); //Kamat: is it overhead?
-    CHECK(ret);
+    *timestamp = fimc_frame_time(&tv);
+
+    // the frame being captured at setZoom() may still have the old crop,
+    // the one after it cannot
+    if (m_zoom_request_time != 0 && m_zoom_request_time < *timestamp
+        && ++m_zoom_frames == 2) {
+        m_zoom_latency = systemTime(SYSTEM_TIME_MONOTONIC) - m_zoom_request_time;
+        if (m_zoom_latency_max < m_zoom_latency)
+            m_zoom_latency_max = m_zoom_latency;
+        m_zoom_request_time = 0;
+    }
+
+#ifdef ZERO_SHUTTER_LAG
+    if (m_flag_zsl_start == FLAG_ON) {
+        Mutex::Autolock lock(m_zsl_lock);
+        m_drainZsl();
+    }
+#endif
 
     return index;
+}
+
+int SecCamera::releasePreviewFrame(int index)
+{
+    if (m_flag_preview_start == FLAG_OFF)
+        return 0;
+
+    if (!(0 <= index && index < MAX_BUFFERS)) {
+        LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
+        return -1;
+    }
+
+    int ret = fimc_v4l2_qbuf(m_cam_fd, index);
+    CHECK(ret);
 
+    return 0;
+}
+
+int SecCamera::getPreview()
+{
+    nsecs_t timestamp;
+    int     skipped;
+    int     index;
+
+    index = getPreviewFrame(&timestamp, &skipped);
+    if (index < 0)
+        return index;
+
+    // the caller reads the frame while the driver may fill it again
+    if (releasePreviewFrame(index) < 0)
+        return -1;
+
+    return index;
 }
 
 #ifdef DUAL_PORT_RECORDING
 int SecCamera::getRecord()
+{
+    nsecs_t timestamp;
+    unsigned int gen;
+
+    return getRecordFrame(&timestamp, &gen);
+}
+
+// the frame comes with one reference, it is queued to the driver again
+// when the last one goes with releaseRecordFrame() of the same generation
+int SecCamera::getRecordFrame(nsecs_t *timestamp, unsigned int *gen)
 {
     int index;
+    struct timeval tv = { 0, 0 };
 
 #ifdef PERFORMANCE
     LOG_TIME_DEFINE(0)
@@ -1068,23 +1317,88 @@ int SecCamera::getRecord()
     LOG_CAMERA("fimc_poll interval: %lu us", LOG_TIME(0));
 
     LOG_TIME_START(1)
-    index = fimc_v4l2_dqbuf(m_cam_fd2);
+    index = fimc_v4l2_dqbuf_time(m_cam_fd2, &tv);
     LOG_TIME_END(1)
     LOG_CAMERA("fimc_dqbuf interval: %lu us", LOG_TIME(1));
 #else
     fimc_poll(&m_events_c2);
-    index = fimc_v4l2_dqbuf(m_cam_fd2);
+    index = fimc_v4l2_dqbuf_time(m_cam_fd2, &tv);
 #endif
     if(!(0 <= index && index < MAX_BUFFERS)) {
         LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
         return -1;
     }
 
-    //int ret = fimc_v4l2_qbuf(m_cam_fd2, index); //Kamat: is it overhead?
-    //CHECK(ret);
+    *timestamp = fimc_frame_time(&tv);
+
+    Mutex::Autolock lock(m_record_lock);
+    m_record_refs[index] = 1;
+    *gen = m_record_gen;
 
     return index;
 }
+
+// buffers left with the driver; 0 means the next getRecordFrame() would
+// wait for the encoder
+int SecCamera::getRecordQueued(void)
+{
+    Mutex::Autolock lock(m_record_lock);
+    int queued = 0;
+
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (m_record_refs[i] == 0)
+            queued++;
+    }
+
+    return queued;
+}
+
+void SecCamera::refRecordFrame(int index)
+{
+    Mutex::Autolock lock(m_record_lock);
+
+    if (!(0 <= index && index < MAX_BUFFERS) || m_record_refs[index] == 0) {
+        LOGE("ERR(%s):frame %d is not held\n", __FUNCTION__, index);
+        return;
+    }
+
+    m_record_refs[index]++;
+}
+
+int SecCamera::releaseRecordFrame(int index, unsigned int gen)
+{
+    Mutex::Autolock lock(m_record_lock);
+
+    if (!(0 <= index && index < MAX_BUFFERS)) {
+        LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
+        return -1;
+    }
+
+    // a frame of a recording before the last startRecord()
+    if (gen != m_record_gen) {
+        LOGV("%s:frame %d of session %u, now %u", __FUNCTION__, index, gen, m_record_gen);
+        return 0;
+    }
+
+    // a release after stopRecord() or a second one for the same frame
+    if (m_record_refs[index] == 0) {
+        LOGV("%s:frame %d is not held", __FUNCTION__, index);
+        return 0;
+    }
+
+    if (--m_record_refs[index] != 0 || m_flag_record_start == FLAG_OFF)
+        return 0;
+
+    int ret = fimc_v4l2_qbuf(m_cam_fd2, index);
+    CHECK(ret);
+
+    return 0;
+}
+
+int SecCamera::getRecordPixelFormat(void)
+{
+    return RECORD_V4L2_FORMAT;
+}
 #endif //DUAL_PORT_RECORDING
 
 int SecCamera::setPreviewSize(int width, int height, int pixel_format)
@@ -1151,7 +1465,112 @@ void SecCamera::CloseJpegBuffer(void)
 
 int SecCamera::getJpegFd(void)
 {
-    return m_jpeg_fd;
+    if(m_jpeg_ctx == NULL)
+        return 0;
+
+    return api_jpeg_get_fd(m_jpeg_ctx);
+}
+
+int SecCamera::openJpeg(void)
+{
+    if(m_jpeg_ctx != NULL)
+        return 0;
+
+    m_jpeg_ctx = api_jpeg_encode_init();
+    if(m_jpeg_ctx == NULL) {
+        LOGE("ERR(%s):Cannot open a jpeg device file\n", __FUNCTION__);
+        return -1;
+    }
+    LOGV("(%s):JPEG device open ID = %d\n", __FUNCTION__, api_jpeg_get_fd(m_jpeg_ctx));
+
+    m_jpeg_in_buf  = (unsigned char*)api_jpeg_get_encode_in_buf(m_jpeg_ctx, JPEG_FRAME_BUF_SIZE);
+    m_jpeg_out_buf = (unsigned char*)api_jpeg_get_encode_out_buf(m_jpeg_ctx);
+    if(m_jpeg_in_buf == NULL || m_jpeg_out_buf == NULL) {
+        LOGE("ERR(%s):Fail on jpeg in(%p) / out(%p) buffer\n",
+                __FUNCTION__, m_jpeg_in_buf, m_jpeg_out_buf);
+        closeJpeg();
+        return -1;
+    }
+
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    // the thumbnail is coded in the same codec buffers after the picture,
+    // which waits in m_jpeg_pic_buf. pictures still go out when these fail
+    m_jpeg_thumb_in_buf = (unsigned char*)malloc(THUMBNAIL_BUF_SIZE);
+    if(m_jpeg_thumb_in_buf == NULL)
+        LOGE("ERR(%s):Fail on malloc(%d), no thumbnails\n", __FUNCTION__, THUMBNAIL_BUF_SIZE);
+
+    m_exif_buf    = (unsigned char*)malloc(EXIF_APP1_MAX_SIZE);
+    m_jpeg_pic_buf = (unsigned char*)malloc(JPEG_PICTURE_BUF_SIZE);
+    if(m_exif_buf == NULL || m_jpeg_pic_buf == NULL)
+        LOGE("ERR(%s):Fail on the EXIF buffers, no EXIF\n", __FUNCTION__);
+#endif
+
+    return 0;
+}
+
+void SecCamera::closeJpeg(void)
+{
+    if(m_jpeg_ctx != NULL) {
+        LOGE_IF(api_jpeg_encode_deinit(m_jpeg_ctx) != JPEG_OK,
+                "ERR(%s):Fail on api_jpeg_encode_deinit\n", __FUNCTION__);
+        m_jpeg_ctx = NULL;
+    }
+
+    m_jpeg_in_buf  = NULL;
+    m_jpeg_out_buf = NULL;
+
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    free(m_jpeg_thumb_in_buf);
+    free(m_jpeg_pic_buf);
+    free(m_exif_buf);
+    m_jpeg_thumb_in_buf = NULL;
+    m_jpeg_pic_buf      = NULL;
+    m_exif_buf          = NULL;
+#endif
+}
+
+// the codec buffers are the same memory for every open of the device, in
+// any process : hold them from filling the input until the picture is out
+int SecCamera::lockJpeg(void)
+{
+    if(openJpeg() < 0)
+        return -1;
+
+    if(api_jpeg_lock(m_jpeg_ctx) < 0) {
+        LOGE("ERR(%s):Fail on api_jpeg_lock\n", __FUNCTION__);
+        return -1;
+    }
+
+    return 0;
+}
+
+void SecCamera::unlockJpeg(void)
+{
+    if(m_jpeg_ctx != NULL)
+        api_jpeg_unlock(m_jpeg_ctx);
+}
+
+unsigned char *SecCamera::getJpegInBuf(void)
+{
+    return m_jpeg_in_buf;
+}
+
+// offsets of the encoder in/out buffers in a mapping of getJpegFd()
+int SecCamera::getJpegBufOffsets(int * in_offset, int * out_offset)
+{
+    unsigned char * base;
+
+    if(m_jpeg_ctx == NULL)
+        return -1;
+
+    base = (unsigned char*)api_jpeg_get_encode_base(m_jpeg_ctx);
+    if(base == NULL)
+        return -1;
+
+    *in_offset  = m_jpeg_in_buf  - base;
+    *out_offset = m_jpeg_out_buf - base;
+
+    return 0;
 }
 
 void SecCamera::setJpgAddr(unsigned char *addr)
@@ -1173,6 +1592,18 @@ unsigned int SecCamera::getSnapshot(unsigned char *rawBuffer, int pictureSize)
     LOG_TIME_DEFINE(4)
     LOG_TIME_DEFINE(5)
 
+#ifdef ZERO_SHUTTER_LAG
+    if (m_flag_zsl_start == FLAG_ON) {
+        if (   m_zsl_width     == m_snapshot_width
+            && m_zsl_height    == m_snapshot_height
+            && m_zsl_v4lformat == m_snapshot_v4lformat)
+            return m_getZslSnapshot(rawBuffer, pictureSize);
+
+        // snapshot size / format changed after the ring was started
+        m_stopZsl();
+    }
+#endif
+
     LOG_TIME_START(0)
     stopPreview();
     LOG_TIME_END(0)
@@ -1228,35 +1659,576 @@ unsigned int SecCamera::getSnapshot(unsigned char *rawBuffer, int pictureSize)
     fimc_poll(&m_events_c);
     index = fimc_v4l2_dqbuf(m_cam_fd);
 
-    LOGI("snapshot dqueued buffer = %d snapshot_width = %d snapshot_height = %d",
-            index, m_snapshot_width, m_snapshot_height);
+    if (m_shutter_time != 0) {
+        m_shutter_lag  = systemTime(SYSTEM_TIME_MONOTONIC) - m_shutter_time;
+        m_shutter_time = 0;
+    }
+
+    LOGI("snapshot dqueued buffer = %d snapshot_width = %d snapshot_height = %d",
+            index, m_snapshot_width, m_snapshot_height);
+
+#ifdef DUMP_YUV
+    save_yuv(m_buffers_c, m_snapshot_width, m_snapshot_height, 16, index, 0);
+#endif
+    LOG_TIME_END(2)
+
+    addr = getPhyAddrY(index);
+    if(addr == 0)
+        LOGE("%s] Physical address 0", __FUNCTION__);
+
+    LOGI("phyaddr = 0x%x, index = %d, m_buffers_c[%d].start = 0x%p",
+            addr, index, index, m_buffers_c[index].start);
+    memcpy(rawBuffer, m_buffers_c[index].start, pictureSize);
+
+    fimc_v4l2_streamoff(m_cam_fd);
+
+    close_buffers(m_buffers_c);
+
+    LOG_CAMERA("getSnapshot intervals : stopPreview(%lu), prepare(%lu), capture(%lu), "
+            "memcpy(%lu), yuv2Jpeg(%lu), post(%lu)  us",
+            LOG_TIME(0), LOG_TIME(1), LOG_TIME(2),
+            LOG_TIME(3), LOG_TIME(4), LOG_TIME(5));
+
+    LOGI("%s:shutter lag %lld ms, shot to shot %lld ms\n", __FUNCTION__,
+            ns2ms(m_shutter_lag), ns2ms(m_shot_to_shot));
+
+    // stays untouched until the next capture, the thumbnail is scaled from it
+    m_snapshot_phys = addr;
+
+    LOGI("--%s() \n", __FUNCTION__);
+
+    return addr;
+}
+
+// ======================================================================
+// Zero shutter lag
+
+void SecCamera::markShutter(void)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (m_last_shutter_time != 0)
+        m_shot_to_shot = now - m_last_shutter_time;
+    m_last_shutter_time = now;
+    m_shutter_time      = now;
+
+#ifdef ZERO_SHUTTER_LAG
+    if (m_flag_zsl_start == FLAG_ON) {
+        Mutex::Autolock lock(m_zsl_lock);
+        m_pickZsl(now);
+    }
+#endif
+}
+
+void SecCamera::getCaptureStats(nsecs_t *shutter_lag, nsecs_t *shot_to_shot)
+{
+    *shutter_lag  = m_shutter_lag;
+    *shot_to_shot = m_shot_to_shot;
+}
+
+int SecCamera::setZsl(int flag_on, int nr_frames)
+{
+#ifdef ZERO_SHUTTER_LAG
+    LOGV("%s(flag_on(%d), nr_frames(%d))", __FUNCTION__, flag_on, nr_frames);
+
+    if (nr_frames < ZSL_MIN_BUFFERS)
+        nr_frames = ZSL_MIN_BUFFERS;
+    if (MAX_BUFFERS < nr_frames)
+        nr_frames = MAX_BUFFERS;
+
+    // a running ring is restarted by the next startPreview()
+    if (m_flag_zsl_start == FLAG_ON && (!flag_on || m_zsl_nframe != nr_frames))
+        m_stopZsl();
+
+    m_flag_zsl    = flag_on ? FLAG_ON : FLAG_OFF;
+    m_zsl_nframe  = nr_frames;
+
+    return 0;
+#else
+    if (flag_on) {
+        LOGE("ERR(%s):zero shutter lag is not supported\n", __FUNCTION__);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+int SecCamera::flagZsl(void)
+{
+#ifdef ZERO_SHUTTER_LAG
+    return m_flag_zsl_start == FLAG_ON;
+#else
+    return 0;
+#endif
+}
+
+#ifdef ZERO_SHUTTER_LAG
+int SecCamera::m_startZsl(void)
+{
+    LOGV("++%s() \n", __FUNCTION__);
+
+    int ret;
+
+    if (m_flag_zsl_start == FLAG_ON)
+        return 0;
+
+    // the sensor streams at the preview size, FIMC would only upscale it
+    if (m_preview_width < m_snapshot_width || m_preview_height < m_snapshot_height) {
+        LOGI("%s:snapshot %d x %d is bigger than the preview %d x %d, no ring\n",
+                __FUNCTION__, m_snapshot_width, m_snapshot_height,
+                m_preview_width, m_preview_height);
+        return -1;
+    }
+
+#ifdef DUAL_PORT_RECORDING
+    if (m_flag_record_start == FLAG_ON) {
+        LOGV("%s:%s is recording\n", __FUNCTION__, CAMERA_DEV_NAME_ZSL);
+        return -1;
+    }
+
+    // the recording port is already open and switched to the sensor
+    m_cam_fd_zsl = m_cam_fd2;
+#else
+    m_cam_fd_zsl = open(CAMERA_DEV_NAME_ZSL, O_RDWR);
+    if (m_cam_fd_zsl < 0) {
+        LOGE("ERR(%s):Cannot open %s (error : %s)\n",
+                __FUNCTION__, CAMERA_DEV_NAME_ZSL, strerror(errno));
+        return -1;
+    }
+
+    if (fimc_v4l2_querycap(m_cam_fd_zsl) < 0
+        || fimc_v4l2_s_input(m_cam_fd_zsl, fimc_v4l2_enuminput(m_cam_fd_zsl, m_zsl_input)) < 0) {
+        LOGE("ERR(%s):%s is not a camera port\n", __FUNCTION__, CAMERA_DEV_NAME_ZSL);
+        m_closeZslPort();
+        return -1;
+    }
+#endif
+    LOGV("m_cam_fd_zsl(%d)", m_cam_fd_zsl);
+
+    memset(&m_events_zsl, 0, sizeof(m_events_zsl));
+    m_events_zsl.fd = m_cam_fd_zsl;
+    m_events_zsl.events = POLLIN | POLLERR;
+
+    if (fimc_v4l2_enum_fmt(m_cam_fd_zsl, m_snapshot_v4lformat) < 0
+        || fimc_v4l2_s_fmt(m_cam_fd_zsl, m_snapshot_width, m_snapshot_height,
+                           m_snapshot_v4lformat, 0) < 0) {
+        m_closeZslPort();
+        return -1;
+    }
+#ifdef USE_SEC_CROP_ZOOM
+    // S_FMT reset the crop : the same field of view as the preview
+    m_setCrop(m_cam_fd_zsl, m_zoom, m_snapshot_width, m_snapshot_height);
+#endif
+
+    init_yuv_buffers(m_buffers_zsl, m_snapshot_width, m_snapshot_height, m_snapshot_v4lformat);
+    ret = fimc_v4l2_reqbufs(m_cam_fd_zsl, V4L2_BUF_TYPE_VIDEO_CAPTURE, m_zsl_nframe);
+    if (ret < m_zsl_nframe) {
+        LOGE("ERR(%s):only %d of %d buffers\n", __FUNCTION__, ret, m_zsl_nframe);
+        m_closeZslPort();
+        return -1;
+    }
+
+    ret = fimc_v4l2_querybuf_map(m_cam_fd_zsl, m_buffers_zsl, V4L2_BUF_TYPE_VIDEO_CAPTURE, m_zsl_nframe);
+    if (ret < 0) {
+        close_buffers(m_buffers_zsl);
+        m_closeZslPort();
+        return -1;
+    }
+
+    for (int i = 0; i < m_zsl_nframe; i++) {
+        ret = fimc_v4l2_qbuf(m_cam_fd_zsl, i);
+        if (ret < 0) {
+            close_buffers(m_buffers_zsl);
+            m_closeZslPort();
+            return -1;
+        }
+        m_zsl_state[i]     = ZSL_BUF_QUEUED;
+        m_zsl_timestamp[i] = 0;
+    }
+
+    ret = fimc_v4l2_streamon(m_cam_fd_zsl);
+    if (ret < 0) {
+        close_buffers(m_buffers_zsl);
+        m_closeZslPort();
+        return -1;
+    }
+
+    m_zsl_width      = m_snapshot_width;
+    m_zsl_height     = m_snapshot_height;
+    m_zsl_v4lformat  = m_snapshot_v4lformat;
+    m_zsl_pick       = -1;
+    m_flag_zsl_start = FLAG_ON;
+
+    LOGI("%s:%d x %d, %d buffers\n", __FUNCTION__, m_zsl_width, m_zsl_height, m_zsl_nframe);
+
+    return 0;
+}
+
+int SecCamera::m_stopZsl(void)
+{
+    LOGV("++%s() \n", __FUNCTION__);
+
+    if (m_flag_zsl_start == FLAG_OFF)
+        return 0;
+
+    Mutex::Autolock lock(m_zsl_lock);
+
+    int ret = fimc_v4l2_streamoff(m_cam_fd_zsl);
+
+    close_buffers(m_buffers_zsl);
+    m_closeZslPort();
+
+    m_zsl_pick       = -1;
+    m_flag_zsl_start = FLAG_OFF;
+    // the preview port alone does not keep the sensor settings
+    m_flag_current_info_changed = FLAG_ON;
+    CHECK(ret);
+
+    return 0;
+}
+
+// gives the port back, the recording fd stays open for startRecord()
+void SecCamera::m_closeZslPort(void)
+{
+#ifndef DUAL_PORT_RECORDING
+    if (0 <= m_cam_fd_zsl)
+        close(m_cam_fd_zsl);
+#endif
+    m_cam_fd_zsl = -1;
+}
+
+// move every completed frame out of the driver and hand the oldest back,
+// keeping ZSL_QUEUED_BUFFERS queued. m_zsl_lock is held.
+void SecCamera::m_drainZsl(void)
+{
+    struct timeval tv;
+    int filled = 0;
+    int index;
+
+    while (poll(&m_events_zsl, 1, 0) > 0) {
+        index = fimc_v4l2_dqbuf_time(m_cam_fd_zsl, &tv);
+        if (!(0 <= index && index < m_zsl_nframe))
+            break;
+
+        // the capture time, not when the ring happened to be drained
+        m_zsl_state[index]     = ZSL_BUF_FILLED;
+        m_zsl_timestamp[index] = fimc_frame_time(&tv);
+    }
+
+    for (int i = 0; i < m_zsl_nframe; i++) {
+        if (m_zsl_state[i] == ZSL_BUF_FILLED)
+            filled++;
+    }
+
+    // a locked frame is out of the driver as well
+    if (0 <= m_zsl_pick)
+        filled++;
+
+    while (m_zsl_nframe - ZSL_QUEUED_BUFFERS < filled) {
+        int oldest = -1;
+
+        for (int i = 0; i < m_zsl_nframe; i++) {
+            if (m_zsl_state[i] == ZSL_BUF_FILLED
+                && (oldest < 0 || m_zsl_timestamp[i] < m_zsl_timestamp[oldest]))
+                oldest = i;
+        }
+
+        if (oldest < 0)
+            break;
+
+        if (fimc_v4l2_qbuf(m_cam_fd_zsl, oldest) < 0)
+            break;
+
+        m_zsl_state[oldest] = ZSL_BUF_QUEUED;
+        filled--;
+    }
+}
+
+// lock the frame closest to shutter_time for the next getSnapshot(). m_zsl_lock is held.
+int SecCamera::m_pickZsl(nsecs_t shutter_time)
+{
+    nsecs_t diff, best_diff = 0;
+    int best = -1;
+    int filled = 0;
+
+    // a frame picked by an earlier shutter that was never taken
+    if (0 <= m_zsl_pick)
+        m_zsl_state[m_zsl_pick] = ZSL_BUF_FILLED;
+    m_zsl_pick = -1;
+
+    m_drainZsl();
+
+    for (int i = 0; i < m_zsl_nframe; i++) {
+        if (m_zsl_state[i] == ZSL_BUF_FILLED)
+            filled++;
+    }
+
+    // ring is empty, e.g. right after start : wait for the first frame
+    if (filled == 0) {
+        if (fimc_poll(&m_events_zsl) <= 0)
+            return -1;
+        m_drainZsl();
+    }
+
+    for (int i = 0; i < m_zsl_nframe; i++) {
+        if (m_zsl_state[i] != ZSL_BUF_FILLED)
+            continue;
+
+        diff = m_zsl_timestamp[i] - shutter_time;
+        if (diff < 0)
+            diff = -diff;
+
+        if (best < 0 || diff < best_diff) {
+            best      = i;
+            best_diff = diff;
+        }
+    }
+
+    if (best < 0) {
+        LOGE("ERR(%s):no frame in the ring\n", __FUNCTION__);
+        return -1;
+    }
+
+    m_zsl_state[best] = ZSL_BUF_LOCKED;
+    m_zsl_pick        = best;
+    m_shutter_lag     = m_zsl_timestamp[best] - shutter_time;
+
+    return best;
+}
+
+unsigned int SecCamera::m_getZslSnapshot(unsigned char *rawBuffer, int pictureSize)
+{
+    unsigned int addr;
+    int index;
+
+    Mutex::Autolock lock(m_zsl_lock);
+
+    // getSnapshot() without markShutter()
+    if (m_zsl_pick < 0 && m_pickZsl(systemTime(SYSTEM_TIME_MONOTONIC)) < 0)
+        return 0;
+
+    index = m_zsl_pick;
+
+    addr = fimc_v4l2_s_ctrl(m_cam_fd_zsl, V4L2_CID_PADDR_Y, index);
+    if(addr == 0)
+        LOGE("%s] Physical address 0", __FUNCTION__);
+
+    if ((int)m_buffers_zsl[index].length < pictureSize)
+        pictureSize = m_buffers_zsl[index].length;
+    memcpy(rawBuffer, m_buffers_zsl[index].start, pictureSize);
+
+#ifdef DUMP_YUV
+    save_yuv(m_buffers_zsl, m_zsl_width, m_zsl_height, 16, index, 0);
+#endif
+
+    fimc_v4l2_qbuf(m_cam_fd_zsl, index);
+    m_zsl_state[index] = ZSL_BUF_QUEUED;
+    m_zsl_pick         = -1;
+    m_shutter_time     = 0;
+    m_snapshot_phys    = 0; // back in the ring, the thumbnail comes from the copy
+
+    LOGI("%s:index %d, shutter lag %lld ms, shot to shot %lld ms\n", __FUNCTION__,
+            index, ns2ms(m_shutter_lag), ns2ms(m_shot_to_shot));
+
+    return addr;
+}
+#endif // ZERO_SHUTTER_LAG
+
+// ======================================================================
+// Burst capture
+
+#ifdef BURST_CAPTURE
+// streams the capture port at the snapshot size into nr_buffers buffers.
+// frames come out of getBurstFrame() and go back with releaseBurstFrame().
+int SecCamera::startBurst(int nr_buffers)
+{
+    LOGV("++%s(nr_buffers(%d)) \n", __FUNCTION__, nr_buffers);
+
+    int ret;
+    int index;
+
+    if (m_cam_fd <= 0) {
+        LOGE("ERR(%s):Camera was closed\n", __FUNCTION__);
+        return -1;
+    }
+
+    if (m_flag_burst_start == FLAG_ON)
+        stopBurst();
+
+    if (nr_buffers < BURST_MIN_BUFFERS)
+        nr_buffers = BURST_MIN_BUFFERS;
+    if (MAX_BUFFERS < nr_buffers)
+        nr_buffers = MAX_BUFFERS;
+
+    stopPreview();
+#ifdef ZERO_SHUTTER_LAG
+    // restarted by the next startPreview()
+    m_stopZsl();
+#endif
+
+    memset(&m_events_c, 0, sizeof(m_events_c));
+    m_events_c.fd = m_cam_fd;
+    m_events_c.events = POLLIN | POLLERR;
+
+    ret = fimc_v4l2_enum_fmt(m_cam_fd, m_snapshot_v4lformat);
+    CHECK(ret);
+    ret = fimc_v4l2_s_fmt(m_cam_fd, m_snapshot_width, m_snapshot_height, m_snapshot_v4lformat, 0);
+    CHECK(ret);
+
+    if (m_resetCamera() < 0) {
+        LOGE("ERR(%s):m_resetCamera() fail\n", __FUNCTION__);
+        return -1;
+    }
+#ifdef USE_SEC_CROP_ZOOM
+    // S_FMT reset the crop and m_resetCamera() sizes it for the preview
+    m_setCrop(m_cam_fd, m_zoom, m_snapshot_width, m_snapshot_height);
+#endif
+
+    init_yuv_buffers(m_buffers_c, m_snapshot_width, m_snapshot_height, m_snapshot_v4lformat);
+    ret = fimc_v4l2_reqbufs(m_cam_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, nr_buffers);
+    CHECK(ret);
+    if (ret < BURST_MIN_BUFFERS) {
+        LOGE("ERR(%s):only %d of %d buffers\n", __FUNCTION__, ret, nr_buffers);
+        return -1;
+    }
+    nr_buffers = MIN(ret, nr_buffers);
+
+    ret = fimc_v4l2_querybuf_map(m_cam_fd, m_buffers_c, V4L2_BUF_TYPE_VIDEO_CAPTURE, nr_buffers);
+    if (ret < 0) {
+        close_buffers(m_buffers_c);
+        return -1;
+    }
+
+    for (int i = 0; i < nr_buffers; i++) {
+        ret = fimc_v4l2_qbuf(m_cam_fd, i);
+        if (ret < 0) {
+            close_buffers(m_buffers_c);
+            return -1;
+        }
+    }
+
+    ret = fimc_v4l2_streamon(m_cam_fd);
+    if (ret < 0) {
+        close_buffers(m_buffers_c);
+        return -1;
+    }
+
+    m_burst_nframe     = nr_buffers;
+    m_flag_burst_start = FLAG_ON;
+    m_snapshot_phys    = 0;
+
+    for (int i = 0; i < BURST_SKIP_FRAMES; i++) {
+        if (fimc_poll(&m_events_c) <= 0)
+            break;
+        index = fimc_v4l2_dqbuf(m_cam_fd);
+        if (!(0 <= index && index < m_burst_nframe))
+            break;
+        fimc_v4l2_qbuf(m_cam_fd, index);
+    }
+
+    LOGI("%s:%d x %d, %d buffers\n", __FUNCTION__,
+            m_snapshot_width, m_snapshot_height, m_burst_nframe);
+
+    return 0;
+}
+
+int SecCamera::stopBurst(void)
+{
+    LOGV("++%s() \n", __FUNCTION__);
+
+    if (m_flag_burst_start == FLAG_OFF)
+        return 0;
+
+    int ret = fimc_v4l2_streamoff(m_cam_fd);
+
+    close_buffers(m_buffers_c);
+
+    m_snapshot_phys    = 0;
+    m_burst_nframe     = 0;
+    m_flag_burst_start = FLAG_OFF;
+    m_flag_current_info_changed = FLAG_ON;
+    CHECK(ret);
+
+    return 0;
+}
+
+int SecCamera::flagBurstStart(void)
+{
+    return m_flag_burst_start;
+}
+
+// waits for the next frame, returns its index or -1
+int SecCamera::getBurstFrame(nsecs_t *timestamp)
+{
+    int index;
+
+    if (m_flag_burst_start == FLAG_OFF) {
+        LOGE("ERR(%s):Burst was not started\n", __FUNCTION__);
+        return -1;
+    }
+
+    if (fimc_poll(&m_events_c) <= 0)
+        return -1;
+
+    index = fimc_v4l2_dqbuf(m_cam_fd);
+    if (!(0 <= index && index < m_burst_nframe)) {
+        LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
+        return -1;
+    }
+
+    *timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (m_shutter_time != 0) {
+        m_shutter_lag  = *timestamp - m_shutter_time;
+        m_shutter_time = 0;
+    }
 
 #ifdef DUMP_YUV
     save_yuv(m_buffers_c, m_snapshot_width, m_snapshot_height, 16, index, 0);
 #endif
-    LOG_TIME_END(2)
 
-    addr = getPhyAddrY(index);
-    if(addr == 0)
-        LOGE("%s] Physical address 0", __FUNCTION__);
+    return index;
+}
 
-    LOGI("phyaddr = 0x%x, index = %d, m_buffers_c[%d].start = 0x%p",
-            addr, index, index, m_buffers_c[index].start);
-    memcpy(rawBuffer, m_buffers_c[index].start, pictureSize);
+int SecCamera::releaseBurstFrame(int index)
+{
+    if (m_flag_burst_start == FLAG_OFF)
+        return 0;
 
-    fimc_v4l2_streamoff(m_cam_fd);
+    if (!(0 <= index && index < m_burst_nframe)) {
+        LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
+        return -1;
+    }
 
-    close_buffers(m_buffers_c);
+    return fimc_v4l2_qbuf(m_cam_fd, index);
+}
 
-    LOG_CAMERA("getSnapshot intervals : stopPreview(%lu), prepare(%lu), capture(%lu), "
-            "memcpy(%lu), yuv2Jpeg(%lu), post(%lu)  us",
-            LOG_TIME(0), LOG_TIME(1), LOG_TIME(2),
-            LOG_TIME(3), LOG_TIME(4), LOG_TIME(5));
+// codes a frame that is still out of the driver; the encoder takes its own
+// copy and the thumbnail is scaled by FIMC straight from the capture buffer
+unsigned char *SecCamera::getBurstJpeg(int index, int *jpeg_size,
+                                       unsigned char *pic_buf, int pic_buf_size)
+{
+    unsigned char *jpeg_data;
 
-    LOGI("--%s() \n", __FUNCTION__);
+    if (m_flag_burst_start == FLAG_OFF
+        || !(0 <= index && index < m_burst_nframe)) {
+        LOGE("ERR(%s):wrong index = %d\n", __FUNCTION__, index);
+        return NULL;
+    }
 
-    return addr;
+    m_snapshot_phys = getPhyAddrY(index);
+
+    *jpeg_size = 0;
+    jpeg_data = yuv2Jpeg((unsigned char *)m_buffers_c[index].start,
+            m_frameSize(m_snapshot_v4lformat, m_snapshot_width, m_snapshot_height),
+            jpeg_size, m_snapshot_width, m_snapshot_height, m_snapshot_v4lformat,
+            pic_buf, pic_buf_size);
+
+    m_snapshot_phys = 0;
+
+    return jpeg_data;
 }
+#endif // BURST_CAPTURE
 
 int SecCamera::setSnapshotSize(int width, int height)
 {
@@ -1430,12 +2402,23 @@ void SecCamera::setJpegQuality(int quality)
 {
     m_jpeg_quality = quality;
 }
+
+// last shot and worst shot, JPEG_STAGE_MAX entries each
+void SecCamera::getJpegStageTimes(nsecs_t *times, nsecs_t *times_max)
+{
+    memcpy(times,     m_jpeg_stage_time,     sizeof(m_jpeg_stage_time));
+    memcpy(times_max, m_jpeg_stage_time_max, sizeof(m_jpeg_stage_time_max));
+}
 // -----------------------------------
 
 
 void SecCamera::setFrameRate(int frame_rate)
 {
-    m_frame_rate = frame_rate;
+    // S_PARM goes to the running stream too
+    if(m_frame_rate != frame_rate) {
+        m_frame_rate = frame_rate;
+        m_flag_current_info_changed = FLAG_ON;
+    }
 }
 
 int SecCamera::getFrameRate   (void)
@@ -1465,7 +2448,7 @@ int SecCamera::setSceneMode(int scene_mode)
 
     if(m_scene_mode != scene_mode) {
         m_scene_mode = scene_mode;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
 
     return 0;
@@ -1482,7 +2465,7 @@ int SecCamera::setWhiteBalance(int white_balance)
 
     if(m_white_balance != white_balance) {
         m_white_balance = white_balance;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
 
     return 0;
@@ -1507,7 +2490,7 @@ int SecCamera::setImageEffect(int image_effect)
 
     if(m_image_effect != image_effect) {
         m_image_effect = image_effect;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
 
     return 0;
@@ -1532,7 +2515,7 @@ int SecCamera::setBrightness(int brightness)
 
     if(m_brightness != brightness) {
         m_brightness = brightness;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
 
     return 0;
@@ -1567,7 +2550,7 @@ int SecCamera::setContrast(int contrast)
 
     if(m_contrast != contrast) {
         m_contrast = contrast;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
 
     return 0;
@@ -1600,7 +2583,7 @@ int SecCamera::setSharpness(int sharpness)
 
     if(m_sharpness!= sharpness) {
         m_sharpness = sharpness;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
     return 0;
 }
@@ -1632,7 +2615,7 @@ int SecCamera::setSaturation(int saturation)
 
     if(m_saturation != saturation) {
         m_saturation = saturation;
-        m_flag_current_info_changed = FLAG_ON;
+        m_flag_ctrl_changed = FLAG_ON;
     }
     return 0;
 }
@@ -1660,15 +2643,25 @@ int SecCamera::setZoom(int zoom)
 
     if(zoom < ZOOM_BASE || ZOOM_MAX < zoom) {
         LOGE("%s::invalid zoom (%d) it should %d ~ %d\n",
-              __func__, zoom, SATURATION_BASE, SATURATION_MAX);
+              __func__, zoom, ZOOM_BASE, ZOOM_MAX);
         return -1;
     }
 
-    if(m_zoom != zoom) {
-        m_zoom = zoom;
-        m_flag_current_info_changed = FLAG_ON;
+    if(m_zoom == zoom)
+        return 0;
+
+    m_zoom = zoom;
+
+    // FIMC takes the new crop from the next frame on, the sensor and the
+    // stream stay as they are
+    if(m_flag_preview_start == FLAG_ON) {
+        m_zoom_request_time = systemTime(SYSTEM_TIME_MONOTONIC);
+        m_zoom_frames       = 0;
+        return m_setZoom(zoom);
     }
 
+    m_flag_current_info_changed = FLAG_ON;
+
     return 0;
 }
 
@@ -1687,6 +2680,27 @@ int    SecCamera::getZoomMax(void)
     return ZOOM_MAX;
 }
 
+// magnification of a zoom step in percent, as m_getCropRect() crops
+int    SecCamera::getZoomRatio(int zoom)
+{
+    return (100 * ZOOM_MAX * DEFAULT_ZOOM_RATIO)
+        / (ZOOM_MAX * DEFAULT_ZOOM_RATIO - (DEFAULT_ZOOM_RATIO - 1) * zoom);
+}
+
+// sensor controls written since Create() and the ioctls they took
+void   SecCamera::getCtrlStats(unsigned int *writes, unsigned int *ioctls)
+{
+    *writes = m_ctrl_writes;
+    *ioctls = m_ctrl_ioctls;
+}
+
+// setZoom() to the first preview frame that started after it
+void   SecCamera::getZoomStats(nsecs_t *latency, nsecs_t *latency_max)
+{
+    *latency     = m_zoom_latency;
+    *latency_max = m_zoom_latency_max;
+}
+
 // -----------------------------------
 
 int SecCamera::setAFMode(int af_mode)
@@ -1761,7 +2775,11 @@ unsigned char *SecCamera::getJpeg(unsigned char *snapshot_data, int snapshot_siz
     return jpeg_data;
 }
 
-unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int * jpeg_size,int width, int height, int pixel_format)
+// the picture is put together in pic_buf when the caller passes one of at
+// least JPEG_PICTURE_BUF_SIZE bytes, so the stream leaves the codec buffers
+// once; the returned data then lies inside pic_buf
+unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int * jpeg_size,int width, int height, int pixel_format,
+                                   unsigned char * pic_buf, int pic_buf_size)
 {
     LOGI("++%s \n",__FUNCTION__);
 #ifdef DUMP_SECJPEG
@@ -1771,20 +2789,8 @@ unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int *
     LOGI("%s:raw_data(%p), raw_size(%d), jpeg_size(%d), width(%d), height(%d), format(%d)",
             __FUNCTION__, raw_data, raw_size, *jpeg_size, width, height, pixel_format);
 
-    if(m_jpeg_fd > 0) {
-        LOGE_IF(api_jpeg_encode_deinit(m_jpeg_fd) != JPEG_OK,
-                "ERR(%s):Fail on api_jpeg_encode_deinit\n", __FUNCTION__);
-        m_jpeg_fd = 0;
-    }
-
-    m_jpeg_fd = api_jpeg_encode_init();
-
-    LOGV("(%s):JPEG device open ID = %d\n", __FUNCTION__,m_jpeg_fd);
-    if(m_jpeg_fd <= 0) {
-        m_jpeg_fd = 0;
-        LOGE("ERR(%s):Cannot open a jpeg device file\n", __FUNCTION__);
+    if(openJpeg() < 0)
         return NULL;
-    }
 
     if(pixel_format == V4L2_PIX_FMT_RGB565) {
         LOGE("ERR(%s):It doesn't support V4L2_PIX_FMT_RGB565\n", __FUNCTION__);
@@ -1797,8 +2803,23 @@ unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int *
     unsigned char * OutBuf = NULL;
     unsigned char * jpeg_data = NULL;
     long            frameSize;
-    //exif_file_info_t    ExifInfo;
     struct jpeg_enc_param    enc_param;
+    nsecs_t         stage_time[JPEG_STAGE_MAX];
+    nsecs_t         encode_start;
+    unsigned int    main_size;
+    unsigned char * picture;
+    nsecs_t         now;
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    nsecs_t         main_done  = 0;
+    bool            thumb_scaled;
+    int             thumb_size = 0;
+    int             app1_size  = 0;
+    unsigned char * body;
+#endif
+
+    // too small for the largest picture, assembled in m_jpeg_pic_buf instead
+    if (pic_buf_size < JPEG_PICTURE_BUF_SIZE)
+        pic_buf = NULL;
 
     //int input_file_format = JPEG_MODESEL_YCBCR;
 
@@ -1831,23 +2852,22 @@ unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int *
         }
     }
 
-    /* get Input buffer address */
-    InBuf = (unsigned char*)api_jpeg_get_encode_in_buf(m_jpeg_fd, raw_size);
-    if (InBuf == NULL) {
-        LOGE("ERR(%s):Fail input buffer is NULL \n", __FUNCTION__);
+    if (JPEG_FRAME_BUF_SIZE < raw_size) {
+        LOGE("ERR(%s):raw_size(%d) is bigger than the jpeg input buffer\n", __FUNCTION__, raw_size);
         goto YUV2JPEG_END;
     }
 
-    LOGI("Step 2: memcpy(InBuf(%p), raw_data(%p), raw_size(%d)", InBuf, raw_data, raw_size);
-    memcpy(InBuf, raw_data, raw_size);
-
+    /* the session buffers stay mapped between pictures */
+    InBuf  = m_jpeg_in_buf;
+    OutBuf = m_jpeg_out_buf;
 
-    /* get output buffer address */
-    OutBuf = (unsigned char*)api_jpeg_get_encode_out_buf(m_jpeg_fd);
-    if (OutBuf == NULL) {
-        LOGE("output buffer is NULL\n");
-        goto YUV2JPEG_END;
+    // getSnapshot() normally wrote the frame into InBuf already
+    if (raw_data != InBuf) {
+        LOGI("Step 2: memcpy(InBuf(%p), raw_data(%p), raw_size(%d)", InBuf, raw_data, raw_size);
+        memcpy(InBuf, raw_data, raw_size);
+        m_jpeg_copy_bytes += raw_size;
     }
+
     LOGI("Step 3: get OutBuf (%p)\n", OutBuf);
 
     /* set encode parameters */
@@ -1855,18 +2875,93 @@ unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int *
     enc_param.height = height;
     enc_param.in_fmt = YUV_422; // YCBYCR Only
     enc_param.out_fmt = out_file_format;
-    enc_param.quality = QUALITY_LEVEL_2;
-    api_jpeg_set_encode_param(&enc_param);
+    enc_param.quality = m_jpegQualityLevel(m_jpeg_quality);
+    api_jpeg_set_encode_param(m_jpeg_ctx, &enc_param);
+
+    memset(stage_time, 0, sizeof(stage_time));
 
     LOGI("Step 4: excute jpeg encode\n");
-    result = api_jpeg_encode_exe(m_jpeg_fd, &enc_param);
+    encode_start = systemTime(SYSTEM_TIME_MONOTONIC);
+    picture = OutBuf;
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    // the thumbnail is coded in the same codec buffers : it is scaled into its
+    // own memory while the picture is coded, and coded once the picture is out
+    if (api_jpeg_queue_encode(m_jpeg_ctx, &enc_param, m_jpegDone, &main_done) < 0) {
+        LOGE("encoding failed\n");
+        goto YUV2JPEG_END;
+    }
+
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    thumb_scaled = (m_scaleThumbnail(raw_data, width, height, pixel_format) == 0);
+    stage_time[JPEG_STAGE_SCALE] = systemTime(SYSTEM_TIME_MONOTONIC) - now;
+
+    result = api_jpeg_wait(m_jpeg_ctx);
     if (result != JPEG_ENCODE_OK) {
         LOGE("encoding failed\n");
         goto YUV2JPEG_END;
     }
-    LOGI("Step 5: Done");
-    jpeg_data  = OutBuf;
-    *jpeg_size = (int)enc_param.size;
+    main_size = api_jpeg_get_encode_size(m_jpeg_ctx);
+    stage_time[JPEG_STAGE_MAIN] = main_done - encode_start;
+
+    if (pic_buf == NULL)
+        pic_buf = m_jpeg_pic_buf;
+
+    if (pic_buf != NULL && m_exif_buf != NULL && 2 < main_size
+        && OutBuf[0] == 0xFF && OutBuf[1] == 0xD8) {
+        LOGI("Step 5: move the picture out of the codec\n");
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        // the stream after its SOI, with room for SOI and the largest APP1 in front
+        body = pic_buf + 2 + EXIF_APP1_MAX_SIZE;
+        memcpy(body, OutBuf + 2, main_size - 2);
+        stage_time[JPEG_STAGE_ASSEMBLE] = systemTime(SYSTEM_TIME_MONOTONIC) - now;
+
+        if (thumb_scaled) {
+            now = systemTime(SYSTEM_TIME_MONOTONIC);
+            thumb_size = m_encodeThumbnail(out_file_format);
+            stage_time[JPEG_STAGE_THUMB] = systemTime(SYSTEM_TIME_MONOTONIC) - now;
+        }
+
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        app1_size = m_makeExif(width, height, thumb_size ? OutBuf : NULL, thumb_size);
+        stage_time[JPEG_STAGE_EXIF] = systemTime(SYSTEM_TIME_MONOTONIC) - now;
+
+        LOGI("Step 6: put APP1(%d bytes) after SOI\n", app1_size);
+        picture = body - app1_size - 2;
+        picture[0] = 0xFF;
+        picture[1] = 0xD8;
+        memcpy(picture + 2, m_exif_buf, app1_size);
+        main_size += app1_size;
+    }
+#else
+    result = api_jpeg_encode_exe(m_jpeg_ctx, &enc_param);
+    if (result != JPEG_ENCODE_OK) {
+        LOGE("encoding failed\n");
+        goto YUV2JPEG_END;
+    }
+    main_size = enc_param.size;
+    stage_time[JPEG_STAGE_MAIN] = systemTime(SYSTEM_TIME_MONOTONIC) - encode_start;
+
+    if (pic_buf != NULL && main_size <= JPEG_STREAM_BUF_SIZE) {
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        memcpy(pic_buf, OutBuf, main_size);
+        picture = pic_buf;
+        stage_time[JPEG_STAGE_ASSEMBLE] = systemTime(SYSTEM_TIME_MONOTONIC) - now;
+    }
+#endif
+    stage_time[JPEG_STAGE_TOTAL] = systemTime(SYSTEM_TIME_MONOTONIC) - encode_start;
+
+    for (int i = 0; i < JPEG_STAGE_MAX; i++) {
+        m_jpeg_stage_time[i] = stage_time[i];
+        if (m_jpeg_stage_time_max[i] < stage_time[i])
+            m_jpeg_stage_time_max[i] = stage_time[i];
+    }
+    m_jpeg_shots++;
+
+    LOGI("Step 7: Done, shot %u encoded in %lld us (picture %lld us), %u raw bytes copied so far",
+            m_jpeg_shots, ns2us(stage_time[JPEG_STAGE_TOTAL]),
+            ns2us(stage_time[JPEG_STAGE_MAIN]), m_jpeg_copy_bytes);
+    jpeg_data  = picture;
+    *jpeg_size = (int)main_size;
 
 #ifdef DUMP_SECJPEG
 
@@ -1885,7 +2980,7 @@ unsigned char *SecCamera::yuv2Jpeg(unsigned char * raw_data, int raw_size,int *
         goto YUV2JPEG_END;
     }
 
-    fwrite(jpeg_data, 1, enc_param.size, out_fp);
+    fwrite(jpeg_data, 1, *jpeg_size, out_fp);
     fclose(out_fp);
 
 #endif
@@ -1896,6 +2991,87 @@ YUV2JPEG_END :
     return jpeg_data;
 }
 
+enum jpeg_img_quality_level SecCamera::m_jpegQualityLevel(int quality)
+{
+    // the codec has four quantization tables
+    if (90 <= quality)
+        return QUALITY_LEVEL_1;
+    if (80 <= quality)
+        return QUALITY_LEVEL_2;
+    if (70 <= quality)
+        return QUALITY_LEVEL_3;
+    return QUALITY_LEVEL_4;
+}
+
+#ifdef INCLUDE_JPEG_THUMBNAIL
+void SecCamera::m_jpegDone(struct jpeg_lib *ctx, enum jpeg_ret_type ret, void *cookie)
+{
+    *(nsecs_t *)cookie = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// scales the snapshot, in its own format, to a YCbYCr thumbnail in m_jpeg_thumb_in_buf
+int SecCamera::m_scaleThumbnail(unsigned char *raw_data, int width, int height, int pixel_format)
+{
+    if (   m_jpeg_thumb_in_buf == NULL
+        || m_jpeg_thumbnail_width <= 0 || m_jpeg_thumbnail_height <= 0)
+        return -1;
+
+    if (m_post_proc.scaleThumbnail(m_snapshot_phys, raw_data, width, height, pixel_format,
+                m_jpeg_thumb_in_buf, m_jpeg_thumbnail_width, m_jpeg_thumbnail_height) < 0) {
+        LOGE("ERR(%s):Fail on scaleThumbnail(%d x %d), format(%d)\n", __FUNCTION__,
+                m_jpeg_thumbnail_width, m_jpeg_thumbnail_height, pixel_format);
+        return -1;
+    }
+    if (m_post_proc.flagHwScale())
+        m_jpeg_hw_thumbs++;
+
+    return 0;
+}
+
+// codes the scaled thumbnail once the picture is out of the codec buffers.
+// returns its size at m_jpeg_out_buf, 0 on failure
+int SecCamera::m_encodeThumbnail(enum jpeg_stream_format out_fmt)
+{
+    struct jpeg_enc_param thumb_param;
+    int frame_size = m_jpeg_thumbnail_width * m_jpeg_thumbnail_height * 2;
+
+    memcpy(m_jpeg_in_buf, m_jpeg_thumb_in_buf, frame_size);
+    m_jpeg_copy_bytes += frame_size;
+
+    thumb_param.width   = m_jpeg_thumbnail_width;
+    thumb_param.height  = m_jpeg_thumbnail_height;
+    thumb_param.size    = 0;
+    thumb_param.in_fmt  = YUV_422; // what scaleThumbnail() converts every snapshot format to
+    thumb_param.out_fmt = out_fmt;
+    thumb_param.quality = m_jpegQualityLevel(m_jpeg_thumbnail_quality);
+    api_jpeg_set_encode_param(m_jpeg_ctx, &thumb_param);
+
+    if (api_jpeg_encode_exe(m_jpeg_ctx, &thumb_param) != JPEG_ENCODE_OK) {
+        LOGE("ERR(%s):thumbnail encoding failed, picture goes without it\n", __FUNCTION__);
+        return 0;
+    }
+
+    return thumb_param.size;
+}
+
+int SecCamera::m_makeExif(int width, int height, unsigned char *thumb, int thumb_size)
+{
+    struct exif_attribute attr;
+
+    attr.width         = width;
+    attr.height        = height;
+    attr.rotation      = m_angle;
+    attr.date_time     = time(NULL);
+    attr.gps_enabled   = m_gps_enabled;
+    attr.gps_latitude  = m_gps_latitude;
+    attr.gps_longitude = m_gps_longitude;
+    attr.gps_altitude  = m_gps_altitude;
+    attr.gps_timestamp = m_gps_timestamp;
+
+    return m_post_proc.makeExifApp1(m_exif_buf, EXIF_APP1_MAX_SIZE, &attr, thumb, thumb_size);
+}
+#endif // INCLUDE_JPEG_THUMBNAIL
+
 int SecCamera::setJpegThumbnailSize(int width, int height)
 {
     LOGI("%s(width(%d), height(%d))", __FUNCTION__, width, height);
@@ -1917,8 +3093,14 @@ int SecCamera::getJpegThumbnailSize(int* width, int* height)
 }
 
 
+void SecCamera::setJpegThumbnailQuality(int quality)
+{
+    m_jpeg_thumbnail_quality = quality;
+}
+
 int SecCamera::setGpsInfo(double latitude, double longitude, unsigned int timestamp, int altitude)
 {
+    m_gps_enabled   = 1;
     m_gps_latitude  = latitude;
     m_gps_longitude = longitude;
     m_gps_timestamp = timestamp;
@@ -1927,6 +3109,11 @@ int SecCamera::setGpsInfo(double latitude, double longitude, unsigned int timest
     return 0;
 }
 
+void SecCamera::clearGpsInfo(void)
+{
+    m_gps_enabled = 0;
+}
+
 int SecCamera::m_resetCamera(void)
 {
     int ret = 0;
@@ -1941,28 +3128,148 @@ int SecCamera::m_resetCamera(void)
                 "ERR(%s):m_setZoom fail\n", __FUNCTION__);
         LOGE_IF(m_setFrameRate(m_frame_rate) < 0,
                 "ERR(%s):m_setFrameRate fail\n", __FUNCTION__);
-        LOGE_IF(m_setSceneMode(m_scene_mode) < 0,
-                "ERR(%s):m_setSceneMode fail\n", __FUNCTION__);
-        LOGE_IF(m_setWhiteBalance(m_white_balance) < 0,
-                "ERR(%s):m_setWhiteBalance fail\n", __FUNCTION__);
-        LOGE_IF(m_setImageEffect(m_image_effect) < 0,
-                "ERR(%s):m_setImageEffect fail\n", __FUNCTION__);
-        LOGE_IF(m_setBrightness(m_brightness) < 0,
-                "ERR(%s):m_setBrightness fail\n", __FUNCTION__);
-        LOGE_IF(m_setContrast(m_contrast) < 0,
-                "ERR(%s):m_setContrast fail\n", __FUNCTION__);
-        LOGE_IF(m_setSharpness(m_sharpness) < 0,
-                "ERR(%s):m_setSharpness fail\n", __FUNCTION__);
-        LOGE_IF(m_setSaturation(m_saturation) < 0,
-                "ERR(%s):m_setSaturation fail\n", __FUNCTION__);
 
         int flag_focused = 0;
         LOGE_IF(m_setAF(m_af_mode, FLAG_OFF, FLAG_OFF, &flag_focused) < 0,
                 "ERR(%s):m_setAF fail\n", __FUNCTION__);
 
         m_flag_current_info_changed = FLAG_OFF;
+        m_flag_ctrl_changed         = FLAG_ON;
+    }
+
+    // white balance, effect and friends alone do not redo the above
+    if(m_flag_ctrl_changed == FLAG_ON) {
+        LOGE_IF(m_applyCtrls() < 0,
+                "ERR(%s):m_applyCtrls fail\n", __FUNCTION__);
+    }
+
+    return ret;
+}
+
+// the sensor controls that differ from what the driver has, in one batch
+int SecCamera::m_applyCtrls(void)
+{
+    // a setter racing the values read below raises the flag again
+    m_flag_ctrl_changed = FLAG_OFF;
+
+    LOGE_IF(m_setSceneMode(m_scene_mode) < 0,
+            "ERR(%s):m_setSceneMode fail\n", __FUNCTION__);
+    LOGE_IF(m_setWhiteBalance(m_white_balance) < 0,
+            "ERR(%s):m_setWhiteBalance fail\n", __FUNCTION__);
+    LOGE_IF(m_setImageEffect(m_image_effect) < 0,
+            "ERR(%s):m_setImageEffect fail\n", __FUNCTION__);
+    LOGE_IF(m_setBrightness(m_brightness) < 0,
+            "ERR(%s):m_setBrightness fail\n", __FUNCTION__);
+    LOGE_IF(m_setContrast(m_contrast) < 0,
+            "ERR(%s):m_setContrast fail\n", __FUNCTION__);
+    LOGE_IF(m_setSharpness(m_sharpness) < 0,
+            "ERR(%s):m_setSharpness fail\n", __FUNCTION__);
+    LOGE_IF(m_setSaturation(m_saturation) < 0,
+            "ERR(%s):m_setSaturation fail\n", __FUNCTION__);
+
+    return m_flushCtrls(m_cam_fd);
+}
+
+// written by the next m_flushCtrls(), *current = current_value once it is
+int SecCamera::m_queueCtrl(unsigned int id, int value, int *current, int current_value)
+{
+    int i;
+
+    for (i = 0; i < m_ctrl_count; i++) {
+        if (m_ctrl_batch[i].id == id)
+            break;
+    }
+
+    if (i == CTRL_BATCH_MAX) {
+        LOGE("ERR(%s):control(0x%x) does not fit the batch\n", __FUNCTION__, id);
+        return -1;
+    }
+    if (i == m_ctrl_count)
+        m_ctrl_count++;
+
+    memset(&m_ctrl_batch[i], 0, sizeof(m_ctrl_batch[i]));
+    m_ctrl_batch[i].id    = id;
+    m_ctrl_batch[i].value = value;
+    m_ctrl_current[i]     = current;
+    m_ctrl_value[i]       = current_value;
+
+    return 0;
+}
+
+int SecCamera::m_flushCtrls(int fd)
+{
+    struct v4l2_ext_controls ctrls;
+    struct v4l2_ext_control  batch[CTRL_BATCH_MAX];
+    int          index[CTRL_BATCH_MAX];
+    int          done [CTRL_BATCH_MAX];
+    unsigned int ctrl_class;
+    int ret = 0;
+    int i, j, n;
+
+    if (m_ctrl_count == 0)
+        return 0;
+
+    memset(done, 0, sizeof(done));
+
+    // VIDIOC_S_EXT_CTRLS takes the controls of one class only, so one call
+    // per class, in the order the classes were first queued : the auto white
+    // balance (user class) still goes off before the preset (camera class)
+    for (i = 0; i < m_ctrl_count; i++) {
+        int tried = 0;
+        int class_ret = 0;
+
+        if (done[i])
+            continue;
+
+        ctrl_class = V4L2_CTRL_ID2CLASS(m_ctrl_batch[i].id);
+        for (j = i, n = 0; j < m_ctrl_count; j++) {
+            if (done[j] || V4L2_CTRL_ID2CLASS(m_ctrl_batch[j].id) != ctrl_class)
+                continue;
+            batch[n]   = m_ctrl_batch[j];
+            index[n++] = j;
+            done[j]    = 1;
+        }
+
+        if (m_flag_ext_ctrls == FLAG_ON) {
+            memset(&ctrls, 0, sizeof(ctrls));
+            ctrls.ctrl_class = ctrl_class;
+            ctrls.count      = n;
+            ctrls.controls   = batch;
+
+            tried = 1;
+            m_ctrl_ioctls++;
+            if (ioctl(fd, VIDIOC_S_EXT_CTRLS, &ctrls) == 0) {
+                for (j = 0; j < n; j++)
+                    *m_ctrl_current[index[j]] = m_ctrl_value[index[j]];
+                m_ctrl_writes += n;
+                continue;
+            }
+        }
+
+        for (j = 0; j < n; j++) {
+            m_ctrl_ioctls++;
+            if (fimc_v4l2_s_ctrl(fd, batch[j].id, batch[j].value) < 0) {
+                LOGE("ERR(%s):control(0x%x) value(%d) fail\n", __FUNCTION__,
+                        batch[j].id, batch[j].value);
+                class_ret = -1;
+                continue;
+            }
+            *m_ctrl_current[index[j]] = m_ctrl_value[index[j]];
+            m_ctrl_writes++;
+        }
+
+        // every control is fine on its own, so the batch is what the driver refused
+        if (class_ret == 0 && tried) {
+            LOGI("%s:VIDIOC_S_EXT_CTRLS not supported, controls go one by one\n", __FUNCTION__);
+            m_flag_ext_ctrls = FLAG_OFF;
+        }
+
+        if (class_ret < 0)
+            ret = -1;
     }
 
+    m_ctrl_count = 0;
+
     return ret;
 }
 
@@ -2113,10 +3420,8 @@ int SecCamera::m_setWhiteBalance(int white_balance)
     if(white_balance == WHITE_BALANCE_AUTO) {
         value = 1;
 
-        if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_AUTO_WHITE_BALANCE, value) < 0) {
-            LOGE("ERR(%s):V4L2_CID_AUTO_WHITE_BALANCE(%d) fail\n", __FUNCTION__, white_balance);
-            return -1;
-        }
+        return m_queueCtrl(V4L2_CID_AUTO_WHITE_BALANCE, value,
+                           &m_current_white_balance, white_balance);
     } else {
         switch (white_balance) {
             //case WHITE_BALANCE_AUTO:
@@ -2140,20 +3445,14 @@ int SecCamera::m_setWhiteBalance(int white_balance)
                 break;
         }
 
-        // this is very temporary enum..
-#if 0
-#define V4L2_CID_WHITE_BALANCE_PRESET   (V4L2_CID_CAMERA_CLASS_BASE+27)
-
-        if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_WHITE_BALANCE_PRESET, value) < 0) {
-            LOGE("ERR(%s):V4L2_CID_WHITE_BALANCE_PRESET(%d) fail\n", __FUNCTION__, white_balance);
+        // auto off first, the preset counts as written only once it is
+        if(m_queueCtrl(V4L2_CID_AUTO_WHITE_BALANCE, 0,
+                       &m_current_white_balance, m_current_white_balance) < 0)
             return -1;
-        }
-#endif
-    }
 
-    m_current_white_balance = white_balance;
-
-    return 0;
+        return m_queueCtrl(V4L2_CID_WHITE_BALANCE_PRESET, value,
+                           &m_current_white_balance, white_balance);
+    }
 }
 
 
@@ -2191,14 +3490,7 @@ int SecCamera::m_setImageEffect(int image_effect)
             break;
     }
 
-    if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_COLORFX, value) < 0) {
-        LOGE("ERR(%s):V4L2_CID_COLORFX(%d) fail\n", __FUNCTION__, image_effect);
-        return -1;
-    }
-
-    m_current_image_effect = image_effect;
-
-    return 0;
+    return m_queueCtrl(V4L2_CID_COLORFX, value, &m_current_image_effect, image_effect);
 }
 
 
@@ -2209,14 +3501,7 @@ int SecCamera::m_setBrightness(int brightness)
 
     LOGV("%s(brightness(%d))", __FUNCTION__, brightness);
 
-    if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_EXPOSURE, brightness) < 0) {
-        LOGE("ERR(%s):V4L2_CID_EXPOSURE(%d) fail\n", __FUNCTION__, brightness);
-        return -1;
-    }
-
-    m_current_brightness = brightness;
-
-    return 0;
+    return m_queueCtrl(V4L2_CID_EXPOSURE, brightness, &m_current_brightness, brightness);
 }
 
 
@@ -2227,14 +3512,7 @@ int SecCamera::m_setContrast(int contrast)
 
     LOGV("%s(contrast(%d))", __FUNCTION__, contrast);
 
-    if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_CONTRAST, contrast) < 0) {
-        LOGE("ERR(%s):V4L2_CID_CONTRAST(%d) fail\n", __FUNCTION__, contrast);
-        return -1;
-    }
-
-    m_current_contrast = contrast;
-
-    return 0;
+    return m_queueCtrl(V4L2_CID_CONTRAST, contrast, &m_current_contrast, contrast);
 }
 
 //======================================================================
@@ -2255,14 +3533,7 @@ int SecCamera::m_setSharpness(int sharpness)
 
     LOGV("%s(sharpness(%d))", __FUNCTION__, sharpness);
 
-    if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_SHARPNESS, sharpness) < 0) {
-        LOGE("ERR(%s):V4L2_CID_SHARPNESS(%d) fail\n", __FUNCTION__, sharpness);
-        return -1;
-    }
-
-    m_current_sharpness = sharpness;
-
-    return 0;
+    return m_queueCtrl(V4L2_CID_SHARPNESS, sharpness, &m_current_sharpness, sharpness);
 }
 
 int  SecCamera::m_setSaturation(int saturation)
@@ -2272,25 +3543,41 @@ int  SecCamera::m_setSaturation(int saturation)
 
     LOGV("%s(saturation(%d))", __FUNCTION__, saturation);
 
-    if(fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_SATURATION, saturation) < 0) {
-        LOGE("ERR(%s):V4L2_CID_CONTRAST(%d) fail\n", __FUNCTION__, saturation);
-        return -1;
-    }
-
-    m_current_saturation = saturation;
-
-    return 0;
+    return m_queueCtrl(V4L2_CID_SATURATION, saturation, &m_current_saturation, saturation);
 }
 
 int SecCamera::m_setZoom(int zoom)
 {
-    if(zoom == m_current_zoom)
-        return 0;
-
+    // also called after S_FMT, which resets the crop, so it is always applied
     LOGV("%s(zoom(%d))", __FUNCTION__, zoom);
 
 #ifdef USE_SEC_CROP_ZOOM
-    // set crop
+    // a burst runs on the preview port at the snapshot size
+    if (m_flag_burst_start == FLAG_ON)
+        m_setCrop(m_cam_fd, zoom, m_snapshot_width, m_snapshot_height);
+    else
+        m_setCrop(m_cam_fd, zoom, m_preview_width, m_preview_height);
+
+#ifdef DUAL_PORT_RECORDING
+    if (m_flag_record_start == FLAG_ON)
+        m_setCrop(m_cam_fd2, zoom, m_preview_width, m_preview_height);
+#endif
+#ifdef ZERO_SHUTTER_LAG
+    // the ring keeps the field of view of the preview
+    if (m_flag_zsl_start == FLAG_ON)
+        m_setCrop(m_cam_fd_zsl, zoom, m_zsl_width, m_zsl_height);
+#endif
+#endif // USE_SEC_CROP_ZOOM
+
+    m_current_zoom = zoom;
+
+    return 0;
+}
+
+#ifdef USE_SEC_CROP_ZOOM
+// crop of the fixed camera output that FIMC scales to the port size, width x height
+int SecCamera::m_setCrop(int fd, int zoom, int width, int height)
+{
     struct v4l2_cropcap cropcap;
     struct v4l2_crop crop;
     unsigned int crop_x      = 0;
@@ -2300,86 +3587,32 @@ int SecCamera::m_setZoom(int zoom)
 
     cropcap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-    if(ioctl(m_cam_fd, VIDIOC_CROPCAP, &cropcap) >= 0) {
-        m_getCropRect(cropcap.bounds.width, cropcap.bounds.height,
-                m_preview_width,     m_preview_height,
-                &crop_x,             &crop_y,
-                &crop_width,         &crop_height,
-                m_zoom);
-
-        if(   (unsigned int)cropcap.bounds.width  != crop_width
-                || (unsigned int)cropcap.bounds.height != crop_height) {
-            cropcap.defrect.left   = crop_x;
-            cropcap.defrect.top    = crop_y;
-            cropcap.defrect.width  = crop_width;
-            cropcap.defrect.height = crop_height;
-            crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            crop.c    = cropcap.defrect;
-
-            if (ioctl(m_cam_fd, VIDIOC_S_CROP, &crop) < 0)
-                LOGE("%s(VIDIOC_S_CROP fail(%d))", __FUNCTION__, zoom);
-        }
-
-        /*
-           LOGV("## 1 cropcap.bounds.width  : %d \n", cropcap.bounds.width);
-           LOGV("## 1 cropcap.bounds.height : %d \n", cropcap.bounds.height);
-           LOGV("## 1 width                 : %d \n", width);
-           LOGV("## 1 height                : %d \n", height);
-           LOGV("## 1 m_zoom                : %d \n", m_zoom);
-           LOGV("## 2 crop_width            : %d \n", crop_width);
-           LOGV("## 2 crop_height           : %d \n", crop_height);
-           LOGV("## 2 cropcap.defrect.width : %d \n", cropcap.defrect.width);
-           LOGV("## 2 cropcap.defrect.height: %d \n", cropcap.defrect.height);
-         */
-    }
-    else
+    if(ioctl(fd, VIDIOC_CROPCAP, &cropcap) < 0) {
         LOGE("%s(VIDIOC_CROPCAP fail (bug ignored..))", __FUNCTION__);
-    // ignore errors
-
-#ifdef DUAL_PORT_RECORDING
-    cropcap.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        return -1;
+    }
 
-    if(ioctl(m_cam_fd2, VIDIOC_CROPCAP, &cropcap) >= 0) {
-        m_getCropRect(cropcap.bounds.width, cropcap.bounds.height,
-                m_preview_width,     m_preview_height,
-                &crop_x,             &crop_y,
-                &crop_width,         &crop_height,
-                m_zoom);
-
-        if(   (unsigned int)cropcap.bounds.width  != crop_width
-                || (unsigned int)cropcap.bounds.height != crop_height) {
-            cropcap.defrect.left   = crop_x;
-            cropcap.defrect.top    = crop_y;
-            cropcap.defrect.width  = crop_width;
-            cropcap.defrect.height = crop_height;
-            crop.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            crop.c    = cropcap.defrect;
-
-            if (ioctl(m_cam_fd2, VIDIOC_S_CROP, &crop) < 0)
-                LOGE("%s(VIDIOC_S_CROP fail(%d))", __FUNCTION__, zoom);
-        }
+    m_getCropRect(cropcap.bounds.width, cropcap.bounds.height,
+            width,               height,
+            &crop_x,             &crop_y,
+            &crop_width,         &crop_height,
+            zoom);
 
-        /*
-           LOGV("## 1 cropcap.bounds.width  : %d \n", cropcap.bounds.width);
-           LOGV("## 1 cropcap.bounds.height : %d \n", cropcap.bounds.height);
-           LOGV("## 1 width                 : %d \n", width);
-           LOGV("## 1 height                : %d \n", height);
-           LOGV("## 1 m_zoom                : %d \n", m_zoom);
-           LOGV("## 2 crop_width            : %d \n", crop_width);
-           LOGV("## 2 crop_height           : %d \n", crop_height);
-           LOGV("## 2 cropcap.defrect.width : %d \n", cropcap.defrect.width);
-           LOGV("## 2 cropcap.defrect.height: %d \n", cropcap.defrect.height);
-         */
-    } else
-        LOGE("%s(VIDIOC_CROPCAP fail (bug ignored..))", __FUNCTION__);
-#endif
-#endif // USE_SEC_CROP_ZOOM
+    // zooming back out needs the full window again, so it is always set
+    crop.type     = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    crop.c.left   = crop_x;
+    crop.c.top    = crop_y;
+    crop.c.width  = crop_width;
+    crop.c.height = crop_height;
 
-    m_current_zoom = zoom;
+    if (ioctl(fd, VIDIOC_S_CROP, &crop) < 0) {
+        LOGE("%s(VIDIOC_S_CROP fail(%d))", __FUNCTION__, zoom);
+        return -1;
+    }
 
     return 0;
 }
-
+#endif // USE_SEC_CROP_ZOOM
 
 int SecCamera::m_setAF(int af_mode, int flag_run, int flag_on, int * flag_focused)
 {
@@ -2495,9 +3728,6 @@ int SecCamera::m_getCropRect(unsigned int   src_width,  unsigned int   src_heigh
                              unsigned int * crop_width, unsigned int * crop_height,
                              int            zoom)
 {
-#define DEFAULT_ZOOM_RATIO        (4) // 4x zoom
-#define DEFAULT_ZOOM_RATIO_SHIFT  (2)
-
     unsigned int cal_src_width   = src_width;
     unsigned int cal_src_height  = src_height;
 
@@ -2524,11 +3754,13 @@ int SecCamera::m_getCropRect(unsigned int   src_width,  unsigned int   src_heigh
         }
 
         if(zoom != 0) {
+            // steps of the aspect corrected window : it keeps its ratio and
+            // ZOOM_MAX is its quarter, as getZoomRatio() reports
             unsigned int zoom_width_step =
-                (src_width  - (src_width  >> DEFAULT_ZOOM_RATIO_SHIFT)) / ZOOM_MAX;
+                (cal_src_width  - (cal_src_width  >> DEFAULT_ZOOM_RATIO_SHIFT)) / ZOOM_MAX;
 
             unsigned int zoom_height_step =
-                (src_height - (src_height >> DEFAULT_ZOOM_RATIO_SHIFT)) / ZOOM_MAX;
+                (cal_src_height - (cal_src_height >> DEFAULT_ZOOM_RATIO_SHIFT)) / ZOOM_MAX;
 
 
             cal_src_width  = cal_src_width   - (zoom_width_step  * zoom);
@@ -2547,6 +3779,10 @@ int SecCamera::m_getCropRect(unsigned int   src_width,  unsigned int   src_heigh
             cal_src_width -= width_align;
     }
 #endif
+    // FIMC scaler input : width in 16 pixels, height in lines pairs
+    cal_src_width  &= ~0xf;
+    cal_src_height &= ~0x1;
+
     // kcoolsw : this can be camera view weird..
     //           because dd calibrate x y once again
     *crop_x      = (src_width  - cal_src_width ) >> 1;
@@ -2602,6 +3838,44 @@ status_t SecCamera::dump(int fd, const Vector<String16>& args)
     String8 result;
     snprintf(buffer, 255, "dump(%d)\n", fd);
     result.append(buffer);
+#ifdef ZERO_SHUTTER_LAG
+    snprintf(buffer, 255, "zsl(%d) started(%d) %d x %d, %d buffers\n",
+            m_flag_zsl, m_flag_zsl_start, m_zsl_width, m_zsl_height, m_zsl_nframe);
+    result.append(buffer);
+#endif
+#ifdef BURST_CAPTURE
+    snprintf(buffer, 255, "burst started(%d) %d buffers\n",
+            m_flag_burst_start, m_burst_nframe);
+    result.append(buffer);
+#endif
+    snprintf(buffer, 255, "zoom %d, step latency %lld us (max %lld us)\n",
+            m_zoom, ns2us(m_zoom_latency), ns2us(m_zoom_latency_max));
+    result.append(buffer);
+    snprintf(buffer, 255, "%u controls in %u ioctls, S_EXT_CTRLS(%d)\n",
+            m_ctrl_writes, m_ctrl_ioctls, m_flag_ext_ctrls);
+    result.append(buffer);
+    snprintf(buffer, 255, "shutter lag %lld ms, shot to shot %lld ms\n",
+            ns2ms(m_shutter_lag), ns2ms(m_shot_to_shot));
+    result.append(buffer);
+    snprintf(buffer, 255, "jpeg session fd(%d) shots(%u) copied %u bytes\n",
+            getJpegFd(), m_jpeg_shots, m_jpeg_copy_bytes);
+    result.append(buffer);
+    {
+        static const char *stage_name[JPEG_STAGE_MAX] =
+            { "scale", "thumb", "main", "exif", "assemble", "total" };
+
+        for (int i = 0; i < JPEG_STAGE_MAX; i++) {
+            snprintf(buffer, 255, "  %-8s %6lld us (max %6lld us)\n", stage_name[i],
+                    ns2us(m_jpeg_stage_time[i]), ns2us(m_jpeg_stage_time_max[i]));
+            result.append(buffer);
+        }
+    }
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    snprintf(buffer, 255, "thumbnail %d x %d quality(%d), %u scaled by FIMC, gps(%d)\n",
+            m_jpeg_thumbnail_width, m_jpeg_thumbnail_height, m_jpeg_thumbnail_quality,
+            m_jpeg_hw_thumbs, m_gps_enabled);
+    result.append(buffer);
+#endif
     ::write(fd, result.string(), result.size());
     return NO_ERROR;
 }
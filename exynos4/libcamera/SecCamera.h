@@ -36,6 +36,10 @@
 #include <videodev2_samsung.h>
 
 #include <camera/CameraHardwareInterface.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+#include "SecCameraPostProc.h"
 
 namespace android {
 
@@ -46,13 +50,19 @@ namespace android {
 
 #define DUAL_PORT_RECORDING //Define this if 2 fimc ports are needed for recording.
 
-//#define INCLUDE_JPEG_THUMBNAIL 0 //Valid only for on chip JPEG encoder
+#define ZERO_SHUTTER_LAG //Define this to keep frames on the recording fimc port for zero shutter lag capture, while not recording. The sensor stays in preview mode, so only pictures no bigger than the preview are taken from the ring; off by default.
+
+#define BURST_CAPTURE //Define this to stream bursts of full resolution pictures from the capture port.
+
+#define INCLUDE_JPEG_THUMBNAIL //Define this to put EXIF and a FIMC scaled thumbnail into the pictures. Valid only for on chip JPEG encoder
+
+#define PREVIEW_CALLBACK_CONVERT //Define this to convert and downscale the preview callback frames on a worker thread. Valid only with PREVIEW_USING_MMAP
 
 //#define PERFORMANCE     //Uncomment to measure performance
 
 //#define DUMP_YUV        //Uncomment to take a dump of YUV frame during capture
 
-//#define USE_SEC_CROP_ZOOM // use digital zoom using crop ( <-> optical zoom)
+#define USE_SEC_CROP_ZOOM // use digital zoom using crop ( <-> optical zoom)
 
 
 #if defined(LOG_NDEBUG) && LOG_NDEBUG == 0
@@ -138,12 +148,45 @@ namespace android {
 
 #ifdef DUAL_PORT_RECORDING
 #define CAMERA_DEV_NAME2  "/dev/video2"
+#define RECORD_V4L2_FORMAT V4L2_PIX_FMT_NV12T // OMX_SEC_COLOR_FormatNV12TPhysicalAddress for the encoder
+#endif
+
+#ifdef ZERO_SHUTTER_LAG
+// FIMC1 is the m2m scaler of overlay / copybit and FIMC3 the one of libhdmi,
+// so the ring borrows the recording port while it runs
+#define CAMERA_DEV_NAME_ZSL "/dev/video2"
+#endif
+
+#define DEFAULT_ZOOM_RATIO        (4) // 4x zoom
+#define DEFAULT_ZOOM_RATIO_SHIFT  (2)
+
+#define CTRL_BATCH_MAX  (8) // sensor controls written by one m_flushCtrls()
+
+// a whole picture : SOI, APP1 (EXIF and thumbnail) and the picture stream
+#ifdef INCLUDE_JPEG_THUMBNAIL
+#define JPEG_PICTURE_BUF_SIZE   (2 + EXIF_APP1_MAX_SIZE + JPEG_STREAM_BUF_SIZE)
+#else
+#define JPEG_PICTURE_BUF_SIZE   (JPEG_STREAM_BUF_SIZE)
 #endif
 
 #define BPP             (2)
 #define MIN(x, y)       ((x < y) ? x : y)
 #define MAX_BUFFERS     (8)
 
+#ifdef ZERO_SHUTTER_LAG
+#define ZSL_MIN_BUFFERS     (3)
+#define ZSL_DEFAULT_BUFFERS (4)
+#define ZSL_QUEUED_BUFFERS  (2) // left with the driver so the ring never stalls
+#endif
+
+#ifdef BURST_CAPTURE
+#define BURST_MIN_BUFFERS   (3)
+#define BURST_SKIP_FRAMES   (10) // sensor settling after the mode switch, as in getSnapshot()
+#define BURST_MAX_PICTURES  (30)
+#define BURST_DEFAULT_QUEUE (2)  // captured frames waiting for the encoder
+#define BURST_HELD_BUFFERS  (3)  // being coded, just captured and one left with the driver
+#endif
+
 /*
  * V 4 L 2   F I M C   E X T E N S I O N S
  *
@@ -277,7 +320,7 @@ public:
 
     enum ZOOM {
         ZOOM_BASE =  0,
-        ZOOM_MAX  = 10,
+        ZOOM_MAX  = 30,   // steps up to DEFAULT_ZOOM_RATIO, one per preview frame for smooth zoom
     };
 
     enum FLAG {
@@ -285,6 +328,16 @@ public:
         FLAG_ON  = 1,
     };
 
+    enum JPEG_STAGE {
+        JPEG_STAGE_SCALE = 0,   // thumbnail downscale
+        JPEG_STAGE_THUMB,       // thumbnail encode
+        JPEG_STAGE_MAIN,        // picture encode
+        JPEG_STAGE_EXIF,        // APP1 segment
+        JPEG_STAGE_ASSEMBLE,    // APP1 put into the picture stream
+        JPEG_STAGE_TOTAL,
+        JPEG_STAGE_MAX,
+    };
+
 private:
     int m_flag_create;
 
@@ -294,6 +347,9 @@ private:
     struct pollfd m_events_c2;
     int m_flag_record_start;
     struct fimc_buffer m_buffers_c2[MAX_BUFFERS];
+    int   m_record_refs[MAX_BUFFERS];  // holders of each recording frame, 0 : queued to the driver
+    unsigned int m_record_gen;         // startRecord() count, frames of an older session are not queued
+    Mutex m_record_lock;
 #endif
 
 #ifdef BOARD_SUPPORT_SYSMMU
@@ -329,6 +385,10 @@ private:
     int m_sharpness;
     int m_saturation;
     int m_zoom;
+    nsecs_t m_zoom_request_time;   // setZoom() not seen in a frame yet
+    int     m_zoom_frames;         // frames completed since then
+    nsecs_t m_zoom_latency;
+    nsecs_t m_zoom_latency_max;
 
     int m_angle;
 
@@ -336,6 +396,17 @@ private:
 
     int m_flag_preview_start;
     int m_flag_current_info_changed;
+    int m_flag_ctrl_changed;    // only sensor controls, see m_applyCtrls()
+
+    // sensor controls for the next m_flushCtrls(), one VIDIOC_S_EXT_CTRLS per class
+    // while the driver takes it, VIDIOC_S_CTRL each otherwise
+    struct v4l2_ext_control m_ctrl_batch[CTRL_BATCH_MAX];
+    int *        m_ctrl_current[CTRL_BATCH_MAX];   // m_current_* set once written
+    int          m_ctrl_value  [CTRL_BATCH_MAX];
+    int          m_ctrl_count;
+    int          m_flag_ext_ctrls;
+    unsigned int m_ctrl_writes;     // controls written
+    unsigned int m_ctrl_ioctls;     // ioctls it took
 
     int m_current_camera_id;
 
@@ -350,10 +421,26 @@ private:
     int m_current_zoom;
     int m_current_af_mode;
 
-    int m_jpeg_fd;
+    struct jpeg_lib * m_jpeg_ctx;
+    unsigned char * m_jpeg_in_buf;   // encoder input, snapshots can be taken straight into it
+    unsigned char * m_jpeg_out_buf;
+    unsigned int    m_jpeg_shots;
+    nsecs_t         m_jpeg_stage_time[JPEG_STAGE_MAX];     // last shot
+    nsecs_t         m_jpeg_stage_time_max[JPEG_STAGE_MAX];
+    unsigned int    m_jpeg_copy_bytes;      // raw bytes copied into the encoder, all shots
+    unsigned int    m_snapshot_phys;        // frame of the last getSnapshot(), 0 once it is given back
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    unsigned char * m_jpeg_thumb_in_buf;    // scaled thumbnail, waits here while the picture is coded
+    unsigned char * m_jpeg_pic_buf;         // picture stream with SOI and APP1 in front, when the caller has no buffer
+    unsigned char * m_exif_buf;             // APP1 segment
+    unsigned int    m_jpeg_hw_thumbs;       // thumbnails scaled by FIMC
+    SecCameraPostProc m_post_proc;
+#endif
     int m_jpeg_thumbnail_width;
     int m_jpeg_thumbnail_height;
+    int m_jpeg_thumbnail_quality;
     int m_jpeg_quality;
+    int          m_gps_enabled;
     double       m_gps_latitude;
     double       m_gps_longitude;
     unsigned int m_gps_timestamp;
@@ -363,6 +450,39 @@ private:
     struct fimc_buffer m_buffers_c[MAX_BUFFERS];
     struct pollfd m_events_c;
 
+#ifdef ZERO_SHUTTER_LAG
+    enum ZSL_BUF_STATE {
+        ZSL_BUF_QUEUED = 0, // owned by the driver
+        ZSL_BUF_FILLED,     // holds a frame, candidate for the next shot
+        ZSL_BUF_LOCKED,     // picked for the current shot
+    };
+
+    int m_cam_fd_zsl;       // open only while the ring runs
+    int m_zsl_input;
+    struct pollfd m_events_zsl;
+    int m_flag_zsl;
+    int m_flag_zsl_start;
+    int m_zsl_nframe;
+    int m_zsl_width;
+    int m_zsl_height;
+    int m_zsl_v4lformat;
+    int m_zsl_pick;
+    struct fimc_buffer m_buffers_zsl[MAX_BUFFERS];
+    int     m_zsl_state[MAX_BUFFERS];
+    nsecs_t m_zsl_timestamp[MAX_BUFFERS];
+    Mutex   m_zsl_lock;
+#endif
+
+#ifdef BURST_CAPTURE
+    int m_flag_burst_start;
+    int m_burst_nframe;
+#endif
+
+    nsecs_t m_shutter_time;
+    nsecs_t m_last_shutter_time;
+    nsecs_t m_shutter_lag;   // frame time - shutter time
+    nsecs_t m_shot_to_shot;  // between the last two shutters
+
  public:
 
     SecCamera();
@@ -389,6 +509,11 @@ private:
     int               startRecord(void);
     int               stopRecord (void);
     int               getRecord(void);
+    int               getRecordFrame(nsecs_t *timestamp, unsigned int *gen);
+    int               getRecordQueued(void);
+    void              refRecordFrame(int index);
+    int               releaseRecordFrame(int index, unsigned int gen);
+    int               getRecordPixelFormat(void);
     unsigned int      getRecPhyAddrY(int);
     unsigned int      getRecPhyAddrC(int);
 #endif
@@ -397,6 +522,8 @@ private:
 
     int               flagPreviewStart(void);
     int               getPreview(void);
+    int               getPreviewFrame(nsecs_t *timestamp, int *skipped);
+    int               releasePreviewFrame(int index);
     int               setPreviewSize(int   width, int	height, int pixel_format);
     int               getPreviewSize(int * width, int * height);
     int               getPreviewSize(int * width, int * height, unsigned int * frame_size);
@@ -413,14 +540,23 @@ private:
 
     unsigned char *   getJpeg  (unsigned char *snapshot_data, int snapshot_size, int * size);
     void              CloseJpegBuffer(void);
+    int               openJpeg(void);
+    void              closeJpeg(void);
+    int               lockJpeg(void);
+    void              unlockJpeg(void);
+    unsigned char *   getJpegInBuf(void);
+    int               getJpegBufOffsets(int * in_offset, int * out_offset);
     unsigned char *   yuv2Jpeg (unsigned char * raw_data, int raw_size,
                                 int * jpeg_size,
-                                int width, int height, int pixel_format);
+                                int width, int height, int pixel_format,
+                                unsigned char * pic_buf = NULL, int pic_buf_size = 0);
 
     int               setJpegThumbnailSize(int   width, int	height);
     int               getJpegThumbnailSize(int * width, int * height);
+    void              setJpegThumbnailQuality(int quality);
 
     int               setGpsInfo(double latitude, double longitude, unsigned int timestamp, int altitude);
+    void              clearGpsInfo(void);
 
     int               SetRotate(int angle);
     int               getRotate(void);
@@ -463,12 +599,30 @@ private:
     int               getZoom(void);
     int               getZoomMin(void);
     int               getZoomMax(void);
+    int               getZoomRatio(int zoom);
+    void              getZoomStats(nsecs_t *latency, nsecs_t *latency_max);
+    void              getCtrlStats(unsigned int *writes, unsigned int *ioctls);
 
     int               setAFMode(int af_mode);
     int               getAFMode(void);
     int               runAF(int flag_on, int * flag_focused);
 
     void              setJpegQuality(int quality);
+    void              getJpegStageTimes(nsecs_t *times, nsecs_t *times_max);
+
+    int               setZsl(int flag_on, int nr_frames);
+    int               flagZsl(void);
+    void              markShutter(void);
+    void              getCaptureStats(nsecs_t *shutter_lag, nsecs_t *shot_to_shot);
+#ifdef BURST_CAPTURE
+    int               startBurst(int nr_buffers);
+    int               stopBurst(void);
+    int               flagBurstStart(void);
+    int               getBurstFrame(nsecs_t *timestamp);
+    int               releaseBurstFrame(int index);
+    unsigned char *   getBurstJpeg(int index, int *jpeg_size,
+                                   unsigned char *pic_buf = NULL, int pic_buf_size = 0);
+#endif
     unsigned char *   getJpeg(int*, unsigned int*);
     unsigned int      getSnapshot(unsigned char* rawBuffer, int pictureSize);
     int               getCameraFd(void);
@@ -495,7 +649,11 @@ private:
     int  m_setSharpness   (int sharpness);
     int  m_setSaturation  (int saturation);
     int  m_setZoom        (int zoom);
+    int  m_setCrop        (int fd, int zoom, int width, int height);
     int  m_setAF          (int af_mode, int flag_run, int flag_on, int * flag_focused);
+    int  m_queueCtrl      (unsigned int id, int value, int *current, int current_value);
+    int  m_flushCtrls     (int fd);
+    int  m_applyCtrls     (void);
 
     int  m_getCropRect    (unsigned int   src_width,  unsigned int   src_height,
                            unsigned int   dst_width,  unsigned int   dst_height,
@@ -503,6 +661,23 @@ private:
                            unsigned int * crop_width, unsigned int * crop_height,
                            int            zoom);
     inline unsigned int m_frameSize(int format, int width, int height);
+
+#ifdef ZERO_SHUTTER_LAG
+    int  m_startZsl       (void);
+    int  m_stopZsl        (void);
+    void m_closeZslPort   (void);
+    void m_drainZsl       (void);
+    int  m_pickZsl        (nsecs_t shutter_time);
+    unsigned int m_getZslSnapshot(unsigned char *rawBuffer, int pictureSize);
+#endif
+
+    static enum jpeg_img_quality_level m_jpegQualityLevel(int quality);
+#ifdef INCLUDE_JPEG_THUMBNAIL
+    static void m_jpegDone(struct jpeg_lib *ctx, enum jpeg_ret_type ret, void *cookie);
+    int  m_scaleThumbnail (unsigned char *raw_data, int width, int height, int pixel_format);
+    int  m_encodeThumbnail(enum jpeg_stream_format out_fmt);
+    int  m_makeExif       (int width, int height, unsigned char *thumb, int thumb_size);
+#endif
 };
 
 extern unsigned long measure_time(struct timeval *start, struct timeval *stop);
@@ -0,0 +1,463 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SecCameraConvert"
+#include <utils/Log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/videodev2.h>
+#include <videodev2_samsung.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "SecCameraConvert.h"
+
+// NV12T layout, as the capture buffers are sized in SecCamera
+#define TILE_W            (64)
+#define TILE_H            (32)
+#define TILE_SIZE         (TILE_W * TILE_H)
+#define ALIGN_TO_32B(x)   ((((x) + (1 <<  5) - 1) >>  5) <<  5)
+#define ALIGN_TO_128B(x)  ((((x) + (1 <<  7) - 1) >>  7) <<  7)
+#define ALIGN_TO_8KB(x)   ((((x) + (1 << 13) - 1) >> 13) << 13)
+
+namespace android {
+
+// one frame, planes and strides in bytes
+struct yuv_frame {
+    int             format;
+    int             width;
+    int             height;
+    unsigned char * y;
+    unsigned char * c0;     // CbCr / CrCb plane, Cb plane of YUV420
+    unsigned char * c1;     // Cr plane of YUV420
+    int             y_stride;
+    int             c_stride;
+};
+
+static void set_frame(struct yuv_frame *f, unsigned char *base, int format, int width, int height)
+{
+    f->format   = format;
+    f->width    = width;
+    f->height   = height;
+    f->y        = base;
+    f->c0       = base + width * height;
+    f->c1       = NULL;
+    f->y_stride = width;
+    f->c_stride = width;
+
+    if (format == V4L2_PIX_FMT_YUV420) {
+        f->c1       = f->c0 + (width >> 1) * (height >> 1);
+        f->c_stride = width >> 1;
+    } else if (format == V4L2_PIX_FMT_YUYV) {
+        f->c0       = base;
+        f->y_stride = width << 1;
+        f->c_stride = width << 1;
+    }
+}
+
+// ======================================================================
+// Line kernels
+
+// a[i], b[i] <- src[2i], src[2i + 1]
+static void deinterleave(const unsigned char *src, unsigned char *a, unsigned char *b, int n)
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t ab = vld2q_u8(src + 2 * i);
+        vst1q_u8(a + i, ab.val[0]);
+        vst1q_u8(b + i, ab.val[1]);
+    }
+#endif
+    for (; i < n; i++) {
+        a[i] = src[2 * i];
+        b[i] = src[2 * i + 1];
+    }
+}
+
+static void interleave(const unsigned char *a, const unsigned char *b, unsigned char *dst, int n)
+{
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t ab;
+        ab.val[0] = vld1q_u8(a + i);
+        ab.val[1] = vld1q_u8(b + i);
+        vst2q_u8(dst + 2 * i, ab);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[2 * i]     = a[i];
+        dst[2 * i + 1] = b[i];
+    }
+}
+
+// Y0 Cb Y1 Cr : luma of width pixels, cb / cr (both or none) of width / 2
+static void unpack_yuyv(const unsigned char *src, unsigned char *y,
+                        unsigned char *cb, unsigned char *cr, int width)
+{
+    int pairs = width >> 1;
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    if (cb == NULL) {
+        for (; i + 8 <= pairs; i += 8) {
+            uint8x16x2_t yc = vld2q_u8(src + 4 * i);
+            vst1q_u8(y + 2 * i, yc.val[0]);
+        }
+    } else {
+        for (; i + 16 <= pairs; i += 16) {
+            uint8x16x4_t ycyc = vld4q_u8(src + 4 * i);
+            uint8x16x2_t yy;
+            yy.val[0] = ycyc.val[0];
+            yy.val[1] = ycyc.val[2];
+            vst2q_u8(y + 2 * i, yy);
+            vst1q_u8(cb + i, ycyc.val[1]);
+            vst1q_u8(cr + i, ycyc.val[3]);
+        }
+    }
+#endif
+    for (; i < pairs; i++) {
+        y[2 * i]     = src[4 * i];
+        y[2 * i + 1] = src[4 * i + 2];
+        if (cb != NULL) {
+            cb[i] = src[4 * i + 1];
+            cr[i] = src[4 * i + 3];
+        }
+    }
+}
+
+static void pack_yuyv(const unsigned char *y, const unsigned char *cb,
+                      const unsigned char *cr, unsigned char *dst, int width)
+{
+    int pairs = width >> 1;
+    int i = 0;
+
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= pairs; i += 16) {
+        uint8x16x2_t yy = vld2q_u8(y + 2 * i);
+        uint8x16x4_t ycyc;
+        ycyc.val[0] = yy.val[0];
+        ycyc.val[1] = vld1q_u8(cb + i);
+        ycyc.val[2] = yy.val[1];
+        ycyc.val[3] = vld1q_u8(cr + i);
+        vst4q_u8(dst + 4 * i, ycyc);
+    }
+#endif
+    for (; i < pairs; i++) {
+        dst[4 * i]     = y[2 * i];
+        dst[4 * i + 1] = cb[i];
+        dst[4 * i + 2] = y[2 * i + 1];
+        dst[4 * i + 3] = cr[i];
+    }
+}
+
+static void scale_line(const unsigned char *src, unsigned char *dst, const int *xmap, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = src[xmap[i]];
+}
+
+// ======================================================================
+// Rows of a frame
+
+static const unsigned char *get_luma(const struct yuv_frame *f, int row, unsigned char *line)
+{
+    const unsigned char *src = f->y + row * f->y_stride;
+
+    if (f->format != V4L2_PIX_FMT_YUYV)
+        return src;
+
+    unpack_yuyv(src, line, NULL, NULL, f->width);
+    return line;
+}
+
+// chroma row of the 4:2:0 frame, YUYV gives the first of its two lines
+static void get_chroma(const struct yuv_frame *f, int crow, unsigned char *cb,
+                       unsigned char *cr, unsigned char *line,
+                       const unsigned char **cb_out, const unsigned char **cr_out)
+{
+    int width = f->width >> 1;
+
+    *cb_out = cb;
+    *cr_out = cr;
+
+    switch (f->format) {
+    case V4L2_PIX_FMT_NV12:
+        deinterleave(f->c0 + crow * f->c_stride, cb, cr, width);
+        break;
+    case V4L2_PIX_FMT_NV21:
+        deinterleave(f->c0 + crow * f->c_stride, cr, cb, width);
+        break;
+    case V4L2_PIX_FMT_YUV420:
+        *cb_out = f->c0 + crow * f->c_stride;
+        *cr_out = f->c1 + crow * f->c_stride;
+        break;
+    case V4L2_PIX_FMT_YUYV:
+        unpack_yuyv(f->c0 + (crow << 1) * f->c_stride, line, cb, cr, f->width);
+        break;
+    }
+}
+
+static void put_row(struct yuv_frame *f, int row, const unsigned char *y,
+                    const unsigned char *cb, const unsigned char *cr)
+{
+    unsigned char *dst = f->y + row * f->y_stride;
+    int width = f->width >> 1;
+
+    if (f->format == V4L2_PIX_FMT_YUYV) {
+        pack_yuyv(y, cb, cr, dst, f->width);
+        return;
+    }
+
+    memcpy(dst, y, f->width);
+
+    if (row & 1)
+        return;
+
+    row >>= 1;
+    switch (f->format) {
+    case V4L2_PIX_FMT_NV12:
+        interleave(cb, cr, f->c0 + row * f->c_stride, width);
+        break;
+    case V4L2_PIX_FMT_NV21:
+        interleave(cr, cb, f->c0 + row * f->c_stride, width);
+        break;
+    case V4L2_PIX_FMT_YUV420:
+        memcpy(f->c0 + row * f->c_stride, cb, width);
+        memcpy(f->c1 + row * f->c_stride, cr, width);
+        break;
+    }
+}
+
+// 64x32 tiles, pairs of tile rows in Z order, a last odd tile row linear
+static int tile_pos(int x, int y, int w, int h)
+{
+    int pos = x + (y & ~1) * w;
+
+    if (y & 1)
+        pos += (x & ~3) + 2;
+    else if ((h & 1) == 0 || y != (h - 1))
+        pos += (x + 2) & ~3;
+
+    return pos;
+}
+
+static void detile_plane(const unsigned char *src, unsigned char *dst, int width, int height)
+{
+    int tiles_w = ALIGN_TO_128B(width)  / TILE_W;
+    int tiles_h = ALIGN_TO_32B (height) / TILE_H;
+
+    for (int ty = 0; ty < tiles_h; ty++) {
+        int lines = height - ty * TILE_H;
+        if (TILE_H < lines)
+            lines = TILE_H;
+
+        for (int tx = 0; tx < tiles_w; tx++) {
+            const unsigned char *tile = src + tile_pos(tx, ty, tiles_w, tiles_h) * TILE_SIZE;
+            unsigned char *out = dst + ty * TILE_H * width + tx * TILE_W;
+            int bytes = width - tx * TILE_W;
+
+            if (bytes <= 0)
+                break;
+            if (TILE_W < bytes)
+                bytes = TILE_W;
+
+            for (int i = 0; i < lines; i++)
+                memcpy(out + i * width, tile + i * TILE_W, bytes);
+        }
+    }
+}
+
+// ======================================================================
+// SecCameraConvert
+
+SecCameraConvert::SecCameraConvert()
+    : m_frame(NULL),
+      m_frame_size(0),
+      m_lines(NULL),
+      m_lines_width(0),
+      m_xmap(NULL)
+{
+}
+
+SecCameraConvert::~SecCameraConvert()
+{
+    free(m_frame);
+    free(m_lines);
+    free(m_xmap);
+}
+
+bool SecCameraConvert::flagSupported(int src_format, int dst_format)
+{
+    switch (src_format) {
+    case V4L2_PIX_FMT_NV12T:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YUYV:
+        break;
+    default:
+        return false;
+    }
+
+    switch (dst_format) {
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YUYV:
+        return true;
+    default:
+        return false;
+    }
+}
+
+unsigned int SecCameraConvert::frameSize(int format, int width, int height)
+{
+    if (format == V4L2_PIX_FMT_YUYV)
+        return (width * height) << 1;
+
+    return (width * height * 3) >> 1;
+}
+
+// luma and chroma lines of the source, the scaled ones and an unpack line
+int SecCameraConvert::m_allocLines(int width)
+{
+    if (width <= m_lines_width)
+        return 0;
+
+    free(m_lines);
+    free(m_xmap);
+
+    m_lines = (unsigned char *)malloc(width * 5);
+    m_xmap  = (int *)malloc(sizeof(int) * (width + (width >> 1)));
+    if (m_lines == NULL || m_xmap == NULL) {
+        LOGE("ERR(%s):line buffers for width %d fail", __func__, width);
+        free(m_lines);
+        free(m_xmap);
+        m_lines       = NULL;
+        m_xmap        = NULL;
+        m_lines_width = 0;
+        return -1;
+    }
+
+    m_lines_width = width;
+    return 0;
+}
+
+int SecCameraConvert::m_detile(const unsigned char *src, int width, int height)
+{
+    unsigned int size = (width * height * 3) >> 1;
+
+    if (m_frame_size < size) {
+        free(m_frame);
+        m_frame = (unsigned char *)malloc(size);
+        if (m_frame == NULL) {
+            LOGE("ERR(%s):%d x %d frame fail", __func__, width, height);
+            m_frame_size = 0;
+            return -1;
+        }
+        m_frame_size = size;
+    }
+
+    detile_plane(src, m_frame, width, height);
+    detile_plane(src + ALIGN_TO_8KB(ALIGN_TO_128B(width) * ALIGN_TO_32B(height)),
+                 m_frame + width * height, width, height >> 1);
+
+    return 0;
+}
+
+int SecCameraConvert::convert(const unsigned char *src, int src_format, int src_width, int src_height,
+                              unsigned char *dst, int dst_format, int dst_width, int dst_height)
+{
+    struct yuv_frame in;
+    struct yuv_frame out;
+    bool scale = (src_width != dst_width || src_height != dst_height);
+
+    if (!flagSupported(src_format, dst_format)
+            || src_width  < dst_width  || (dst_width  & 1) || dst_width  <= 0
+            || src_height < dst_height || (dst_height & 1) || dst_height <= 0) {
+        LOGE("ERR(%s):%d x %d (%d) to %d x %d (%d) not supported", __func__,
+                src_width, src_height, src_format, dst_width, dst_height, dst_format);
+        return -1;
+    }
+
+    if (m_allocLines(src_width) < 0)
+        return -1;
+
+    if (src_format == V4L2_PIX_FMT_NV12T) {
+        if (m_detile(src, src_width, src_height) < 0)
+            return -1;
+        src        = m_frame;
+        src_format = V4L2_PIX_FMT_NV12;
+    }
+
+    set_frame(&in,  (unsigned char *)src, src_format, src_width, src_height);
+    set_frame(&out, dst, dst_format, dst_width, dst_height);
+
+    unsigned char *src_y  = m_lines;
+    unsigned char *src_cb = src_y  + src_width;
+    unsigned char *src_cr = src_cb + (src_width >> 1);
+    unsigned char *dst_y  = src_cr + (src_width >> 1);
+    unsigned char *dst_cb = dst_y  + dst_width;
+    unsigned char *dst_cr = dst_cb + (dst_width >> 1);
+    unsigned char *unpack = dst_cr + (dst_width >> 1);
+    int *xmap_y = m_xmap;
+    int *xmap_c = m_xmap + dst_width;
+
+    if (scale) {
+        for (int x = 0; x < dst_width; x++)
+            xmap_y[x] = x * src_width / dst_width;
+        for (int x = 0; x < (dst_width >> 1); x++)
+            xmap_c[x] = x * (src_width >> 1) / (dst_width >> 1);
+    }
+
+    const unsigned char *y  = NULL;
+    const unsigned char *cb = NULL;
+    const unsigned char *cr = NULL;
+
+    for (int row = 0; row < dst_height; row++) {
+        int src_row = scale ? row * src_height / dst_height : row;
+
+        y = get_luma(&in, src_row, src_y);
+        if (scale) {
+            scale_line(y, dst_y, xmap_y, dst_width);
+            y = dst_y;
+        }
+
+        // 4:2:0 in between, YUYV repeats a chroma row on its two lines
+        if (dst_format == V4L2_PIX_FMT_YUYV || !(row & 1)) {
+            get_chroma(&in, src_row >> 1, src_cb, src_cr, unpack, &cb, &cr);
+            if (scale) {
+                scale_line(cb, dst_cb, xmap_c, dst_width >> 1);
+                scale_line(cr, dst_cr, xmap_c, dst_width >> 1);
+                cb = dst_cb;
+                cr = dst_cr;
+            }
+        }
+
+        put_row(&out, row, y, cb, cr);
+    }
+
+    return 0;
+}
+
+}; // namespace android
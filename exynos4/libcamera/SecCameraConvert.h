@@ -0,0 +1,59 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Software colour conversion of preview frames for the callback clients,
+ * for formats and sizes the capture node does not give them directly.
+ *
+ * Sources  : V4L2_PIX_FMT_NV12T, NV12, NV21, YUV420, YUYV
+ * Targets  : V4L2_PIX_FMT_NV12, NV21, YUV420, YUYV
+ * The frame is processed line by line through small line buffers, with
+ * NEON for the (de)interleaving when the compiler targets it. Downscaling
+ * picks the nearest source pixel.
+ */
+
+#ifndef ANDROID_HARDWARE_SEC_CAMERA_CONVERT_H
+#define ANDROID_HARDWARE_SEC_CAMERA_CONVERT_H
+
+namespace android {
+
+class SecCameraConvert {
+public:
+    SecCameraConvert();
+    ~SecCameraConvert();
+
+    static bool         flagSupported(int src_format, int dst_format);
+    static unsigned int frameSize(int format, int width, int height);
+
+    // dst no larger than src, both sizes even; src is a whole capture
+    // buffer, NV12T with the FIMC alignment
+    int     convert(const unsigned char *src, int src_format, int src_width, int src_height,
+                    unsigned char *dst, int dst_format, int dst_width, int dst_height);
+
+private:
+    int     m_allocLines(int width);
+    int     m_detile(const unsigned char *src, int width, int height);
+
+    unsigned char * m_frame;        // NV12T source as linear NV12
+    unsigned int    m_frame_size;
+    unsigned char * m_lines;        // line buffers, see m_allocLines()
+    int             m_lines_width;
+    int           * m_xmap;         // dst column to src column, luma then chroma
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_SEC_CAMERA_CONVERT_H
@@ -52,12 +52,93 @@ struct ADDRS_CAP {
     unsigned int height;
 };
 
+#define OMX_SEC_COLOR_FormatNV12TPhysicalAddress        0x7F000001
+
+// recording frame as SEC_OMX_Venc takes it: the physical addresses of the
+// planes instead of the pixels, starting like ADDRS
+struct ADDRS_REC {
+    unsigned int addr_y;
+    unsigned int addr_cbcr;
+    unsigned int buf_idx;       // recording buffer, back with releaseRecordingFrame()
+    unsigned int color_format;  // OMX_SEC_COLOR_FormatNV12TPhysicalAddress, 0 : unknown layout
+    unsigned int width;
+    unsigned int height;
+};
+
+// what a changed key costs the running preview, by setParameters()
+enum PARAM_CLASS {
+    PARAM_STORED     = 1 << 0,  // taken by the next capture or not used at all
+    PARAM_ON_STREAM  = 1 << 1,  // sensor control or FIMC crop, no restart
+    PARAM_RESTART    = 1 << 2,  // capture buffers change, preview restarts
+    PARAM_READ_ONLY  = 1 << 3,  // statistics of getParameters(), ignored
+};
+
+static const struct {
+    const char *key;
+    int         type;
+} param_class[] = {
+    { CameraParameters::KEY_PREVIEW_SIZE,          PARAM_RESTART    },
+    { CameraParameters::KEY_PREVIEW_FORMAT,        PARAM_RESTART    },
+    { "preview-callback-format",                   PARAM_RESTART    },
+    { "preview-callback-size",                     PARAM_RESTART    },
+    { "zsl",                                       PARAM_RESTART    },
+    { "zsl-buffer-count",                          PARAM_RESTART    },
+    { CameraParameters::KEY_PREVIEW_FRAME_RATE,    PARAM_ON_STREAM  },
+    { CameraParameters::KEY_ZOOM,                  PARAM_ON_STREAM  },
+    { CameraParameters::KEY_WHITE_BALANCE,         PARAM_ON_STREAM  },
+    { CameraParameters::KEY_EFFECT,                PARAM_ON_STREAM  },
+    { CameraParameters::KEY_EXPOSURE_COMPENSATION, PARAM_ON_STREAM  },
+    { "scene-mode",                                PARAM_ON_STREAM  },
+    { "preview-frames",                            PARAM_READ_ONLY  },
+    { "preview-frames-skipped",                    PARAM_READ_ONLY  },
+    { "preview-frames-reclaimed",                  PARAM_READ_ONLY  },
+    { "preview-latency-us",                        PARAM_READ_ONLY  },
+    { "preview-latency-max-us",                    PARAM_READ_ONLY  },
+    { "preview-jitter-us",                         PARAM_READ_ONLY  },
+    { "preview-callback-frames",                   PARAM_READ_ONLY  },
+    { "preview-callback-frames-dropped",           PARAM_READ_ONLY  },
+    { "preview-callback-cost-us",                  PARAM_READ_ONLY  },
+    { "preview-callback-cost-max-us",              PARAM_READ_ONLY  },
+    { "zoom-latency-us",                           PARAM_READ_ONLY  },
+    { "zoom-latency-max-us",                       PARAM_READ_ONLY  },
+    { "record-frames",                             PARAM_READ_ONLY  },
+    { "record-frames-dropped",                     PARAM_READ_ONLY  },
+    { "record-latency-us",                         PARAM_READ_ONLY  },
+    { "record-latency-max-us",                     PARAM_READ_ONLY  },
+    { "burst-capture-fps",                         PARAM_READ_ONLY  },
+    { "burst-picture-fps",                         PARAM_READ_ONLY  },
+    { "burst-pictures",                            PARAM_READ_ONLY  },
+    { "burst-dropped",                             PARAM_READ_ONLY  },
+    { "jpeg-heaps-pooled",                         PARAM_READ_ONLY  },
+    { "jpeg-heaps-allocated",                      PARAM_READ_ONLY  },
+    { "param-sets",                                PARAM_READ_ONLY  },
+    { "param-sets-unchanged",                      PARAM_READ_ONLY  },
+    { "param-restarts",                            PARAM_READ_ONLY  },
+    { "param-restarts-avoided",                    PARAM_READ_ONLY  },
+    { "ctrl-writes",                               PARAM_READ_ONLY  },
+    { "ctrl-ioctls",                               PARAM_READ_ONLY  },
+};
+
+static int param_type(const char *key, int len)
+{
+    for (unsigned int i = 0; i < sizeof(param_class) / sizeof(param_class[0]); i++) {
+        if (strncmp(param_class[i].key, key, len) == 0 && param_class[i].key[len] == '\0')
+            return param_class[i].type;
+    }
+
+    return PARAM_STORED;
+}
+
 CameraHardwareSec::CameraHardwareSec(int cameraId)
                   : mParameters(),
                     mPreviewHeap(0),
                     mRawHeap(0),
                     mRecordHeap(0),
                     mJpegHeap(0),
+                    mJpegInOffset(0),
+                    mJpegOutPooled(0),
+                    mJpegOutAllocated(0),
+                    mRecordSession(0),
                     mSecCamera(NULL),
                     mPreviewRunning(false),
                     mRecordRunning(false),
@@ -75,10 +156,45 @@ CameraHardwareSec::CameraHardwareSec(int cameraId)
                     mDataCbTimestamp(0),
                     mCallbackCookie(0),
                     mMsgEnabled(0),
-                    mAFMode(SecCamera::AF_MODE_AUTO)
+                    mAFMode(SecCamera::AF_MODE_AUTO),
+                    mZoomTarget(-1),
+                    mParamSets(0),
+                    mParamUnchanged(0),
+                    mParamRestarts(0),
+                    mParamRestartsAvoided(0)
 {
     LOGV("%s :", __FUNCTION__);
 
+#ifdef BURST_CAPTURE
+    mBurstCount       = 1;
+    mBurstQueueDepth  = BURST_DEFAULT_QUEUE;
+    mBurstDropOnFull  = false;
+    mBurstQueueHead   = 0;
+    mBurstQueueCount  = 0;
+    mBurstAbort       = false;
+    mBurstRunning     = false;
+    mBurstCaptureDone = true;
+    mBurstEncodeDone  = true;
+    mBurstCaptured    = 0;
+    mBurstDropped     = 0;
+    mBurstDelivered   = 0;
+    mBurstStartTime   = 0;
+    mBurstFrameTime   = 0;
+    mBurstPictureTime = 0;
+    mBurstCaptureFps  = 0.0f;
+    mBurstPictureFps  = 0.0f;
+#endif
+
+#ifdef PREVIEW_CALLBACK_CONVERT
+    mCallbackEnabled  = false;
+    mCallbackFormat   = 0;
+    mCallbackWidth    = 0;
+    mCallbackHeight   = 0;
+    mCallbackExit     = false;
+#endif
+
+    m_resetPreviewRing();
+
     mSecCamera = SecCamera::createInstance();
     LOGE_IF(mSecCamera == NULL, "ERR(%s):Fail on mSecCamera object creation", __FUNCTION__);
 
@@ -98,7 +214,9 @@ CameraHardwareSec::CameraHardwareSec(int cameraId)
     }
 #endif
 
-    int recordHeapSize = sizeof(struct ADDRS) * kBufferCount;
+    // two sessions of descriptors, a stopped recording's stay readable
+    // while the next one starts
+    int recordHeapSize = sizeof(struct ADDRS_REC) * kBufferCountForRecord * 2;
     LOGV("mRecordHeap : MemoryHeapBase(recordHeapSize(%d))", recordHeapSize);
 
     mRecordHeap = new MemoryHeapBase(recordHeapSize);
@@ -107,6 +225,8 @@ CameraHardwareSec::CameraHardwareSec(int cameraId)
         mRecordHeap.clear();
     }
 
+    m_resetRecordStats();
+
     int rawHeapSize = sizeof(struct ADDRS_CAP);
     LOGV("mRawAddrHeap : MemoryHeapBase(rawAddrHeapSize(%d))", rawHeapSize);
     mRawAddrHeap = new MemoryHeapBase(rawHeapSize);
@@ -115,12 +235,38 @@ CameraHardwareSec::CameraHardwareSec(int cameraId)
         mRawAddrHeap.clear();
     }
 
+    // snapshots go straight into the encoder input through this mapping,
+    // the jpeg is copied out of the encoder output for the client
+    int jpegOutOffset;
+    if(mSecCamera->getJpegFd() > 0
+            && mSecCamera->getJpegBufOffsets(&mJpegInOffset, &jpegOutOffset) == 0) {
+        LOGV("mJpegHeap : MemoryHeapBase(fd(%d), size(%d), %d)",
+                mSecCamera->getJpegFd(), JPEG_TOTAL_BUF_SIZE, 0);
+        mJpegHeap = new MemoryHeapBase(mSecCamera->getJpegFd(), (size_t)JPEG_TOTAL_BUF_SIZE, (uint32_t)0);
+        if (mJpegHeap->getHeapID() < 0) {
+            LOGE("ERR(%s): Jpeg heap creation fail", __FUNCTION__);
+            mJpegHeap.clear();
+        }
+    }
+
+    // the pages are only committed as the pictures are written
+    for (int i = 0; i < kJpegOutHeapCount; i++) {
+        mJpegOutHeaps[i] = new MemoryHeapBase(JPEG_PICTURE_BUF_SIZE);
+        if (mJpegOutHeaps[i]->getHeapID() < 0) {
+            LOGE("ERR(%s): Jpeg out heap creation fail", __FUNCTION__);
+            mJpegOutHeaps[i].clear();
+        }
+    }
+
     memset(&mFrameRateTimer,  0, sizeof(DurationTimer));
     memset(&mGpsInfo, 0, sizeof(gps_info));
 
     m_initDefaultParameters(cameraId);
 
     mPreviewThread = new PreviewThread(this);
+#ifdef PREVIEW_CALLBACK_CONVERT
+    mCallbackThread = new CallbackThread(this);
+#endif
 }
 
 void CameraHardwareSec::m_initDefaultParameters(int cameraId)
@@ -211,12 +357,57 @@ void CameraHardwareSec::m_initDefaultParameters(int cameraId)
     }
 
     p.set(CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY, "100");
+
+#ifdef ZERO_SHUTTER_LAG
+    // the ring runs with the sensor in preview mode : it only serves
+    // pictures no bigger than the preview, larger ones still restart it
+    p.set("zsl-values",       "off,on");
+    p.set("zsl",              "off");
+    p.set("zsl-buffer-count", ZSL_DEFAULT_BUFFERS);
+#endif
+#ifdef BURST_CAPTURE
+    p.set("burst-capture-max",     BURST_MAX_PICTURES);
+    p.set("burst-capture",         1);
+    p.set("burst-queue-depth-max", MAX_BUFFERS - BURST_HELD_BUFFERS);
+    p.set("burst-queue-depth",     BURST_DEFAULT_QUEUE);
+    p.set("burst-overflow-values", "wait,drop");
+    p.set("burst-overflow",        "wait");
+#endif
+#ifdef USE_SEC_CROP_ZOOM
+    // digital zoom : FIMC crop of the unchanged camera output
+    String8 zoom_ratios;
+    char    ratio[8];
+
+    for (int zoom = SecCamera::ZOOM_BASE; zoom <= SecCamera::ZOOM_MAX; zoom++) {
+        snprintf(ratio, sizeof(ratio), zoom == SecCamera::ZOOM_BASE ? "%d" : ",%d",
+                 mSecCamera->getZoomRatio(zoom));
+        zoom_ratios.append(ratio);
+    }
+    p.set(CameraParameters::KEY_ZOOM_SUPPORTED,        CameraParameters::TRUE);
+    p.set(CameraParameters::KEY_SMOOTH_ZOOM_SUPPORTED, CameraParameters::TRUE);
+    p.set(CameraParameters::KEY_MAX_ZOOM,              SecCamera::ZOOM_MAX);
+    p.set(CameraParameters::KEY_ZOOM_RATIOS,           zoom_ratios.string());
+    p.set(CameraParameters::KEY_ZOOM,                  SecCamera::ZOOM_BASE);
+#endif
+#ifdef PREVIEW_CALLBACK_CONVERT
+    // no preview-callback-format : the preview format, NV21 for NV12T
+    p.set("preview-callback-format-values", "yuv420sp,yuv420sp_nv12,yuv420p,yuv422i-yuyv");
+#endif
     p.set(CameraParameters::KEY_ROTATION, 0);
+    p.set(CameraParameters::KEY_SUPPORTED_WHITE_BALANCE,
+          "auto,incandescent,fluorescent,daylight,cloudy-daylight");
     p.set(CameraParameters::KEY_WHITE_BALANCE, CameraParameters::WHITE_BALANCE_AUTO);
+    p.set(CameraParameters::KEY_SUPPORTED_EFFECTS, "none,mono,negative,sepia,aqua,whiteboard");
+    p.set(CameraParameters::KEY_EFFECT,        CameraParameters::EFFECT_NONE);
+    // exposure compensation steps are the brightness steps around normal
+    p.set(CameraParameters::KEY_MAX_EXPOSURE_COMPENSATION,  SecCamera::BRIGHTNESS_NORMAL);
+    p.set(CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION,  SecCamera::BRIGHTNESS_BASE - SecCamera::BRIGHTNESS_NORMAL);
+    p.set(CameraParameters::KEY_EXPOSURE_COMPENSATION_STEP, "1");
+    p.set(CameraParameters::KEY_EXPOSURE_COMPENSATION,      0);
 
     mParameters = p;
 
-    setParameters(p);
+    m_applyParameters(p);
 
     mSecCamera->setContrast(CONTRAST_DEFAULT);
     mSecCamera->setSharpness(SHARPNESS_DEFAULT);
@@ -352,25 +543,196 @@ status_t CameraHardwareSec::setSurface(const sp<ISurface> &surface)
 
 // ---------------------------------------------------------------------------
 
+void CameraHardwareSec::m_resetPreviewRing(void)
+{
+    for (int i = 0; i < kBufferCount; i++) {
+        mPreviewHold[i] = 0;
+        mPreviewSeq[i]  = 0;
+#if defined(BOARD_USES_CAMERA_OVERLAY)
+        mOverlaySlot[i] = -1;
+#endif
+    }
+
+    mPreviewFrames     = 0;
+    mPreviewSkipped    = 0;
+    mPreviewReclaimed  = 0;
+    mPreviewLastTime   = 0;
+    mPreviewInterval   = 0;
+    mPreviewJitter     = 0;
+    mPreviewLatency    = 0;
+    mPreviewLatencyMax = 0;
+
+#ifdef PREVIEW_CALLBACK_CONVERT
+    mCallbackIndex     = -1;
+    mCallbackDone      = -1;
+    mCallbackFrames    = 0;
+    mCallbackDropped   = 0;
+    mCallbackCost      = 0;
+    mCallbackCostMax   = 0;
+#endif
+}
+
+// the buffer goes back to the camera once nobody holds it
+void CameraHardwareSec::m_releasePreviewHold(int index, int hold)
+{
+    if (mPreviewHold[index] == 0)
+        return;
+
+    mPreviewHold[index] &= ~hold;
+    if (mPreviewHold[index] == 0)
+        mSecCamera->releasePreviewFrame(index);
+}
+
+void CameraHardwareSec::m_recyclePreviewBuffers(void)
+{
+    int queued = 0;
+    int oldest;
+
+#if defined(BOARD_USES_CAMERA_OVERLAY)
+    // the overlay went away with frames in it
+    if (!mUseOverlay)
+        m_releaseOverlaySlots();
+#endif
+
+#ifdef PREVIEW_CALLBACK_CONVERT
+    {
+        Mutex::Autolock lock(mCallbackLock);
+
+        if (0 <= mCallbackDone) {
+            m_releasePreviewHold(mCallbackDone, PREVIEW_HOLD_CALLBACK);
+            mCallbackDone = -1;
+        }
+    }
+#endif
+
+    for (int i = 0; i < kBufferCount; i++) {
+        if ((mPreviewHold[i] & PREVIEW_HOLD_CLIENT)
+                && (mBuffers[i] == 0 || mBuffers[i]->getStrongCount() <= 1))
+            m_releasePreviewHold(i, PREVIEW_HOLD_CLIENT);
+
+        if (mPreviewHold[i] == 0)
+            queued++;
+    }
+
+    // a slow client must not starve the camera
+    while (queued < kPreviewMinQueued) {
+        oldest = -1;
+        for (int i = 0; i < kBufferCount; i++) {
+            if (mPreviewHold[i] == PREVIEW_HOLD_CLIENT
+                    && (oldest < 0 || (int)(mPreviewSeq[i] - mPreviewSeq[oldest]) < 0))
+                oldest = i;
+        }
+
+        if (oldest < 0)
+            break;
+
+        m_releasePreviewHold(oldest, PREVIEW_HOLD_CLIENT);
+        mPreviewReclaimed++;
+        queued++;
+    }
+}
+
+#if defined(BOARD_USES_CAMERA_OVERLAY)
+void CameraHardwareSec::m_releaseOverlaySlots(void)
+{
+    for (int i = 0; i < kBufferCount; i++) {
+        if (0 <= mOverlaySlot[i])
+            m_releasePreviewHold(mOverlaySlot[i], PREVIEW_HOLD_OVERLAY);
+        mOverlaySlot[i] = -1;
+    }
+}
+
+// shows the frame through the next overlay slot, it stays held until the
+// overlay gives that slot back
+void CameraHardwareSec::m_queueOverlay(int index, struct ADDRS *addr, nsecs_t timestamp)
+{
+    overlay_buffer_t overlay_buffer;
+    int slots = mOverlay->getBufferCount();
+    int slot;
+    int ret;
+    nsecs_t latency;
+
+    if (!(0 < slots && slots <= kBufferCount))
+        slots = 2;
+
+    mOverlayBufferIdx = (mOverlayBufferIdx + 1) % slots;
+
+    // taken back by a flush without a dequeue
+    if (0 <= mOverlaySlot[mOverlayBufferIdx]) {
+        m_releasePreviewHold(mOverlaySlot[mOverlayBufferIdx], PREVIEW_HOLD_OVERLAY);
+        mOverlaySlot[mOverlayBufferIdx] = -1;
+    }
+
+    addr->buf_idx = mOverlayBufferIdx;
+    ret = mOverlay->queueBuffer((void*)addr);
+    if (ret == ALL_BUFFERS_FLUSHED) {
+        m_releaseOverlaySlots();
+        return;
+    } else if (ret == -1) {
+        LOGE("ERR(%s):overlay queueBuffer fail", __FUNCTION__);
+        return;
+    }
+
+    mOverlaySlot[mOverlayBufferIdx] = index;
+    mPreviewHold[index] |= PREVIEW_HOLD_OVERLAY;
+
+    latency = systemTime(SYSTEM_TIME_MONOTONIC) - timestamp;
+    mPreviewLatency += (latency - mPreviewLatency) / 16;
+    if (mPreviewLatencyMax < latency)
+        mPreviewLatencyMax = latency;
+
+    ret = mOverlay->dequeueBuffer(&overlay_buffer);
+    if (ret == ALL_BUFFERS_FLUSHED) {
+        m_releaseOverlaySlots();
+    } else if (ret == 0) {
+        slot = (int)overlay_buffer;
+        if (0 <= slot && slot < slots && 0 <= mOverlaySlot[slot]) {
+            m_releasePreviewHold(mOverlaySlot[slot], PREVIEW_HOLD_OVERLAY);
+            mOverlaySlot[slot] = -1;
+        }
+    }
+}
+#endif
+
 int CameraHardwareSec::previewThread()
 {
-    sp<MemoryBase> previewBuffer;
-    sp<MemoryBase> recordBuffer;
+    int index;
 
     {
         LOGV(" m_previewThreadFunc ");
 
-        int index;
+        int skipped;
         unsigned int phyYAddr = 0;
         unsigned int phyCAddr = 0;
+        nsecs_t timestamp;
+        nsecs_t interval;
 
-        index = mSecCamera->getPreview();
+        // buffers the overlay or the client gave back since the last frame
+        m_recyclePreviewBuffers();
+
+        index = mSecCamera->getPreviewFrame(&timestamp, &skipped);
         if(index < 0) {
-            LOGE("ERR(%s):Fail on SecCamera->getPreview()", __FUNCTION__);
+            LOGE("ERR(%s):Fail on SecCamera->getPreviewFrame()", __FUNCTION__);
             return UNKNOWN_ERROR;
         }
 
-		nsecs_t timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+        mPreviewHold[index] = PREVIEW_HOLD_HAL;
+        mPreviewSeq[index]  = mPreviewFrames++;
+        mPreviewSkipped    += skipped;
+
+        if (mPreviewLastTime != 0) {
+            interval = timestamp - mPreviewLastTime;
+            if (mPreviewInterval != 0) {
+                nsecs_t change = interval - mPreviewInterval;
+                if (change < 0)
+                    change = -change;
+                mPreviewJitter += (change - mPreviewJitter) / 16;
+            }
+            mPreviewInterval = interval;
+        }
+        mPreviewLastTime = timestamp;
+
+        m_stepSmoothZoom();
 
 #ifdef BOARD_SUPPORT_SYSMMU
         phyYAddr = mSecCamera->getSecureID(index);
@@ -381,110 +743,111 @@ int CameraHardwareSec::previewThread()
 #endif
         if(phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
             LOGE("ERR(%s):Fail on SecCamera getPhyAddr Y addr = %0x C addr = %0x", __FUNCTION__, phyYAddr, phyCAddr);
+            m_releasePreviewHold(index, PREVIEW_HOLD_HAL);
             return UNKNOWN_ERROR;
         }
 
-        int width, height, offset;
-        unsigned int frame_size;
-        mSecCamera->getPreviewSize(&width, &height, &frame_size);
-
 #ifdef PREVIEW_USING_MMAP
-        {
-            //offset = (frame_size + 16) * index;
-            offset = (frame_size) * index;
-            previewBuffer = new MemoryBase(mPreviewHeap, offset, frame_size);
-
-            //memcpy(static_cast<unsigned char *>(mPreviewHeap->base()) + (offset + frame_size	), &phyYAddr, 4);
-            //memcpy(static_cast<unsigned char *>(mPreviewHeap->base()) + (offset + frame_size + 4), &phyCAddr, 4);
-
 	#if defined(BOARD_USES_CAMERA_OVERLAY)
-            if (mUseOverlay) {
-                int ret;
-                struct ADDRS addr;
-                mOverlayBufferIdx ^= 1;
-            #if 1
-                addr.addr_y = phyYAddr;
-                addr.addr_cbcr = phyCAddr;
-                addr.buf_idx = mOverlayBufferIdx;
-
-                ret = mOverlay->queueBuffer((void*)&addr);
-            #else
-                memcpy(static_cast<unsigned char*>(mPreviewHeap->base()) + sizeof(phyYAddr) + sizeof(phyCAddr),
-                        &mOverlayBufferIdx, sizeof(mOverlayBufferIdx));
-
-                ret = mOverlay->queueBuffer((void*)(static_cast<unsigned char *>(mPreviewHeap->base())));
-            #endif
-                if (ret == ALL_BUFFERS_FLUSHED) {
-                } else if (ret == -1) {
-                    LOGE("ERR(%s):overlay queueBuffer fail", __FUNCTION__);
-                } else {
-                    overlay_buffer_t overlay_buffer;
-                    ret = mOverlay->dequeueBuffer(&overlay_buffer);
-                }
-            }
-	#endif
+        if (mUseOverlay) {
+            struct ADDRS addr;
+
+            addr.addr_y    = phyYAddr;
+            addr.addr_cbcr = phyCAddr;
+            m_queueOverlay(index, &addr, timestamp);
         }
+	#endif
 #else
         {
             struct ADDRS *addrs = (struct ADDRS *)mPreviewHeap->base();
 
-            previewBuffer = new MemoryBase(mPreviewHeap, index * sizeof(struct ADDRS), sizeof(struct ADDRS));;
             addrs[index].addr_y    = phyYAddr;
             addrs[index].addr_cbcr = phyCAddr;
 	#if defined(BOARD_USES_CAMERA_OVERLAY)
-            if (mUseOverlay) {
-                int ret;
-                mOverlayBufferIdx ^= 1;
-                addrs[index].buf_idx = mOverlayBufferIdx;
-
-                ret = mOverlay->queueBuffer((void*)(static_cast<unsigned char *>(mPreviewHeap->base() + index * sizeof(struct ADDRS))));
-
-                if (ret == ALL_BUFFERS_FLUSHED) {
-                } else if (ret == -1) {
-                    LOGE("ERR(%s):overlay queueBuffer fail", __FUNCTION__);
-                } else {
-                    overlay_buffer_t overlay_buffer;
-                    ret = mOverlay->dequeueBuffer(&overlay_buffer);
-                }
-            }
+            if (mUseOverlay)
+                m_queueOverlay(index, &addrs[index], timestamp);
 	#endif
         }
 #endif //PREVIEW_USING_MMAP
 
 #if 0 //defined(BOARD_USES_HDMI)
+        int width, height;
+        unsigned int frame_size;
+        mSecCamera->getPreviewSize(&width, &height, &frame_size);
+
         if(mISurface != NULL)
             mISurface->postBuffer2HDMI(phyYAddr, phyCAddr, width, height);
 #endif
 
         mStateLock.lock();
 
-        if(mRecordRunning == true) {
+        if(mRecordRunning == true && mRecordHeap != 0) {
             LOGV("mRecordRunning++");
+            int rec_index;
+            nsecs_t rec_time;
+            unsigned int rec_format = 0;
+            unsigned int rec_gen = 0;
 #ifdef DUAL_PORT_RECORDING
-            index = mSecCamera->getRecord();
-            if(index < 0) {
-                LOGE("ERR(%s):Fail on SecCamera->getRecord()", __FUNCTION__);
+            // the encoder holds every buffer, waiting would stall the preview
+            if (mSecCamera->getRecordQueued() == 0) {
+                mRecordStatsLock.lock();
+                mRecordDropped++;
+                mRecordStatsLock.unlock();
+                mStateLock.unlock();
+                goto preview_callback;
+            }
+
+            rec_index = mSecCamera->getRecordFrame(&rec_time, &rec_gen);
+            if(rec_index < 0) {
+                LOGE("ERR(%s):Fail on SecCamera->getRecordFrame()", __FUNCTION__);
+                mStateLock.unlock();
+                m_releasePreviewHold(index, PREVIEW_HOLD_HAL);
                 return UNKNOWN_ERROR;
             }
-            phyYAddr = mSecCamera->getRecPhyAddrY(index);
-            phyCAddr = mSecCamera->getRecPhyAddrC(index);
+            phyYAddr = mSecCamera->getRecPhyAddrY(rec_index);
+            phyCAddr = mSecCamera->getRecPhyAddrC(rec_index);
             if(phyYAddr == 0xffffffff || phyCAddr == 0xffffffff) {
                 LOGE("ERR(%s):Fail on SecCamera getRectPhyAddr Y addr = %0x C addr = %0x",
                         __FUNCTION__, phyYAddr, phyCAddr);
+                mSecCamera->releaseRecordFrame(rec_index, rec_gen);
+                mStateLock.unlock();
+                m_releasePreviewHold(index, PREVIEW_HOLD_HAL);
                 return UNKNOWN_ERROR;
             }
+            if (mSecCamera->getRecordPixelFormat() == V4L2_PIX_FMT_NV12T)
+                rec_format = OMX_SEC_COLOR_FormatNV12TPhysicalAddress;
+#else
+            rec_index = index;
+            rec_time  = timestamp;
+            if (mSecCamera->getPreviewPixelFormat() == V4L2_PIX_FMT_NV12T)
+                rec_format = OMX_SEC_COLOR_FormatNV12TPhysicalAddress;
 #endif//DUAL_PORT_RECORDING
 
-            struct ADDRS *addrs = (struct ADDRS *)mRecordHeap->base();
+            int rec_width, rec_height;
+            unsigned int rec_size;
+            mSecCamera->getPreviewSize(&rec_width, &rec_height, &rec_size);
+
+            struct ADDRS_REC *addrs = (struct ADDRS_REC *)mRecordHeap->base()
+                                    + (mRecordSession & 1) * kBufferCountForRecord;
+
+            addrs[rec_index].addr_y       = phyYAddr;
+            addrs[rec_index].addr_cbcr    = phyCAddr;
+            addrs[rec_index].buf_idx      = rec_index;
+            addrs[rec_index].color_format = rec_format;
+            addrs[rec_index].width        = rec_width;
+            addrs[rec_index].height       = rec_height;
+
+            mRecordStatsLock.lock();
+            mRecordTime[rec_index] = rec_time;
+            mRecordGen [rec_index] = rec_gen;
+            mRecordStatsLock.unlock();
 
-            recordBuffer = new MemoryBase(mRecordHeap, index * sizeof(struct ADDRS), sizeof(struct ADDRS));
-            addrs[index].addr_y    = phyYAddr;
-            addrs[index].addr_cbcr = phyCAddr;
             // Notify the client of a new frame.
             if(mDataCbTimestamp && (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME)) {
-                //nsecs_t timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
-                LOGV("recording time = %lld us ", timestamp);
-                mDataCbTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME, recordBuffer, mCallbackCookie);
+                LOGV("recording time = %lld us ", rec_time);
+                mDataCbTimestamp(rec_time, CAMERA_MSG_VIDEO_FRAME, mRecordBuffers[rec_index], mCallbackCookie);
+            } else {
+                mSecCamera->releaseframe(rec_index);
             }
             LOGV("mRecordRunning--");
 
@@ -492,31 +855,218 @@ int CameraHardwareSec::previewThread()
         mStateLock.unlock();
     }
 
-    // schedule for main camera process
-    usleep(1);
-    if(previewBuffer != 0) {
-        // Notify the client of a new frame. //Kamat --eclair
-        if(mDataCb && (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME)) {
-            mDataCb(CAMERA_MSG_PREVIEW_FRAME, previewBuffer, mCallbackCookie);
+#ifdef DUAL_PORT_RECORDING
+preview_callback:
+#endif
+#ifdef PREVIEW_CALLBACK_CONVERT
+    if (mCallbackEnabled) {
+        if (mDataCb && (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME))
+            m_postCallbackFrame(index);
+    } else
+#endif
+    // Notify the client of a new frame. //Kamat --eclair
+    if(mDataCb && (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME) && mBuffers[index] != 0) {
+        mDataCb(CAMERA_MSG_PREVIEW_FRAME, mBuffers[index], mCallbackCookie);
+
+        // the client may keep the memory past the callback
+        if (1 < mBuffers[index]->getStrongCount())
+            mPreviewHold[index] |= PREVIEW_HOLD_CLIENT;
+    }
+
+    m_releasePreviewHold(index, PREVIEW_HOLD_HAL);
+
+    return NO_ERROR;
+}
+
+#ifdef PREVIEW_CALLBACK_CONVERT
+static int callback_format(const char *str)
+{
+    if (strcmp(str, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0)
+        return V4L2_PIX_FMT_NV21;
+    else if (strcmp(str, "yuv420sp_nv12") == 0)
+        return V4L2_PIX_FMT_NV12;
+    else if (strcmp(str, "yuv420p") == 0)
+        return V4L2_PIX_FMT_YUV420;
+    else if (strcmp(str, CameraParameters::PIXEL_FORMAT_YUV422I) == 0)
+        return V4L2_PIX_FMT_YUYV;
+
+    return -1;
+}
+
+// callback format and size against what the camera captures, the
+// conversion runs only when they differ
+void CameraHardwareSec::m_initCallbackConvert(void)
+{
+    int width, height;
+    int new_width, new_height;
+    int format = mSecCamera->getPreviewPixelFormat();
+    const char *str;
+
+    mSecCamera->getPreviewSize(&width, &height);
+
+    // clients can not walk the tiles
+    mCallbackFormat = (format == V4L2_PIX_FMT_NV12T) ? V4L2_PIX_FMT_NV21 : format;
+    str = mParameters.get("preview-callback-format");
+    if (str != NULL && 0 < callback_format(str))
+        mCallbackFormat = callback_format(str);
+
+    mCallbackWidth  = width;
+    mCallbackHeight = height;
+    str = mParameters.get("preview-callback-size");
+    if (str != NULL && sscanf(str, "%dx%d", &new_width, &new_height) == 2) {
+        if (new_width <= width && new_height <= height) {
+            mCallbackWidth  = new_width;
+            mCallbackHeight = new_height;
+        } else
+            LOGE("ERR(%s):preview-callback-size %s larger than the preview %dx%d",
+                    __FUNCTION__, str, width, height);
+    }
+
+    mCallbackEnabled = (mCallbackFormat != format
+            || mCallbackWidth != width || mCallbackHeight != height);
+
+    if (mCallbackEnabled && !SecCameraConvert::flagSupported(format, mCallbackFormat)) {
+        LOGE("ERR(%s):no conversion of format(%d) to format(%d)", __FUNCTION__, format, mCallbackFormat);
+        mCallbackEnabled = false;
+    }
+
+    if (!mCallbackEnabled)
+        return;
+
+    unsigned int size = SecCameraConvert::frameSize(mCallbackFormat, mCallbackWidth, mCallbackHeight);
+
+    if (mCallbackHeap == 0 || mCallbackHeap->getSize() != size * kCallbackBufferCount) {
+        mCallbackHeap = new MemoryHeapBase(size * kCallbackBufferCount);
+        if (mCallbackHeap->getHeapID() < 0) {
+            LOGE("ERR(%s): Callback heap creation fail", __FUNCTION__);
+            mCallbackHeap.clear();
+            mCallbackEnabled = false;
+            return;
         }
+
+        for (int i = 0; i < kCallbackBufferCount; i++)
+            mCallbackBuffers[i] = new MemoryBase(mCallbackHeap, size * i, size);
     }
 
-#if 0
-    // Wait for it...
-    if (mTimeStart.tv_sec == 0 && mTimeStart.tv_usec == 0) {
-        gettimeofday(&mTimeStart, NULL);
-    } else {
-        gettimeofday(&mTimeStop, NULL);
-        long time = measure_time(&mTimeStart, &mTimeStop);
-        int delay = (mPreviewFrameRateMicrosec > time) ? mPreviewFrameRateMicrosec - time : 0;
+    LOGI("%s:callback frames %dx%d format(%d) from %dx%d format(%d)", __FUNCTION__,
+            mCallbackWidth, mCallbackHeight, mCallbackFormat, width, height, format);
+}
 
-        usleep(delay);
-        //LOG_CAMERA_PREVIEW("delay = %d time = %ld us\n ", delay, time);
-        gettimeofday(&mTimeStart, NULL);
+// hands the frame to the callback thread, or drops it when that is busy
+void CameraHardwareSec::m_postCallbackFrame(int index)
+{
+    Mutex::Autolock lock(mCallbackLock);
+
+    if (0 <= mCallbackIndex || 0 <= mCallbackDone) {
+        mCallbackDropped++;
+        return;
     }
-#endif
+
+    mPreviewHold[index] |= PREVIEW_HOLD_CALLBACK;
+    mCallbackIndex = index;
+    mCallbackCond.signal();
+}
+
+void CameraHardwareSec::m_stopCallbackThread(void)
+{
+    {
+        Mutex::Autolock lock(mCallbackLock);
+
+        mCallbackExit = true;
+        mCallbackCond.signal();
+    }
+
+    mCallbackThread->requestExitAndWait();
+}
+
+int CameraHardwareSec::callbackThread()
+{
+    int index;
+    int buf = -1;
+    int ret = -1;
+    int width, height;
+    unsigned int frame_size;
+    nsecs_t cost = 0;
+
+    mCallbackLock.lock();
+    while (mCallbackIndex < 0 && !mCallbackExit)
+        mCallbackCond.wait(mCallbackLock);
+
+    if (mCallbackExit) {
+        mCallbackLock.unlock();
+        return INVALID_OPERATION;
+    }
+    index = mCallbackIndex;
+    mCallbackLock.unlock();
+
+    // a buffer the client is done with
+    for (int i = 0; i < kCallbackBufferCount; i++) {
+        if (mCallbackBuffers[i]->getStrongCount() <= 1) {
+            buf = i;
+            break;
+        }
+    }
+
+    if (0 <= buf) {
+        mSecCamera->getPreviewSize(&width, &height, &frame_size);
+
+        cost = systemTime(SYSTEM_TIME_MONOTONIC);
+        ret  = mCallbackConvert.convert((unsigned char *)mBuffers[index]->pointer(),
+                    mSecCamera->getPreviewPixelFormat(), width, height,
+                    (unsigned char *)mCallbackBuffers[buf]->pointer(),
+                    mCallbackFormat, mCallbackWidth, mCallbackHeight);
+        cost = systemTime(SYSTEM_TIME_MONOTONIC) - cost;
+    }
+
+    mCallbackLock.lock();
+    mCallbackIndex = -1;
+    mCallbackDone  = index;
+    if (ret < 0) {
+        mCallbackDropped++;
+    } else {
+        mCallbackFrames++;
+        mCallbackCost += (cost - mCallbackCost) / 16;
+        if (mCallbackCostMax < cost)
+            mCallbackCostMax = cost;
+    }
+    mCallbackLock.unlock();
+
+    if (ret == 0 && mDataCb && (mMsgEnabled & CAMERA_MSG_PREVIEW_FRAME))
+        mDataCb(CAMERA_MSG_PREVIEW_FRAME, mCallbackBuffers[buf], mCallbackCookie);
+
     return NO_ERROR;
 }
+#endif // PREVIEW_CALLBACK_CONVERT
+
+// one zoom step per preview frame, the crop changes from the next frame on
+void CameraHardwareSec::m_stepSmoothZoom(void)
+{
+    Mutex::Autolock lock(mStateLock);
+
+    if (mZoomTarget < 0)
+        return;
+
+    int zoom = mSecCamera->getZoom();
+
+    if (zoom < mZoomTarget)
+        zoom++;
+    else if (mZoomTarget < zoom)
+        zoom--;
+
+    if (mSecCamera->setZoom(zoom) < 0) {
+        LOGE("ERR(%s):Fail on mSecCamera->setZoom(zoom(%d))", __FUNCTION__, zoom);
+        mZoomTarget = zoom = mSecCamera->getZoom();
+    }
+
+    bool flag_stopped = (zoom == mZoomTarget);
+    if (flag_stopped)
+        mZoomTarget = -1;
+
+    mParameters.set(CameraParameters::KEY_ZOOM, zoom);
+
+    if (mNotifyCb && (mMsgEnabled & CAMERA_MSG_ZOOM))
+        mNotifyCb(CAMERA_MSG_ZOOM, zoom, flag_stopped, mCallbackCookie);
+}
 
 status_t CameraHardwareSec::startPreview()
 {
@@ -564,15 +1114,29 @@ status_t CameraHardwareSec::startPreview()
         LOGV("MemoryHeapBase(fd(%d), size(%d), %d)", (int)mSecCamera->getCameraFd(), (size_t)(previewHeapSize), (uint32_t)0);
 
         mPreviewHeap = new MemoryHeapBase((int)mSecCamera->getCameraFd(), (size_t)(previewHeapSize), (uint32_t)0);
-		/*
+
         for(int index=0; index < kBufferCount; index++)
         {
             mBuffers[index] = new MemoryBase(mPreviewHeap, frameSize*index, frameSize);
-        } */
-
+        }
+    }
+    #else
+    for(int index=0; index < kBufferCount; index++)
+    {
+        mBuffers[index] = new MemoryBase(mPreviewHeap, index * sizeof(struct ADDRS), sizeof(struct ADDRS));
     }
     #endif
 
+    m_resetPreviewRing();
+
+#ifdef PREVIEW_CALLBACK_CONVERT
+    m_initCallbackConvert();
+    if (mCallbackEnabled) {
+        mCallbackExit = false;
+        mCallbackThread->run("CameraCallbackThread", PRIORITY_NORMAL);
+    }
+#endif
+
     mPreviewRunning = true;
 
 //    if(mPreviewRunning == 0)
@@ -596,10 +1160,29 @@ void CameraHardwareSec::stopPreview()
      */
     mPreviewThread->requestExitAndWait();
 
+#ifdef PREVIEW_CALLBACK_CONVERT
+    // it may still be reading a capture buffer
+    m_stopCallbackThread();
+
+    if (mCallbackEnabled)
+        LOGI("%s:%u callback frames, %u dropped, conversion %lld us (max %lld us)", __FUNCTION__,
+                mCallbackFrames, mCallbackDropped, ns2us(mCallbackCost), ns2us(mCallbackCostMax));
+#endif
 
     if(mSecCamera && mSecCamera->stopPreview() < 0)
         LOGE("ERR(%s):Fail on mSecCamera->stopPreview()", __FUNCTION__);
 
+    LOGI("%s:%u frames, %u skipped, %u reclaimed from the client, "
+            "latency %lld us (max %lld us), jitter %lld us", __FUNCTION__,
+            mPreviewFrames, mPreviewSkipped, mPreviewReclaimed,
+            ns2us(mPreviewLatency), ns2us(mPreviewLatencyMax), ns2us(mPreviewJitter));
+
+    // streamoff took every buffer back
+    m_resetPreviewRing();
+
+    // a smooth zoom stops where it is, without a frame to report on
+    mZoomTarget = -1;
+
     mPreviewRunning = false;
     LOGV("--%s \n", __FUNCTION__);
 }
@@ -624,6 +1207,8 @@ status_t CameraHardwareSec::startRecording()
         return UNKNOWN_ERROR;
     }
 #endif
+    m_newRecordBuffers();
+    m_resetRecordStats();
     mRecordRunning = true;
     LOGD("--%s :", __FUNCTION__);
     return NO_ERROR;
@@ -644,6 +1229,12 @@ void CameraHardwareSec::stopRecording()
 #endif
 
     mRecordRunning = false;
+
+    Mutex::Autolock statsLock(mRecordStatsLock);
+    LOGI("%s:%u frames, %u dropped while the encoder held every buffer, "
+            "latency %lld us (max %lld us)", __FUNCTION__,
+            mRecordFrames, mRecordDropped,
+            ns2us(mRecordLatency), ns2us(mRecordLatencyMax));
     LOGD("--%s :", __FUNCTION__);
 }
 
@@ -654,21 +1245,77 @@ bool CameraHardwareSec::recordingEnabled()
     return mRecordRunning;
 }
 
+void CameraHardwareSec::m_resetRecordStats(void)
+{
+    Mutex::Autolock lock(mRecordStatsLock);
+
+    for (int i = 0; i < kBufferCountForRecord; i++) {
+        mRecordTime[i] = 0;
+        mRecordGen [i] = 0;
+    }
+
+    mRecordFrames     = 0;
+    mRecordDropped    = 0;
+    mRecordLatency    = 0;
+    mRecordLatencyMax = 0;
+}
+
+// fresh descriptors for a recording : a frame is known by the memory
+// object it went out in, so a release of an older session matches none
+void CameraHardwareSec::m_newRecordBuffers(void)
+{
+    Mutex::Autolock lock(mRecordStatsLock);
+
+    mRecordSession++;
+
+    for (int i = 0; i < kBufferCountForRecord; i++) {
+        if (mRecordHeap == 0) {
+            mRecordBuffers[i].clear();
+            continue;
+        }
+        int offset = ((mRecordSession & 1) * kBufferCountForRecord + i) * sizeof(struct ADDRS_REC);
+        mRecordBuffers[i] = new MemoryBase(mRecordHeap, offset, sizeof(struct ADDRS_REC));
+    }
+}
+
 void CameraHardwareSec::releaseRecordingFrame(const sp<IMemory>& mem)
 {
     LOG_CAMERA_PREVIEW("%s :", __FUNCTION__);
 
-    ssize_t offset; size_t size;
-//    sp<MemoryBase>	   mem1	= mem;
-//    sp<MemoryHeapBase> heap = mem->getMemory(&offset, &size);
-//    LOGD("@@@(%s):offset(%d), size()%d", __FUNCTION__,offset,size);
+    int index;
+    unsigned int gen;
+
+    mRecordStatsLock.lock();
+    for (index = 0; index < kBufferCountForRecord; index++) {
+        if (mRecordBuffers[index] != 0 && mRecordBuffers[index].get() == mem.get())
+            break;
+    }
+
+    // handed out before the last startRecording(), its buffer may be in use again
+    if (index == kBufferCountForRecord) {
+        mRecordStatsLock.unlock();
+        LOGV("%s:frame of an older recording", __FUNCTION__);
+        return;
+    }
+    gen = mRecordGen[index];
 
-//    mem1.clear();
-//    heap.clear();
+    // capture to the encoder letting go of the frame
+    if (mRecordTime[index] != 0) {
+        nsecs_t latency = systemTime(SYSTEM_TIME_MONOTONIC) - mRecordTime[index];
 
-    sp<IMemoryHeap> heap = mem->getMemory(&offset, &size);
-	mSecCamera->releaseframe(int(offset/size));
+        mRecordLatency += (latency - mRecordLatency) / 16;
+        if (mRecordLatencyMax < latency)
+            mRecordLatencyMax = latency;
+        mRecordFrames++;
+        mRecordTime[index] = 0;
+    }
+    mRecordStatsLock.unlock();
 
+#ifdef DUAL_PORT_RECORDING
+    mSecCamera->releaseRecordFrame(index, gen);
+#else
+    mSecCamera->releaseframe(index);
+#endif
 }
 
 int CameraHardwareSec::m_autoFocusThreadFunc()
@@ -722,6 +1369,49 @@ status_t CameraHardwareSec::cancelAutoFocus()
     return NO_ERROR;
 }
 
+// a pool heap only the pool references, for the next picture to be put
+// together in. the returned reference keeps other pictures off it
+sp<MemoryHeapBase> CameraHardwareSec::m_jpegOutHeap(void)
+{
+    Mutex::Autolock lock(mJpegOutLock);
+
+    for (int i = 0; i < kJpegOutHeapCount; i++) {
+        if (mJpegOutHeaps[i] != 0 && mJpegOutHeaps[i]->getStrongCount() <= 1)
+            return mJpegOutHeaps[i];
+    }
+
+    return NULL;
+}
+
+// the client keeps the picture after the one-way callback returns, while
+// the encoder mapping also holds the raw frame and is coded over next time.
+// a picture the encoder assembled in jpegHeap goes out as it is
+sp<MemoryBase> CameraHardwareSec::m_jpegMemory(const sp<MemoryHeapBase> &jpegHeap,
+                                               const unsigned char *jpegData, int jpegSize)
+{
+    Mutex::Autolock lock(mJpegOutLock);
+
+    if (jpegHeap != 0) {
+        const unsigned char *base = (const unsigned char *)jpegHeap->base();
+
+        if (base <= jpegData && jpegData + jpegSize <= base + jpegHeap->getSize()) {
+            mJpegOutPooled++;
+            return new MemoryBase(jpegHeap, jpegData - base, jpegSize);
+        }
+    }
+
+    // every pool heap is still with the client
+    sp<MemoryHeapBase> ownHeap = new MemoryHeapBase(jpegSize);
+    if (ownHeap->getHeapID() < 0) {
+        LOGE("ERR(%s):Fail on MemoryHeapBase(%d)", __FUNCTION__, jpegSize);
+        return NULL;
+    }
+    mJpegOutAllocated++;
+
+    memcpy(ownHeap->base(), jpegData, jpegSize);
+    return new MemoryBase(ownHeap, 0, jpegSize);
+}
+
 int CameraHardwareSec::pictureThread()
 {
     LOGV("++%s :", __FUNCTION__);
@@ -739,9 +1429,24 @@ int CameraHardwareSec::pictureThread()
 
     unsigned char * jpegData = NULL;
     int             jpegSize = 0;
+    unsigned char * rawData  = NULL;
+    bool            jpegLocked = false;
 
     mSecCamera->getSnapshotSize(&pictureWidth, &pictureHeight, &pictureSize);
 
+    // the snapshot goes straight into the codec input, which nobody else
+    // may touch until the picture is copied out
+    if(mJpegHeap != 0 && mSecCamera->lockJpeg() == 0)
+        jpegLocked = true;
+
+    if(mJpegHeap != 0) {
+        rawData   = mSecCamera->getJpegInBuf();
+        rawBuffer = new MemoryBase(mJpegHeap, mJpegInOffset, pictureSize);
+    } else if(mRawHeap != 0) {
+        rawData   = (unsigned char*)mRawHeap->base();
+        rawBuffer = new MemoryBase(mRawHeap, 0, pictureSize);
+    }
+
     LOGV("pictureWidth %d, pictureHeight %d, pictureSize %d", pictureWidth, pictureHeight, pictureSize);
 
     if((mMsgEnabled & CAMERA_MSG_RAW_IMAGE) && mDataCb) {
@@ -752,10 +1457,12 @@ int CameraHardwareSec::pictureThread()
                         mGpsInfo.timestamp, mGpsInfo.altitude) < 0) {
                 LOGE("%s::setGpsInfo fail.. but making jpeg is progressing\n", __FUNCTION__);
             }
+        } else {
+            mSecCamera->clearGpsInfo();
         }
 
-        rawBuffer = new MemoryBase(mRawHeap, 0, pictureSize);
-        picturePhyAddr = mSecCamera->getSnapshot((unsigned char*)mRawHeap->base(), pictureSize);
+        if(rawData != NULL)
+            picturePhyAddr = mSecCamera->getSnapshot(rawData, pictureSize);
         if(picturePhyAddr == 0) {
             LOGE("ERR(%s):Fail on SecCamera->getSnapshot()", __FUNCTION__);
             mStateLock.lock();
@@ -817,15 +1524,22 @@ int CameraHardwareSec::pictureThread()
 #endif
 
     if(mDataCb && (mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE)) {
+        sp<MemoryHeapBase> jpegHeap = m_jpegOutHeap();
+
         if(picturePhyAddr != 0)
-            jpegData = mSecCamera->yuv2Jpeg((unsigned char*)mRawHeap->base(), 0, &jpegSize,
-                    pictureWidth, pictureHeight, pictureFormat);
+            jpegData = mSecCamera->yuv2Jpeg(rawData, 0, &jpegSize,
+                    pictureWidth, pictureHeight, pictureFormat,
+                    jpegHeap != 0 ? (unsigned char *)jpegHeap->base() : NULL,
+                    jpegHeap != 0 ? (int)jpegHeap->getSize() : 0);
 
         sp<MemoryBase> jpegMem = NULL;
-        if(jpegData != NULL) {
-            sp<MemoryHeapBase> jpegHeap = new MemoryHeapBase(jpegSize);
-            jpegMem  = new MemoryBase(jpegHeap, 0, jpegSize);
-            memcpy(jpegHeap->base(), jpegData, jpegSize);
+        if(jpegData != NULL)
+            jpegMem = m_jpegMemory(jpegHeap, jpegData, jpegSize);
+        jpegHeap.clear();
+
+        if(jpegLocked == true) {
+            mSecCamera->unlockJpeg();
+            jpegLocked = false;
         }
 
         mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, jpegMem, mCallbackCookie);
@@ -833,15 +1547,213 @@ int CameraHardwareSec::pictureThread()
         mSecCamera->CloseJpegBuffer();
     }
 
+    if(jpegLocked == true)
+        mSecCamera->unlockJpeg();
+
+    LOGV("--%s :", __FUNCTION__);
+
+    return ret;
+}
+
+#ifdef BURST_CAPTURE
+static float burstFps(unsigned int frames, nsecs_t start, nsecs_t end)
+{
+    if (frames == 0 || end <= start)
+        return 0.0f;
+
+    return (float)frames * 1000000000.0f / (float)(end - start);
+}
+
+// captures mBurstCount frames from one full resolution stream. frame k+1
+// is captured while burstEncodeThread() codes frame k; a full queue either
+// holds the frame until the encoder takes one or drops it.
+int CameraHardwareSec::burstThread()
+{
+    LOGV("++%s :", __FUNCTION__);
+
+    int     ret = NO_ERROR;
+    int     index;
+    nsecs_t timestamp;
+    bool    encoding = false;
+    int     count    = mBurstCount;
+    int     depth    = mBurstQueueDepth;
+    bool    drop     = mBurstDropOnFull;
+
+    if(0 <= m_getGpsInfo(&mParameters, &mGpsInfo)) {
+        if(mSecCamera->setGpsInfo(mGpsInfo.latitude,  mGpsInfo.longitude,
+                    mGpsInfo.timestamp, mGpsInfo.altitude) < 0) {
+            LOGE("%s::setGpsInfo fail.. but making jpeg is progressing\n", __FUNCTION__);
+        }
+    } else {
+        mSecCamera->clearGpsInfo();
+    }
+
+    if (mSecCamera->startBurst(depth + BURST_HELD_BUFFERS) < 0) {
+        LOGE("ERR(%s):Fail on mSecCamera->startBurst()", __FUNCTION__);
+        ret = UNKNOWN_ERROR;
+    } else if (createThread(m_beginBurstEncodeThread, this) == false) {
+        LOGE("ERR(%s):Fail on createThread(m_beginBurstEncodeThread)", __FUNCTION__);
+        ret = UNKNOWN_ERROR;
+    } else {
+        encoding = true;
+    }
+
+    while (encoding) {
+        mBurstLock.lock();
+        bool done = mBurstAbort || count <= (int)mBurstCaptured;
+        mBurstLock.unlock();
+        if (done)
+            break;
+
+        index = mSecCamera->getBurstFrame(&timestamp);
+        if (index < 0) {
+            LOGE("ERR(%s):Fail on mSecCamera->getBurstFrame()", __FUNCTION__);
+            ret = UNKNOWN_ERROR;
+            break;
+        }
+
+        Mutex::Autolock lock(mBurstLock);
+
+        if (mBurstStartTime == 0)
+            mBurstStartTime = timestamp;
+        mBurstFrameTime = timestamp;
+
+        if (depth <= mBurstQueueCount && drop) {
+            mSecCamera->releaseBurstFrame(index);
+            mBurstDropped++;
+            continue;
+        }
+
+        while (depth <= mBurstQueueCount && !mBurstAbort)
+            mBurstCond.wait(mBurstLock);
+
+        if (mBurstAbort) {
+            mSecCamera->releaseBurstFrame(index);
+            break;
+        }
+
+        mBurstQueue[(mBurstQueueHead + mBurstQueueCount) % MAX_BUFFERS] = index;
+        mBurstQueueCount++;
+        mBurstCaptured++;
+        mBurstCond.broadcast();
+    }
+
+    mBurstLock.lock();
+    mBurstCaptureDone = true;
+    mBurstCond.broadcast();
+    while (encoding && !mBurstEncodeDone)
+        mBurstCond.wait(mBurstLock);
+
+    // intervals between the frames seen, kept or dropped
+    mBurstCaptureFps = 0.0f;
+    if (1 < mBurstCaptured + mBurstDropped)
+        mBurstCaptureFps = burstFps(mBurstCaptured + mBurstDropped - 1,
+                                    mBurstStartTime, mBurstFrameTime);
+    mBurstPictureFps = burstFps(mBurstDelivered, mBurstStartTime, mBurstPictureTime);
+
+    LOGI("%s:%u of %d pictures, %u frames dropped, capture %.1f fps, pictures %.1f fps\n",
+            __FUNCTION__, mBurstDelivered, count, mBurstDropped,
+            mBurstCaptureFps, mBurstPictureFps);
+    mBurstLock.unlock();
+
+    mSecCamera->stopBurst();
+
+    mStateLock.lock();
+    mCaptureInProgress = false;
+    mStateLock.unlock();
+
+    mBurstLock.lock();
+    mBurstRunning = false;
+    mBurstCond.broadcast();
+    mBurstLock.unlock();
+
     LOGV("--%s :", __FUNCTION__);
 
     return ret;
 }
 
+// codes the queued frames and hands every picture out as it is done
+int CameraHardwareSec::burstEncodeThread()
+{
+    LOGV("++%s :", __FUNCTION__);
+
+    int             index;
+    unsigned char * jpegData;
+    int             jpegSize;
+    bool            delivered;
+
+    for (;;) {
+        mBurstLock.lock();
+        while (mBurstQueueCount == 0 && !mBurstCaptureDone && !mBurstAbort)
+            mBurstCond.wait(mBurstLock);
+
+        if (mBurstAbort || mBurstQueueCount == 0) {
+            mBurstLock.unlock();
+            break;
+        }
+
+        index = mBurstQueue[mBurstQueueHead];
+        mBurstQueueHead = (mBurstQueueHead + 1) % MAX_BUFFERS;
+        mBurstQueueCount--;
+        mBurstCond.broadcast();
+        mBurstLock.unlock();
+
+        sp<MemoryBase> jpegMem = NULL;
+        sp<MemoryHeapBase> jpegHeap = m_jpegOutHeap();
+
+        // the codec buffers are ours until the picture is copied out
+        bool jpegLocked = (mSecCamera->lockJpeg() == 0);
+
+        jpegSize  = 0;
+        jpegData  = mSecCamera->getBurstJpeg(index, &jpegSize,
+                jpegHeap != 0 ? (unsigned char *)jpegHeap->base() : NULL,
+                jpegHeap != 0 ? (int)jpegHeap->getSize() : 0);
+        delivered = false;
+
+        // the encoder has its own copy by now
+        mSecCamera->releaseBurstFrame(index);
+
+        if (jpegData == NULL)
+            LOGE("ERR(%s):Fail on mSecCamera->getBurstJpeg(%d)", __FUNCTION__, index);
+        else if (mDataCb && (mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE))
+            jpegMem = m_jpegMemory(jpegHeap, jpegData, jpegSize);
+        jpegHeap.clear();
+
+        if (jpegLocked)
+            mSecCamera->unlockJpeg();
+
+        // the callback is one-way, the next frame is coded while the client reads this one
+        if (jpegMem != NULL) {
+            mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, jpegMem, mCallbackCookie);
+            delivered = true;
+        }
+
+        mBurstLock.lock();
+        if (delivered) {
+            mBurstDelivered++;
+            mBurstPictureTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        }
+        mBurstLock.unlock();
+    }
+
+    mBurstLock.lock();
+    mBurstEncodeDone = true;
+    mBurstCond.broadcast();
+    mBurstLock.unlock();
+
+    LOGV("--%s :", __FUNCTION__);
+
+    return NO_ERROR;
+}
+#endif // BURST_CAPTURE
+
 status_t CameraHardwareSec::takePicture()
 {
     LOGV("++%s :", __FUNCTION__);
 
+    // with zero shutter lag this picks the frame, so it goes before stopPreview()
+    mSecCamera->markShutter();
+
     this->stopPreview();
 
     if (mCaptureInProgress) {
@@ -849,6 +1761,31 @@ status_t CameraHardwareSec::takePicture()
         return INVALID_OPERATION;
     }
 
+#ifdef BURST_CAPTURE
+    if (1 < mBurstCount) {
+        mBurstLock.lock();
+        mBurstQueueHead   = 0;
+        mBurstQueueCount  = 0;
+        mBurstAbort       = false;
+        mBurstCaptureDone = false;
+        mBurstEncodeDone  = false;
+        mBurstCaptured    = 0;
+        mBurstDropped     = 0;
+        mBurstDelivered   = 0;
+        mBurstStartTime   = 0;
+        mBurstFrameTime   = 0;
+        mBurstPictureTime = 0;
+        mBurstRunning     = true;
+        mBurstLock.unlock();
+
+        if (createThread(m_beginBurstThread, this) == false) {
+            mBurstLock.lock();
+            mBurstRunning = false;
+            mBurstLock.unlock();
+            return UNKNOWN_ERROR;
+        }
+    } else
+#endif
     if (createThread(m_beginPictureThread, this) == false)
         return UNKNOWN_ERROR;
 
@@ -861,14 +1798,73 @@ status_t CameraHardwareSec::takePicture()
 
 status_t CameraHardwareSec::cancelPicture()
 {
+#ifdef BURST_CAPTURE
+    // the pictures already delivered stay valid, the rest of the burst is dropped
+    Mutex::Autolock lock(mBurstLock);
+    mBurstAbort = true;
+    mBurstCond.broadcast();
+#endif
     return NO_ERROR;
 }
 
+#ifdef BURST_CAPTURE
+// aborts a running burst and waits until its threads are out of mSecCamera
+void CameraHardwareSec::m_stopBurstThreads(void)
+{
+    Mutex::Autolock lock(mBurstLock);
+
+    mBurstAbort = true;
+    mBurstCond.broadcast();
+    while (mBurstRunning)
+        mBurstCond.wait(mBurstLock);
+}
+#endif
+
+// classes of the keys whose value differs from mParameters, 0 : none
+int CameraHardwareSec::m_diffParameters(const CameraParameters& params) const
+{
+    String8      flat = params.flatten();
+    const char * pos  = flat.string();
+    int          type = 0;
+
+    // "key=value;key=value"
+    while (*pos != '\0') {
+        const char * end = strchr(pos, ';');
+        const char * eq  = strchr(pos, '=');
+        if (end == NULL)
+            end = pos + strlen(pos);
+
+        if (eq != NULL && eq < end) {
+            char         key[64];
+            int          key_len = eq - pos;
+            const char * cur;
+
+            if (key_len < (int)sizeof(key)) {
+                memcpy(key, pos, key_len);
+                key[key_len] = '\0';
+
+                cur = mParameters.get(key);
+                if (cur == NULL
+                    || (int)strlen(cur) != end - eq - 1
+                    || strncmp(cur, eq + 1, end - eq - 1) != 0)
+                    type |= param_type(key, key_len);
+            }
+        }
+
+        pos = (*end == ';') ? end + 1 : end;
+    }
+
+    return type & ~PARAM_READ_ONLY;
+}
+
+// only what changed reaches the camera, and the preview restarts only
+// for the keys that change its buffers
 status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 {
     LOGV("++%s :", __FUNCTION__);
 
-    status_t ret = NO_ERROR;
+    status_t ret;
+    int      type;
 
     /* if someone calls us while picture thread is running, it could screw
      * up the sensor quite a bit so return error.  we can't wait because
@@ -883,6 +1879,44 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 
     mStateLock.unlock();
 
+    type = m_diffParameters(params);
+    mParamSets++;
+    if (type == 0) {
+        mParamUnchanged++;
+        return NO_ERROR;
+    }
+
+    if (!previewEnabled())
+        return m_applyParameters(params);
+
+    if (type & PARAM_RESTART) {
+        if (mRecordRunning) {
+            LOGE("%s : preview size or format change while recording, not allowed", __FUNCTION__);
+            return INVALID_OPERATION;
+        }
+
+        stopPreview();
+        ret = m_applyParameters(params);
+        if (startPreview() != NO_ERROR) {
+            LOGE("ERR(%s):restart of the preview fail", __FUNCTION__);
+            ret = UNKNOWN_ERROR;
+        }
+        mParamRestarts++;
+        return ret;
+    }
+
+    if (type & PARAM_ON_STREAM)
+        mParamRestartsAvoided++;
+
+    return m_applyParameters(params);
+}
+
+status_t CameraHardwareSec::m_applyParameters(const CameraParameters& params)
+{
+    LOGV("++%s :", __FUNCTION__);
+
+    status_t ret = NO_ERROR;
+
     // preview size
     int new_preview_width  = 0;
     int new_preview_height = 0;
@@ -942,6 +1976,32 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 #endif
     }
 
+#ifdef PREVIEW_CALLBACK_CONVERT
+    // preview callback format and size, taken by the next startPreview()
+    const char * new_str_callback_format = params.get("preview-callback-format");
+    if (new_str_callback_format != NULL) {
+        if (callback_format(new_str_callback_format) < 0) {
+            LOGE("ERR(%s):unsupported preview-callback-format(%s)", __FUNCTION__, new_str_callback_format);
+            ret = UNKNOWN_ERROR;
+        } else
+            mParameters.set("preview-callback-format", new_str_callback_format);
+    }
+
+    const char * new_str_callback_size = params.get("preview-callback-size");
+    if (new_str_callback_size != NULL) {
+        int new_callback_width  = 0;
+        int new_callback_height = 0;
+
+        if (sscanf(new_str_callback_size, "%dx%d", &new_callback_width, &new_callback_height) != 2
+                || new_callback_width  <= 0 || (new_callback_width  & 1)
+                || new_callback_height <= 0 || (new_callback_height & 1)) {
+            LOGE("ERR(%s):invalid preview-callback-size(%s)", __FUNCTION__, new_str_callback_size);
+            ret = UNKNOWN_ERROR;
+        } else
+            mParameters.set("preview-callback-size", new_str_callback_size);
+    }
+#endif
+
     int new_picture_width  = 0;
     int new_picture_height = 0;
     int new_picture_size = 0;
@@ -992,12 +2052,15 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 
     mSecCamera->getSnapshotSize(&new_picture_width, &new_picture_height, &new_picture_size);
 
+    // only needed when there is no mapping of the jpeg encoder buffers
     int rawHeapSize = new_picture_size;
-    LOGV("mRawHeap : MemoryHeapBase(previewHeapSize(%d))", rawHeapSize);
-    mRawHeap = new MemoryHeapBase(rawHeapSize);
-    if (mRawHeap->getHeapID() < 0) {
-        LOGE("ERR(%s): Raw heap creation fail", __FUNCTION__);
-        mRawHeap.clear();
+    if (mJpegHeap == 0 && (mRawHeap == 0 || (int)mRawHeap->getSize() != rawHeapSize)) {
+        LOGV("mRawHeap : MemoryHeapBase(previewHeapSize(%d))", rawHeapSize);
+        mRawHeap = new MemoryHeapBase(rawHeapSize);
+        if (mRawHeap->getHeapID() < 0) {
+            LOGE("ERR(%s): Raw heap creation fail", __FUNCTION__);
+            mRawHeap.clear();
+        }
     }
 
     //JPEG image quality
@@ -1010,6 +2073,61 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         mParameters.set(CameraParameters::KEY_JPEG_QUALITY, new_jpeg_quality);
     }
 
+    int new_jpeg_thumbnail_quality = params.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY);
+    if (new_jpeg_thumbnail_quality >=1 && new_jpeg_thumbnail_quality <= 100) {
+        mSecCamera->setJpegThumbnailQuality(new_jpeg_thumbnail_quality);
+        mParameters.set(CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY, new_jpeg_thumbnail_quality);
+    }
+
+#ifdef ZERO_SHUTTER_LAG
+    // zero shutter lag
+    const char * new_str_zsl = params.get("zsl");
+    int new_zsl_buffer_count = params.getInt("zsl-buffer-count");
+    if (new_zsl_buffer_count <= 0)
+        new_zsl_buffer_count = ZSL_DEFAULT_BUFFERS;
+    if (new_str_zsl != NULL) {
+        int new_zsl = (strcmp(new_str_zsl, "on") == 0);
+
+        if (mSecCamera->setZsl(new_zsl, new_zsl_buffer_count) < 0) {
+            LOGE("ERR(%s):Fail on mSecCamera->setZsl(%s, %d)",
+                    __FUNCTION__, new_str_zsl, new_zsl_buffer_count);
+            mParameters.set("zsl", "off");
+        } else {
+            mParameters.set("zsl", new_zsl ? "on" : "off");
+            mParameters.set("zsl-buffer-count", new_zsl_buffer_count);
+        }
+    }
+#endif
+
+#ifdef BURST_CAPTURE
+    // burst capture
+    int new_burst_count = params.getInt("burst-capture");
+    if (1 <= new_burst_count && new_burst_count <= BURST_MAX_PICTURES) {
+        mBurstCount = new_burst_count;
+        mParameters.set("burst-capture", new_burst_count);
+    }
+
+    int new_burst_queue_depth = params.getInt("burst-queue-depth");
+    if (1 <= new_burst_queue_depth && new_burst_queue_depth <= MAX_BUFFERS - BURST_HELD_BUFFERS) {
+        mBurstQueueDepth = new_burst_queue_depth;
+        mParameters.set("burst-queue-depth", new_burst_queue_depth);
+    }
+
+    const char * new_str_burst_overflow = params.get("burst-overflow");
+    if (new_str_burst_overflow != NULL) {
+        if (strcmp(new_str_burst_overflow, "drop") == 0) {
+            mBurstDropOnFull = true;
+            mParameters.set("burst-overflow", new_str_burst_overflow);
+        } else if (strcmp(new_str_burst_overflow, "wait") == 0) {
+            mBurstDropOnFull = false;
+            mParameters.set("burst-overflow", new_str_burst_overflow);
+        } else {
+            LOGE("%s::invalid burst-overflow(%s)", __FUNCTION__, new_str_burst_overflow);
+            ret = UNKNOWN_ERROR;
+        }
+    }
+#endif
+
 
     // JPEG thumbnail size
     int new_jpeg_thumbnail_width = params.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH);
@@ -1048,9 +2166,101 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         }
     }
 
-    // brightness
+#ifdef USE_SEC_CROP_ZOOM
+    // zoom, applied to the running preview without a restart
+    int new_zoom = params.getInt(CameraParameters::KEY_ZOOM);
+    if (SecCamera::ZOOM_BASE <= new_zoom) {
+        mStateLock.lock();
+        bool smooth_zoom = (0 <= mZoomTarget);
+        mStateLock.unlock();
+
+        if (smooth_zoom) {
+            // the smooth zoom owns the value until it stops
+        } else if (mSecCamera->setZoom(new_zoom) < 0) {
+            LOGE("ERR(%s):Fail on mSecCamera->setZoom(new_zoom(%d))", __FUNCTION__, new_zoom);
+            ret = UNKNOWN_ERROR;
+        } else
+            mParameters.set(CameraParameters::KEY_ZOOM, new_zoom);
+    }
+#endif
+
+    // exposure compensation
+    const char * new_str_exposure = params.get(CameraParameters::KEY_EXPOSURE_COMPENSATION);
+    if (new_str_exposure != NULL) {
+        int new_exposure   = atoi(new_str_exposure);
+        int new_brightness = SecCamera::BRIGHTNESS_NORMAL + new_exposure;
+
+        // the range advertised above, BRIGHTNESS_MAX is one step past it
+        if (new_exposure < SecCamera::BRIGHTNESS_BASE - SecCamera::BRIGHTNESS_NORMAL
+                || SecCamera::BRIGHTNESS_NORMAL < new_exposure) {
+            LOGE("%s::invalid exposure-compensation(%s)", __FUNCTION__, new_str_exposure);
+            ret = UNKNOWN_ERROR;
+        } else if (mSecCamera->setBrightness(new_brightness) < 0) {
+            LOGE("ERR(%s):Fail on mSecCamera->setBrightness(brightness(%d))", __FUNCTION__, new_brightness);
+            ret = UNKNOWN_ERROR;
+        } else
+            mParameters.set(CameraParameters::KEY_EXPOSURE_COMPENSATION, new_exposure);
+    }
 
     // whitebalance
+    const char * new_white_str = params.get(CameraParameters::KEY_WHITE_BALANCE);
+    if (new_white_str != NULL) {
+        int new_white = -1;
+
+        if (strcmp(new_white_str, CameraParameters::WHITE_BALANCE_AUTO) == 0)
+            new_white = SecCamera::WHITE_BALANCE_AUTO;
+        else if (strcmp(new_white_str, CameraParameters::WHITE_BALANCE_INCANDESCENT) == 0)
+            new_white = SecCamera::WHITE_BALANCE_INCANDESCENT;
+        else if (strcmp(new_white_str, CameraParameters::WHITE_BALANCE_FLUORESCENT) == 0)
+            new_white = SecCamera::WHITE_BALANCE_FLUORESCENT;
+        else if (strcmp(new_white_str, CameraParameters::WHITE_BALANCE_DAYLIGHT) == 0)
+            new_white = SecCamera::WHITE_BALANCE_SUNNY;
+        else if (strcmp(new_white_str, CameraParameters::WHITE_BALANCE_CLOUDY_DAYLIGHT) == 0)
+            new_white = SecCamera::WHITE_BALANCE_CLOUDY;
+        else {
+            LOGE("%s::invalid white balance(%s)", __FUNCTION__, new_white_str);
+            ret = UNKNOWN_ERROR;
+        }
+
+        if (0 <= new_white) {
+            if (mSecCamera->setWhiteBalance(new_white) < 0) {
+                LOGE("ERR(%s):Fail on mSecCamera->setWhiteBalance(white(%d))", __FUNCTION__, new_white);
+                ret = UNKNOWN_ERROR;
+            } else
+                mParameters.set(CameraParameters::KEY_WHITE_BALANCE, new_white_str);
+        }
+    }
+
+    // image effect
+    const char * new_effect_str = params.get(CameraParameters::KEY_EFFECT);
+    if (new_effect_str != NULL) {
+        int new_effect = -1;
+
+        if (strcmp(new_effect_str, CameraParameters::EFFECT_NONE) == 0)
+            new_effect = SecCamera::IMAGE_EFFECT_ORIGINAL;
+        else if (strcmp(new_effect_str, CameraParameters::EFFECT_MONO) == 0)
+            new_effect = SecCamera::IMAGE_EFFECT_MONO;
+        else if (strcmp(new_effect_str, CameraParameters::EFFECT_NEGATIVE) == 0)
+            new_effect = SecCamera::IMAGE_EFFECT_NEGATIVE;
+        else if (strcmp(new_effect_str, CameraParameters::EFFECT_SEPIA) == 0)
+            new_effect = SecCamera::IMAGE_EFFECT_SEPIA;
+        else if (strcmp(new_effect_str, CameraParameters::EFFECT_AQUA) == 0)
+            new_effect = SecCamera::IMAGE_EFFECT_AQUA;
+        else if (strcmp(new_effect_str, CameraParameters::EFFECT_WHITEBOARD) == 0)
+            new_effect = SecCamera::IMAGE_EFFECT_WHITEBOARD;
+        else {
+            LOGE("%s::invalid effect(%s)", __FUNCTION__, new_effect_str);
+            ret = UNKNOWN_ERROR;
+        }
+
+        if (0 <= new_effect) {
+            if (mSecCamera->setImageEffect(new_effect) < 0) {
+                LOGE("ERR(%s):Fail on mSecCamera->setImageEffect(effect(%d))", __FUNCTION__, new_effect);
+                ret = UNKNOWN_ERROR;
+            } else
+                mParameters.set(CameraParameters::KEY_EFFECT, new_effect_str);
+        }
+    }
 
     // scene mode
     const char * new_scene_mode_str = params.get("scene-mode");
@@ -1122,56 +2332,121 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
 CameraParameters CameraHardwareSec::getParameters() const
 {
     LOGV("%s :", __FUNCTION__);
-    return mParameters;
+    CameraParameters params = mParameters;
+
+    // preview since startPreview(), read only
+    params.set("preview-frames",           (int)mPreviewFrames);
+    params.set("preview-frames-skipped",   (int)mPreviewSkipped);
+    params.set("preview-frames-reclaimed", (int)mPreviewReclaimed);
+    params.set("preview-latency-us",       (int)ns2us(mPreviewLatency));
+    params.set("preview-latency-max-us",   (int)ns2us(mPreviewLatencyMax));
+    params.set("preview-jitter-us",        (int)ns2us(mPreviewJitter));
+#ifdef PREVIEW_CALLBACK_CONVERT
+    params.set("preview-callback-frames",         (int)mCallbackFrames);
+    params.set("preview-callback-frames-dropped", (int)mCallbackDropped);
+    params.set("preview-callback-cost-us",        (int)ns2us(mCallbackCost));
+    params.set("preview-callback-cost-max-us",    (int)ns2us(mCallbackCostMax));
+#endif
+
+#ifdef USE_SEC_CROP_ZOOM
+    nsecs_t zoom_latency, zoom_latency_max;
+
+    // setZoom() to the first frame with the new crop, read only
+    mSecCamera->getZoomStats(&zoom_latency, &zoom_latency_max);
+    params.set(CameraParameters::KEY_ZOOM,  mSecCamera->getZoom());
+    params.set("zoom-latency-us",           (int)ns2us(zoom_latency));
+    params.set("zoom-latency-max-us",       (int)ns2us(zoom_latency_max));
+#endif
+
+    // setParameters() and the sensor controls it led to, read only
+    unsigned int ctrl_writes, ctrl_ioctls;
+
+    mSecCamera->getCtrlStats(&ctrl_writes, &ctrl_ioctls);
+    params.set("param-sets",               (int)mParamSets);
+    params.set("param-sets-unchanged",     (int)mParamUnchanged);
+    params.set("param-restarts",           (int)mParamRestarts);
+    params.set("param-restarts-avoided",   (int)mParamRestartsAvoided);
+    params.set("ctrl-writes",              (int)ctrl_writes);
+    params.set("ctrl-ioctls",              (int)ctrl_ioctls);
+
+    // recording since startRecording(), read only
+    mRecordStatsLock.lock();
+    params.set("record-frames",            (int)mRecordFrames);
+    params.set("record-frames-dropped",    (int)mRecordDropped);
+    params.set("record-latency-us",        (int)ns2us(mRecordLatency));
+    params.set("record-latency-max-us",    (int)ns2us(mRecordLatencyMax));
+    mRecordStatsLock.unlock();
+
+    // compressed pictures since open, read only
+    mJpegOutLock.lock();
+    params.set("jpeg-heaps-pooled",    (int)mJpegOutPooled);
+    params.set("jpeg-heaps-allocated", (int)mJpegOutAllocated);
+    mJpegOutLock.unlock();
+
+#ifdef BURST_CAPTURE
+    char str[16];
+
+    // results of the last burst, read only
+    Mutex::Autolock lock(mBurstLock);
+    snprintf(str, sizeof(str), "%.1f", mBurstCaptureFps);
+    params.set("burst-capture-fps", str);
+    snprintf(str, sizeof(str), "%.1f", mBurstPictureFps);
+    params.set("burst-picture-fps", str);
+    params.set("burst-pictures", (int)mBurstDelivered);
+    params.set("burst-dropped",  (int)mBurstDropped);
+#endif
+    return params;
 }
 
 status_t CameraHardwareSec::sendCommand(int32_t command, int32_t arg1,
                                          int32_t arg2)
 {
-    int  cur_zoom     = 0;
-    int  new_zoom     = 0;
-    bool enable_zoom  = false;
-    bool flag_stopped = false;
-    int  min_zoom     = 0;
-    int  max_zoom     = 10;
+    status_t ret = NO_ERROR;
     LOGV("++%s :", __FUNCTION__);
 
     switch(command) {
         case CAMERA_CMD_START_SMOOTH_ZOOM :
             LOGD("%s::CAMERA_CMD_START_SMOOTH_ZOOM arg1(%d) arg2(%d)\n", __FUNCTION__, arg1, arg2);
 
-            min_zoom = mSecCamera->getZoomMin();
-            max_zoom = mSecCamera->getZoomMax();
-            cur_zoom = mSecCamera->getZoom();
-            new_zoom = arg1;
+            if(arg1 < mSecCamera->getZoomMin() || mSecCamera->getZoomMax() < arg1) {
+                LOGE("ERR(%s):invalid zoom(%d)", __FUNCTION__, arg1);
+                ret = BAD_VALUE;
+                break;
+            }
 
-            if(cur_zoom < new_zoom && cur_zoom < max_zoom)
-                enable_zoom = true;
-            else if(new_zoom < cur_zoom && min_zoom < cur_zoom)
-                enable_zoom = true;
+            {
+                Mutex::Autolock lock(mStateLock);
 
-            if(enable_zoom == true && mSecCamera->setZoom(new_zoom) < 0) {
-                LOGE("ERR(%s):Fail on mSecCamera->setZoom(new_zoom(%d))", __FUNCTION__, new_zoom);
-                enable_zoom = false;
+                if (mPreviewRunning) {
+                    // previewThread() steps to it, CAMERA_MSG_ZOOM for each step
+                    mZoomTarget = arg1;
+                    break;
+                }
             }
 
-            if(enable_zoom == false
-                    || new_zoom == max_zoom
-                    || new_zoom == min_zoom) {
-                flag_stopped = true;
-            } else
-                flag_stopped = false;
-
-            // kcoolsw : we need to check up..
-            flag_stopped = true;
+            // no frames to step on, go there at once
+            if(mSecCamera->setZoom(arg1) < 0) {
+                LOGE("ERR(%s):Fail on mSecCamera->setZoom(zoom(%d))", __FUNCTION__, arg1);
+                ret = UNKNOWN_ERROR;
+                break;
+            }
+            mParameters.set(CameraParameters::KEY_ZOOM, arg1);
 
             if(mNotifyCb && (mMsgEnabled & CAMERA_MSG_ZOOM))
-                mNotifyCb(CAMERA_MSG_ZOOM, new_zoom, flag_stopped, mCallbackCookie);
+                mNotifyCb(CAMERA_MSG_ZOOM, arg1, true, mCallbackCookie);
 
             break;
 
         case CAMERA_CMD_STOP_SMOOTH_ZOOM :
             LOGD("%s::CAMERA_CMD_STOP_SMOOTH_ZOOM  arg1(%d) arg2(%d)\n", __FUNCTION__, arg1, arg2);
+
+            {
+                Mutex::Autolock lock(mStateLock);
+
+                // the next step is the last one, it reports the stop
+                if (0 <= mZoomTarget)
+                    mZoomTarget = mSecCamera->getZoom();
+            }
             break;
 
         case CAMERA_CMD_SET_DISPLAY_ORIENTATION :
@@ -1181,8 +2456,7 @@ status_t CameraHardwareSec::sendCommand(int32_t command, int32_t arg1,
     }
     LOGV("--%s :", __FUNCTION__);
 
-    //return BAD_VALUE;
-    return NO_ERROR;
+    return ret;
 }
 
 void CameraHardwareSec::release()
@@ -1207,6 +2481,17 @@ void CameraHardwareSec::release()
     if (previewThread != 0)
         previewThread->requestExitAndWait();
 
+#ifdef PREVIEW_CALLBACK_CONVERT
+    if (mCallbackThread != 0) {
+        m_stopCallbackThread();
+        mCallbackThread.clear();
+    }
+#endif
+
+#ifdef BURST_CAPTURE
+    m_stopBurstThreads();
+#endif
+
     {
         Mutex::Autolock autofocusLock(&mAutofocusLock);
 
@@ -1223,9 +2508,19 @@ void CameraHardwareSec::release()
         if(mJpegHeap != NULL)
             mJpegHeap.clear();
 
+        for (int i = 0; i < kJpegOutHeapCount; i++)
+            mJpegOutHeaps[i].clear();
+
         if(mPreviewHeap != NULL)
             mPreviewHeap.clear();
 
+#ifdef PREVIEW_CALLBACK_CONVERT
+        for (int i = 0; i < kCallbackBufferCount; i++)
+            mCallbackBuffers[i].clear();
+        if(mCallbackHeap != NULL)
+            mCallbackHeap.clear();
+#endif
+
         if(mRecordHeap != NULL)
             mRecordHeap.clear();
 
@@ -1272,6 +2567,22 @@ int CameraHardwareSec::m_beginPictureThread(void *cookie)
     return c->pictureThread();
 }
 
+#ifdef BURST_CAPTURE
+int CameraHardwareSec::m_beginBurstThread(void *cookie)
+{
+    LOGV("%s :", __FUNCTION__);
+    CameraHardwareSec *c = (CameraHardwareSec *)cookie;
+    return c->burstThread();
+}
+
+int CameraHardwareSec::m_beginBurstEncodeThread(void *cookie)
+{
+    LOGV("%s :", __FUNCTION__);
+    CameraHardwareSec *c = (CameraHardwareSec *)cookie;
+    return c->burstEncodeThread();
+}
+#endif
+
 int CameraHardwareSec::m_getGpsInfo(CameraParameters * camParams, gps_info * gps)
 {
     int flag_gps_info_valid = 1;
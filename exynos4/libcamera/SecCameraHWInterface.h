@@ -19,6 +19,7 @@
 #define ANDROID_HARDWARE_CAMERA_HARDWARE_SEC_H
 
 #include "SecCamera.h"
+#include "SecCameraConvert.h"
 #include <utils/threads.h>
 #include <camera/CameraHardwareInterface.h>
 #include <binder/MemoryBase.h>
@@ -54,6 +55,19 @@ private:
 		}
 	    };
 
+#ifdef PREVIEW_CALLBACK_CONVERT
+    class CallbackThread : public Thread {
+        CameraHardwareSec *mHardware;
+    public:
+        CallbackThread(CameraHardwareSec *hw):
+            Thread(false),
+            mHardware(hw) { }
+        virtual bool threadLoop() {
+            return mHardware->callbackThread() == NO_ERROR;
+        }
+    };
+#endif
+
 
     typedef struct
 	{
@@ -75,14 +89,36 @@ private:
 
     static const int    kBufferCount = MAX_BUFFERS;
     static const int    kBufferCountForRecord = MAX_BUFFERS;
+    static const int    kPreviewMinQueued = 2;  // capture buffers always left with the camera
 
     sp<MemoryHeapBase>  mPreviewHeap;
     sp<MemoryHeapBase>  mRawHeap;
     sp<MemoryHeapBase>  mRawAddrHeap;
     sp<MemoryHeapBase>  mRecordHeap;
-    sp<MemoryHeapBase>  mJpegHeap;
-    sp<MemoryBase>      mBuffers      [kBufferCount];
-    //sp<MemoryBase>      mRecordBuffers[kBufferCountForRecord];
+    sp<MemoryHeapBase>  mJpegHeap;      // mapping of the jpeg encoder buffers
+    int                 mJpegInOffset;
+
+    // compressed pictures are put together in these and go out as they are,
+    // a heap is taken again once the client has dropped the picture it held
+    // (only the pool references it)
+    static const int    kJpegOutHeapCount = 4;
+    sp<MemoryHeapBase>  mJpegOutHeaps[kJpegOutHeapCount];
+    mutable Mutex       mJpegOutLock;
+    unsigned int        mJpegOutPooled;     // pictures handed out in a pool heap
+    unsigned int        mJpegOutAllocated;  // pool busy, the picture got a heap of its own
+    sp<MemoryBase>      mBuffers      [kBufferCount];   // preview callback memory, one per capture buffer
+    sp<MemoryBase>      mRecordBuffers[kBufferCountForRecord];  // recording frame descriptors of this session
+    unsigned int        mRecordSession;     // startRecording() count, picks the half of mRecordHeap
+
+    // recording since startRecording(), the encoder releases frames from
+    // its own thread
+    mutable Mutex       mRecordStatsLock;
+    nsecs_t             mRecordTime[kBufferCountForRecord];     // capture time of the frame in each buffer
+    unsigned int        mRecordGen[kBufferCountForRecord];      // SecCamera recording generation of each frame
+    unsigned int        mRecordFrames;      // given back by the encoder
+    unsigned int        mRecordDropped;     // skipped while the encoder held every buffer
+    nsecs_t             mRecordLatency;     // smoothed capture to encoder release
+    nsecs_t             mRecordLatencyMax;
 
     SecCamera          *mSecCamera;
     bool                mPreviewRunning;
@@ -96,10 +132,54 @@ private:
     // protected by mCameraLock
     sp<PreviewThread>   mPreviewThread;
 
+    // preview ring : who holds each capture buffer, 0 : queued to the camera
+    enum PREVIEW_HOLD {
+        PREVIEW_HOLD_HAL     = 1 << 0,  // in previewThread()
+        PREVIEW_HOLD_OVERLAY = 1 << 1,  // queued to the overlay, back on its dequeue
+        PREVIEW_HOLD_CLIENT  = 1 << 2,  // callback memory still referenced
+        PREVIEW_HOLD_CALLBACK = 1 << 3, // being converted for the callback
+    };
+    int                 mPreviewHold[kBufferCount];
+    unsigned int        mPreviewSeq [kBufferCount];    // frame number, oldest client hold goes first
+
+    // preview statistics since startPreview()
+    unsigned int        mPreviewFrames;
+    unsigned int        mPreviewSkipped;    // completed but replaced by a newer frame
+    unsigned int        mPreviewReclaimed;  // client holds broken to keep the camera fed
+    nsecs_t             mPreviewLastTime;   // capture time of the last frame
+    nsecs_t             mPreviewInterval;
+    nsecs_t             mPreviewJitter;     // smoothed change of the frame interval
+    nsecs_t             mPreviewLatency;    // smoothed capture to overlay queue
+    nsecs_t             mPreviewLatencyMax;
+
+#ifdef PREVIEW_CALLBACK_CONVERT
+    // preview callback conversion : the callback thread converts a capture
+    // buffer into its own memory, previewThread() never waits for it
+    static const int    kCallbackBufferCount = 2;
+    sp<CallbackThread>  mCallbackThread;
+    SecCameraConvert    mCallbackConvert;
+    bool                mCallbackEnabled;   // chosen by startPreview()
+    int                 mCallbackFormat;    // V4L2 format given to the client
+    int                 mCallbackWidth;
+    int                 mCallbackHeight;
+    sp<MemoryHeapBase>  mCallbackHeap;
+    sp<MemoryBase>      mCallbackBuffers[kCallbackBufferCount];
+    Mutex               mCallbackLock;
+    Condition           mCallbackCond;
+    bool                mCallbackExit;
+    int                 mCallbackIndex;     // capture buffer being converted, -1 : none
+    int                 mCallbackDone;      // converted, released by previewThread()
+    unsigned int        mCallbackFrames;
+    unsigned int        mCallbackDropped;   // converter busy or every buffer with the client
+    nsecs_t             mCallbackCost;      // smoothed conversion time
+    nsecs_t             mCallbackCostMax;
+#endif
+
 #if defined(BOARD_USES_CAMERA_OVERLAY)
     sp<Overlay>         mOverlay;
     bool                mUseOverlay;
     int                 mOverlayBufferIdx;
+    int                 mOverlaySlot[kBufferCount]; // capture buffer in each overlay slot, -1 : none
 #endif
 
 #if defined(BOARD_USES_HDMI)
@@ -115,8 +195,41 @@ private:
 
     int                 mAFMode;
 
+    // smooth zoom : previewThread() moves one step per frame to the target
+    int                 mZoomTarget;        // -1 : not zooming, protected by mStateLock
+
+    // setParameters() since open, see m_diffParameters()
+    unsigned int        mParamSets;
+    unsigned int        mParamUnchanged;        // nothing differed from mParameters
+    unsigned int        mParamRestarts;         // preview stopped and started again
+    unsigned int        mParamRestartsAvoided;  // changed on the running preview
+
     gps_info            mGpsInfo;
 
+#ifdef BURST_CAPTURE
+    // burst capture : the burst thread queues frames for the encode thread
+    int                 mBurstCount;        // pictures per takePicture(), 1 : single shot
+    int                 mBurstQueueDepth;
+    bool                mBurstDropOnFull;   // drop frames instead of waiting for the encoder
+    mutable Mutex       mBurstLock;
+    Condition           mBurstCond;
+    int                 mBurstQueue[MAX_BUFFERS];
+    int                 mBurstQueueHead;
+    int                 mBurstQueueCount;
+    bool                mBurstAbort;
+    bool                mBurstRunning;      // burstThread() until it returns, the encode thread ends first
+    bool                mBurstCaptureDone;
+    bool                mBurstEncodeDone;
+    unsigned int        mBurstCaptured;
+    unsigned int        mBurstDropped;
+    unsigned int        mBurstDelivered;
+    nsecs_t             mBurstStartTime;    // first frame out of the sensor
+    nsecs_t             mBurstFrameTime;    // last frame out of the sensor
+    nsecs_t             mBurstPictureTime;  // last picture out of the encoder
+    float               mBurstCaptureFps;   // last burst
+    float               mBurstPictureFps;
+#endif
+
 public:
     virtual sp<IMemoryHeap> getPreviewHeap() const;
     virtual sp<IMemoryHeap> getRawHeap() const;
@@ -170,8 +283,29 @@ private:
     virtual    ~CameraHardwareSec();
 
     void       m_initDefaultParameters(int cameraId);
+    int        m_diffParameters(const CameraParameters& params) const;
+    status_t   m_applyParameters(const CameraParameters& params);
 
     int        previewThread();
+    void       m_resetPreviewRing(void);
+    void       m_resetRecordStats(void);
+    void       m_newRecordBuffers(void);
+    void       m_releasePreviewHold(int index, int hold);
+    sp<MemoryHeapBase> m_jpegOutHeap(void);
+    sp<MemoryBase> m_jpegMemory(const sp<MemoryHeapBase> &jpegHeap,
+                                const unsigned char *jpegData, int jpegSize);
+    void       m_recyclePreviewBuffers(void);
+    void       m_stepSmoothZoom(void);
+#ifdef PREVIEW_CALLBACK_CONVERT
+    int        callbackThread();
+    void       m_initCallbackConvert(void);
+    void       m_postCallbackFrame(int index);
+    void       m_stopCallbackThread(void);
+#endif
+#if defined(BOARD_USES_CAMERA_OVERLAY)
+    void       m_queueOverlay(int index, struct ADDRS *addr, nsecs_t timestamp);
+    void       m_releaseOverlaySlots(void);
+#endif
 
     static int m_beginAutoFocusThread(void *cookie);
     int        m_autoFocusThreadFunc();
@@ -179,6 +313,14 @@ private:
     static int m_beginPictureThread(void *cookie);
     int        pictureThread();
 
+#ifdef BURST_CAPTURE
+    static int m_beginBurstThread(void *cookie);
+    int        burstThread();
+    static int m_beginBurstEncodeThread(void *cookie);
+    int        burstEncodeThread();
+    void       m_stopBurstThreads(void);
+#endif
+
     int        m_getGpsInfo(CameraParameters * camParams, gps_info * gps);
 
     #ifdef RUN_VARIOUS_EFFECT_TEST
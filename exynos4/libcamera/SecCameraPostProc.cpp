@@ -0,0 +1,558 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SecCameraPostProc"
+#include <utils/Log.h>
+#include <cutils/properties.h>
+#include <math.h>
+#include <linux/android_pmem.h>
+
+#include "android_pmem_s5p.h"
+#include "SecFimc.h"
+#include "SecCameraPostProc.h"
+#include "sec_v4l2_shim.h"
+
+#define ALIGN_TO_4KB(x)   ((((x) + (1 << 12) - 1) >> 12) << 12)
+
+namespace android {
+
+// ======================================================================
+// Thumbnail
+
+SecCameraPostProc::SecCameraPostProc()
+    : m_pmem_fd(-1),
+      m_pmem_base(NULL),
+      m_pmem_phys(0),
+      m_flag_hw_scale(false)
+{
+}
+
+SecCameraPostProc::~SecCameraPostProc()
+{
+    m_closePmem();
+}
+
+int SecCameraPostProc::m_openPmem(void)
+{
+    struct pmem_region region;
+    void *base;
+
+    if (0 <= m_pmem_fd)
+        return 0;
+
+    m_pmem_fd = open(CAMERA_PMEM_DEV_NAME, O_RDWR);
+    if (m_pmem_fd < 0) {
+        LOGE("ERR(%s):open(%s) fail(%s)", __func__, CAMERA_PMEM_DEV_NAME, strerror(errno));
+        return -1;
+    }
+
+    // mapping a pmem fd allocates the region
+    base = mmap(0, ALIGN_TO_4KB(THUMBNAIL_BUF_SIZE), PROT_READ | PROT_WRITE,
+                MAP_SHARED, m_pmem_fd, 0);
+    if (base == MAP_FAILED) {
+        LOGE("ERR(%s):mmap fail(%s)", __func__, strerror(errno));
+        goto OPEN_FAIL;
+    }
+    m_pmem_base = (unsigned char *)base;
+
+    if (ioctl(m_pmem_fd, PMEM_GET_PHYS, &region) < 0) {
+        LOGE("ERR(%s):PMEM_GET_PHYS fail", __func__);
+        goto OPEN_FAIL;
+    }
+    m_pmem_phys = (unsigned int)region.offset;
+
+    LOGV("%s:thumbnail pmem virt(%p) phys(0x%08x)", __func__, m_pmem_base, m_pmem_phys);
+    return 0;
+
+OPEN_FAIL:
+    m_closePmem();
+    return -1;
+}
+
+void SecCameraPostProc::m_closePmem(void)
+{
+    if (m_pmem_base != NULL)
+        munmap(m_pmem_base, ALIGN_TO_4KB(THUMBNAIL_BUF_SIZE));
+    if (0 <= m_pmem_fd)
+        close(m_pmem_fd);
+
+    m_pmem_fd   = -1;
+    m_pmem_base = NULL;
+    m_pmem_phys = 0;
+}
+
+int SecCameraPostProc::m_hwScale(unsigned int src_phys, int src_width, int src_height, int src_format,
+                                 unsigned char *dst, int dst_width, int dst_height)
+{
+    SecFimc fimc;
+    unsigned int crop_width, crop_height;
+    struct pmem_region region;
+    int ret = -1;
+
+    if (m_openPmem() < 0)
+        return -1;
+
+    // FIMC1 is the memory to memory port copybit uses, taken for this one frame
+    if (fimc.create(SecFimc::FIMC_DEV1, FIMC_OVLY_NONE_SINGLE_BUF, 1) == false) {
+        LOGE("ERR(%s):fimc.create fail", __func__);
+        return -1;
+    }
+
+    crop_width  = src_width;
+    crop_height = src_height;
+    // SecFimc takes the V4L2 formats of the camera as they are
+    if (fimc.setSrcParams(src_width, src_height, 0, 0, &crop_width, &crop_height,
+                src_format, true) == false) {
+        LOGE("ERR(%s):fimc.setSrcParams(%d, %d, %d) fail", __func__, src_width, src_height, src_format);
+        goto SCALE_END;
+    }
+
+    if (fimc.setSrcPhyAddr(src_phys) == false) {
+        LOGE("ERR(%s):fimc.setSrcPhyAddr(0x%08x) fail", __func__, src_phys);
+        goto SCALE_END;
+    }
+
+    crop_width  = dst_width;
+    crop_height = dst_height;
+    if (fimc.setDstParams(dst_width, dst_height, 0, 0, &crop_width, &crop_height,
+                HAL_PIXEL_FORMAT_YCbCr_422_I, true) == false
+        || (int)crop_width != dst_width || (int)crop_height != dst_height) {
+        LOGE("ERR(%s):fimc.setDstParams(%d, %d) fail", __func__, dst_width, dst_height);
+        goto SCALE_END;
+    }
+
+    if (fimc.setDstPhyAddr(m_pmem_phys) == false) {
+        LOGE("ERR(%s):fimc.setDstPhyAddr(0x%08x) fail", __func__, m_pmem_phys);
+        goto SCALE_END;
+    }
+
+    if (fimc.handleOneShot() == false) {
+        LOGE("ERR(%s):fimc.handleOneShot fail", __func__);
+        goto SCALE_END;
+    }
+
+    // FIMC wrote behind the cache
+    region.offset = (unsigned long)m_pmem_base;
+    region.len    = dst_width * dst_height * 2;
+    ioctl(m_pmem_fd, PMEM_CACHE_INV, &region);
+
+    memcpy(dst, m_pmem_base, dst_width * dst_height * 2);
+    ret = 0;
+
+SCALE_END:
+    fimc.destroy();
+    return ret;
+}
+
+int SecCameraPostProc::m_swScale(const unsigned char *src, int src_width, int src_height, int src_format,
+                                 unsigned char *dst, int dst_width, int dst_height)
+{
+    const int frame = src_width * src_height;
+
+    switch (src_format) {
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_YUV420:
+        break;
+    default:
+        LOGE("ERR(%s):format %d is not supported", __func__, src_format);
+        return -1;
+    }
+
+    // nearest neighbour on Y0 Cb Y1 Cr pairs
+    for (int y = 0; y < dst_height; y++) {
+        int sy = y * src_height / dst_height;
+        const unsigned char *s = src + sy * src_width * 2;       // packed
+        const unsigned char *l = src + sy * src_width;           // luma plane
+        const unsigned char *c = src + frame + (sy / 2) * src_width; // 4:2:0 chroma
+        unsigned char *d = dst + y * dst_width * 2;
+
+        for (int x = 0; x < dst_width; x += 2) {
+            int sx = (x * src_width / dst_width) & ~1;
+
+            switch (src_format) {
+            case V4L2_PIX_FMT_YUYV:
+                memcpy(d + x * 2, s + sx * 2, 4);
+                break;
+            case V4L2_PIX_FMT_UYVY:
+                d[x * 2 + 0] = s[sx * 2 + 1];
+                d[x * 2 + 1] = s[sx * 2 + 0];
+                d[x * 2 + 2] = s[sx * 2 + 3];
+                d[x * 2 + 3] = s[sx * 2 + 2];
+                break;
+            case V4L2_PIX_FMT_NV12:
+            case V4L2_PIX_FMT_NV21:
+                d[x * 2 + 0] = l[sx];
+                d[x * 2 + 2] = l[sx + 1];
+                d[x * 2 + 1] = c[sx + (src_format == V4L2_PIX_FMT_NV21)];
+                d[x * 2 + 3] = c[sx + (src_format == V4L2_PIX_FMT_NV12)];
+                break;
+            default: // V4L2_PIX_FMT_YUV420
+            {
+                const unsigned char *cb = src + frame + (sy / 2) * (src_width / 2);
+
+                d[x * 2 + 0] = l[sx];
+                d[x * 2 + 2] = l[sx + 1];
+                d[x * 2 + 1] = cb[sx / 2];
+                d[x * 2 + 3] = cb[frame / 4 + sx / 2];
+                break;
+            }
+            }
+        }
+    }
+    return 0;
+}
+
+int SecCameraPostProc::scaleThumbnail(unsigned int src_phys, const unsigned char *src,
+                                      int src_width, int src_height, int src_format,
+                                      unsigned char *dst, int dst_width, int dst_height)
+{
+    if (   dst_width  <= 0 || MAX_THUMBNAIL_WIDTH  < dst_width
+        || dst_height <= 0 || MAX_THUMBNAIL_HEIGHT < dst_height) {
+        LOGE("ERR(%s):Invalid thumbnail size(%d x %d)", __func__, dst_width, dst_height);
+        return -1;
+    }
+
+    m_flag_hw_scale = false;
+
+    if (src_phys != 0
+        && m_hwScale(src_phys, src_width, src_height, src_format, dst, dst_width, dst_height) == 0) {
+        m_flag_hw_scale = true;
+        return 0;
+    }
+
+    if (src == NULL)
+        return -1;
+
+    return m_swScale(src, src_width, src_height, src_format, dst, dst_width, dst_height);
+}
+
+bool SecCameraPostProc::flagHwScale(void)
+{
+    return m_flag_hw_scale;
+}
+
+// ======================================================================
+// EXIF
+
+enum EXIF_TYPE {
+    EXIF_TYPE_BYTE      = 1,
+    EXIF_TYPE_ASCII     = 2,
+    EXIF_TYPE_SHORT     = 3,
+    EXIF_TYPE_LONG      = 4,
+    EXIF_TYPE_RATIONAL  = 5,
+    EXIF_TYPE_UNDEFINED = 7,
+};
+
+#define EXIF_TAG_MAKE                   0x010F
+#define EXIF_TAG_MODEL                  0x0110
+#define EXIF_TAG_ORIENTATION            0x0112
+#define EXIF_TAG_X_RESOLUTION           0x011A
+#define EXIF_TAG_Y_RESOLUTION           0x011B
+#define EXIF_TAG_RESOLUTION_UNIT        0x0128
+#define EXIF_TAG_DATE_TIME              0x0132
+#define EXIF_TAG_YCBCR_POSITIONING      0x0213
+#define EXIF_TAG_EXIF_IFD_POINTER       0x8769
+#define EXIF_TAG_GPS_IFD_POINTER        0x8825
+#define EXIF_TAG_COMPRESSION            0x0103
+#define EXIF_TAG_JPEG_IF_OFFSET         0x0201
+#define EXIF_TAG_JPEG_IF_LENGTH         0x0202
+
+#define EXIF_TAG_EXIF_VERSION           0x9000
+#define EXIF_TAG_DATE_TIME_ORG          0x9003
+#define EXIF_TAG_DATE_TIME_DIGITIZE     0x9004
+#define EXIF_TAG_COMPONENTS_CONFIG      0x9101
+#define EXIF_TAG_FLASHPIX_VERSION       0xA000
+#define EXIF_TAG_COLOR_SPACE            0xA001
+#define EXIF_TAG_PIXEL_X_DIMENSION      0xA002
+#define EXIF_TAG_PIXEL_Y_DIMENSION      0xA003
+
+#define EXIF_TAG_GPS_VERSION_ID         0x0000
+#define EXIF_TAG_GPS_LATITUDE_REF       0x0001
+#define EXIF_TAG_GPS_LATITUDE           0x0002
+#define EXIF_TAG_GPS_LONGITUDE_REF      0x0003
+#define EXIF_TAG_GPS_LONGITUDE          0x0004
+#define EXIF_TAG_GPS_ALTITUDE_REF       0x0005
+#define EXIF_TAG_GPS_ALTITUDE           0x0006
+#define EXIF_TAG_GPS_TIMESTAMP          0x0007
+#define EXIF_TAG_GPS_DATESTAMP          0x001D
+
+#define NUM_0TH_IFD_TIFF                9   // + GPS IFD pointer
+#define NUM_0TH_IFD_EXIF                8
+#define NUM_0TH_IFD_GPS                 9
+#define NUM_1TH_IFD_TIFF                6
+
+// IFDs, strings and rationals without the thumbnail stay well below this
+#define EXIF_TIFF_FIXED_MAX_SIZE        (1024 + 2 * PROPERTY_VALUE_MAX)
+
+// offsets in the IFDs are from the start of the TIFF header
+struct ifd_writer {
+    unsigned char * tiff;
+    unsigned char * entry;  // next 12 byte entry
+    unsigned int    data;   // next free byte after the IFD
+};
+
+static inline void put16(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static inline void put32(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+// returns the link to the next IFD
+static unsigned char *ifd_begin(struct ifd_writer *w, unsigned int offset, int entries)
+{
+    unsigned char *next = w->tiff + offset + 2 + entries * 12;
+
+    put16(w->tiff + offset, entries);
+    put32(next, 0);
+
+    w->entry = w->tiff + offset + 2;
+    w->data  = offset + 2 + entries * 12 + 4;
+    return next;
+}
+
+// returns the value field, for pointers patched later
+static unsigned char *ifd_entry(struct ifd_writer *w, unsigned int tag, unsigned int type,
+                                unsigned int count, const unsigned char *value, unsigned int size)
+{
+    unsigned char *field = w->entry + 8;
+
+    put16(w->entry,     tag);
+    put16(w->entry + 2, type);
+    put32(w->entry + 4, count);
+
+    if (size <= 4) {
+        memset(field, 0, 4);
+        memcpy(field, value, size);
+    } else {
+        memcpy(w->tiff + w->data, value, size);
+        put32(field, w->data);
+        w->data += (size + 1) & ~1;
+    }
+
+    w->entry += 12;
+    return field;
+}
+
+static unsigned char *ifd_short(struct ifd_writer *w, unsigned int tag, unsigned int value)
+{
+    unsigned char buf[2];
+
+    put16(buf, value);
+    return ifd_entry(w, tag, EXIF_TYPE_SHORT, 1, buf, 2);
+}
+
+static unsigned char *ifd_long(struct ifd_writer *w, unsigned int tag, unsigned int value)
+{
+    unsigned char buf[4];
+
+    put32(buf, value);
+    return ifd_entry(w, tag, EXIF_TYPE_LONG, 1, buf, 4);
+}
+
+static void ifd_ascii(struct ifd_writer *w, unsigned int tag, const char *str)
+{
+    unsigned int size = strlen(str) + 1;
+
+    ifd_entry(w, tag, EXIF_TYPE_ASCII, size, (const unsigned char *)str, size);
+}
+
+// values are numerator, denominator pairs
+static void ifd_rational(struct ifd_writer *w, unsigned int tag,
+                         const unsigned int *values, int count)
+{
+    unsigned char buf[3 * 8];
+
+    for (int i = 0; i < count * 2; i++)
+        put32(buf + i * 4, values[i]);
+    ifd_entry(w, tag, EXIF_TYPE_RATIONAL, count, buf, count * 8);
+}
+
+static void gps_dms(double degrees, unsigned int *values)
+{
+    double minutes;
+
+    degrees   = fabs(degrees);
+    values[0] = (unsigned int)degrees;
+    values[1] = 1;
+    minutes   = (degrees - values[0]) * 60;
+    values[2] = (unsigned int)minutes;
+    values[3] = 1;
+    values[4] = (unsigned int)((minutes - values[2]) * 60 * 100);
+    values[5] = 100;
+}
+
+static int exif_orientation(int rotation)
+{
+    switch (rotation) {
+    case 90:
+        return 6;
+    case 180:
+        return 3;
+    case 270:
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+int SecCameraPostProc::makeExifApp1(unsigned char *buf, int buf_size,
+                                    const struct exif_attribute *attr,
+                                    const unsigned char *thumb, int thumb_size)
+{
+    static const unsigned char exif_header[6]   = { 'E', 'x', 'i', 'f', 0, 0 };
+    static const unsigned char tiff_header[8]   = { 'I', 'I', 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00 };
+    static const unsigned char exif_version[4]  = { '0', '2', '2', '0' };
+    static const unsigned char fpix_version[4]  = { '0', '1', '0', '0' };
+    static const unsigned char components[4]    = { 1, 2, 3, 0 };
+    static const unsigned char gps_version[4]   = { 2, 2, 0, 0 };
+    static const unsigned int  resolution[2]    = { 72, 1 };
+
+    struct ifd_writer w;
+    unsigned char *exif_ptr, *gps_ptr = NULL, *next_ifd;
+    unsigned char *thumb_ptr;
+    char make[PROPERTY_VALUE_MAX];
+    char model[PROPERTY_VALUE_MAX];
+    char date_time[20];
+    struct tm tm;
+    int size;
+
+    if (buf_size < 10 + EXIF_TIFF_FIXED_MAX_SIZE) {
+        LOGE("ERR(%s):buf_size(%d) too small", __func__, buf_size);
+        return 0;
+    }
+
+    if (EXIF_APP1_MAX_SIZE < buf_size)
+        buf_size = EXIF_APP1_MAX_SIZE;
+
+    if (thumb != NULL && buf_size < 10 + EXIF_TIFF_FIXED_MAX_SIZE + thumb_size) {
+        LOGE("ERR(%s):thumbnail(%d bytes) does not fit the APP1 segment, dropped",
+                __func__, thumb_size);
+        thumb = NULL;
+    }
+
+    property_get("ro.product.manufacturer", make, "SAMSUNG");
+    property_get("ro.product.model", model, "");
+
+    localtime_r(&attr->date_time, &tm);
+    strftime(date_time, sizeof(date_time), "%Y:%m:%d %H:%M:%S", &tm);
+
+    // APP1 marker, length patched below, "Exif\0\0", TIFF header
+    buf[0] = 0xFF;
+    buf[1] = 0xE1;
+    memcpy(buf + 4, exif_header, sizeof(exif_header));
+    memcpy(buf + 10, tiff_header, sizeof(tiff_header));
+
+    w.tiff = buf + 10;
+
+    // 0th IFD
+    next_ifd = ifd_begin(&w, 8, NUM_0TH_IFD_TIFF + (attr->gps_enabled ? 1 : 0));
+    ifd_ascii(&w, EXIF_TAG_MAKE, make);
+    ifd_ascii(&w, EXIF_TAG_MODEL, model);
+    ifd_short(&w, EXIF_TAG_ORIENTATION, exif_orientation(attr->rotation));
+    ifd_rational(&w, EXIF_TAG_X_RESOLUTION, resolution, 1);
+    ifd_rational(&w, EXIF_TAG_Y_RESOLUTION, resolution, 1);
+    ifd_short(&w, EXIF_TAG_RESOLUTION_UNIT, 2); // inches
+    ifd_ascii(&w, EXIF_TAG_DATE_TIME, date_time);
+    ifd_short(&w, EXIF_TAG_YCBCR_POSITIONING, 1); // centered
+    exif_ptr = ifd_long(&w, EXIF_TAG_EXIF_IFD_POINTER, 0);
+    if (attr->gps_enabled)
+        gps_ptr = ifd_long(&w, EXIF_TAG_GPS_IFD_POINTER, 0);
+
+    // Exif IFD
+    put32(exif_ptr, w.data);
+    ifd_begin(&w, w.data, NUM_0TH_IFD_EXIF);
+    ifd_entry(&w, EXIF_TAG_EXIF_VERSION, EXIF_TYPE_UNDEFINED, 4, exif_version, 4);
+    ifd_ascii(&w, EXIF_TAG_DATE_TIME_ORG, date_time);
+    ifd_ascii(&w, EXIF_TAG_DATE_TIME_DIGITIZE, date_time);
+    ifd_entry(&w, EXIF_TAG_COMPONENTS_CONFIG, EXIF_TYPE_UNDEFINED, 4, components, 4);
+    ifd_entry(&w, EXIF_TAG_FLASHPIX_VERSION, EXIF_TYPE_UNDEFINED, 4, fpix_version, 4);
+    ifd_short(&w, EXIF_TAG_COLOR_SPACE, 1); // sRGB
+    ifd_long(&w, EXIF_TAG_PIXEL_X_DIMENSION, attr->width);
+    ifd_long(&w, EXIF_TAG_PIXEL_Y_DIMENSION, attr->height);
+
+    // GPS IFD
+    if (attr->gps_enabled) {
+        unsigned int values[6];
+        unsigned char altitude_ref;
+        time_t gps_time = attr->gps_timestamp;
+        char gps_date[11];
+
+        put32(gps_ptr, w.data);
+        ifd_begin(&w, w.data, NUM_0TH_IFD_GPS);
+        ifd_entry(&w, EXIF_TAG_GPS_VERSION_ID, EXIF_TYPE_BYTE, 4, gps_version, 4);
+        ifd_ascii(&w, EXIF_TAG_GPS_LATITUDE_REF, attr->gps_latitude < 0 ? "S" : "N");
+        gps_dms(attr->gps_latitude, values);
+        ifd_rational(&w, EXIF_TAG_GPS_LATITUDE, values, 3);
+        ifd_ascii(&w, EXIF_TAG_GPS_LONGITUDE_REF, attr->gps_longitude < 0 ? "W" : "E");
+        gps_dms(attr->gps_longitude, values);
+        ifd_rational(&w, EXIF_TAG_GPS_LONGITUDE, values, 3);
+        altitude_ref = attr->gps_altitude < 0 ? 1 : 0;
+        ifd_entry(&w, EXIF_TAG_GPS_ALTITUDE_REF, EXIF_TYPE_BYTE, 1, &altitude_ref, 1);
+        values[0] = abs(attr->gps_altitude);
+        values[1] = 1;
+        ifd_rational(&w, EXIF_TAG_GPS_ALTITUDE, values, 1);
+
+        gmtime_r(&gps_time, &tm);
+        values[0] = tm.tm_hour;
+        values[1] = 1;
+        values[2] = tm.tm_min;
+        values[3] = 1;
+        values[4] = tm.tm_sec;
+        values[5] = 1;
+        ifd_rational(&w, EXIF_TAG_GPS_TIMESTAMP, values, 3);
+        strftime(gps_date, sizeof(gps_date), "%Y:%m:%d", &tm);
+        ifd_ascii(&w, EXIF_TAG_GPS_DATESTAMP, gps_date);
+    }
+
+    // 1st IFD : the thumbnail
+    if (thumb != NULL) {
+        put32(next_ifd, w.data);
+        ifd_begin(&w, w.data, NUM_1TH_IFD_TIFF);
+        ifd_short(&w, EXIF_TAG_COMPRESSION, 6); // JPEG
+        ifd_rational(&w, EXIF_TAG_X_RESOLUTION, resolution, 1);
+        ifd_rational(&w, EXIF_TAG_Y_RESOLUTION, resolution, 1);
+        ifd_short(&w, EXIF_TAG_RESOLUTION_UNIT, 2);
+        thumb_ptr = ifd_long(&w, EXIF_TAG_JPEG_IF_OFFSET, 0);
+        ifd_long(&w, EXIF_TAG_JPEG_IF_LENGTH, thumb_size);
+
+        put32(thumb_ptr, w.data);
+        memcpy(w.tiff + w.data, thumb, thumb_size);
+        w.data += thumb_size;
+    }
+
+    size = 10 + w.data;
+
+    // the length counts itself, not the marker
+    buf[2] = ((size - 2) >> 8) & 0xff;
+    buf[3] =  (size - 2) & 0xff;
+
+    LOGV("%s:APP1 %d bytes, thumbnail %d bytes", __func__, size, thumb ? thumb_size : 0);
+    return size;
+}
+
+}; // namespace android
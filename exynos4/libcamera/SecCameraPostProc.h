@@ -0,0 +1,87 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Capture post-processing for SecCamera : thumbnail downscale and the
+ * EXIF APP1 segment of the pictures.
+ *
+ * Kept apart from SecCamera.cpp because SecFimc.h and SecCamera.h both
+ * declare struct fimc_buffer.
+ */
+
+#ifndef ANDROID_HARDWARE_SEC_CAMERA_POST_PROC_H
+#define ANDROID_HARDWARE_SEC_CAMERA_POST_PROC_H
+
+#include <time.h>
+
+namespace android {
+
+#define CAMERA_PMEM_DEV_NAME    "/dev/pmem_adsp"
+
+#define MAX_THUMBNAIL_WIDTH     (320)
+#define MAX_THUMBNAIL_HEIGHT    (240)
+#define THUMBNAIL_BUF_SIZE      (MAX_THUMBNAIL_WIDTH * MAX_THUMBNAIL_HEIGHT * 2) // YCbYCr
+
+// marker, length and payload; the length field limits the payload to 64KB
+#define EXIF_APP1_MAX_SIZE      (2 + 0xffff)
+
+struct exif_attribute {
+    int          width;
+    int          height;
+    int          rotation;        // SetRotate() angle : 0, 90, 180, 270
+    time_t       date_time;
+
+    int          gps_enabled;
+    double       gps_latitude;    // degrees, negative is south
+    double       gps_longitude;   // degrees, negative is west
+    int          gps_altitude;    // meters, negative is below sea level
+    unsigned int gps_timestamp;   // UTC seconds
+};
+
+class SecCameraPostProc {
+public:
+    SecCameraPostProc();
+    ~SecCameraPostProc();
+
+    // src in the V4L2 snapshot format, dst is YCbYCr; src_phys 0 or a FIMC
+    // failure falls back to the CPU, which takes YUYV, UYVY, NV12, NV21 and YUV420
+    int     scaleThumbnail(unsigned int src_phys, const unsigned char *src,
+                           int src_width, int src_height, int src_format,
+                           unsigned char *dst, int dst_width, int dst_height);
+    bool    flagHwScale(void);   // the last scale was done by FIMC
+
+    // APP1 segment from its marker on into buf, returns its size or 0
+    int     makeExifApp1(unsigned char *buf, int buf_size,
+                         const struct exif_attribute *attr,
+                         const unsigned char *thumb, int thumb_size);
+
+private:
+    int     m_openPmem(void);
+    void    m_closePmem(void);
+    int     m_hwScale(unsigned int src_phys, int src_width, int src_height, int src_format,
+                      unsigned char *dst, int dst_width, int dst_height);
+    int     m_swScale(const unsigned char *src, int src_width, int src_height, int src_format,
+                      unsigned char *dst, int dst_width, int dst_height);
+
+    int             m_pmem_fd;
+    unsigned char * m_pmem_base;   // FIMC destination, cpu side
+    unsigned int    m_pmem_phys;
+    bool            m_flag_hw_scale;
+};
+
+}; // namespace android
+
+#endif // ANDROID_HARDWARE_SEC_CAMERA_POST_PROC_H
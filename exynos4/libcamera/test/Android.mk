@@ -0,0 +1,69 @@
+ifeq ($(BOARD_CAMERA_LIBRARIES),libcamera)
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# SecCamera is built in, routed to the emulated sensor
+LOCAL_SRC_FILES := \
+	seccamera_ctrl_test.cpp \
+	../SecCamera.cpp \
+	../SecCameraPostProc.cpp \
+	../../libfimc/SecFimc.cpp \
+	../../libs5pjpeg/jpeg_api.c
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS := -fno-short-enums
+LOCAL_CFLAGS += -DSLSI_S5PC210 -DBOARD_USES_V4L2_SHIM
+
+LOCAL_STATIC_LIBRARIES := libv4l2shim_static
+LOCAL_SHARED_LIBRARIES := libutils libcutils liblog libbinder libcamera_client
+
+ifeq ($(BOARD_SUPPORT_SYSMMU),true)
+LOCAL_CFLAGS += -DBOARD_SUPPORT_SYSMMU
+LOCAL_C_INCLUDES += device/sec/sec_proprietary/include
+LOCAL_SHARED_LIBRARIES += libMali
+endif
+
+LOCAL_MODULE := seccamera_ctrl_test
+include $(BUILD_EXECUTABLE)
+
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# the whole HAL is built in, routed to the emulated sensor
+LOCAL_SRC_FILES := \
+	camera_burst_bench.cpp \
+	../SecCamera.cpp \
+	../SecCameraPostProc.cpp \
+	../SecCameraConvert.cpp \
+	../SecCameraHWInterface.cpp \
+	../../libfimc/SecFimc.cpp \
+	../../libs5pjpeg/jpeg_api.c
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS := -fno-short-enums
+LOCAL_CFLAGS += -DSLSI_S5PC210 -DBOARD_USES_V4L2_SHIM
+
+LOCAL_STATIC_LIBRARIES := libv4l2shim_static
+LOCAL_SHARED_LIBRARIES := libutils libcutils libui liblog libbinder libcamera_client libdl
+
+ifeq ($(BOARD_SUPPORT_SYSMMU),true)
+LOCAL_CFLAGS += -DBOARD_SUPPORT_SYSMMU
+LOCAL_C_INCLUDES += device/sec/sec_proprietary/include
+LOCAL_SHARED_LIBRARIES += libMali
+endif
+
+LOCAL_MODULE := camera_burst_bench
+include $(BUILD_EXECUTABLE)
+
+endif
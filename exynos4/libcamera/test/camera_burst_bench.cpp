@@ -0,0 +1,188 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Takes one burst through the camera HAL on the emulated sensor and
+ * reports the capture and picture rates together with how many of the
+ * compressed pictures went out in a pooled heap and how many needed a
+ * fresh one. The callback keeps the last few pictures, like a client
+ * still writing them out.
+ *
+ * usage : camera_burst_bench [pictures] [held]
+ * Returns 0 when every picture of the burst arrived.
+ */
+
+#define LOG_TAG "camera_burst_bench"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <camera/CameraHardwareInterface.h>
+#include "SecCamera.h"
+#include "sec_v4l2_shim.h"
+
+using namespace android;
+
+#define BENCH_WIDTH       (640)
+#define BENCH_HEIGHT      (480)
+#define FRAME_US          (33333)
+#define DEFAULT_PICTURES  (10)
+#define DEFAULT_HELD      (2)
+#define MAX_HELD          (8)
+#define BURST_TIMEOUT_NS  (30000000000LL)
+
+struct bench {
+    Mutex         lock;
+    Condition     cond;
+    int           held;
+    int           received;
+    size_t        bytes;
+    sp<IMemory>   pictures[MAX_HELD];
+};
+
+static void add_nodes(void)
+{
+    struct sec_v4l2_emul_config config;
+
+    memset(&config, 0, sizeof(config));
+    config.width  = BENCH_WIDTH;
+    config.height = BENCH_HEIGHT;
+    config.frame_interval_us = FRAME_US;
+
+    config.phys_base = 0x50000000;
+    sec_v4l2_emul_add_node(CAMERA_DEV_NAME,  SEC_V4L2_EMUL_CAPTURE, &config);
+    config.phys_base = 0x51000000;
+    sec_v4l2_emul_add_node("/dev/video1",    SEC_V4L2_EMUL_OUTPUT,  &config);
+    config.phys_base = 0x52000000;
+    sec_v4l2_emul_add_node(CAMERA_DEV_NAME2, SEC_V4L2_EMUL_CAPTURE, &config);
+    config.phys_base = 0x58000000;
+    sec_v4l2_emul_add_node(JPEG_DRIVER_NAME, SEC_V4L2_EMUL_JPEG,    &config);
+}
+
+static void notify_cb(int32_t msgType, int32_t ext1, int32_t ext2, void *user)
+{
+}
+
+static void data_cb(int32_t msgType, const sp<IMemory> &dataPtr, void *user)
+{
+    struct bench *b = (struct bench *)user;
+
+    if (msgType != CAMERA_MSG_COMPRESSED_IMAGE || dataPtr == NULL)
+        return;
+
+    Mutex::Autolock lock(b->lock);
+    // drops the picture taken `held` ago, its heap can go back to the pool
+    b->pictures[b->received % b->held] = dataPtr;
+    b->bytes += dataPtr->size();
+    b->received++;
+    b->cond.signal();
+}
+
+static void data_timestamp_cb(nsecs_t timestamp, int32_t msgType,
+                              const sp<IMemory> &dataPtr, void *user)
+{
+}
+
+int main(int argc, char **argv)
+{
+    struct bench b;
+    int pictures = DEFAULT_PICTURES;
+    int ret = 0;
+
+    b.held     = DEFAULT_HELD;
+    b.received = 0;
+    b.bytes    = 0;
+
+    if (1 < argc)
+        pictures = atoi(argv[1]);
+    if (2 < argc)
+        b.held = atoi(argv[2]);
+    if (pictures < 1 || BURST_MAX_PICTURES < pictures ||
+        b.held < 1 || MAX_HELD < b.held) {
+        fprintf(stderr, "usage : %s [pictures 1..%d] [held 1..%d]\n",
+                argv[0], BURST_MAX_PICTURES, MAX_HELD);
+        return 1;
+    }
+
+    add_nodes();
+    sec_v4l2_emul_install();
+
+    sp<CameraHardwareInterface> hw = HAL_openCameraHardware(0);
+    if (hw == NULL) {
+        fprintf(stderr, "%s : no camera\n", argv[0]);
+        return 1;
+    }
+
+    hw->setCallbacks(notify_cb, data_cb, data_timestamp_cb, &b);
+    hw->enableMsgType(CAMERA_MSG_COMPRESSED_IMAGE);
+
+    CameraParameters params = hw->getParameters();
+    params.setPreviewSize(BENCH_WIDTH, BENCH_HEIGHT);
+    params.setPictureSize(BENCH_WIDTH, BENCH_HEIGHT);
+    params.set("burst-capture", pictures);
+    if (hw->setParameters(params) != NO_ERROR)
+        fprintf(stderr, "%s : setParameters failed\n", argv[0]);
+
+    hw->startPreview();
+
+    nsecs_t start = systemTime();
+    hw->takePicture();
+
+    b.lock.lock();
+    while (b.received < pictures) {
+        if (b.cond.waitRelative(b.lock, BURST_TIMEOUT_NS) != NO_ERROR)
+            break;
+    }
+    int received = b.received;
+    size_t bytes = b.bytes;
+    b.lock.unlock();
+
+    nsecs_t elapsed = systemTime() - start;
+
+    params = hw->getParameters();
+    printf("pictures             : %d of %d (client holds %d)\n",
+           received, pictures, b.held);
+    printf("wall time            : %lld ms, %.1f pictures/s, %u KB/picture\n",
+           (long long)(elapsed / 1000000),
+           elapsed ? received * 1e9 / elapsed : 0.0,
+           received ? (unsigned int)(bytes / received / 1024) : 0);
+    printf("burst-capture-fps    : %s\n", params.get("burst-capture-fps"));
+    printf("burst-picture-fps    : %s\n", params.get("burst-picture-fps"));
+    printf("burst-dropped        : %d\n", params.getInt("burst-dropped"));
+    printf("jpeg-heaps-pooled    : %d\n", params.getInt("jpeg-heaps-pooled"));
+    printf("jpeg-heaps-allocated : %d\n", params.getInt("jpeg-heaps-allocated"));
+
+    if (received < pictures) {
+        fprintf(stderr, "%s : %d picture(s) missing\n", argv[0], pictures - received);
+        ret = 1;
+    }
+
+    b.lock.lock();
+    for (int i = 0; i < MAX_HELD; i++)
+        b.pictures[i].clear();
+    b.lock.unlock();
+
+    hw->stopPreview();
+    hw->release();
+    hw.clear();
+
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    return ret;
+}
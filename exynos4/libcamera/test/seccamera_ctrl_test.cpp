@@ -0,0 +1,202 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs SecCamera preview on the emulated sensor and checks the control
+ * diff : unchanged settings write nothing, changed ones go out in one
+ * VIDIOC_S_EXT_CTRLS per control class (the emulator, like the kernel,
+ * refuses a batch that mixes classes) and land with the right values.
+ * Returns 0 when every check passes.
+ */
+
+#define LOG_TAG "seccamera_ctrl_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SecCamera.h"
+#include "sec_v4l2_shim.h"
+
+using namespace android;
+
+#define TEST_WIDTH      (640)
+#define TEST_HEIGHT     (480)
+#define FRAME_US        (33333)  // 30 fps, getPreviewFrame() drains what is ready
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            g_failures++;                                               \
+        }                                                               \
+    } while (0)
+
+static void add_nodes(void)
+{
+    struct sec_v4l2_emul_config config;
+
+    memset(&config, 0, sizeof(config));
+    config.width  = TEST_WIDTH;
+    config.height = TEST_HEIGHT;
+    config.frame_interval_us = FRAME_US;
+
+    config.phys_base = 0x50000000;
+    sec_v4l2_emul_add_node(CAMERA_DEV_NAME,  SEC_V4L2_EMUL_CAPTURE, &config);
+    config.phys_base = 0x52000000;
+    sec_v4l2_emul_add_node(CAMERA_DEV_NAME2, SEC_V4L2_EMUL_CAPTURE, &config);
+    config.phys_base = 0x58000000;
+    sec_v4l2_emul_add_node(JPEG_DRIVER_NAME, SEC_V4L2_EMUL_JPEG,    &config);
+}
+
+// what the sensor driver holds now
+static int sensor_ctrl(unsigned int id)
+{
+    struct v4l2_control ctrl;
+    int fd = open(CAMERA_DEV_NAME, O_RDWR);
+
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.id = id;
+    if (fd < 0 || ioctl(fd, VIDIOC_G_CTRL, &ctrl) < 0)
+        ctrl.value = -1;
+    if (0 <= fd)
+        close(fd);
+
+    return ctrl.value;
+}
+
+// applies the pending settings, returns the control writes / ioctls it took
+static void apply(SecCamera *camera, unsigned int *writes, unsigned int *ioctls)
+{
+    unsigned int writes0, ioctls0;
+    nsecs_t timestamp;
+    int skipped;
+    int index;
+
+    camera->getCtrlStats(&writes0, &ioctls0);
+    index = camera->getPreviewFrame(&timestamp, &skipped);
+    camera->getCtrlStats(writes, ioctls);
+
+    CHECK(0 <= index);
+    if (0 <= index)
+        CHECK(camera->releasePreviewFrame(index) == 0);
+
+    *writes -= writes0;
+    *ioctls -= ioctls0;
+}
+
+static void test_unchanged(SecCamera *camera)
+{
+    unsigned int writes, ioctls;
+
+    // what setParameters() does every frame
+    CHECK(camera->setWhiteBalance(camera->getWhiteBalance()) == 0);
+    CHECK(camera->setImageEffect(camera->getImageEffect()) == 0);
+    CHECK(camera->setContrast(camera->getContrast()) == 0);
+    apply(camera, &writes, &ioctls);
+    CHECK(writes == 0);
+    CHECK(ioctls == 0);
+}
+
+static void test_one_class(SecCamera *camera)
+{
+    unsigned int writes, ioctls;
+
+    CHECK(camera->setImageEffect(SecCamera::IMAGE_EFFECT_SEPIA) == 0);
+    CHECK(camera->setContrast(SecCamera::CONTRAST_MAX) == 0);
+    CHECK(camera->setSaturation(SecCamera::SATURATION_BASE) == 0);
+    apply(camera, &writes, &ioctls);
+    CHECK(writes == 3);
+    CHECK(ioctls == 1);
+
+    CHECK(sensor_ctrl(V4L2_CID_COLORFX) == 3);
+    CHECK(sensor_ctrl(V4L2_CID_CONTRAST) == SecCamera::CONTRAST_MAX);
+    CHECK(sensor_ctrl(V4L2_CID_SATURATION) == SecCamera::SATURATION_BASE);
+}
+
+static void test_white_balance_preset(SecCamera *camera)
+{
+    unsigned int writes, ioctls;
+
+    // the sensor starts in auto white balance
+    CHECK(camera->getWhiteBalance() == SecCamera::WHITE_BALANCE_AUTO);
+
+    // auto off is a user class control, the preset a camera class one
+    CHECK(camera->setWhiteBalance(SecCamera::WHITE_BALANCE_SUNNY) == 0);
+    apply(camera, &writes, &ioctls);
+    CHECK(writes == 2);
+    CHECK(ioctls == 2);
+    CHECK(sensor_ctrl(V4L2_CID_AUTO_WHITE_BALANCE) == 0);
+    CHECK(sensor_ctrl(V4L2_CID_WHITE_BALANCE_PRESET) == 2);
+    CHECK(camera->getWhiteBalance() == SecCamera::WHITE_BALANCE_SUNNY);
+
+    // with user class controls around, still one ioctl per class
+    CHECK(camera->setWhiteBalance(SecCamera::WHITE_BALANCE_CLOUDY) == 0);
+    CHECK(camera->setImageEffect(SecCamera::IMAGE_EFFECT_MONO) == 0);
+    CHECK(camera->setSharpness(SecCamera::SHARPNESS_MAX) == 0);
+    apply(camera, &writes, &ioctls);
+    CHECK(writes == 4);
+    CHECK(ioctls == 2);
+    CHECK(sensor_ctrl(V4L2_CID_WHITE_BALANCE_PRESET) == 3);
+    CHECK(sensor_ctrl(V4L2_CID_COLORFX) == 1);
+    CHECK(sensor_ctrl(V4L2_CID_SHARPNESS) == SecCamera::SHARPNESS_MAX);
+
+    // back to auto : the auto control alone
+    CHECK(camera->setWhiteBalance(SecCamera::WHITE_BALANCE_AUTO) == 0);
+    apply(camera, &writes, &ioctls);
+    CHECK(writes == 1);
+    CHECK(ioctls == 1);
+    CHECK(sensor_ctrl(V4L2_CID_AUTO_WHITE_BALANCE) == 1);
+
+    // nothing left over
+    apply(camera, &writes, &ioctls);
+    CHECK(writes == 0);
+    CHECK(ioctls == 0);
+}
+
+int main(int argc, char **argv)
+{
+    add_nodes();
+    sec_v4l2_emul_install();
+
+    SecCamera *camera = new SecCamera();
+
+    CHECK(camera->Create(SecCamera::CAMERA_ID_BACK) == 0);
+    CHECK(camera->setPreviewSize(TEST_WIDTH, TEST_HEIGHT, V4L2_PIX_FMT_NV21) == 0);
+    CHECK(camera->startPreview() == 0);
+
+    test_unchanged(camera);
+    test_one_class(camera);
+    test_white_balance_preset(camera);
+
+    CHECK(camera->stopPreview() == 0);
+    camera->Destroy();
+    delete camera;
+
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}
@@ -36,6 +36,11 @@ LOCAL_C_INCLUDES := \
 		$(LOCAL_PATH)/../include \
 		framework/base/include
 
+ifeq ($(BOARD_USES_V4L2_SHIM),true)
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM
+LOCAL_SHARED_LIBRARIES += libv4l2shim
+endif
+
 LOCAL_MODULE_TAGS := eng
 LOCAL_MODULE := libfimc
 include $(BUILD_SHARED_LIBRARY)
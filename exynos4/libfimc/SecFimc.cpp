@@ -26,6 +26,7 @@
 #include <errno.h>
 
 #include "SecFimc.h"
+#include "sec_v4l2_shim.h"
 
 #undef BOARD_SUPPORT_SYSMMU
 
@@ -160,6 +160,35 @@ SYNC_DONE :
     return ret;
 }
 
+bool FimgApi::StretchAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                           unsigned int * fence)
+{
+    // don't take t_Lock() here.
+    // it is held while the blit runs, and this must not wait for that.
+    if(m_flagCreate == false) {
+        PRINT("%s::This is not Created fail \n", __func__);
+        return false;
+    }
+
+    if(t_StretchAsync(src, dst, clip, flag, fence) == false)
+        return false;
+
+    return true;
+}
+
+bool FimgApi::Sync(unsigned int fence)
+{
+    if(m_flagCreate == false) {
+        PRINT("%s::This is not Created fail \n", __func__);
+        return false;
+    }
+
+    if(t_SyncFence(fence) == false)
+        return false;
+
+    return true;
+}
+
 bool FimgApi::t_Create(void)
 {
     PRINT("%s::This is empty virtual function fail\n", __func__);
@@ -184,6 +213,19 @@ bool FimgApi::t_Sync(void)
     return false;
 }
 
+bool FimgApi::t_StretchAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                             unsigned int * fence)
+{
+    PRINT("%s::This is empty virtual function fail\n", __func__);
+    return false;
+}
+
+bool FimgApi::t_SyncFence(unsigned int fence)
+{
+    PRINT("%s::This is empty virtual function fail\n", __func__);
+    return false;
+}
+
 bool FimgApi::t_Lock(void)
 {
     PRINT("%s::This is empty virtual function fail\n", __func__);
@@ -243,3 +285,40 @@ extern "C" int SyncFimgApi(void)
     return 0;
 }
 
+extern "C" int stretchFimgApiAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                                   unsigned int * fence)
+{
+    FimgApi * fimgApi = createFimgApi();
+
+    if(fimgApi == NULL) {
+        PRINT("%s::createFimgApi() fail \n", __func__);
+        return -1;
+    }
+
+    if(fimgApi->StretchAsync(src, dst, clip, flag, fence) == false) {
+        destroyFimgApi(fimgApi);
+        return -1;
+    }
+
+    destroyFimgApi(fimgApi);
+
+    return 0;
+}
+
+extern "C" int SyncFimgApiFence(unsigned int fence)
+{
+    FimgApi * fimgApi = createFimgApi();
+    if(fimgApi == NULL) {
+        PRINT("%s::createFimgApi() fail \n", __func__);
+        return -1;
+    }
+
+    if(fimgApi->Sync(fence) == false) {
+        destroyFimgApi(fimgApi);
+        return -1;
+    }
+
+    destroyFimgApi(fimgApi);
+
+    return 0;
+}
@@ -197,11 +197,23 @@ public:
     bool        Stretch(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag);
     bool	    Sync(void);
 
+    // queue the blit and return at once.
+    // *fence is the token to pass to Sync(fence).
+    // src/dst memory must stay valid until the fence is signaled.
+    // Sync(fence) reports a failed blit only for the last
+    // FIMG_FENCE_HISTORY fences, older ones count as done.
+    bool        StretchAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                             unsigned int * fence);
+    bool        Sync(unsigned int fence);
+
 protected:
     virtual bool t_Create(void);
     virtual bool t_Destroy(void);
     virtual bool t_Stretch(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag);
     virtual bool t_Sync(void);
+    virtual bool t_StretchAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                                unsigned int * fence);
+    virtual bool t_SyncFence(unsigned int fence);
     virtual bool t_Lock(void);
     virtual bool t_UnLock(void);
 
@@ -218,6 +230,12 @@ protected:
 //
 // usage 2
 // stretchFimgApi(src, dst, clip, flag);
+//
+// usage 3
+// unsigned int fence;
+// stretchFimgApiAsync(src, dst, clip, flag, &fence);
+// ... (cpu work)
+// SyncFimgApiFence(fence);
 //---------------------------------------------------------------------------//
 #ifdef __cplusplus
 extern "C" 
@@ -241,4 +259,17 @@ extern "C"
 #endif
 int              SyncFimgApi(void);
 
+#ifdef __cplusplus
+extern "C"
+#endif
+int              stretchFimgApiAsync(FimgRect * src,
+                                     FimgRect * dst,
+                                     FimgClip * clip,
+                                     FimgFlag * flag,
+                                     unsigned int * fence);
+#ifdef __cplusplus
+extern "C"
+#endif
+int              SyncFimgApiFence(unsigned int fence);
+
 #endif //FIMG_API_H
@@ -37,6 +37,8 @@ Mutex      FimgC210::m_instanceLock;
 int        FimgC210::m_curFimgC210Index = 0;
 int        FimgC210::m_numOfInstance    = 0;
 FimgApi *  FimgC210::m_ptrFimgApiList[NUMBER_FIMG_LIST] = {NULL, };
+unsigned int FimgC210::m_asyncLastFence = 0;
+FimgC210FenceStatus FimgC210::m_asyncFenceStatus[FIMG_FENCE_HISTORY] = {{0, false}, };
 
 //---------------------------------------------------------------------------//	
 
@@ -47,7 +49,13 @@ FimgC210::FimgC210()
            m_g2dSrcVirtAddr(NULL),
            m_g2dSrcSize(0),
            m_g2dDstVirtAddr(NULL),
-           m_g2dDstSize(0)
+           m_g2dDstSize(0),
+           m_asyncThread(NULL),
+           m_asyncExit(false),
+           m_asyncHead(0),
+           m_asyncNum(0),
+           m_asyncSubmitFence(m_asyncLastFence),
+           m_asyncDoneFence(m_asyncLastFence)
 {
     m_lock = new Mutex(Mutex::SHARED, "FimgC210");
 }
@@ -153,6 +161,11 @@ bool FimgC210::t_Destroy(void)
 {
     bool ret = true;
 
+    if(m_StopAsync() == false) {
+        PRINT("%s::m_StopAsync() fail \n", __func__);
+        ret = false;
+    }
+
     if(m_DestroyG2D() == false) {
         PRINT("%s::m_DestroyG2D() fail \n", __func__);
         ret = false;
@@ -171,17 +184,25 @@ bool FimgC210::t_Stretch(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFl
         int          stopWatchIndex = 0;
     #endif // CHECK_FIMGC210_PERFORMANCE
 
-    if(m_DoG2D(src, dst, clip, flag) == false) {
-        goto STRETCH_FAIL;        
-    }
+    // keep submission order against queued async blits
+    if(m_WaitFence(m_asyncSubmitFence) == false)
+        PRINT("%s::m_WaitFence() fail\n", __func__);
 
-#ifdef G2D_NONE_BLOCKING_MODE
-    if(m_PollG2D(&m_g2dPoll) == false)
     {
-        PRINT("%s::m_PollG2D() fail\n", __func__);
-        goto STRETCH_FAIL;  
-    }
+        Mutex::Autolock autolock(m_hwLock);
+
+        if(m_DoG2D(src, dst, clip, flag) == false) {
+            goto STRETCH_FAIL;
+        }
+
+#ifdef G2D_NONE_BLOCKING_MODE
+        if(m_PollG2D(&m_g2dPoll) == false)
+        {
+            PRINT("%s::m_PollG2D() fail\n", __func__);
+            goto STRETCH_FAIL;
+        }
 #endif
+    }
 
     #ifdef CHECK_FIMGC210_PERFORMANCE
         m_PrintFimgC210Performance(src, dst, stopWatchIndex, stopWatchName, stopWatchTime);
@@ -196,6 +217,11 @@ STRETCH_FAIL:
 
 bool FimgC210::t_Sync(void)
 {
+    if(m_WaitFence(m_asyncSubmitFence) == false) {
+        PRINT("%s::m_WaitFence() fail\n", __func__);
+        goto SYNC_FAIL;
+    }
+
 #if 0
     if(ioctl(m_g2dFd, G2D_SYNC) < 0) {
         PRINT("%s::G2D_Sync fail\n", __func__);
@@ -215,6 +241,74 @@ SYNC_FAIL:
 
 }
 
+bool FimgC210::t_StretchAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                              unsigned int * fence)
+{
+    if(m_StartAsync() == false) {
+        PRINT("%s::m_StartAsync() fail\n", __func__);
+        return false;
+    }
+
+    Mutex::Autolock autolock(m_asyncLock);
+
+    // back-pressure : wait for a free slot
+    while(FIMG_ASYNC_QUEUE_DEPTH <= m_asyncNum) {
+        if(m_asyncDoneCond.waitRelative(m_asyncLock, ms2ns(G2D_POLL_TIME)) != NO_ERROR) {
+            PRINT("%s::no free slot in %d milli secs..\n", __func__, G2D_POLL_TIME);
+            return false;
+        }
+    }
+
+    // fence 0 means "nothing", skip it on wrap-around
+    m_asyncSubmitFence++;
+    if(m_asyncSubmitFence == 0)
+        m_asyncSubmitFence++;
+
+    FimgC210AsyncJob * job = &m_asyncQueue[(m_asyncHead + m_asyncNum) % FIMG_ASYNC_QUEUE_DEPTH];
+
+    memcpy(&job->src, src, sizeof(FimgRect));
+    memcpy(&job->dst, dst, sizeof(FimgRect));
+    memcpy(&job->clip, clip, sizeof(FimgClip));
+    memcpy(&job->flag, flag, sizeof(FimgFlag));
+    job->fence = m_asyncSubmitFence;
+
+    m_asyncNum++;
+
+    if(fence != NULL)
+        *fence = m_asyncSubmitFence;
+
+    m_asyncSubmitCond.signal();
+
+    return true;
+}
+
+bool FimgC210::t_SyncFence(unsigned int fence)
+{
+    if(m_WaitFence(fence) == false) {
+        PRINT("%s::m_WaitFence(%d) fail\n", __func__, fence);
+        return false;
+    }
+
+    if(fence == 0)
+        return true;
+
+    Mutex::Autolock autolock(m_asyncLock);
+
+    FimgC210FenceStatus * status = &m_asyncFenceStatus[fence % FIMG_FENCE_HISTORY];
+
+    // a later fence took the slot : the blit finished long ago and
+    // callers only wait on recent fences, so count it as done
+    if(status->fence != fence)
+        return true;
+
+    if(status->ok == false) {
+        PRINT("%s::blit of fence(%d) fail\n", __func__, fence);
+        return false;
+    }
+
+    return true;
+}
+
 bool FimgC210::t_Lock(void)
 {
     m_lock->lock();
@@ -270,6 +364,123 @@ bool FimgC210::m_DestroyG2D(void)
     return true;
 }
 
+bool FimgC210::m_StartAsync(void)
+{
+    Mutex::Autolock autolock(m_asyncLock);
+
+    if(m_asyncThread != NULL)
+        return true;
+
+    m_asyncExit = false;
+    m_asyncThread = new AsyncThread(this);
+
+    if(m_asyncThread->run("FimgC210AsyncThread", PRIORITY_URGENT_DISPLAY) != NO_ERROR) {
+        PRINT("%s::run(FimgC210AsyncThread) fail\n", __func__);
+        m_asyncThread = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool FimgC210::m_StopAsync(void)
+{
+    sp<AsyncThread> thread;
+
+    {
+        Mutex::Autolock autolock(m_asyncLock);
+
+        m_asyncLastFence = m_asyncSubmitFence;
+
+        if(m_asyncThread == NULL)
+            return true;
+
+        // the thread drains the queue before it exits
+        m_asyncExit = true;
+        m_asyncSubmitCond.signal();
+
+        thread = m_asyncThread;
+        m_asyncThread = NULL;
+    }
+
+    thread->requestExitAndWait();
+
+    return true;
+}
+
+bool FimgC210::m_AsyncThreadLoop(void)
+{
+    FimgC210AsyncJob job;
+    bool             ret = true;
+
+    {
+        Mutex::Autolock autolock(m_asyncLock);
+
+        while(m_asyncNum == 0) {
+            if(m_asyncExit == true)
+                return false;
+
+            m_asyncSubmitCond.wait(m_asyncLock);
+        }
+
+        job = m_asyncQueue[m_asyncHead];
+    }
+
+    {
+        Mutex::Autolock autolock(m_hwLock);
+
+        if(m_DoG2D(&job.src, &job.dst, &job.clip, &job.flag) == false) {
+            PRINT("%s::m_DoG2D(fence %d) fail\n", __func__, job.fence);
+            ret = false;
+        }
+
+#ifdef G2D_NONE_BLOCKING_MODE
+        if(ret == true && m_PollG2D(&m_g2dPoll) == false) {
+            PRINT("%s::m_PollG2D(fence %d) fail\n", __func__, job.fence);
+            ret = false;
+        }
+#endif
+    }
+
+    {
+        Mutex::Autolock autolock(m_asyncLock);
+
+        m_asyncHead = (m_asyncHead + 1) % FIMG_ASYNC_QUEUE_DEPTH;
+        m_asyncNum--;
+
+        m_asyncDoneFence = job.fence;
+        m_asyncFenceStatus[job.fence % FIMG_FENCE_HISTORY].fence = job.fence;
+        m_asyncFenceStatus[job.fence % FIMG_FENCE_HISTORY].ok    = ret;
+
+        m_asyncDoneCond.broadcast();
+    }
+
+    return true;
+}
+
+bool FimgC210::m_WaitFence(unsigned int fence)
+{
+    Mutex::Autolock autolock(m_asyncLock);
+
+    if(fence == 0)
+        return true;
+
+    // fences are issued in order, so compare with wrap-around.
+    if(0 < (int)(fence - m_asyncSubmitFence)) {
+        PRINT("%s::fence(%d) was never issued (last %d)\n", __func__, fence, m_asyncSubmitFence);
+        return false;
+    }
+
+    while((int)(m_asyncDoneFence - fence) < 0) {
+        if(m_asyncDoneCond.waitRelative(m_asyncLock, ms2ns(G2D_POLL_TIME)) != NO_ERROR) {
+            PRINT("%s::fence(%d) not done in %d milli secs..\n", __func__, fence, G2D_POLL_TIME);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 //bool FimgC210::m_DoG2D(FimgRect * src, FimgRect * dst, int rotateValue, int alphaValue, int colorKey)
 bool FimgC210::m_DoG2D(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag)
 {
@@ -315,8 +526,6 @@ bool FimgC210::m_DoG2D(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag
 
 inline bool FimgC210::m_PollG2D(struct pollfd * events)
 {
-    #define G2D_POLL_TIME (1000)
-
     int ret;
 
     ret = poll(events, 1, G2D_POLL_TIME);
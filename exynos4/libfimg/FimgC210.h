@@ -54,17 +54,54 @@ namespace android
 //#define CHECK_FIMGC210_CRITICAL_PERFORMANCE
 #define NUMBER_FIMG_LIST           (1)  // kcoolsw : because of pmem
 //#define G2D_NONE_BLOCKING_MODE        // Not supported yet. because of sysMMU Page fault
+#define FIMG_ASYNC_QUEUE_DEPTH     (4)  // max outstanding StretchAsync() blits
+#define FIMG_FENCE_HISTORY         (64) // finished fences whose failure Sync(fence) can report
+#define G2D_POLL_TIME              (1000) // milli secs
 #define GET_RECT_SIZE(rect)        ((rect->full_w) * (rect->h) * (rect->bytes_per_pixel))
 #define GET_REAL_SIZE(rect)        ((rect->full_w) * (rect->h) * (rect->bytes_per_pixel))
 #define GET_START_ADDR(rect)        (rect->virt_addr + ((rect->y * rect->full_w) * rect->bytes_per_pixel))
 
 
+//---------------------------------------------------------------------------//
+// struct FimgC210AsyncJob
+//---------------------------------------------------------------------------//
+struct FimgC210AsyncJob {
+    FimgRect     src;
+    FimgRect     dst;
+    FimgClip     clip;
+    FimgFlag     flag;
+    unsigned int fence;
+};
+
+struct FimgC210FenceStatus {
+    unsigned int fence;   // 0 : slot never used
+    bool         ok;
+};
+
 //---------------------------------------------------------------------------//
 // class FimgC210 : public FimgBase
 //---------------------------------------------------------------------------//
 class FimgC210 : public FimgApi
 {
 private :
+    class AsyncThread : public Thread
+    {
+        private:
+            FimgC210 * mFimgC210;
+
+        public:
+            AsyncThread(FimgC210 * fimgC210)
+                : Thread(false),
+                  mFimgC210(fimgC210)
+                  { }
+
+            virtual bool threadLoop()
+            {
+                return mFimgC210->m_AsyncThreadLoop();
+            }
+    };
+    friend class AsyncThread;
+
     int              m_g2dFd;
 
     unsigned char *  m_g2dVirtAddr;
@@ -82,7 +119,29 @@ private :
     static int       m_numOfInstance;
 
     static FimgApi * m_ptrFimgApiList[NUMBER_FIMG_LIST];
-    
+
+    // async submission queue
+    // a job stays in its slot until the blit is done,
+    // so m_asyncNum is the number of outstanding blits.
+    Mutex            m_hwLock;    // held around each G2D_BLIT (+ poll)
+    Mutex            m_asyncLock;
+    Condition        m_asyncSubmitCond;
+    Condition        m_asyncDoneCond;
+    sp<AsyncThread>  m_asyncThread;
+    bool             m_asyncExit;
+    FimgC210AsyncJob m_asyncQueue[FIMG_ASYNC_QUEUE_DEPTH];
+    int              m_asyncHead;
+    int              m_asyncNum;
+    unsigned int     m_asyncSubmitFence;
+    unsigned int     m_asyncDoneFence;
+
+    // keeps fences monotonic when the instance is freed and re-created
+    static unsigned int m_asyncLastFence;
+    // result of each finished fence, slot fence % FIMG_FENCE_HISTORY.
+    // static like m_asyncLastFence, written under m_asyncLock of the
+    // only instance (NUMBER_FIMG_LIST)
+    static FimgC210FenceStatus m_asyncFenceStatus[FIMG_FENCE_HISTORY];
+
 
 protected :
     FimgC210();
@@ -98,6 +157,9 @@ protected:
     virtual bool     t_Destroy(void);
     virtual bool     t_Stretch(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag);
     virtual bool     t_Sync(void);
+    virtual bool     t_StretchAsync(FimgRect * src, FimgRect * dst, FimgClip * clip, FimgFlag * flag,
+                                    unsigned int * fence);
+    virtual bool     t_SyncFence(unsigned int fence);
     virtual bool     t_Lock(void);
     virtual bool     t_UnLock(void);
 
@@ -110,6 +172,11 @@ private:
 
     inline bool      m_PollG2D(struct pollfd * events);
 
+    bool             m_StartAsync(void);
+    bool             m_StopAsync(void);
+    bool             m_AsyncThreadLoop(void);
+    bool             m_WaitFence(unsigned int fence);
+
     inline bool      m_CleanG2D  (unsigned int addr, unsigned int size);
     inline bool      m_FlushG2D  (unsigned int addr, unsigned int size);
 
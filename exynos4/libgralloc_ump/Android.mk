@@ -36,6 +36,7 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
 LOCAL_SRC_FILES := \
 	gralloc_module.cpp \
 	alloc_device.cpp \
+	fimc_pool.cpp \
 	framebuffer_device.cpp
 
 LOCAL_MODULE_TAGS := eng
@@ -45,6 +46,9 @@ LOCAL_MODULE := gralloc.$(TARGET_BOARD_PLATFORM)
 LOCAL_CFLAGS := -DLOG_TAG=\"gralloc\"
 
 LOCAL_CFLAGS += -DSLSI_S5PC210
+ifneq ($(BOARD_FIMC1_RESERVED_MEM_SIZE),)
+LOCAL_CFLAGS += -DFIMC1_RESERVED_MEM_SIZE=$(BOARD_FIMC1_RESERVED_MEM_SIZE)
+endif
 ifeq ($(BOARD_CACHEABLE_UMP),true)
 LOCAL_CFLAGS += -DSLSI_S5PC210_CACHE_UMP
 endif
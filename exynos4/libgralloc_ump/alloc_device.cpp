@@ -61,13 +61,9 @@
 #include <pixelflinger/format.h>
 #endif
 
-#include <linux/videodev2.h>
-#include "s5p_fimc.h"
-
-#define PFX_NODE_FIMC1   "/dev/video1"
+#include "fimc_pool.h"
 
 static pthread_mutex_t l_surface= PTHREAD_MUTEX_INITIALIZER;
-static bool buffer_oridring=false;
 
 static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage, buffer_handle_t* pHandle)
 {
@@ -78,49 +74,18 @@ static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage, buf
 	size = round_up_to_page_size(size);
 
 	if(usage & GRALLOC_USAGE_HW_FIMC1) {
-		//LOGI("gralloc_alloc_buffer:alloc for FIMC[%x,%x] size:%d from PMEM",usage,GRALLOC_USAGE_HW_FIMC1,size);
-		int dev_fd=0;
-		char node[20];
+		unsigned int paddr = 0;
 		int ret;
-		int paddr=0;
-		int offset=0;
-
-		struct v4l2_control     vc;
-		sprintf(node, "%s", PFX_NODE_FIMC1);
-
-		/* open device file */
-		if(dev_fd == 0) {
-			dev_fd = open(node, O_RDWR);
 
-			if(dev_fd < 0) {
-				LOGE("%s:: %s Post processor open error\n", __func__, node);
-				return false;
-			}
-		}
-
-
-		vc.id = V4L2_CID_RESERVED_MEM_BASE_ADDR;
-		vc.value = 0;
-
-		ret = ioctl(dev_fd, VIDIOC_G_CTRL, &vc);
+		ret = fimc_pool_alloc(size, &paddr);
 		if (ret < 0) {
-			LOGE("Error in video VIDIOC_G_CTRL - V4L2_CID_RESERVED_MEM_BAES_ADDR (%d)\n", ret);
-			return false;
+			LOGE("gralloc_alloc_buffer() failed to allocate %d bytes from FIMC1 pool", size);
+			fimc_pool_dump();
+			return ret;
 		}
 
-		paddr = (unsigned int)vc.value;
-
-		close(dev_fd);
-
-		if(buffer_oridring) {
-			paddr+=800*480*4;
-			buffer_oridring=false;
-		} else
-			buffer_oridring=true;
-
 		private_handle_t* hnd = new private_handle_t(private_handle_t::PRIV_FLAGS_USES_IOCTL, size, paddr,
 				                                             private_handle_t::LOCK_STATE_MAPPED, 0, 0);
-		//LOGI("gralloc_alloc_buffer() success to allocate handle.. from fimc[%d(%d)][%d]",dev_fd,hnd->pmem_fd,hnd->size);
 
 		*pHandle = hnd;
 		return 0;
@@ -129,10 +94,13 @@ static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage, buf
     else
     {
 
+	int priv_flags = private_handle_t::PRIV_FLAGS_USES_UMP;
+
 #ifdef SLSI_S5PC210_CACHE_UMP
-	if((usage&GRALLOC_USAGE_SW_READ_MASK)==GRALLOC_USAGE_SW_READ_OFTEN)
+	if((usage&GRALLOC_USAGE_SW_READ_MASK)==GRALLOC_USAGE_SW_READ_OFTEN) {
 		ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_USE_CACHE);
-	else
+		priv_flags |= private_handle_t::PRIV_FLAGS_USES_CACHE;
+	} else
 		ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_NONE);
 #else
 		ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_NONE);
@@ -147,7 +115,7 @@ static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage, buf
 				ump_id = ump_secure_id_get(ump_mem_handle);
 				if (UMP_INVALID_SECURE_ID != ump_id)
 				{
-					private_handle_t* hnd = new private_handle_t(private_handle_t::PRIV_FLAGS_USES_UMP, size, (int)cpu_ptr,
+					private_handle_t* hnd = new private_handle_t(priv_flags, size, (int)cpu_ptr,
 					                                             private_handle_t::LOCK_STATE_MAPPED, ump_id, ump_mem_handle);
 					if (NULL != hnd)
 					{
@@ -255,6 +223,7 @@ static int alloc_device_alloc(alloc_device_t* dev, int w, int h, int format, int
 
 	size_t size;
 	size_t stride;
+	size_t stride_bytes = 0; // 0 for planar formats
 	if (format == HAL_PIXEL_FORMAT_YCbCr_420_SP ||
 	    format == HAL_PIXEL_FORMAT_YCbCr_422_SP ||
 		format == GGL_PIXEL_FORMAT_L_8)
@@ -304,6 +273,7 @@ static int alloc_device_alloc(alloc_device_t* dev, int w, int h, int format, int
 		size_t bpr = (w*bpp + (align-1)) & ~(align-1);
 		size = bpr * h;
 		stride = bpr / bpp;
+		stride_bytes = bpr;
 	}
 
 	int err;
@@ -323,6 +293,13 @@ static int alloc_device_alloc(alloc_device_t* dev, int w, int h, int format, int
 		return err;
 	}
 
+	// lets gralloc_lock() track the dirty rows of cached buffers
+	private_handle_t* hnd = (private_handle_t*)*pHandle;
+	if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP)
+	{
+		hnd->stride_bytes = stride_bytes;
+	}
+
 	*pStride = stride;
 	return 0;
 }
@@ -351,6 +328,10 @@ static int alloc_device_free(alloc_device_t* dev, buffer_handle_t handle)
 		ump_mapped_pointer_release((ump_handle)hnd->ump_mem_handle);
 		ump_reference_release((ump_handle)hnd->ump_mem_handle);
 	}
+	else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_IOCTL)
+	{
+		fimc_pool_free((unsigned int)hnd->base);
+	}
 	pthread_mutex_unlock(&l_surface);
 	delete hnd;
 
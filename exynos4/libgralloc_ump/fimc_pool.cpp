@@ -0,0 +1,232 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+#include <cutils/log.h>
+
+#include <linux/videodev2.h>
+#include "s5p_fimc.h"
+
+#include "gralloc_helper.h"
+#include "fimc_pool.h"
+
+#define PFX_NODE_FIMC1   "/dev/video1"
+
+struct fimc_pool_block_t
+{
+	unsigned int offset;
+	unsigned int size;
+	int          used;
+};
+
+struct fimc_pool_t
+{
+	pthread_mutex_t   lock;
+	unsigned int      base;       // physical base, read once from the driver
+	int               numBlocks;  // blocks are sorted by offset and cover the region
+	fimc_pool_block_t blocks[FIMC_POOL_MAX_BLOCKS];
+
+	unsigned int      usedBytes;
+	unsigned int      peakBytes;
+	unsigned int      numAlloc;
+	unsigned int      numFree;
+	unsigned int      numFail;    // requests that found no fitting block
+};
+
+static fimc_pool_t s_pool = { PTHREAD_MUTEX_INITIALIZER, 0, 0, };
+
+static int fimc_pool_init_locked(void)
+{
+	struct v4l2_control vc;
+	int dev_fd;
+
+	if (s_pool.base != 0)
+	{
+		return 0;
+	}
+
+	dev_fd = open(PFX_NODE_FIMC1, O_RDWR);
+	if (dev_fd < 0)
+	{
+		LOGE("%s:: %s Post processor open error\n", __func__, PFX_NODE_FIMC1);
+		return -ENODEV;
+	}
+
+	vc.id = V4L2_CID_RESERVED_MEM_BASE_ADDR;
+	vc.value = 0;
+
+	if (ioctl(dev_fd, VIDIOC_G_CTRL, &vc) < 0)
+	{
+		LOGE("Error in video VIDIOC_G_CTRL - V4L2_CID_RESERVED_MEM_BAES_ADDR\n");
+		close(dev_fd);
+		return -EIO;
+	}
+
+	close(dev_fd);
+
+	s_pool.base = (unsigned int)vc.value;
+	s_pool.numBlocks = 1;
+	s_pool.blocks[0].offset = 0;
+	s_pool.blocks[0].size   = FIMC1_RESERVED_MEM_SIZE;
+	s_pool.blocks[0].used   = 0;
+
+	LOGI("%s:: FIMC1 reserved memory 0x%08x, %d bytes\n", __func__, s_pool.base, FIMC1_RESERVED_MEM_SIZE);
+
+	return 0;
+}
+
+static void fimc_pool_remove_block_locked(int index)
+{
+	memmove(&s_pool.blocks[index], &s_pool.blocks[index + 1],
+	        (s_pool.numBlocks - index - 1) * sizeof(fimc_pool_block_t));
+	s_pool.numBlocks--;
+}
+
+int fimc_pool_alloc(size_t size, unsigned int* paddr)
+{
+	int best = -1;
+	int ret;
+
+	size = round_up_to_page_size(size);
+
+	pthread_mutex_lock(&s_pool.lock);
+
+	ret = fimc_pool_init_locked();
+	if (ret < 0)
+	{
+		pthread_mutex_unlock(&s_pool.lock);
+		return ret;
+	}
+
+	// best fit : the smallest free block that is big enough
+	for (int i = 0; i < s_pool.numBlocks; i++)
+	{
+		fimc_pool_block_t* block = &s_pool.blocks[i];
+
+		if (block->used || block->size < size)
+		{
+			continue;
+		}
+
+		if (best < 0 || block->size < s_pool.blocks[best].size)
+		{
+			best = i;
+		}
+	}
+
+	// a split needs one more block slot
+	if (best < 0 ||
+	    (s_pool.blocks[best].size != size && FIMC_POOL_MAX_BLOCKS <= s_pool.numBlocks))
+	{
+		s_pool.numFail++;
+		LOGE("%s:: FIMC1 pool exhausted (request %d, used %d/%d, fail %d)\n",
+		     __func__, size, s_pool.usedBytes, FIMC1_RESERVED_MEM_SIZE, s_pool.numFail);
+		pthread_mutex_unlock(&s_pool.lock);
+		return -ENOMEM;
+	}
+
+	if (s_pool.blocks[best].size != size)
+	{
+		memmove(&s_pool.blocks[best + 1], &s_pool.blocks[best],
+		        (s_pool.numBlocks - best) * sizeof(fimc_pool_block_t));
+		s_pool.numBlocks++;
+
+		s_pool.blocks[best + 1].offset = s_pool.blocks[best].offset + size;
+		s_pool.blocks[best + 1].size   = s_pool.blocks[best].size - size;
+		s_pool.blocks[best + 1].used   = 0;
+		s_pool.blocks[best].size       = size;
+	}
+
+	s_pool.blocks[best].used = 1;
+
+	s_pool.usedBytes += size;
+	if (s_pool.peakBytes < s_pool.usedBytes)
+	{
+		s_pool.peakBytes = s_pool.usedBytes;
+	}
+	s_pool.numAlloc++;
+
+	*paddr = s_pool.base + s_pool.blocks[best].offset;
+
+	pthread_mutex_unlock(&s_pool.lock);
+
+	return 0;
+}
+
+void fimc_pool_free(unsigned int paddr)
+{
+	int i;
+
+	pthread_mutex_lock(&s_pool.lock);
+
+	for (i = 0; i < s_pool.numBlocks; i++)
+	{
+		if (s_pool.blocks[i].used && s_pool.base + s_pool.blocks[i].offset == paddr)
+		{
+			break;
+		}
+	}
+
+	if (i == s_pool.numBlocks)
+	{
+		LOGE("%s:: 0x%08x is not allocated from the FIMC1 pool\n", __func__, paddr);
+		pthread_mutex_unlock(&s_pool.lock);
+		return;
+	}
+
+	s_pool.blocks[i].used = 0;
+	s_pool.usedBytes -= s_pool.blocks[i].size;
+	s_pool.numFree++;
+
+	// merge with the next free block
+	if (i + 1 < s_pool.numBlocks && !s_pool.blocks[i + 1].used)
+	{
+		s_pool.blocks[i].size += s_pool.blocks[i + 1].size;
+		fimc_pool_remove_block_locked(i + 1);
+	}
+
+	// merge with the previous free block
+	if (0 < i && !s_pool.blocks[i - 1].used)
+	{
+		s_pool.blocks[i - 1].size += s_pool.blocks[i].size;
+		fimc_pool_remove_block_locked(i);
+	}
+
+	pthread_mutex_unlock(&s_pool.lock);
+}
+
+void fimc_pool_dump(void)
+{
+	pthread_mutex_lock(&s_pool.lock);
+
+	LOGI("FIMC1 pool: base 0x%08x, used %d/%d bytes (peak %d), alloc %d, free %d, fail %d\n",
+	     s_pool.base, s_pool.usedBytes, FIMC1_RESERVED_MEM_SIZE, s_pool.peakBytes,
+	     s_pool.numAlloc, s_pool.numFree, s_pool.numFail);
+
+	for (int i = 0; i < s_pool.numBlocks; i++)
+	{
+		LOGI("  [%2d] 0x%08x %8d %s\n", i, s_pool.base + s_pool.blocks[i].offset,
+		     s_pool.blocks[i].size, s_pool.blocks[i].used ? "used" : "free");
+	}
+
+	pthread_mutex_unlock(&s_pool.lock);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIMC_POOL_H_
+#define FIMC_POOL_H_
+
+#include <stddef.h>
+
+// Size of the FIMC1 reserved memory handed out to GRALLOC_USAGE_HW_FIMC1 buffers.
+// The driver only reports the base address, so the size comes from the board.
+#ifndef FIMC1_RESERVED_MEM_SIZE
+#define FIMC1_RESERVED_MEM_SIZE  (800 * 480 * 4 * 2)
+#endif
+
+// Upper bound of blocks (free and used) the region can be split into
+#define FIMC_POOL_MAX_BLOCKS     (32)
+
+// Best-fit allocation from the FIMC1 reserved region.
+// Returns 0 and the physical address in *paddr, or a negative errno.
+int  fimc_pool_alloc(size_t size, unsigned int* paddr);
+
+// Give a block back to the pool, merging it with free neighbours.
+void fimc_pool_free(unsigned int paddr);
+
+// Log the block list and the usage / exhaustion counters.
+void fimc_pool_dump(void);
+
+#endif /* FIMC_POOL_H_ */
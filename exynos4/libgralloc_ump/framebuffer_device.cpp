@@ -11,6 +11,7 @@
  *    * init_frame_buffer()
  *    * fb_close()
  *    * framebuffer_device_open()
+ *    * vsync thread
  *
  * Copyright (C) 2008 The Android Open Source Project
  *
@@ -30,6 +31,9 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/fb.h>
 
@@ -46,11 +50,227 @@
 // numbers of buffers for page flipping
 #define NUM_BUFFERS 2
 
+#define FBIO_WAITFORVSYNC       _IOW('F', 0x20, __u32)
+#define S3CFB_SET_VSYNC_INT	_IOW('F', 206, unsigned int)
+
+// the vsync interrupt is turned off after this long without a post
+#define VSYNC_IDLE_NS           (500000000LL)
+#define VSYNC_STATS_PERIOD      (600)   // flips between two stats dumps
+
+// fb_post() returns right after the pan request when this is defined.
+// Only safe when the compositor doesn't draw into the previous front
+// buffer before the next vsync, so by default fb_post() still returns
+// once the flip is on screen (but without any ioctl of its own).
+//#define FB_POST_ASYNC
+
 enum
 {
 	PAGE_FLIP = 0x00000001,
 };
 
+struct vsync_state_t
+{
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	int             fd;
+	bool            running;
+	bool            exit;
+	bool            intEnabled;
+
+	int64_t         period;
+	int64_t         lastVsync;
+	int64_t         lastPost;
+
+	bool            flipPending;
+	int64_t         flipRequest;
+
+	unsigned int    numFlips;
+	unsigned int    numMissed;      // vsyncs the compositor didn't post for
+	int64_t         latencySum;     // flip request -> vsync
+	int64_t         latencyMax;
+};
+
+static vsync_state_t s_vsync = { 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, -1, };
+
+static int64_t vsync_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return int64_t(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+
+static void vsync_set_interrupt_locked(bool enable)
+{
+	int interrupt = enable ? 1 : 0;
+
+	if (s_vsync.intEnabled == enable)
+	{
+		return;
+	}
+
+	if (ioctl(s_vsync.fd, S3CFB_SET_VSYNC_INT, &interrupt) < 0)
+	{
+		LOGE("S3CFB_SET_VSYNC_INT %s failed", enable ? "enable" : "disable");
+	}
+
+	s_vsync.intEnabled = enable;
+}
+
+static void vsync_dump_stats_locked(void)
+{
+	unsigned int flips = s_vsync.numFlips ? s_vsync.numFlips : 1;
+
+	LOGV("fb_post: %u flips, %u missed vsyncs, flip latency avg %lld us max %lld us",
+	     s_vsync.numFlips, s_vsync.numMissed,
+	     s_vsync.latencySum / flips / 1000, s_vsync.latencyMax / 1000);
+
+	s_vsync.numFlips   = 0;
+	s_vsync.numMissed  = 0;
+	s_vsync.latencySum = 0;
+	s_vsync.latencyMax = 0;
+}
+
+// Keeps the vsync interrupt on while posts come in, timestamps each vsync
+// and completes the pending flip on it.
+static void* vsync_thread_loop(void* arg)
+{
+	pthread_mutex_lock(&s_vsync.lock);
+
+	while (!s_vsync.exit)
+	{
+		if (!s_vsync.flipPending && VSYNC_IDLE_NS < vsync_now() - s_vsync.lastPost)
+		{
+			// nothing on screen is changing : no wakeups until the next post
+			vsync_set_interrupt_locked(false);
+			pthread_cond_wait(&s_vsync.cond, &s_vsync.lock);
+			continue;
+		}
+
+		vsync_set_interrupt_locked(true);
+
+		// only a pan done before the wait began is surely on screen at the
+		// vsync it returns : one requested during the wait may have missed it
+		int64_t waitStart = vsync_now();
+
+		pthread_mutex_unlock(&s_vsync.lock);
+		int ret = ioctl(s_vsync.fd, FBIO_WAITFORVSYNC, 0);
+		int64_t now = vsync_now();
+		pthread_mutex_lock(&s_vsync.lock);
+
+		if (ret < 0)
+		{
+			// don't leave fb_post() waiting on a broken interrupt
+			LOGE("FBIO_WAITFORVSYNC failed");
+			pthread_mutex_unlock(&s_vsync.lock);
+			usleep(s_vsync.period / 1000);
+			pthread_mutex_lock(&s_vsync.lock);
+			now = vsync_now();
+		}
+
+		s_vsync.lastVsync = now;
+
+		// a flip requested after waitStart waits for the next vsync
+		if (s_vsync.flipPending && s_vsync.flipRequest < waitStart)
+		{
+			int64_t latency = now - s_vsync.flipRequest;
+
+			s_vsync.flipPending = false;
+			s_vsync.numFlips++;
+			s_vsync.latencySum += latency;
+			if (s_vsync.latencyMax < latency)
+			{
+				s_vsync.latencyMax = latency;
+			}
+
+			if (VSYNC_STATS_PERIOD <= s_vsync.numFlips)
+			{
+				vsync_dump_stats_locked();
+			}
+
+			pthread_cond_broadcast(&s_vsync.cond);
+		}
+	}
+
+	vsync_set_interrupt_locked(false);
+	pthread_mutex_unlock(&s_vsync.lock);
+
+	return NULL;
+}
+
+static int vsync_start(private_module_t* m)
+{
+	pthread_mutex_lock(&s_vsync.lock);
+
+	if (s_vsync.running)
+	{
+		pthread_mutex_unlock(&s_vsync.lock);
+		return 0;
+	}
+
+	s_vsync.fd          = m->framebuffer->fd;
+	s_vsync.period      = int64_t(1000000000.0f / m->fps);
+	s_vsync.exit        = false;
+	s_vsync.intEnabled  = false;
+	s_vsync.flipPending = false;
+	s_vsync.lastPost    = 0;
+
+	if (pthread_create(&s_vsync.thread, NULL, vsync_thread_loop, NULL) != 0)
+	{
+		LOGE("failed to create the vsync thread");
+		pthread_mutex_unlock(&s_vsync.lock);
+		return -1;
+	}
+
+	s_vsync.running = true;
+
+	pthread_mutex_unlock(&s_vsync.lock);
+	return 0;
+}
+
+static void vsync_stop(void)
+{
+	pthread_mutex_lock(&s_vsync.lock);
+
+	if (!s_vsync.running)
+	{
+		pthread_mutex_unlock(&s_vsync.lock);
+		return;
+	}
+
+	s_vsync.exit = true;
+	pthread_cond_broadcast(&s_vsync.cond);
+	pthread_mutex_unlock(&s_vsync.lock);
+
+	pthread_join(s_vsync.thread, NULL);
+
+	pthread_mutex_lock(&s_vsync.lock);
+	s_vsync.running = false;
+	pthread_mutex_unlock(&s_vsync.lock);
+}
+
+// Waits for the outstanding flip, if any. Gives up after a few periods
+// so a missing vsync never hangs the compositor.
+static void vsync_wait_flip_locked(void)
+{
+	while (s_vsync.flipPending && s_vsync.running)
+	{
+		struct timespec timeout;
+		int64_t deadline;
+
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		deadline = int64_t(timeout.tv_sec) * 1000000000LL + timeout.tv_nsec + s_vsync.period * 3;
+		timeout.tv_sec  = deadline / 1000000000LL;
+		timeout.tv_nsec = deadline % 1000000000LL;
+
+		if (pthread_cond_timedwait(&s_vsync.cond, &s_vsync.lock, &timeout) == ETIMEDOUT)
+		{
+			LOGE("fb_post: no vsync for the pending flip");
+			s_vsync.flipPending = false;
+		}
+	}
+}
+
 static int fb_set_swap_interval(struct framebuffer_device_t* dev, int interval)
 {
 	if (interval < dev->minSwapInterval || interval > dev->maxSwapInterval)
@@ -83,7 +303,6 @@ static int fb_post(struct framebuffer_device_t* dev, buffer_handle_t buffer)
 		m->base.lock(&m->base, buffer, private_module_t::PRIV_USAGE_LOCKED_FOR_POST,  0, 0, m->info.xres, m->info.yres, NULL);
 
 		const size_t offset = hnd->base - m->framebuffer->base;
-                int interrupt;
 		m->info.activate = FB_ACTIVATE_VBL;
 		m->info.yoffset = offset / m->finfo.line_length;
 #if 0 //!defined(SLSI_S5PC210)
@@ -97,31 +316,38 @@ static int fb_post(struct framebuffer_device_t* dev, buffer_handle_t buffer)
 #else
                 // LCD driver changes other configurations each FBIOPUT_VSCREENINFO call.
                 // However, it changes only FB address configuration for the FBIOPAN_DISPLAY call.
+                pthread_mutex_lock(&s_vsync.lock);
+                // one flip in flight : the previous one must be on screen first
+                vsync_wait_flip_locked();
+                pthread_mutex_unlock(&s_vsync.lock);
+
                 if (ioctl(m->framebuffer->fd, FBIOPAN_DISPLAY, &m->info) == -1) {
                     LOGE("FBIOPAN_DISPLAY failed");
                     m->base.unlock(&m->base, buffer);
                     return 0;
                 }
 
-#define FBIO_WAITFORVSYNC       _IOW('F', 0x20, __u32)
-#define S3CFB_SET_VSYNC_INT	_IOW('F', 206, unsigned int)
-                // enable VSYNC
-                interrupt = 1;
-                if(ioctl(m->framebuffer->fd, S3CFB_SET_VSYNC_INT, &interrupt) < 0) {
-                    LOGE("S3CFB_SET_VSYNC_INT enable failed");
-                    return 0;
-                }
-                // wait for VSYNC
-                if(ioctl(m->framebuffer->fd, FBIO_WAITFORVSYNC, 0) < 0) {
-                    LOGE("FBIO_WAITFORVSYNC failed");
-                    return 0;
-                }
-                // disable VSYNC
-                interrupt = 0;
-                if(ioctl(m->framebuffer->fd, S3CFB_SET_VSYNC_INT, &interrupt) < 0) {
-                    LOGE("S3CFB_SET_VSYNC_INT disable failed");
-                    return 0;
+                pthread_mutex_lock(&s_vsync.lock);
+                {
+                    int64_t now = vsync_now();
+
+                    if (s_vsync.lastPost != 0 && now - s_vsync.lastPost < VSYNC_IDLE_NS &&
+                        s_vsync.period * 3 / 2 < now - s_vsync.lastPost)
+                    {
+                        s_vsync.numMissed += (now - s_vsync.lastPost) / s_vsync.period - 1;
+                    }
+
+                    s_vsync.lastPost    = now;
+                    s_vsync.flipRequest = now;
+                    s_vsync.flipPending = s_vsync.running;
+
+                    // wakes the vsync thread up if it went idle
+                    pthread_cond_broadcast(&s_vsync.cond);
                 }
+#ifndef FB_POST_ASYNC
+                vsync_wait_flip_locked();
+#endif
+                pthread_mutex_unlock(&s_vsync.lock);
 #endif
 		m->currentBuffer = buffer;
 	}
@@ -364,6 +590,7 @@ static int fb_close(struct hw_device_t *device)
 	framebuffer_device_t* dev = reinterpret_cast<framebuffer_device_t*>(device);
 	if (dev)
 	{
+		vsync_stop();
 		ump_close();
 		delete dev;
 	}
@@ -421,5 +648,10 @@ int framebuffer_device_open(hw_module_t const* module, const char* name, hw_devi
 	*device = &dev->common;
 	status = 0;
 
+	if (m->flags & PAGE_FLIP)
+	{
+		vsync_start(m);
+	}
+
 	return status;
 }
@@ -45,6 +45,93 @@
 static pthread_mutex_t s_map_lock = PTHREAD_MUTEX_INITIALIZER;
 static int s_ump_is_open = 0;
 
+#ifdef SLSI_S5PC210_CACHE_UMP
+#include <time.h>
+
+#define CACHE_LINE_SIZE         (32)
+#define CACHE_STATS_PERIOD_SEC  (1)
+
+// per process cache maintenance accounting, dumped with LOGV
+struct cache_stats_t
+{
+	pthread_mutex_t lock;
+	time_t          start;
+	unsigned int    frames;         // unlocks after a cpu write
+	unsigned int    cleanBytes;
+	unsigned int    invalBytes;
+	unsigned int    wholeBytes;     // what whole-buffer ops would have cost
+	unsigned int    skipped;        // uncached or hw-only locks
+};
+
+static cache_stats_t s_cache_stats = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0, 0, 0 };
+
+static void cache_stats_update(int frames, int clean, int inval, int whole, int skipped)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&s_cache_stats.lock);
+
+	s_cache_stats.frames     += frames;
+	s_cache_stats.cleanBytes += clean;
+	s_cache_stats.invalBytes += inval;
+	s_cache_stats.wholeBytes += whole;
+	s_cache_stats.skipped    += skipped;
+
+	if (s_cache_stats.start == 0)
+	{
+		s_cache_stats.start = now.tv_sec;
+	}
+	else if (CACHE_STATS_PERIOD_SEC <= now.tv_sec - s_cache_stats.start)
+	{
+		unsigned int frames = (s_cache_stats.frames) ? s_cache_stats.frames : 1;
+
+		LOGV("cache maintenance: %u frames, %u bytes/frame (clean %u, inval %u), whole-buffer %u bytes/frame, %u skipped",
+		     s_cache_stats.frames,
+		     (s_cache_stats.cleanBytes + s_cache_stats.invalBytes) / frames,
+		     s_cache_stats.cleanBytes, s_cache_stats.invalBytes,
+		     s_cache_stats.wholeBytes / frames,
+		     s_cache_stats.skipped);
+
+		s_cache_stats.start      = now.tv_sec;
+		s_cache_stats.frames     = 0;
+		s_cache_stats.cleanBytes = 0;
+		s_cache_stats.invalBytes = 0;
+		s_cache_stats.wholeBytes = 0;
+		s_cache_stats.skipped    = 0;
+	}
+
+	pthread_mutex_unlock(&s_cache_stats.lock);
+}
+
+// byte range of the rows covered by the locked rect, cache line aligned.
+// buffers of unknown stride (planar yuv) use the whole buffer.
+static void cache_range_get(private_handle_t const* hnd, int t, int h, int* offset, int* size)
+{
+	int start = 0;
+	int end   = hnd->size;
+
+	if (0 < hnd->stride_bytes && 0 <= t && 0 < h)
+	{
+		start = t * hnd->stride_bytes;
+		end   = (t + h) * hnd->stride_bytes;
+
+		start &= ~(CACHE_LINE_SIZE - 1);
+		end    = (end + (CACHE_LINE_SIZE - 1)) & ~(CACHE_LINE_SIZE - 1);
+
+		if (hnd->size < end)
+			end = hnd->size;
+
+		if (end < start)
+			start = end;
+	}
+
+	*offset = start;
+	*size   = end - start;
+}
+#endif
+
 static int gralloc_device_open(const hw_module_t* module, const char* name, hw_device_t** device)
 {
 	int status = -EINVAL;
@@ -185,6 +272,50 @@ static int gralloc_lock(gralloc_module_t const* module, buffer_handle_t handle,
 		*vaddr = (void*)hnd->base;
 	}
 
+#ifdef SLSI_S5PC210_CACHE_UMP
+	if ((hnd->flags & private_handle_t::PRIV_FLAGS_USES_CACHE) &&
+	    (usage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)))
+	{
+		int offset;
+		int size;
+
+		cache_range_get(hnd, t, h, &offset, &size);
+
+		// drop stale lines before the cpu reads what the hw wrote
+		if (usage & GRALLOC_USAGE_SW_READ_MASK)
+		{
+			ump_cpu_msync_now((ump_handle)hnd->ump_mem_handle, UMP_MSYNC_CLEAN_AND_INVALIDATE,
+			                  (void*)(hnd->base + offset), size);
+			cache_stats_update(0, 0, size, hnd->size, 0);
+		}
+
+		// remember the written rows, they are cleaned on unlock
+		if ((usage & GRALLOC_USAGE_SW_WRITE_MASK) && 0 < size)
+		{
+			if (hnd->dirty_size == 0)
+			{
+				hnd->dirty_offset = offset;
+				hnd->dirty_size   = size;
+			}
+			else
+			{
+				int start = (offset < hnd->dirty_offset) ? offset : hnd->dirty_offset;
+				int end   = hnd->dirty_offset + hnd->dirty_size;
+
+				if (end < offset + size)
+					end = offset + size;
+
+				hnd->dirty_offset = start;
+				hnd->dirty_size   = end - start;
+			}
+		}
+	}
+	else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP)
+	{
+		cache_stats_update(0, 0, 0, 0, 1);
+	}
+#endif
+
 	return 0;
 }
 
@@ -199,9 +330,16 @@ static int gralloc_unlock(gralloc_module_t const* module, buffer_handle_t handle
 	private_handle_t* hnd = (private_handle_t*)handle;
 
 #ifdef SLSI_S5PC210_CACHE_UMP
-	if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP) /* &&(usage&GRALLOC_USAGE_SW_READ_MASK)==GRALLOC_USAGE_SW_READ_OFTEN*/
+	// only cached buffers written by the cpu need a clean,
+	// and only over the rows locked for writing.
+	if ((hnd->flags & private_handle_t::PRIV_FLAGS_USES_CACHE) && 0 < hnd->dirty_size)
 	{
-		ump_cpu_msync_now((ump_handle)hnd->ump_mem_handle, UMP_MSYNC_CLEAN_AND_INVALIDATE, NULL, 0);
+		ump_cpu_msync_now((ump_handle)hnd->ump_mem_handle, UMP_MSYNC_CLEAN,
+		                  (void*)(hnd->base + hnd->dirty_offset), hnd->dirty_size);
+		cache_stats_update(1, hnd->dirty_size, 0, hnd->size, 0);
+
+		hnd->dirty_offset = 0;
+		hnd->dirty_size   = 0;
 	}
 #endif
 	return 0;
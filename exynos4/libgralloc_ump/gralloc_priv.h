@@ -80,6 +80,7 @@ struct private_handle_t
 		PRIV_FLAGS_FRAMEBUFFER = 0x00000001,
 		PRIV_FLAGS_USES_UMP    = 0x00000002,
 		PRIV_FLAGS_USES_IOCTL  = 0x00000004,
+		PRIV_FLAGS_USES_CACHE  = 0x00000008,
 	};
 
 	enum
@@ -107,9 +108,14 @@ struct private_handle_t
 	// Following members is for framebuffer only
 	int     offset;
 
+	// Following members are for cached UMP memory only
+	int     stride_bytes;   // 0 : unknown, cache ops cover the whole buffer
+	int     dirty_offset;   // cpu-written range since the last clean
+	int     dirty_size;
+
 
 #ifdef __cplusplus
-	static const int sNumInts = 11;
+	static const int sNumInts = 14;
 	static const int sNumFds = 0;
 	static const int sMagic = 0x3141592;
 
@@ -124,8 +130,10 @@ struct private_handle_t
 		pid(getpid()),
 		ump_id((int)secure_id),
 		ump_mem_handle((int)handle),
-		offset(0)
-
+		offset(0),
+		stride_bytes(0),
+		dirty_offset(0),
+		dirty_size(0)
 	{
 		version = sizeof(native_handle);
 		numFds = sNumFds;
@@ -143,7 +151,10 @@ struct private_handle_t
 		pid(getpid()),
 		ump_id((int)UMP_INVALID_SECURE_ID),
 		ump_mem_handle((int)UMP_INVALID_MEMORY_HANDLE),
-		offset(fb_offset)
+		offset(fb_offset),
+		stride_bytes(0),
+		dirty_offset(0),
+		dirty_size(0)
 	{
 		version = sizeof(native_handle);
 		numFds = sNumFds;
@@ -12,9 +12,10 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
+LOCAL_PATH:= $(call my-dir)
+
 ifeq ($(BOARD_USES_HDMI),true)
 
-LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_MODULE_TAGS := eng
@@ -22,7 +23,7 @@ LOCAL_MODULE_TAGS := eng
 LOCAL_PRELINK_MODULE := false
 #LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_SHARED_LIBRARIES := libutils liblog libedid libcec
-LOCAL_SRC_FILES := SecHdmi.cpp fimd_api.c
+LOCAL_SRC_FILES := SecHdmi.cpp fimd_api.c hdmi_policy.c
 LOCAL_C_INCLUDES := \
 	$(LOCAL_PATH)/../include \
 
@@ -33,6 +34,14 @@ LOCAL_CFLAGS  += \
 
 LOCAL_SHARED_LIBRARIES += libfimc
 
+ifneq ($(BOARD_HDMI_FIMC_OUTPUT_BUF_NUM),)
+LOCAL_CFLAGS  += -DHDMI_FIMC_OUTPUT_BUF_NUM=$(BOARD_HDMI_FIMC_OUTPUT_BUF_NUM)
+endif
+
+ifneq ($(BOARD_FIMC3_RESERVED_MEM_SIZE),)
+LOCAL_CFLAGS  += -DFIMC3_RESERVED_MEM_SIZE=$(BOARD_FIMC3_RESERVED_MEM_SIZE)
+endif
+
 ifeq ($(BOARD_USES_HDMI_SUBTITLES),true)
 LOCAL_CFLAGS     += -DBOARD_USES_HDMI_SUBTITLES
 #ifeq ($(BOARD_USES_FIMGAPI),true)
@@ -58,7 +67,14 @@ ifeq ($(BOARD_HDMI_STD),STD_1080P)
 LOCAL_CFLAGS  += -DSTD_1080P
 endif
 
+ifeq ($(BOARD_USES_V4L2_SHIM),true)
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM
+LOCAL_SHARED_LIBRARIES += libv4l2shim
+endif
+
 LOCAL_MODULE := libhdmi
 include $(BUILD_SHARED_LIBRARY)
 
 endif
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
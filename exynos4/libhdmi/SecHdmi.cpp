@@ -17,12 +17,20 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "libhdmi"
 #include <cutils/log.h>
+#include <cutils/atomic.h>
+
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include "SecHdmi.h"
 #include "fimd_api.h"
+#include "hdmi_policy.h"
 #if defined(BOARD_USES_FIMGAPI)
 #include "FimgApi.h"
 #endif
+#include "sec_v4l2_shim.h"
 
 
 namespace android {
@@ -32,6 +40,9 @@ v4l2_std_id t_std_id     = V4L2_STD_1080P_30;
 static int g_hpd_state   = HPD_CABLE_OUT;
 static unsigned int g_hdcp_en = 0;
 
+// sink capabilities, read from EDID at connect time
+static struct hdmi_sink_caps g_sink_caps;
+
 static int fp_tvout    = -1;
 static int fp_tvout_v  = -1;
 static int fp_tvout_g0 = -1;
@@ -39,6 +50,103 @@ static int fp_tvout_g1 = -1;
 
 struct vid_overlay_param vo_param;
 
+// FIMC output buffers for UI mirroring, BOARD_HDMI_FIMC_OUTPUT_BUF_NUM.
+// they are carved from the FIMC3 reserved memory, whose size the driver
+// does not report : BOARD_FIMC3_RESERVED_MEM_SIZE must match the kernel.
+#ifndef HDMI_FIMC_OUTPUT_BUF_NUM
+#define HDMI_FIMC_OUTPUT_BUF_NUM      (3)
+#endif
+#ifndef FIMC3_RESERVED_MEM_SIZE
+#define FIMC3_RESERVED_MEM_SIZE       (HDMI_FIMC_OUTPUT_BUF_NUM * HDMI_FIMC_OUTPUT_BUF_SIZE)
+#endif
+#if HDMI_FIMC_OUTPUT_BUF_NUM < 1 || HDMI_FIMC_OUTPUT_BUF_MAX < HDMI_FIMC_OUTPUT_BUF_NUM
+#error "HDMI_FIMC_OUTPUT_BUF_NUM must be 1..HDMI_FIMC_OUTPUT_BUF_MAX"
+#endif
+
+// frames between statistics logs
+#define HDMI_LAYER_STAT_FRAMES        (300)
+#define HDMI_FIMC_OUT_BUF_STAT_FRAMES (600)
+
+// last parameters programmed on each tvout layer.
+// steady-state frames only differ in the source address,
+// so everything else is skipped while it matches.
+
+struct tvout_layer_state {
+    bool         valid;
+
+    int          src_w;
+    int          src_h;
+    int          color_format;
+    int          dst_x;
+    int          dst_y;
+    int          dst_w;
+    int          dst_h;
+    unsigned int base_y;
+    unsigned int base_c;
+
+    unsigned int frames;
+    unsigned int ioctls;
+    unsigned int full_updates;
+};
+
+static struct tvout_layer_state g_layer_state[HDMI_LAYER_MAX];
+
+static void hdmi_invalidate_layer_state(int layer)
+{
+    if(layer < 0 || HDMI_LAYER_MAX <= layer)
+        return;
+
+    g_layer_state[layer].valid = false;
+}
+
+static bool hdmi_check_layer_state(struct tvout_layer_state *state,
+        int src_w, int src_h, int color_format,
+        int dst_x, int dst_y, int dst_w, int dst_h)
+{
+    if(state->valid        == true         &&
+       state->src_w        == src_w        &&
+       state->src_h        == src_h        &&
+       state->color_format == color_format &&
+       state->dst_x        == dst_x        &&
+       state->dst_y        == dst_y        &&
+       state->dst_w        == dst_w        &&
+       state->dst_h        == dst_h)
+        return true;
+
+    state->src_w        = src_w;
+    state->src_h        = src_h;
+    state->color_format = color_format;
+    state->dst_x        = dst_x;
+    state->dst_y        = dst_y;
+    state->dst_w        = dst_w;
+    state->dst_h        = dst_h;
+
+    return false;
+}
+
+static void hdmi_update_layer_stats(int layer, unsigned int ioctls, bool full_update)
+{
+    struct tvout_layer_state *state = &g_layer_state[layer];
+
+    state->frames++;
+    state->ioctls += ioctls;
+    if(full_update == true)
+        state->full_updates++;
+
+    if(state->frames < HDMI_LAYER_STAT_FRAMES)
+        return;
+
+    LOGV("%s::layer(%d) %d frames : %d ioctls (%d.%02d per frame), %d full updates\n",
+            __func__, layer, state->frames, state->ioctls,
+            state->ioctls / state->frames,
+            ((state->ioctls % state->frames) * 100) / state->frames,
+            state->full_updates);
+
+    state->frames       = 0;
+    state->ioctls       = 0;
+    state->full_updates = 0;
+}
+
 #if defined(BOARD_USES_FIMGAPI)
 static unsigned int g2d_reserved_memory0     = 0;
 static unsigned int g2d_reserved_memory1     = 0;
@@ -171,6 +279,9 @@ int tvout_init(v4l2_std_id std_id)
     unsigned int matched=0, i=0;
     int output_index;
 
+    for(i = 0; i < HDMI_LAYER_MAX; i++)
+        hdmi_invalidate_layer_state(i);
+
     // It was initialized already
     if(fp_tvout <= 0)
     {
@@ -592,6 +703,8 @@ int hdmi_init_layer(int layer)
     LOGD("### %s (layer = %d) called\n", __func__, layer);
 #endif
 
+    hdmi_invalidate_layer_state(layer);
+
     switch(layer)
     {
     case HDMI_LAYER_VIDEO :
@@ -641,6 +754,9 @@ int hdmi_deinit_layer(int layer)
 #ifdef DEBUG_HDMI_HW_LEVEL
     LOGD("### %s(layer = %d) called\n", __func__, layer);
 #endif
+
+    hdmi_invalidate_layer_state(layer);
+
     switch(layer)
     {
     case HDMI_LAYER_VIDEO :
@@ -695,12 +811,39 @@ int hdmi_set_v_param(int layer,
 {
     int round_up_src_w;
     int round_up_src_h;
+    struct tvout_layer_state *state = &g_layer_state[HDMI_LAYER_VIDEO];
+    unsigned int ioctls = 0;
+
     if(fp_tvout_v <= 0)
     {
         LOGE("fp_tvout is < 0 fail\n");
         return -1;
     }
 
+    if(hdmi_check_layer_state(state, src_w, src_h, colorFormat,
+                0, 0, dst_w, dst_h) == true)
+    {
+        // same geometry : only the source address goes to the driver
+        if(state->base_y != src_y_address || state->base_c != src_c_address)
+        {
+            vo_param.src.base_y = (void *)src_y_address;
+            vo_param.src.base_c = (void *)src_c_address;
+
+            ioctls++;
+            if(tvout_v4l2_s_fmt(fp_tvout_v, V4L2_BUF_TYPE_PRIVATE, &vo_param.src) < 0)
+            {
+                state->valid = false;
+                return -1;
+            }
+
+            state->base_y = src_y_address;
+            state->base_c = src_c_address;
+        }
+
+        hdmi_update_layer_stats(HDMI_LAYER_VIDEO, ioctls, false);
+        return 0;
+    }
+
     /* src_w, src_h round up to DWORD because of VP restriction */
     round_up_src_w = ROUND_UP( src_w, 2*sizeof(uint32_t) );
     round_up_src_h = ROUND_UP( src_h, 2*sizeof(uint32_t) );
@@ -717,32 +860,48 @@ int hdmi_set_v_param(int layer,
     //        vo_param.src.pix_fmt.field, vo_param.src.pix_fmt.pixelformat );
 #endif
 
-    tvout_v4l2_s_fmt(fp_tvout_v, V4L2_BUF_TYPE_PRIVATE, &vo_param.src);
+    ioctls++;
+    if(tvout_v4l2_s_fmt(fp_tvout_v, V4L2_BUF_TYPE_PRIVATE, &vo_param.src) < 0)
+    {
+        state->valid = false;
+        return -1;
+    }
 
     vo_param.src_crop.width   = src_w;
     vo_param.src_crop.height  = src_h;
 
+    ioctls++;
     tvout_v4l2_s_crop(fp_tvout_v, V4L2_BUF_TYPE_PRIVATE, &vo_param.src_crop);
 
-    if(dst_w * src_h <= dst_h * src_w)
-    {
-        vo_param.dst_win.w.left   = 0;
-        vo_param.dst_win.w.top    = (dst_h - ((dst_w * src_h) / src_w)) >> 1;
-        vo_param.dst_win.w.width  = dst_w;
-        vo_param.dst_win.w.height = ((dst_w * src_h) / src_w);
-    }
-    else
     {
-        vo_param.dst_win.w.left   = (dst_w - ((dst_h * src_w) / src_h)) >> 1;
-        vo_param.dst_win.w.top    = 0;
-        vo_param.dst_win.w.width  = ((dst_h * src_w) / src_h);
-        vo_param.dst_win.w.height = dst_h;
+        const struct hdmi_mode *mode = hdmi_policy_find_std(t_std_id);
+        struct hdmi_rect rect;
+
+        hdmi_policy_letterbox(src_w, src_h, dst_w, dst_h,
+                              mode ? mode->dar_w : 0, mode ? mode->dar_h : 0,
+                              &rect);
+
+        vo_param.dst_win.w.left   = rect.x;
+        vo_param.dst_win.w.top    = rect.y;
+        vo_param.dst_win.w.width  = rect.w;
+        vo_param.dst_win.w.height = rect.h;
     }
 
     vo_param.dst.fmt.priv = 10;
     vo_param.dst_win.global_alpha = 255;
-    tvout_v4l2_s_fbuf(fp_tvout_v, &vo_param.dst);
-    tvout_v4l2_s_fmt(fp_tvout_v, V4L2_BUF_TYPE_VIDEO_OVERLAY, &vo_param.dst_win);
+    ioctls += 2;
+    if(tvout_v4l2_s_fbuf(fp_tvout_v, &vo_param.dst) < 0 ||
+       tvout_v4l2_s_fmt(fp_tvout_v, V4L2_BUF_TYPE_VIDEO_OVERLAY, &vo_param.dst_win) < 0)
+    {
+        state->valid = false;
+        return -1;
+    }
+
+    state->base_y = src_y_address;
+    state->base_c = src_c_address;
+    state->valid  = true;
+
+    hdmi_update_layer_stats(HDMI_LAYER_VIDEO, ioctls, true);
 
     /*
     // sw5771.park : calibration in floating level..
@@ -801,6 +960,45 @@ int hdmi_set_v_param(int layer,
 
 
 #if defined(BOARD_USES_HDMI_SUBTITLES)
+static int hdmi_gl_update_layer(int layer, int fp_tvout_g, unsigned int base_addr,
+        struct fb_var_screeninfo *var, struct s5ptvfb_user_window *window)
+{
+    struct tvout_layer_state *state = &g_layer_state[layer];
+    unsigned int ioctls = 0;
+    bool full_update = false;
+
+    if(hdmi_check_layer_state(state, var->xres, var->yres, var->bits_per_pixel,
+                window->x, window->y, 0, 0) == false)
+        full_update = true;
+
+    if(full_update == true || state->base_y != base_addr)
+    {
+        ioctls++;
+        if(tvout_v4l2_s_baseaddr(fp_tvout_g, (void *)base_addr) < 0)
+        {
+            state->valid = false;
+            return -1;
+        }
+        state->base_y = base_addr;
+    }
+
+    if(full_update == true)
+    {
+        ioctls += 2;
+        if(put_vscreeninfo(fp_tvout_g, var) < 0 ||
+           ioctl(fp_tvout_g, S5PTVFB_WIN_POSITION, window) < 0)
+        {
+            LOGE("%s::layer(%d) geometry update fail\n", __func__, layer);
+            state->valid = false;
+            return -1;
+        }
+        state->valid = true;
+    }
+
+    hdmi_update_layer_stats(layer, ioctls, full_update);
+    return 0;
+}
+
 int hdmi_gl_set_param(int layer,
         int src_w, int src_h,
         unsigned int src_y_address, unsigned int src_c_address,
@@ -848,10 +1046,18 @@ int hdmi_gl_set_param(int layer,
         FimgApi::COLOR_FORMAT_ARGB_8888,
         4, (unsigned char *)src_y_address};
 
+    // the UI keeps its aspect ratio : the layer only covers the letterbox rect
+    const struct hdmi_mode *mode = hdmi_policy_find_std(t_std_id);
+    struct hdmi_rect rect;
+
+    if(mode != NULL && (mUIRotVal == 0 || mUIRotVal == 180))
+        hdmi_policy_letterbox(src_w, src_h, dst_w, dst_h, mode->dar_w, mode->dar_h, &rect);
+    else
+        hdmi_policy_letterbox(src_w, src_h, dst_w, dst_h, 0, 0, &rect);
 
     FimgRect dstRect = {0, 0,
-        dst_w, dst_h,
-        dst_w, dst_h,
+        rect.w, rect.h,
+        rect.w, rect.h,
         dst_color_format,
         dst_bpp,
         NULL};
@@ -903,11 +1109,15 @@ int hdmi_gl_set_param(int layer,
 
     if(mUIRotVal == 0 || mUIRotVal == 180)
     {
-        var.xres = dst_w;
-        var.yres = dst_h;
+        var.xres = rect.w;
+        var.yres = rect.h;
+        window.x = dst_x + rect.x;
+        window.y = dst_y + rect.y;
     }else{
-        var.xres = dst_h;
-        var.yres = dst_w;
+        var.xres = rect.h;
+        var.yres = rect.w;
+        window.x = dst_x + rect.y;
+        window.y = dst_y + rect.x;
     }
 
     var.xres_virtual = var.xres;
@@ -918,14 +1128,7 @@ int hdmi_gl_set_param(int layer,
     var.height = 0;
     var.activate = FB_ACTIVATE_FORCE;
 
-    window.x = dst_x;
-    window.y = dst_y;
-
-    tvout_v4l2_s_baseaddr(fp_tvout_g, (void *)dstRect.addr);
-    put_vscreeninfo(fp_tvout_g, &var);
-    ioctl(fp_tvout_g, S5PTVFB_WIN_POSITION, &window);
-
-    return 0;
+    return hdmi_gl_update_layer(layer, fp_tvout_g, (unsigned int)dstRect.addr, &var, &window);
 }
 #else
 {
@@ -957,11 +1160,7 @@ int hdmi_gl_set_param(int layer,
     window.x = dst_x;
     window.y = dst_y;
 
-    tvout_v4l2_s_baseaddr(fp_tvout_g, (void *)src_y_address);
-    put_vscreeninfo(fp_tvout_g, &var);
-    ioctl(fp_tvout_g, S5PTVFB_WIN_POSITION, &window);
-
-    return 0;
+    return hdmi_gl_update_layer(layer, fp_tvout_g, src_y_address, &var, &window);
 }
 #endif
 #endif
@@ -1083,21 +1282,16 @@ int composite_std_2_v4l2_std_id(int std)
 
 static int hdmi_check_output_mode(int v4l2_output_type)
 {
-    struct HDMIVideoParameter video;
-    struct HDMIAudioParameter audio;
     int    calbirate_v4l2_mode = v4l2_output_type;
 
-    audio.formatCode = LPCM_FORMAT;
-    audio.outPacket  = HDMI_ASP;
-    audio.channelNum = CH_2;
-    audio.sampleFreq = SF_44KHZ;
+    if (!g_sink_caps.valid)
+        hdmi_policy_read_caps(&g_sink_caps);
 
     switch(v4l2_output_type)
     {
     case V4L2_OUTPUT_TYPE_DIGITAL :
 
-        video.mode = HDMI;
-        if (!EDIDHDMIModeSupport(&video))
+        if (!g_sink_caps.hdmi)
         {
             //jhkim//calbirate_v4l2_mode = V4L2_OUTPUT_TYPE_DVI;
             //audio_state = NOT_SUPPORT;
@@ -1110,8 +1304,7 @@ static int hdmi_check_output_mode(int v4l2_output_type)
           audio_state = ON;
           }*/
 
-        video.colorSpace = HDMI_CS_YCBCR444;
-        if (!EDIDColorSpaceSupport(&video))
+        if (!g_sink_caps.ycbcr444)
         {
             calbirate_v4l2_mode = V4L2_OUTPUT_TYPE_HDMI_RGB;
             LOGI("Change mode into HDMI_RGB\n");
@@ -1120,8 +1313,7 @@ static int hdmi_check_output_mode(int v4l2_output_type)
 
     case V4L2_OUTPUT_TYPE_HDMI_RGB:
 
-        video.mode = HDMI;
-        if (!EDIDHDMIModeSupport(&video))
+        if (!g_sink_caps.hdmi)
         {
             //jhkim//calbirate_v4l2_mode = V4L2_OUTPUT_TYPE_DVI;
             //audio_state = NOT_SUPPORT;
@@ -1133,8 +1325,7 @@ static int hdmi_check_output_mode(int v4l2_output_type)
           if (EDIDAudioModeSupport(&audio))
           audio_state = ON;
           }*/
-        video.colorSpace = HDMI_CS_YCBCR444;
-        if (EDIDColorSpaceSupport(&video))
+        if (g_sink_caps.ycbcr444)
         {
             //jhkim//calbirate_v4l2_mode = V4L2_OUTPUT_TYPE_DIGITAL;
             LOGI("Change mode into HDMI\n");
@@ -1143,11 +1334,9 @@ static int hdmi_check_output_mode(int v4l2_output_type)
 
     case V4L2_OUTPUT_TYPE_DVI:
 
-        video.mode = HDMI;
-        if (EDIDHDMIModeSupport(&video))
+        if (g_sink_caps.hdmi)
         {
-            video.colorSpace = HDMI_CS_YCBCR444;
-            if (EDIDColorSpaceSupport(&video))
+            if (g_sink_caps.ycbcr444)
             {
                 calbirate_v4l2_mode = V4L2_OUTPUT_TYPE_DIGITAL;
                 LOGI("Change mode into HDMI_YCBCR\n");
@@ -1171,78 +1360,6 @@ static int hdmi_check_output_mode(int v4l2_output_type)
 }
 
 
-static int hdmi_check_resolution(v4l2_std_id std_id)
-{
-    struct HDMIVideoParameter video;
-    struct HDMIAudioParameter audio;
-
-    switch (std_id)
-    {
-    case V4L2_STD_480P_60_16_9:
-        video.resolution = v720x480p_60Hz;
-        video.pixelAspectRatio = HDMI_PIXEL_RATIO_16_9;
-        break;
-    case V4L2_STD_480P_60_4_3:
-        video.resolution = v640x480p_60Hz;
-        video.pixelAspectRatio = HDMI_PIXEL_RATIO_4_3;
-        break;
-    case V4L2_STD_576P_50_16_9:
-        video.resolution = v720x576p_50Hz;
-        video.pixelAspectRatio = HDMI_PIXEL_RATIO_16_9;
-        break;
-    case V4L2_STD_576P_50_4_3:
-        video.resolution = v720x576p_50Hz;
-        video.pixelAspectRatio = HDMI_PIXEL_RATIO_4_3;
-        break;
-    case V4L2_STD_720P_60:
-        video.resolution = v1280x720p_60Hz;
-        break;
-    case V4L2_STD_720P_50:
-        video.resolution = v1280x720p_50Hz;
-        break;
-    case V4L2_STD_1080P_60:
-        video.resolution = v1920x1080p_60Hz;
-        break;
-    case V4L2_STD_1080P_50:
-        video.resolution = v1920x1080p_50Hz;
-        break;
-    case V4L2_STD_1080I_60:
-        video.resolution = v1920x1080i_60Hz;
-        break;
-    case V4L2_STD_1080I_50:
-        video.resolution = v1920x1080i_50Hz;
-        break;
-    case V4L2_STD_480P_59:
-        video.resolution = v720x480p_60Hz;
-        break;
-    case V4L2_STD_720P_59:
-        video.resolution = v1280x720p_60Hz;
-        break;
-    case V4L2_STD_1080I_59:
-        video.resolution = v1920x1080i_60Hz;
-        break;
-    case V4L2_STD_1080P_59:
-        video.resolution = v1920x1080p_60Hz;
-        break;
-    case V4L2_STD_1080P_30:
-        video.resolution = v1920x1080p_30Hz;
-        break;
-    default:
-        LOGE("%s::unmathced std_id(%lld)", __func__, std_id);
-        return -1;
-        break;
-    }
-
-    if (!EDIDVideoResolutionSupport(&video))
-    {
-        LOGD("%s::EDIDVideoResolutionSupport(%llx) fail (not suppoted std_id) \n", __func__, std_id);
-
-        return -1;
-    }
-
-    return 0;
-}
-
 int hdmi_resolution_2_std_id(unsigned int resolution, int * w, int * h, v4l2_std_id * std_id)
 {
     int ret = 0;
@@ -1362,222 +1479,559 @@ static int hdmi_check_audio(void)
     return ret;
 }
 
+//=============================
+// HDMI event loop : hotplug uevents, CEC messages and control commands
+// are all waited on with one epoll, so an idle HDMI costs no wakeup.
+
+#define HDMI_EVENT_MAX          (4)
+#define HDMI_UEVENT_MSG_LEN     (1024)
+
+#define HDMI_EVENT_CMD_EXIT     ('x')
+
 #if defined(BOARD_USES_CEC)
-SecHdmi::CECThread::~CECThread()
+#define CEC_VERSION_1_3A        (0x04)
+#define CEC_POWER_STATUS_ON     (0x00)
+
+#define CEC_ABORT_UNRECOGNIZED  (0x00)
+#define CEC_ABORT_REFUSED       (0x04)
+
+// what to do with a received CEC message, by opcode
+const SecHdmi::EventThread::cec_handler SecHdmi::EventThread::mCECHandlers[] =
+{
+    { CEC_OPCODE_GIVE_PHYSICAL_ADDRESS,    &SecHdmi::EventThread::m_cecGivePhysicalAddress },
+    { CEC_OPCODE_REQUEST_ACTIVE_SOURCE,    &SecHdmi::EventThread::m_cecRequestActiveSource },
+    { CEC_OPCODE_GET_CEC_VERSION,          &SecHdmi::EventThread::m_cecGetCECVersion       },
+    { CEC_OPCODE_GIVE_DEVICE_POWER_STATUS, &SecHdmi::EventThread::m_cecGivePowerStatus     },
+    { CEC_OPCODE_ABORT,                    &SecHdmi::EventThread::m_cecAbort               },
+    // never answer to these
+    { CEC_OPCODE_FEATURE_ABORT,            NULL                                            },
+    { CEC_OPCODE_REPORT_PHYSICAL_ADDRESS,  NULL                                            },
+    { CEC_OPCODE_ACTIVE_SOURCE,            NULL                                            },
+    { CEC_OPCODE_CEC_VERSION,              NULL                                            },
+    { CEC_OPCODE_REPORT_POWER_STATUS,      NULL                                            },
+};
+#endif
+
+SecHdmi::EventThread::~EventThread()
 {
 #ifdef DEBUG_HDMI_HW_LEVEL
     LOGD("%s", __func__);
 #endif
-    mFlagRunning = false;
+    m_closeFds();
 }
 
-bool SecHdmi::CECThread::threadLoop()
+void SecHdmi::EventThread::m_closeFds(void)
 {
-#ifdef DEBUG_HDMI_HW_LEVEL
-    //LOGD("%s", __func__);
-#endif
-    unsigned char buffer[CEC_MAX_FRAME_SIZE];
-    int size;
-    unsigned char lsrc, ldst, opcode;
+    if(0 <= mUeventFd)
+    {
+        close(mUeventFd);
+        mUeventFd = -1;
+    }
+
+    for(int i = 0; i < 2; i++)
+    {
+        if(0 <= mCtrlPipe[i])
+        {
+            close(mCtrlPipe[i]);
+            mCtrlPipe[i] = -1;
+        }
+    }
 
+    if(0 <= mEpollFd)
     {
-        Mutex::Autolock lock(mThreadLoopLock);
-        mFlagRunning = true;
+        close(mEpollFd);
+        mEpollFd = -1;
+    }
+}
 
-        size = CECReceiveMessage(buffer, CEC_MAX_FRAME_SIZE, 100000);
+bool SecHdmi::EventThread::m_addFd(int fd)
+{
+    struct epoll_event event;
 
-        if (!size) { // no data available or ctrl-c
-            //LOGE("CECReceiveMessage() failed!\n");
-            return true;
-        }
+    memset(&event, 0, sizeof(event));
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
 
-        if (size == 1)
-            return true; // "Polling Message"
+    if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        LOGE("%s::epoll_ctl(%d) fail(%d) \n", __func__, fd, errno);
+        return false;
+    }
+    return true;
+}
 
-        lsrc = buffer[0] >> 4;
+bool SecHdmi::EventThread::threadLoop()
+{
+    struct epoll_event events[HDMI_EVENT_MAX];
 
-        /* ignore messages with src address == mLaddr*/
-        if (lsrc == mLaddr)
+    int num = epoll_wait(mEpollFd, events, HDMI_EVENT_MAX, -1);
+    if(num < 0)
+    {
+        if(errno == EINTR)
             return true;
 
-        opcode = buffer[1];
+        LOGE("%s::epoll_wait fail(%d) \n", __func__, errno);
+        return false;
+    }
 
-        if (CECIgnoreMessage(opcode, lsrc)) {
-            LOGE("### ignore message coming from address 15 (unregistered)\n");
-            return true;
-        }
+    for(int i = 0; i < num; i++)
+    {
+        int fd = events[i].data.fd;
 
-        if (!CECCheckMessageSize(opcode, size)) {
-            LOGE("### invalid message size: %d(opcode: 0x%x) ###\n", size, opcode);
-            return true;
+        if(fd == mCtrlPipe[0])
+        {
+            char cmd;
+            while(read(mCtrlPipe[0], &cmd, 1) == 1)
+            {
+                if(cmd == HDMI_EVENT_CMD_EXIT)
+                    return false;
+            }
         }
-
-        /* check if message broadcasted/directly addressed */
-        if (!CECCheckMessageMode(opcode, (buffer[0] & 0x0F) == CEC_MSG_BROADCAST ? 1 : 0)) {
-            LOGE("### invalid message mode (directly addressed/broadcast) ###\n");
-            return true;
+        else if(fd == mUeventFd)
+            m_handleUevent();
+#if defined(BOARD_USES_CEC)
+        else if(events[i].events & (EPOLLHUP | EPOLLERR))
+        {
+            // device gone (or the stand-in peer closed) : it would stay readable
+            LOGE("%s::CEC fd hangup \n", __func__);
+            stopCEC();
         }
+#endif
+        else
+            m_handleCEC();
+    }
 
-        ldst = lsrc;
+    return !exitPending();
+}
 
-        //TODO: macroses to extract src and dst logical addresses
-        //TODO: macros to extract opcode
+void SecHdmi::EventThread::m_handleUevent(void)
+{
+    char msg[HDMI_UEVENT_MSG_LEN + 2];
+    bool flagHpd = false;
+    int  len;
 
-        switch (opcode)
-        {
-        case CEC_OPCODE_GIVE_PHYSICAL_ADDRESS:
-            /* responce with "Report Physical Address" */
-            buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
-            buffer[1] = CEC_OPCODE_REPORT_PHYSICAL_ADDRESS;
-            buffer[2] = (mPaddr >> 8) & 0xFF;
-            buffer[3] = mPaddr & 0xFF;
-            buffer[4] = mDevtype;
-            size = 5;
-            break;
+    while((len = recv(mUeventFd, msg, HDMI_UEVENT_MSG_LEN, MSG_DONTWAIT)) > 0)
+    {
+        // "action@devpath" first, then KEY=VALUE strings
+        msg[len] = msg[len + 1] = '\0';
+        if(strstr(msg, "HPD") != NULL || strstr(msg, "hdmi") != NULL)
+            flagHpd = true;
+    }
 
-        case CEC_OPCODE_REQUEST_ACTIVE_SOURCE:
-            LOGD("[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]\n");
-            /* responce with "Active Source" */
-            buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
-            buffer[1] = CEC_OPCODE_ACTIVE_SOURCE;
-            buffer[2] = (mPaddr >> 8) & 0xFF;
-            buffer[3] = mPaddr & 0xFF;
-            size = 4;
-            LOGD("Tx : [CEC_OPCODE_ACTIVE_SOURCE]\n");
-            break;
+    if(flagHpd == false)
+        return;
 
-        case CEC_OPCODE_ABORT:
-        case CEC_OPCODE_FEATURE_ABORT:
-        default:
-            /* send "Feature Abort" */
-            buffer[0] = (mLaddr << 4) | ldst;
-            buffer[1] = CEC_OPCODE_FEATURE_ABORT;
-            buffer[2] = CEC_OPCODE_ABORT;
-            buffer[3] = 0x04; // "refused"
-            size = 4;
-            break;
-        }
+    int state = hdmi_cable_status();
+    if(state < 0 || state == android_atomic_acquire_load(&mHpdState))
+        return;
 
-        if (CECSendMessage(buffer, size) != size)
-            LOGE("CECSendMessage() failed!!!\n");
+    android_atomic_release_store(state, &mHpdState);
+    LOGI("%s::hdmi cable %s \n", __func__, state ? "in" : "out");
 
-    }
-    return true;
+#if defined(BOARD_USES_CEC)
+    // the physical address goes with the sink, wait for the next connect()
+    if(state == HPD_CABLE_OUT)
+        stopCEC();
+#endif
 }
 
-bool SecHdmi::CECThread::start()
+int SecHdmi::EventThread::hpdState(void)
 {
-#ifdef DEBUG_HDMI_HW_LEVEL
-    LOGD("%s", __func__);
-#endif
+    // no uevent socket : nobody keeps mHpdState up to date
+    if(mUeventFd < 0)
+        return -1;
+
+    return android_atomic_acquire_load(&mHpdState);
+}
 
+bool SecHdmi::EventThread::start()
+{
     Mutex::Autolock lock(mThreadControlLock);
-    if(exitPending()){
-        if(requestExitAndWait() == WOULD_BLOCK)
-        {
-            LOGE("mCECThread.requestExitAndWait() == WOULD_BLOCK");
-            return false;
-        }
-    }
 
-#ifdef DEBUG_HDMI_HW_LEVEL
-    LOGD("EDIDGetCECPhysicalAddress");
-#endif
-    /* set to not valid physical address */
-    mPaddr = CEC_NOT_VALID_PHYSICAL_ADDRESS;
+    if(0 <= mEpollFd)
+        return true;
 
-    if (!EDIDGetCECPhysicalAddress(&mPaddr)) {
-        LOGE("Error: EDIDGetCECPhysicalAddress() failed.\n");
+    mEpollFd = epoll_create(HDMI_EVENT_MAX);
+    if(mEpollFd < 0)
+    {
+        LOGE("%s::epoll_create fail(%d) \n", __func__, errno);
         return false;
     }
 
-    //LOGD("Device physical address is %X.%X.%X.%X\n",
-    //       (mPaddr & 0xF000) >> 12, (mPaddr & 0x0F00) >> 8,
-    //       (mPaddr & 0x00F0) >> 4, mPaddr & 0x000F);
-
-#ifdef DEBUG_HDMI_HW_LEVEL
-    LOGD("CECOpen");
-#endif
-    if (!CECOpen()) {
-        LOGE("CECOpen() failed!!!\n");
+    if(pipe(mCtrlPipe) < 0)
+    {
+        LOGE("%s::pipe fail(%d) \n", __func__, errno);
+        m_closeFds();
         return false;
     }
+    fcntl(mCtrlPipe[0], F_SETFL, O_NONBLOCK);
 
-    /* a logical address should only be allocated when a device \
-       has a valid physical address, at all other times a device \
-       should take the 'Unregistered' logical address (15)
-       */
-
-    /* if physical address is not valid device should take \
-       the 'Unregistered' logical address (15)
-       */
+    if(m_addFd(mCtrlPipe[0]) == false)
+    {
+        m_closeFds();
+        return false;
+    }
 
-#ifdef DEBUG_HDMI_HW_LEVEL
-    LOGD("CECAllocLogicalAddress");
-#endif
-    mLaddr = CECAllocLogicalAddress(mPaddr, mDevtype);
+    // hotplug is optional : without it m_flagHWConnected() asks the driver
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid    = 0;
+    addr.nl_groups = 0xffffffff;
 
-    if (!mLaddr) {
-        LOGE("CECAllocLogicalAddress() failed!!!\n");
-        if (!CECClose()) {
-            LOGE("CECClose() failed!\n");
-        }
-        return false;
+    mUeventFd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if(mUeventFd < 0 ||
+       bind(mUeventFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+       m_addFd(mUeventFd) == false)
+    {
+        LOGE("%s::uevent socket fail(%d), hotplug is polled \n", __func__, errno);
+        if(0 <= mUeventFd)
+            close(mUeventFd);
+        mUeventFd = -1;
     }
 
-#ifdef DEBUG_HDMI_HW_LEVEL
-    LOGD("request to run CECThread");
-#endif
-    //buffer = (unsigned char *)malloc(CEC_MAX_FRAME_SIZE);
-    status_t ret = run("SecHdmi::CECThread", PRIORITY_DISPLAY);
-    if(ret != NO_ERROR)
+    android_atomic_release_store(hdmi_cable_status(), &mHpdState);
+
+    if(run("SecHdmi::EventThread", PRIORITY_DISPLAY) != NO_ERROR)
     {
         LOGE("%s fail to run thread", __func__);
+        m_closeFds();
         return false;
     }
     return true;
 }
 
-bool SecHdmi::CECThread::stop()
+bool SecHdmi::EventThread::stop()
 {
-#ifdef DEBUG_HDMI_HW_LEVEL
-    LOGD("%s request Exit", __func__);
-#endif
     Mutex::Autolock lock(mThreadControlLock);
+
+    if(mEpollFd < 0)
+        return true;
+
+#if defined(BOARD_USES_CEC)
+    stopCEC();
+#endif
+
+    char cmd = HDMI_EVENT_CMD_EXIT;
+    requestExit();
+    write(mCtrlPipe[1], &cmd, 1);
+
     if(requestExitAndWait() == WOULD_BLOCK)
     {
-        LOGE("mCECThread.requestExitAndWait() == WOULD_BLOCK");
+        LOGE("mEventThread.requestExitAndWait() == WOULD_BLOCK");
         return false;
     }
 
-    if (!CECClose()) {
-        LOGE("CECClose() failed!\n");
-    }
-
-    mFlagRunning = false;
+    m_closeFds();
     return true;
 }
-#endif
 
-////////////////////////////////////////////////////////////////////////
-SecHdmi::SecHdmi():
 #if defined(BOARD_USES_CEC)
-    mCECThread(NULL),
-#endif
-    mFlagCreate(false),
-    mFlagConnected(false),
-    //mFlagHdmiStart(false),
-    mHdmiDstWidth(0),
-    mHdmiDstHeight(0),
-    mHdmiSrcYAddr(0),
-    mHdmiSrcCbCrAddr(0),
-    mHdmiOutputMode(DEFAULT_OUPUT_MODE),
+bool SecHdmi::EventThread::startCEC(void)
+{
+    int paddr = CEC_NOT_VALID_PHYSICAL_ADDRESS;
+
+    if (!EDIDGetCECPhysicalAddress(&paddr)) {
+        LOGE("Error: EDIDGetCECPhysicalAddress() failed.\n");
+        return false;
+    }
+
+    return startCEC(-1, 0, paddr);
+}
+
+bool SecHdmi::EventThread::startCEC(int fd, int laddr, int paddr)
+{
+    Mutex::Autolock lock(mCECLock);
+
+    if(mFlagCEC == true)
+        return true;
+
+    if(mEpollFd < 0)
+    {
+        LOGE("%s::event loop not started \n", __func__);
+        return false;
+    }
+
+    if(fd < 0)
+    {
+        if (!CECOpen()) {
+            LOGE("CECOpen() failed!!!\n");
+            return false;
+        }
+
+        /* a logical address should only be allocated when a device \
+           has a valid physical address, at all other times a device \
+           should take the 'Unregistered' logical address (15)
+           */
+        laddr = CECAllocLogicalAddress(paddr, mDevtype);
+    }
+    else
+    {
+        // stand-in device : addresses come from the caller
+        CECOpenFd(fd);
+    }
+
+    if (!laddr) {
+        LOGE("CECAllocLogicalAddress() failed!!!\n");
+        if (!CECClose()) {
+            LOGE("CECClose() failed!\n");
+        }
+        return false;
+    }
+
+    mLaddr = laddr;
+    mPaddr = paddr;
+
+    if(m_addFd(CECGetFd()) == false)
+    {
+        CECClose();
+        return false;
+    }
+
+    mFlagCEC = true;
+    return true;
+}
+
+bool SecHdmi::EventThread::stopCEC(void)
+{
+    Mutex::Autolock lock(mCECLock);
+
+    if(mFlagCEC == false)
+        return true;
+
+    // removed before closing, so the loop never sees a stale fd
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, CECGetFd(), NULL);
+
+    if (!CECClose()) {
+        LOGE("CECClose() failed!\n");
+    }
+
+    mFlagCEC = false;
+    return true;
+}
+
+void SecHdmi::EventThread::m_handleCEC(void)
+{
+    Mutex::Autolock lock(mCECLock);
+
+    unsigned char buffer[CEC_MAX_FRAME_SIZE];
+    unsigned char lsrc, opcode;
+    int size;
+
+    if(mFlagCEC == false)
+        return;
+
+    // epoll said readable, so this does not wait
+    size = CECReceiveMessage(buffer, CEC_MAX_FRAME_SIZE, 0);
+
+    if (size <= 1)
+        return; // nothing or "Polling Message"
+
+    lsrc = buffer[0] >> 4;
+
+    /* ignore messages with src address == mLaddr*/
+    if (lsrc == mLaddr)
+        return;
+
+    opcode = buffer[1];
+
+    if (CECIgnoreMessage(opcode, lsrc)) {
+        LOGE("### ignore message coming from address 15 (unregistered)\n");
+        return;
+    }
+
+    if (!CECCheckMessageSize(opcode, size)) {
+        LOGE("### invalid message size: %d(opcode: 0x%x) ###\n", size, opcode);
+        return;
+    }
+
+    /* check if message broadcasted/directly addressed */
+    bool broadcast = ((buffer[0] & 0x0F) == CEC_MSG_BROADCAST);
+    if (!CECCheckMessageMode(opcode, broadcast ? 1 : 0)) {
+        LOGE("### invalid message mode (directly addressed/broadcast) ###\n");
+        return;
+    }
+
+    cec_handler_func handler = NULL;
+    bool known = false;
+
+    for(unsigned int i = 0; i < sizeof(mCECHandlers) / sizeof(mCECHandlers[0]); i++)
+    {
+        if(mCECHandlers[i].opcode == opcode)
+        {
+            handler = mCECHandlers[i].handler;
+            known   = true;
+            break;
+        }
+    }
+
+    if(known == true)
+    {
+        if(handler == NULL)
+            return;
+
+        size = (this->*handler)(buffer, lsrc);
+    }
+    else
+    {
+        // broadcast messages are never aborted
+        if(broadcast == true)
+            return;
+
+        size = m_cecFeatureAbort(buffer, lsrc, opcode, CEC_ABORT_UNRECOGNIZED);
+    }
+
+    if (0 < size && CECSendMessage(buffer, size) != size)
+        LOGE("CECSendMessage() failed!!!\n");
+}
+
+int SecHdmi::EventThread::m_cecFeatureAbort(unsigned char *buffer, unsigned char ldst,
+                                            unsigned char opcode, unsigned char reason)
+{
+    buffer[0] = (mLaddr << 4) | ldst;
+    buffer[1] = CEC_OPCODE_FEATURE_ABORT;
+    buffer[2] = opcode;
+    buffer[3] = reason;
+    return 4;
+}
+
+int SecHdmi::EventThread::m_cecGivePhysicalAddress(unsigned char *buffer, unsigned char lsrc)
+{
+    /* responce with "Report Physical Address" */
+    buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
+    buffer[1] = CEC_OPCODE_REPORT_PHYSICAL_ADDRESS;
+    buffer[2] = (mPaddr >> 8) & 0xFF;
+    buffer[3] = mPaddr & 0xFF;
+    buffer[4] = mDevtype;
+    return 5;
+}
+
+int SecHdmi::EventThread::m_cecRequestActiveSource(unsigned char *buffer, unsigned char lsrc)
+{
+    LOGD("[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]\n");
+    /* responce with "Active Source" */
+    buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
+    buffer[1] = CEC_OPCODE_ACTIVE_SOURCE;
+    buffer[2] = (mPaddr >> 8) & 0xFF;
+    buffer[3] = mPaddr & 0xFF;
+    LOGD("Tx : [CEC_OPCODE_ACTIVE_SOURCE]\n");
+    return 4;
+}
+
+int SecHdmi::EventThread::m_cecGetCECVersion(unsigned char *buffer, unsigned char lsrc)
+{
+    buffer[0] = (mLaddr << 4) | lsrc;
+    buffer[1] = CEC_OPCODE_CEC_VERSION;
+    buffer[2] = CEC_VERSION_1_3A;
+    return 3;
+}
+
+int SecHdmi::EventThread::m_cecGivePowerStatus(unsigned char *buffer, unsigned char lsrc)
+{
+    buffer[0] = (mLaddr << 4) | lsrc;
+    buffer[1] = CEC_OPCODE_REPORT_POWER_STATUS;
+    buffer[2] = CEC_POWER_STATUS_ON;
+    return 3;
+}
+
+int SecHdmi::EventThread::m_cecAbort(unsigned char *buffer, unsigned char lsrc)
+{
+    /* "Abort" is answered with "Feature Abort", reason "refused" */
+    return m_cecFeatureAbort(buffer, lsrc, CEC_OPCODE_ABORT, CEC_ABORT_REFUSED);
+}
+#endif
+
+SecHdmi::VsyncThread::~VsyncThread()
+{
+#ifdef DEBUG_HDMI_HW_LEVEL
+    LOGD("%s", __func__);
+#endif
+    if(0 < mFd)
+        fb_close(mFd);
+}
+
+bool SecHdmi::VsyncThread::threadLoop()
+{
+    if(ioctl(mFd, S5PTVFB_WAITFORVSYNC, 0) < 0)
+    {
+        LOGE("%s::S5PTVFB_WAITFORVSYNC fail(%d) \n", __func__, errno);
+        mSecHdmi->m_handleVsync(false);
+        return false;
+    }
+
+    mSecHdmi->m_handleVsync(true);
+    return true;
+}
+
+bool SecHdmi::VsyncThread::start()
+{
+    unsigned int interrupt = 1;
+
+    if(mFd <= 0)
+    {
+        // the mixer vsync is shared by all the layers,
+        // so any tvout window node can be used to wait on it.
+        mFd = fb_open(TVOUT_FB_G0);
+        if(mFd < 0)
+            return false;
+    }
+
+    if(ioctl(mFd, S5PTVFB_SET_VSYNC_INT, &interrupt) < 0)
+    {
+        LOGE("%s::S5PTVFB_SET_VSYNC_INT fail \n", __func__);
+        return false;
+    }
+
+    if(run("SecHdmi::VsyncThread", PRIORITY_URGENT_DISPLAY) != NO_ERROR)
+    {
+        LOGE("%s fail to run thread", __func__);
+        return false;
+    }
+
+    return true;
+}
+
+bool SecHdmi::VsyncThread::stop()
+{
+    unsigned int interrupt = 0;
+
+    if(requestExitAndWait() == WOULD_BLOCK)
+    {
+        LOGE("mVsyncThread.requestExitAndWait() == WOULD_BLOCK");
+        return false;
+    }
+
+    if(0 < mFd)
+        ioctl(mFd, S5PTVFB_SET_VSYNC_INT, &interrupt);
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+SecHdmi::SecHdmi():
+    mFlagCreate(false),
+    mFlagConnected(false),
+    //mFlagHdmiStart(false),
+    mHdmiDstWidth(0),
+    mHdmiDstHeight(0),
+    mHdmiSrcYAddr(0),
+    mHdmiSrcCbCrAddr(0),
+    mHdmiOutputMode(DEFAULT_OUPUT_MODE),
     mHdmiResolutionValue(DEFAULT_HDMI_RESOLUTION_VALUE), // V4L2_STD_480P_60_4_3
+    mHdmiUserResolutionValue(DEFAULT_HDMI_RESOLUTION_VALUE),
     mHdmiStdId(DEFAULT_HDMI_STD_ID), // V4L2_STD_480P_60_4_3
     mCompositeStd(DEFAULT_COMPOSITE_STD),
     mHdcpMode(false),
     mAudioMode(2),
     mUIRotVal(0),
+    mContentWidth(0),
+    mContentHeight(0),
+    mContentFps(0),
+    mContentFrameWidth(0),
+    mContentFrameHeight(0),
+    mContentFrames(0),
+    mContentFrameStart(0),
+    mContentLastFrame(0),
     mCurrentHdmiOutputMode(-1),
     mCurrentHdmiResolutionValue(0), // 1080960
     mCurrentHdcpMode(false),
@@ -1585,7 +2039,14 @@ SecHdmi::SecHdmi():
     mHdmiInfoChange(true),
     mFlagFimcStart(false),
     mFimcDstColorFormat(0),
+    mFimcOutBufNum(HDMI_FIMC_OUTPUT_BUF_NUM),
     mFimcCurrentOutBufIndex(0),
+    mFlagVsync(false),
+    mVsyncCount(0),
+    mFimcOutBufSeq(0),
+    mFimcOutBufQueued(0),
+    mFimcOutBufStalls(0),
+    mFimcOutBufReplaced(0),
     mDefaultFBFd(-1)
 {
 #ifdef DEBUG_HDMI_HW_LEVEL
@@ -1620,14 +2081,11 @@ SecHdmi::SecHdmi():
     mHdmiResolutionValueList[9]  = 4809601;
     mHdmiResolutionValueList[10] = 4809602;
 
-#if defined(BOARD_USES_CEC)
-    mCECThread = new CECThread(this);
-#endif
-
-    for(int i=0; i<HDMI_FIMC_OUTPUT_BUF_NUM; i++)
+    for(int i=0; i<HDMI_FIMC_OUTPUT_BUF_MAX; i++)
     {
         mFimcReservedMem[i]= 0;
     }
+    m_resetFimcOutBuf();
 }
 
 SecHdmi::~SecHdmi()
@@ -1647,7 +2105,7 @@ bool SecHdmi::create(void)
 {
     Mutex::Autolock lock(mLock);
     unsigned int fimcReservedMemStart;
-    unsigned int fimc_buf_size = 2<<20;
+    unsigned int fimc_buf_size = HDMI_FIMC_OUTPUT_BUF_SIZE;
     mFimcCurrentOutBufIndex = 0;
 
     if(mFlagCreate == true)
@@ -1673,10 +2131,34 @@ bool SecHdmi::create(void)
 
     fimcReservedMemStart = mSecFimc.getFimcRsrvedPhysMemAddr();
 
-    for(int i=0; i < HDMI_FIMC_OUTPUT_BUF_NUM; i++)
+    // past the reserved memory FIMC would write over other carveouts
+    mFimcOutBufNum = HDMI_FIMC_OUTPUT_BUF_NUM;
+    if(FIMC3_RESERVED_MEM_SIZE < mFimcOutBufNum * fimc_buf_size)
+    {
+        mFimcOutBufNum = FIMC3_RESERVED_MEM_SIZE / fimc_buf_size;
+        LOGE("%s::FIMC3 reserved memory (%d bytes) holds only %d of %d output buffers\n",
+                __func__, FIMC3_RESERVED_MEM_SIZE, mFimcOutBufNum, HDMI_FIMC_OUTPUT_BUF_NUM);
+    }
+    if(mFimcOutBufNum < 1)
+    {
+        LOGE("%s::no room for a FIMC output buffer fail \n", __func__);
+        goto CREATE_FAIL;
+    }
+
+    for(int i=0; i < mFimcOutBufNum; i++)
     {
         mFimcReservedMem[i] = fimcReservedMemStart + (fimc_buf_size * i);
     }
+    m_resetFimcOutBuf();
+
+    if(mVsyncThread == NULL)
+        mVsyncThread = new VsyncThread(this);
+
+    if(mEventThread == NULL)
+        mEventThread = new EventThread(this);
+
+    if(mEventThread->start() == false)
+        LOGE("%s::mEventThread start fail, no hotplug and CEC events\n", __func__);
 
 
     v4l2_std_id std_id;
@@ -1800,6 +2282,9 @@ bool SecHdmi::destroy(void)
         goto DESTROY_FAIL;
     }
 #endif
+    if(mEventThread != NULL)
+        mEventThread->stop();
+
     tvout_deinit();
 
     if(   mSecFimc.flagCreate() == true
@@ -1866,11 +2351,15 @@ bool SecHdmi::connect(void)
                 if (!EDIDClose())
                     LOGE("EDIDClose() failed!\n");
             }
+            else if (hdmi_policy_read_caps(&g_sink_caps) < 0)
+            {
+                LOGE("hdmi_policy_read_caps() failed!\n");
+            }
 #endif
 
 #if defined(BOARD_USES_CEC)
-            if(!(mCECThread->mFlagRunning))
-                mCECThread->start();
+            if(mEventThread->startCEC() == false)
+                LOGE("%s::startCEC() fail \n", __func__);
 #endif
         }
     }
@@ -1881,8 +2370,8 @@ bool SecHdmi::connect(void)
     if(mHdmiOutputMode >= HDMI_OUTPUT_MODE_YCBCR &&
             mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI)
     {
-        if(this->setHdmiResolution(mHdmiResolutionValue, true) == false)
-            LOGE("%s::setHdmiResolution(%d) fail \n", __func__, mHdmiResolutionValue);
+        if(this->setHdmiResolution(mHdmiUserResolutionValue, true) == false)
+            LOGE("%s::setHdmiResolution(%d) fail \n", __func__, mHdmiUserResolutionValue);
 
         if(this->setHdcpMode(mHdcpMode, false) == false)
             LOGE("%s::setHdcpMode(%d) fail \n", __func__, mHdcpMode);
@@ -1924,11 +2413,12 @@ bool SecHdmi::disconnect(void)
         mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI)
     {
 #if defined(BOARD_USES_CEC)
-        if(mCECThread->mFlagRunning)
-            mCECThread->stop();
+        mEventThread->stopCEC();
 #endif
 
 #if defined(BOARD_USES_EDID)
+        hdmi_policy_reset_caps(&g_sink_caps);
+
         if (!EDIDClose())
         {
             LOGE("EDIDClose() failed!\n");
@@ -2046,6 +2536,13 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
        }
        */
 
+    // video, not the UI converted by FIMC, drives the resolution policy
+    if(hdmiLayer == HDMI_LAYER_VIDEO &&
+       (srcColorFormat == HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP ||
+        srcColorFormat == HAL_PIXEL_FORMAT_YCrCb_420_SP ||
+        srcColorFormat == HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP))
+        m_trackHdmiContent(srcW, srcH);
+
     if( srcW               != mSrcWidth      [hdmiLayer] ||
         srcH               != mSrcHeight     [hdmiLayer] ||
         srcColorFormat     != mSrcColorFormat[hdmiLayer] ||
@@ -2094,18 +2591,23 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                 y_size =  ALIGN(ALIGN(srcH,128) * ALIGN(srcW, 32), SZ_8K);
             }
 
+            int index = m_getFimcOutBuf();
+            mFimcCurrentOutBufIndex = index;
+
             if( mSecFimc.setDstPhyAddr(mFimcReservedMem[mFimcCurrentOutBufIndex],
                         mFimcReservedMem[mFimcCurrentOutBufIndex] + y_size) < 0)
             {
                 LOGE("%s::mSecFimc.setDstPhyAddr(%d, %d) fail \n",
                         __func__, mFimcReservedMem[mFimcCurrentOutBufIndex],
                         mFimcReservedMem[mFimcCurrentOutBufIndex] + y_size);
+                m_putFimcOutBuf(index);
                 return false;
             }
 
             if(mSecFimc.handleOneShot() < 0)
             {
                 LOGE("%s::mSecFimc.handleOneshot() fail \n", __func__);
+                m_putFimcOutBuf(index);
                 return false;
             }
 
@@ -2127,11 +2629,7 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
                         mHdmiDstWidth, mHdmiDstHeight);
             }
 
-            mFimcCurrentOutBufIndex++;
-            if(mFimcCurrentOutBufIndex >= HDMI_FIMC_OUTPUT_BUF_NUM)
-            {
-                mFimcCurrentOutBufIndex = 0;
-            }
+            m_queueFimcOutBuf(index);
         }
 
     }
@@ -2282,7 +2780,7 @@ bool SecHdmi::setHdmiResolution(unsigned int hdmiResolutionValue, bool forceRun)
         return false;
     }
 
-    if(forceRun == false && mHdmiResolutionValue == hdmiResolutionValue)
+    if(forceRun == false && mHdmiUserResolutionValue == hdmiResolutionValue)
     {
 #ifdef DEBUG_HDMI_HW_LEVEL
         LOGD("%s::same hdmiResolutionValue(%d) \n", __func__, hdmiResolutionValue);
@@ -2290,57 +2788,90 @@ bool SecHdmi::setHdmiResolution(unsigned int hdmiResolutionValue, bool forceRun)
         return true;
     }
 
-    unsigned int newHdmiResolutionValue = hdmiResolutionValue;
-    int w = 0;
-    int h = 0;
-    v4l2_std_id std_id;
+    mHdmiUserResolutionValue = hdmiResolutionValue;
     mFimcCurrentOutBufIndex = 0;
 
-#if defined(BOARD_USES_EDID)
-    // find perfect resolutions..
-    if( hdmi_resolution_2_std_id(newHdmiResolutionValue, &w, &h, &std_id) < 0 ||
-        hdmi_check_resolution(std_id) < 0)
-    {
-        bool flagFoundIndex = false;
-        int resolutionValueIndex = m_resolutionValueIndex(newHdmiResolutionValue);
+    m_calibrateHdmiResolution();
 
-        for(int i = resolutionValueIndex + 1; i < mHdmiSizeOfResolutionValueList; i++)
-        {
-            if( hdmi_resolution_2_std_id(mHdmiResolutionValueList[i], &w, &h, &std_id) == 0 &&
-                hdmi_check_resolution(std_id) == 0)
-            {
-                newHdmiResolutionValue = mHdmiResolutionValueList[i];
-                flagFoundIndex = true;
-                break;
-            }
-        }
+    return true;
+}
 
-        if(flagFoundIndex == false)
-        {
-            LOGE("%s::hdmi cannot control this resolution(%d) fail \n", __func__, hdmiResolutionValue);
-            // Set resolution to 480P
-            newHdmiResolutionValue = mHdmiResolutionValueList[mHdmiSizeOfResolutionValueList-2];
-        }
-        else
-            LOGD("%s::HDMI resolutions size is calibrated(%d -> %d)..\n", __func__, hdmiResolutionValue, newHdmiResolutionValue);
+bool SecHdmi::setHdmiContent(int contentW, int contentH, int contentFps)
+{
+    Mutex::Autolock lock(mLock);
+
+    if(mFlagCreate == false)
+    {
+        LOGE("%s::Not Yet Created \n", __func__);
+        return false;
     }
-    else
+
+    m_setHdmiContent(contentW, contentH, contentFps);
+
+    return true;
+}
+
+void SecHdmi::m_setHdmiContent(int contentW, int contentH, int contentFps)
+{
+    if(contentW     == mContentWidth  &&
+       contentH     == mContentHeight &&
+       contentFps   == mContentFps)
+        return;
+
+    mContentWidth  = contentW;
+    mContentHeight = contentH;
+    mContentFps    = contentFps;
+
+    if(mFlagConnected == true &&
+       mHdmiOutputMode >= HDMI_OUTPUT_MODE_YCBCR &&
+       mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI)
+        m_calibrateHdmiResolution();
+}
+
+// Video frames given to flush() : the size is known at once, the rate is
+// measured over HDMI_CONTENT_FPS_FRAMES frames and snapped to the usual
+// video rates, so the mode changes only when the content really does.
+void SecHdmi::m_trackHdmiContent(int srcW, int srcH)
+{
+    static const int videoFps[] = { 24, 25, 30, 50, 60 };
+    nsecs_t now = systemTime();
+    nsecs_t lastFrame = mContentLastFrame;
+
+    mContentLastFrame = now;
+
+    // a new size or a pause between two frames restarts the measurement,
+    // however long the HDMI_CONTENT_FPS_FRAMES frames take at slow rates
+    if(srcW != mContentFrameWidth || srcH != mContentFrameHeight ||
+       mContentFrameStart == 0 || lastFrame == 0 ||
+       milliseconds(HDMI_CONTENT_PAUSE_MS) < now - lastFrame)
     {
-#ifdef DEBUG_HDMI_HW_LEVEL
-        LOGD("%s::find resolutions(%d) at once\n", __func__, hdmiResolutionValue);
-#endif
+        mContentFrameWidth  = srcW;
+        mContentFrameHeight = srcH;
+        mContentFrames      = 0;
+        mContentFrameStart  = now;
+        return;
     }
-#endif
 
-    if(mHdmiResolutionValue != newHdmiResolutionValue)
+    if(++mContentFrames < HDMI_CONTENT_FPS_FRAMES)
+        return;
+
+    int fps = (int)((mContentFrames * seconds(1) + (now - mContentFrameStart) / 2)
+                    / (now - mContentFrameStart));
+
+    for(unsigned int i = 0; i < sizeof(videoFps) / sizeof(videoFps[0]); i++)
     {
-        mHdmiResolutionValue = newHdmiResolutionValue;
-        mHdmiInfoChange = true;
+        if(abs(fps - videoFps[i]) * 10 <= videoFps[i])
+        {
+            fps = videoFps[i];
+            break;
+        }
     }
 
-    return true;
-}
+    mContentFrames     = 0;
+    mContentFrameStart = now;
 
+    m_setHdmiContent(srcW, srcH, fps);
+}
 
 bool SecHdmi::setHdcpMode(bool hdcpMode, bool forceRun)
 {
@@ -2390,6 +2921,31 @@ bool SecHdmi::setUIRotation(unsigned int rotVal)
     return true;
 }
 
+#if defined(BOARD_USES_CEC)
+bool SecHdmi::startCEC(int fd, int laddr, int paddr)
+{
+    Mutex::Autolock lock(mLock);
+
+    if(mFlagCreate == false || mEventThread == NULL)
+    {
+        LOGE("%s::Not Yet Created \n", __func__);
+        return false;
+    }
+
+    return mEventThread->startCEC(fd, laddr, paddr);
+}
+
+bool SecHdmi::stopCEC(void)
+{
+    Mutex::Autolock lock(mLock);
+
+    if(mEventThread == NULL)
+        return true;
+
+    return mEventThread->stopCEC();
+}
+#endif
+
 bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer)
 {
 #ifdef DEBUG_HDMI_HW_LEVEL
@@ -2477,8 +3033,7 @@ bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer)
         if( mHdmiOutputMode >= HDMI_OUTPUT_MODE_YCBCR &&
             mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI)
         {
-            if(mCECThread->mFlagRunning)
-                mCECThread->stop();
+            mEventThread->stopCEC();
         }
 #endif
 
@@ -2563,8 +3118,8 @@ bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer)
             mHdmiOutputMode <= HDMI_OUTPUT_MODE_DVI)
         {
 #if defined(BOARD_USES_CEC)
-            if(!(mCECThread->mFlagRunning))
-                mCECThread->start();
+            if(mEventThread->startCEC() == false)
+                LOGE("%s::startCEC() fail \n", __func__);
 #endif
 
             if(m_setAudioMode(mAudioMode) == false)
@@ -2597,6 +3152,9 @@ bool SecHdmi::m_startHdmi(int hdmiLayer)
     case HDMI_LAYER_VIDEO:
         tvout_v4l2_start_overlay(fp_tvout_v);
         mFlagHdmiStart[hdmiLayer] = true;
+
+        if(mVsyncThread != NULL && mVsyncThread->start() == false)
+            LOGE("%s::mVsyncThread start fail, FIMC buffers are reused without vsync\n", __func__);
         break;
     case HDMI_LAYER_GRAPHIC_0 :
         if(mFlagLayerEnable[hdmiLayer])
@@ -2639,19 +3197,32 @@ bool SecHdmi::m_stopHdmi(int hdmiLayer)
     switch(hdmiLayer)
     {
     case HDMI_LAYER_VIDEO:
+        if(mVsyncThread != NULL)
+            mVsyncThread->stop();
+
         tvout_v4l2_stop_overlay(fp_tvout_v);
+        hdmi_invalidate_layer_state(hdmiLayer);
+        m_dumpFimcOutBuf();
+        m_resetFimcOutBuf();
         mFlagHdmiStart[hdmiLayer] = false;
+
+        // back to the mode for the UI alone
+        mContentFrameStart = 0;
+        mContentLastFrame  = 0;
+        m_setHdmiContent(0, 0, 0);
         break;
     case HDMI_LAYER_GRAPHIC_0 :
         if(mFlagLayerEnable[hdmiLayer])
         {
             ioctl(fp_tvout_g0, FBIOBLANK, (void *)FB_BLANK_POWERDOWN);
+            hdmi_invalidate_layer_state(hdmiLayer);
             mFlagHdmiStart[hdmiLayer] = false;
         }
     case HDMI_LAYER_GRAPHIC_1 :
         if(mFlagLayerEnable[hdmiLayer])
         {
             ioctl(fp_tvout_g1, FBIOBLANK, (void *)FB_BLANK_POWERDOWN);
+            hdmi_invalidate_layer_state(hdmiLayer);
             mFlagHdmiStart[hdmiLayer] = false;
         }
         break;
@@ -2835,6 +3406,216 @@ bool SecHdmi::m_setAudioMode(int audioMode)
     return true;
 }
 
+void SecHdmi::m_resetFimcOutBuf(void)
+{
+    Mutex::Autolock lock(mFimcOutBufLock);
+
+    for(int i = 0; i < mFimcOutBufNum; i++)
+    {
+        mFimcOutBuf[i].state      = FIMC_OUT_BUF_FREE;
+        mFimcOutBuf[i].seq        = 0;
+        mFimcOutBuf[i].queueVsync = 0;
+        mFimcOutBuf[i].queueTime  = 0;
+        mFimcOutBuf[i].frames     = 0;
+        mFimcOutBuf[i].latencySum = 0;
+        mFimcOutBuf[i].latencyMax = 0;
+    }
+
+    mFlagVsync          = false;
+    mFimcOutBufQueued   = 0;
+    mFimcOutBufStalls   = 0;
+    mFimcOutBufReplaced = 0;
+
+    mFimcOutBufCondition.broadcast();
+}
+
+int SecHdmi::m_getFimcOutBuf(void)
+{
+    Mutex::Autolock lock(mFimcOutBufLock);
+    int index = -1;
+
+    while(1)
+    {
+        for(int i = 0; i < mFimcOutBufNum; i++)
+        {
+            if(mFimcOutBuf[i].state == FIMC_OUT_BUF_FREE)
+            {
+                index = i;
+                break;
+            }
+        }
+
+        if(0 <= index || mFlagVsync == false)
+            break;
+
+        // FIMC is ahead of the mixer : wait until it releases one.
+        if(mFimcOutBufCondition.waitRelative(mFimcOutBufLock, ms2ns(50)) != NO_ERROR)
+        {
+            mFimcOutBufStalls++;
+            break;
+        }
+    }
+
+    if(index < 0)
+    {
+        // no vsync information : take the oldest buffer,
+        // which keeps the old round robin behavior.
+        for(int i = 0; i < mFimcOutBufNum; i++)
+        {
+            if(mFimcOutBuf[i].state == FIMC_OUT_BUF_FIMC)
+                continue;
+
+            if(index < 0 || mFimcOutBuf[i].seq < mFimcOutBuf[index].seq)
+                index = i;
+        }
+    }
+
+    mFimcOutBuf[index].state = FIMC_OUT_BUF_FIMC;
+
+    return index;
+}
+
+void SecHdmi::m_queueFimcOutBuf(int index)
+{
+    bool flagDump;
+
+    {
+        Mutex::Autolock lock(mFimcOutBufLock);
+
+        mFimcOutBuf[index].state      = FIMC_OUT_BUF_QUEUED;
+        mFimcOutBuf[index].seq        = ++mFimcOutBufSeq;
+        mFimcOutBuf[index].queueVsync = mVsyncCount;
+        mFimcOutBuf[index].queueTime  = systemTime();
+
+        mFimcOutBufQueued++;
+        flagDump = (mFimcOutBufQueued % HDMI_FIMC_OUT_BUF_STAT_FRAMES) == 0;
+    }
+
+    if(flagDump == true)
+        m_dumpFimcOutBuf();
+}
+
+void SecHdmi::m_putFimcOutBuf(int index)
+{
+    Mutex::Autolock lock(mFimcOutBufLock);
+
+    mFimcOutBuf[index].state = FIMC_OUT_BUF_FREE;
+    mFimcOutBufCondition.signal();
+}
+
+void SecHdmi::m_handleVsync(bool flagVsync)
+{
+    Mutex::Autolock lock(mFimcOutBufLock);
+    nsecs_t now = systemTime();
+    int newest = -1;
+
+    mFlagVsync = flagVsync;
+    if(flagVsync == false)
+    {
+        mFimcOutBufCondition.broadcast();
+        return;
+    }
+
+    mVsyncCount++;
+
+    // a buffer queued before vsync N may be latched at vsync N or N+1,
+    // depending on when this thread woke up. it is only known to be
+    // on screen after the second vsync.
+    for(int i = 0; i < mFimcOutBufNum; i++)
+    {
+        if(mFimcOutBuf[i].state != FIMC_OUT_BUF_QUEUED &&
+           mFimcOutBuf[i].state != FIMC_OUT_BUF_ON_SCREEN)
+            continue;
+
+        if(mFimcOutBuf[i].state == FIMC_OUT_BUF_QUEUED &&
+           mVsyncCount - mFimcOutBuf[i].queueVsync < 2)
+            continue;
+
+        if(newest < 0 || mFimcOutBuf[newest].seq < mFimcOutBuf[i].seq)
+            newest = i;
+    }
+
+    if(newest < 0 || mFimcOutBuf[newest].state == FIMC_OUT_BUF_ON_SCREEN)
+        return;
+
+    nsecs_t latency = now - mFimcOutBuf[newest].queueTime;
+
+    mFimcOutBuf[newest].state = FIMC_OUT_BUF_ON_SCREEN;
+    mFimcOutBuf[newest].frames++;
+    mFimcOutBuf[newest].latencySum += latency;
+    if(mFimcOutBuf[newest].latencyMax < latency)
+        mFimcOutBuf[newest].latencyMax = latency;
+
+    // everything older is not scanned out anymore
+    for(int i = 0; i < mFimcOutBufNum; i++)
+    {
+        if(i == newest || mFimcOutBuf[newest].seq < mFimcOutBuf[i].seq)
+            continue;
+
+        if(mFimcOutBuf[i].state == FIMC_OUT_BUF_QUEUED)
+            mFimcOutBufReplaced++;
+        else if(mFimcOutBuf[i].state != FIMC_OUT_BUF_ON_SCREEN)
+            continue;
+
+        mFimcOutBuf[i].state = FIMC_OUT_BUF_FREE;
+    }
+
+    mFimcOutBufCondition.broadcast();
+}
+
+void SecHdmi::m_dumpFimcOutBuf(void)
+{
+    Mutex::Autolock lock(mFimcOutBufLock);
+
+    if(mFimcOutBufQueued == 0)
+        return;
+
+    LOGV("%s::%d frames queued, %d stalls, %d replaced before scan out\n",
+            __func__, mFimcOutBufQueued, mFimcOutBufStalls, mFimcOutBufReplaced);
+
+    for(int i = 0; i < mFimcOutBufNum; i++)
+    {
+        if(mFimcOutBuf[i].frames == 0)
+            continue;
+
+        LOGV("%s::buf[%d] %d frames, latency avg %lld us max %lld us\n",
+                __func__, i, mFimcOutBuf[i].frames,
+                ns2us(mFimcOutBuf[i].latencySum / mFimcOutBuf[i].frames),
+                ns2us(mFimcOutBuf[i].latencyMax));
+    }
+}
+
+void SecHdmi::m_calibrateHdmiResolution(void)
+{
+    unsigned int newHdmiResolutionValue = mHdmiUserResolutionValue;
+
+#if defined(BOARD_USES_EDID)
+    if(g_sink_caps.valid == 0)
+        hdmi_policy_read_caps(&g_sink_caps);
+
+    newHdmiResolutionValue = hdmi_policy_choose_mode(&g_sink_caps,
+                                                     mHdmiUserResolutionValue,
+                                                     mContentWidth,
+                                                     mContentHeight,
+                                                     mContentFps);
+
+    if(g_sink_caps.valid == 0 || newHdmiResolutionValue == 0)
+    {
+        LOGE("%s::hdmi cannot control this resolution(%d) fail \n", __func__, mHdmiUserResolutionValue);
+        // Set resolution to 480P
+        newHdmiResolutionValue = mHdmiResolutionValueList[mHdmiSizeOfResolutionValueList-2];
+    }
+    else if(newHdmiResolutionValue != mHdmiUserResolutionValue)
+        LOGD("%s::HDMI resolutions size is calibrated(%d -> %d)..\n", __func__, mHdmiUserResolutionValue, newHdmiResolutionValue);
+#endif
+
+    if(mHdmiResolutionValue != newHdmiResolutionValue)
+    {
+        mHdmiResolutionValue = newHdmiResolutionValue;
+        mHdmiInfoChange = true;
+    }
+}
+
 int SecHdmi::m_resolutionValueIndex(unsigned int ResolutionValue)
 {
     int index = -1;
@@ -2858,7 +3639,14 @@ bool SecHdmi::m_flagHWConnected(void)
 #endif
 
     bool ret = true;
-    int hdmiStatus = hdmi_cable_status();
+    int hdmiStatus = -1;
+
+    // the event thread tracks hotplug, ask the driver only without uevents
+    if(mEventThread != NULL)
+        hdmiStatus = mEventThread->hpdState();
+
+    if(hdmiStatus < 0)
+        hdmiStatus = hdmi_cable_status();
 
     if(hdmiStatus <= 0)
     {
@@ -31,6 +31,7 @@
 #include <cutils/log.h>
 
 #include "fimd_api.h"
+#include "sec_v4l2_shim.h"
 
 int fb_open(int win)
 {
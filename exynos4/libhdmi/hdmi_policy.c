@@ -0,0 +1,283 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "libhdmi"
+#include <cutils/log.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hdmi_policy.h"
+#include "../libsForhdmi/libedid/libedid.h"
+
+/*
+ * Output timings, from the biggest to the smallest.
+ * keep in sync with SecHdmi::mHdmiResolutionValueList.
+ */
+static const struct hdmi_mode hdmi_modes[] =
+{
+    { 1080960, V4L2_STD_1080P_60,     v1920x1080p_60Hz, HDMI_PIXEL_RATIO_16_9, 1920, 1080, 60, 0, 16, 9 },
+    { 1080950, V4L2_STD_1080P_50,     v1920x1080p_50Hz, HDMI_PIXEL_RATIO_16_9, 1920, 1080, 50, 0, 16, 9 },
+    { 1080930, V4L2_STD_1080P_30,     v1920x1080p_30Hz, HDMI_PIXEL_RATIO_16_9, 1920, 1080, 30, 0, 16, 9 },
+    { 1080160, V4L2_STD_1080I_60,     v1920x1080i_60Hz, HDMI_PIXEL_RATIO_16_9, 1920, 1080, 60, 1, 16, 9 },
+    { 1080150, V4L2_STD_1080I_50,     v1920x1080i_50Hz, HDMI_PIXEL_RATIO_16_9, 1920, 1080, 50, 1, 16, 9 },
+    {  720960, V4L2_STD_720P_60,      v1280x720p_60Hz,  HDMI_PIXEL_RATIO_16_9, 1280,  720, 60, 0, 16, 9 },
+    {  720950, V4L2_STD_720P_50,      v1280x720p_50Hz,  HDMI_PIXEL_RATIO_16_9, 1280,  720, 50, 0, 16, 9 },
+    { 5769501, V4L2_STD_576P_50_16_9, v720x576p_50Hz,   HDMI_PIXEL_RATIO_16_9,  720,  576, 50, 0, 16, 9 },
+    { 5769502, V4L2_STD_576P_50_4_3,  v720x576p_50Hz,   HDMI_PIXEL_RATIO_4_3,   720,  576, 50, 0,  4, 3 },
+    { 4809601, V4L2_STD_480P_60_16_9, v720x480p_60Hz,   HDMI_PIXEL_RATIO_16_9,  720,  480, 60, 0, 16, 9 },
+    { 4809602, V4L2_STD_480P_60_4_3,  v720x480p_60Hz,   HDMI_PIXEL_RATIO_4_3,   720,  480, 60, 0,  4, 3 },
+};
+
+#define HDMI_NUM_MODES ((int)(sizeof(hdmi_modes) / sizeof(hdmi_modes[0])))
+
+int hdmi_policy_num_modes(void)
+{
+    return HDMI_NUM_MODES;
+}
+
+const struct hdmi_mode *hdmi_policy_mode(int index)
+{
+    if (index < 0 || HDMI_NUM_MODES <= index)
+        return NULL;
+
+    return &hdmi_modes[index];
+}
+
+int hdmi_policy_mode_index(unsigned int resolution_value)
+{
+    int i;
+
+    for (i = 0; i < HDMI_NUM_MODES; i++) {
+        if (hdmi_modes[i].resolution_value == resolution_value)
+            return i;
+    }
+    return -1;
+}
+
+const struct hdmi_mode *hdmi_policy_find_std(v4l2_std_id std_id)
+{
+    int i;
+
+    for (i = 0; i < HDMI_NUM_MODES; i++) {
+        if (hdmi_modes[i].std_id == std_id)
+            return &hdmi_modes[i];
+    }
+    return NULL;
+}
+
+void hdmi_policy_reset_caps(struct hdmi_sink_caps *caps)
+{
+    memset(caps, 0, sizeof(*caps));
+}
+
+/*
+ * Ask libedid everything the policy needs, once.
+ * Afterwards mode and colour decisions are bit tests on caps.
+ */
+int hdmi_policy_read_caps(struct hdmi_sink_caps *caps)
+{
+    struct HDMIVideoParameter video;
+    int i;
+
+    hdmi_policy_reset_caps(caps);
+
+    if (!EDIDRead()) {
+        LOGE("%s::EDIDRead() fail\n", __func__);
+        return -1;
+    }
+
+    memset(&video, 0, sizeof(video));
+
+    video.mode = HDMI;
+    caps->hdmi = EDIDHDMIModeSupport(&video) ? 1 : 0;
+
+    video.colorSpace = HDMI_CS_YCBCR444;
+    caps->ycbcr444 = EDIDColorSpaceSupport(&video) ? 1 : 0;
+    video.colorSpace = HDMI_CS_YCBCR422;
+    caps->ycbcr422 = EDIDColorSpaceSupport(&video) ? 1 : 0;
+
+    video.colorSpace = HDMI_CS_RGB;
+    video.colorDepth = HDMI_CD_30;
+    caps->dc30 = EDIDColorDepthSupport(&video) ? 1 : 0;
+    video.colorDepth = HDMI_CD_36;
+    caps->dc36 = EDIDColorDepthSupport(&video) ? 1 : 0;
+
+    video.colorimetry = HDMI_COLORIMETRY_EXTENDED_xvYCC601;
+    caps->xvycc601 = EDIDColorimetrySupport(&video) ? 1 : 0;
+    video.colorimetry = HDMI_COLORIMETRY_EXTENDED_xvYCC709;
+    caps->xvycc709 = EDIDColorimetrySupport(&video) ? 1 : 0;
+
+    for (i = 0; i < HDMI_NUM_MODES; i++) {
+        video.resolution       = hdmi_modes[i].format;
+        video.pixelAspectRatio = hdmi_modes[i].ratio;
+        if (EDIDVideoResolutionSupport(&video))
+            caps->modes |= (1 << i);
+    }
+
+    caps->valid = 1;
+
+    LOGI("%s::hdmi(%d) ycbcr(444:%d 422:%d) dc(30:%d 36:%d) xvycc(601:%d 709:%d) modes(0x%03x)\n",
+         __func__, caps->hdmi, caps->ycbcr444, caps->ycbcr422,
+         caps->dc30, caps->dc36, caps->xvycc601, caps->xvycc709, caps->modes);
+
+    return 0;
+}
+
+int hdmi_policy_mode_supported(const struct hdmi_sink_caps *caps,
+                               unsigned int resolution_value)
+{
+    int index = hdmi_policy_mode_index(resolution_value);
+
+    if (index < 0 || !caps->valid)
+        return 0;
+
+    return (caps->modes & (1 << index)) ? 1 : 0;
+}
+
+/*
+ * Largest rect with the source aspect ratio that fits in dst_w x dst_h,
+ * centered. dar_w:dar_h is the display aspect ratio of the output mode,
+ * so anamorphic modes (720x480 16:9) letterbox correctly.
+ * Source pixels are square.
+ */
+void hdmi_policy_letterbox(int src_w, int src_h,
+                           int dst_w, int dst_h,
+                           int dar_w, int dar_h,
+                           struct hdmi_rect *rect)
+{
+    long long w = dst_w;
+    long long h = dst_h;
+
+    if (dar_w <= 0 || dar_h <= 0) {
+        dar_w = dst_w;
+        dar_h = dst_h;
+    }
+
+    if (0 < src_w && 0 < src_h) {
+        if ((long long)src_w * dar_h <= (long long)src_h * dar_w) {
+            // narrow source : pillarbox
+            w = ((long long)dst_w * src_w * dar_h) / ((long long)src_h * dar_w);
+        } else {
+            // wide source : letterbox
+            h = ((long long)dst_h * src_h * dar_w) / ((long long)src_w * dar_h);
+        }
+    }
+
+    // the mixer and the video processor want even sizes and offsets
+    rect->w = (int)w & ~1;
+    rect->h = (int)h & ~1;
+    rect->x = ((dst_w - rect->w) >> 1) & ~1;
+    rect->y = ((dst_h - rect->h) >> 1) & ~1;
+}
+
+/*
+ * Scaling work of showing content_w x content_h on a mode, in pixels per
+ * frame the scaler has to create or drop, plus penalties for uneven frame
+ * cadence and for interlaced output.
+ */
+static long long hdmi_policy_mode_cost(const struct hdmi_mode *mode,
+                                       int content_w, int content_h,
+                                       int content_fps)
+{
+    struct hdmi_rect rect;
+    long long mode_area = (long long)mode->width * mode->height;
+    long long cost;
+
+    hdmi_policy_letterbox(content_w, content_h, mode->width, mode->height,
+                          mode->dar_w, mode->dar_h, &rect);
+
+    cost = llabs((long long)rect.w * rect.h - (long long)content_w * content_h);
+
+    // 24/25/30 fps on a refresh that is not a multiple of it judders
+    if (0 < content_fps && mode->refresh % content_fps != 0)
+        cost += mode_area / 2;
+
+    if (mode->interlaced)
+        cost += mode_area / 4;
+
+    return cost;
+}
+
+/*
+ * Pick the output mode for the content.
+ * requested is the resolution chosen by the user and is used as a ceiling:
+ * content is never shown on a bigger mode than that.
+ * Without content information, the supported mode closest to the requested
+ * one wins. Returns 0 if the sink supports none of the modes.
+ */
+unsigned int hdmi_policy_choose_mode(const struct hdmi_sink_caps *caps,
+                                     unsigned int requested,
+                                     int content_w, int content_h,
+                                     int content_fps)
+{
+    int req_index = hdmi_policy_mode_index(requested);
+    long long ceiling = 0;
+    long long best_cost = 0;
+    int best = -1;
+    int i;
+
+    if (!caps->valid)
+        return requested;
+
+    if (0 <= req_index) {
+        const struct hdmi_mode *req = &hdmi_modes[req_index];
+
+        ceiling = (long long)req->width * req->height;
+
+        if (content_w <= 0 || content_h <= 0) {
+            if (caps->modes & (1 << req_index))
+                return requested;
+
+            content_w   = req->width;
+            content_h   = req->height;
+            content_fps = req->refresh;
+            ceiling     = 0;
+        }
+    } else if (content_w <= 0 || content_h <= 0) {
+        return 0;
+    }
+
+    for (i = 0; i < HDMI_NUM_MODES; i++) {
+        const struct hdmi_mode *mode = &hdmi_modes[i];
+        long long cost;
+
+        if (!(caps->modes & (1 << i)))
+            continue;
+
+        if (ceiling && ceiling < (long long)mode->width * mode->height)
+            continue;
+
+        cost = hdmi_policy_mode_cost(mode, content_w, content_h, content_fps);
+
+        // on a tie keep the requested mode, then the bigger one
+        if (best < 0 || cost < best_cost ||
+            (cost == best_cost && i == req_index)) {
+            best      = i;
+            best_cost = cost;
+        }
+    }
+
+    if (best < 0)
+        return 0;
+
+    LOGV("%s::content(%dx%d@%d) requested(%d) -> %d (cost %lld)\n", __func__,
+         content_w, content_h, content_fps, requested,
+         hdmi_modes[best].resolution_value, best_cost);
+
+    return hdmi_modes[best].resolution_value;
+}
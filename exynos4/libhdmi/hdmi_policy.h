@@ -0,0 +1,88 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HDMI_POLICY_H__
+#define __HDMI_POLICY_H__
+
+#include "s5p_tvout.h"
+#include "video.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! One HDMI output timing selectable by SecHdmi::setHdmiResolution()
+struct hdmi_mode
+{
+    unsigned int          resolution_value; // 1080960, 720950, 4809602 ...
+    v4l2_std_id           std_id;
+    enum VideoFormat      format;
+    enum PixelAspectRatio ratio;
+    int                   width;
+    int                   height;
+    int                   refresh;          // field rate for interlaced modes
+    int                   interlaced;
+    int                   dar_w;            // display aspect ratio
+    int                   dar_h;
+};
+
+//! What the sink can show, read from EDID once per hotplug
+struct hdmi_sink_caps
+{
+    int          valid;
+    int          hdmi;          // HDMI VSDB present, otherwise DVI
+    int          ycbcr444;
+    int          ycbcr422;
+    int          dc30;          // deep colour, bits per component
+    int          dc36;
+    int          xvycc601;
+    int          xvycc709;
+    unsigned int modes;         // bit n set if hdmi_policy_mode(n) is supported
+};
+
+struct hdmi_rect
+{
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+int                       hdmi_policy_num_modes(void);
+const struct hdmi_mode   *hdmi_policy_mode(int index);
+int                       hdmi_policy_mode_index(unsigned int resolution_value);
+const struct hdmi_mode   *hdmi_policy_find_std(v4l2_std_id std_id);
+
+int  hdmi_policy_read_caps(struct hdmi_sink_caps *caps);
+void hdmi_policy_reset_caps(struct hdmi_sink_caps *caps);
+int  hdmi_policy_mode_supported(const struct hdmi_sink_caps *caps,
+                                unsigned int resolution_value);
+
+unsigned int hdmi_policy_choose_mode(const struct hdmi_sink_caps *caps,
+                                     unsigned int requested,
+                                     int content_w, int content_h,
+                                     int content_fps);
+
+void hdmi_policy_letterbox(int src_w, int src_h,
+                           int dst_w, int dst_h,
+                           int dar_w, int dar_h,
+                           struct hdmi_rect *rect);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HDMI_POLICY_H__ */
@@ -0,0 +1,88 @@
+# Copyright (C) 2008 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+ifeq ($(BOARD_USES_HDMI),true)
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# libhdmi is built in, routed to the emulator, with CEC forced on
+LOCAL_SRC_FILES := \
+        hdmi_cec_test.cpp \
+        ../SecHdmi.cpp \
+        ../fimd_api.c \
+        ../hdmi_policy.c \
+        ../../libfimc/SecFimc.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM -DBOARD_USES_CEC -DSLSI_S5PC210
+LOCAL_CFLAGS += -DDEFAULT_FB_NUM=$(DEFAULT_FB_NUM)
+
+LOCAL_STATIC_LIBRARIES := libv4l2shim_static
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libedid libcec
+
+LOCAL_MODULE := hdmi_cec_test
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# ioctls per mirrored frame, recorded by the emulator
+LOCAL_SRC_FILES := \
+        hdmi_flush_test.cpp \
+        ../SecHdmi.cpp \
+        ../fimd_api.c \
+        ../hdmi_policy.c \
+        ../../libfimc/SecFimc.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM -DSLSI_S5PC210
+LOCAL_CFLAGS += -DDEFAULT_FB_NUM=$(DEFAULT_FB_NUM)
+
+LOCAL_STATIC_LIBRARIES := libv4l2shim_static
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libedid libcec
+
+LOCAL_MODULE := hdmi_flush_test
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# sink capabilities and mode choice over a corpus of EDIDs, no DDC
+LOCAL_SRC_FILES := \
+        hdmi_edid_test.cpp \
+        ../hdmi_policy.c
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS += -DSLSI_S5PC210
+
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils libedid
+
+LOCAL_MODULE := hdmi_edid_test
+include $(BUILD_EXECUTABLE)
+
+endif
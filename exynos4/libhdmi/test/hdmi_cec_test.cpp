@@ -0,0 +1,220 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Drives the SecHdmi event loop CEC handlers through one end of a
+ * socketpair standing in for the CEC device, with the tvout nodes on
+ * the userspace emulator. Returns 0 when every check passes.
+ */
+
+#define LOG_TAG "hdmi_cec_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "SecHdmi.h"
+#include "sec_v4l2_shim.h"
+
+using namespace android;
+
+#define TEST_LADDR          (4)       // playback device 1
+#define TEST_PADDR          (0x1000)  // 1.0.0.0
+#define TEST_PEER           (0)       // the TV
+#define REPLY_TIMEOUT_MS    (1000)
+#define NO_REPLY_MS         (200)
+
+#define CEC_VERSION_1_3A        (0x04)
+#define CEC_POWER_STATUS_ON     (0x00)
+#define CEC_ABORT_UNRECOGNIZED  (0x00)
+#define CEC_ABORT_REFUSED       (0x04)
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            g_failures++;                                               \
+        }                                                               \
+    } while (0)
+
+static void add_nodes(void)
+{
+    struct sec_v4l2_emul_config config;
+    char path[32];
+
+    memset(&config, 0, sizeof(config));
+
+    for (int i = 0; i < 4; i++) {
+        config.phys_base = 0x50000000 + (i << 24);
+        snprintf(path, sizeof(path), "/dev/video%d", i);
+        sec_v4l2_emul_add_node(path, SEC_V4L2_EMUL_OUTPUT, &config);
+    }
+
+    config.phys_base = 0x60000000;
+    sec_v4l2_emul_add_node(TVOUT_DEV,   SEC_V4L2_EMUL_OUTPUT, &config);
+    sec_v4l2_emul_add_node(TVOUT_DEV_V, SEC_V4L2_EMUL_OUTPUT, &config);
+    sec_v4l2_emul_add_node(HPD_DEV,     SEC_V4L2_EMUL_HPD,    &config);
+
+    config.width  = 1920;
+    config.height = 1080;
+    config.bpp    = 32;
+    config.phys_base = 0x70000000;
+    sec_v4l2_emul_add_node("/dev/graphics/fb0",  SEC_V4L2_EMUL_FB, &config);
+    sec_v4l2_emul_add_node("/dev/graphics/fb10", SEC_V4L2_EMUL_FB, &config);
+    sec_v4l2_emul_add_node("/dev/graphics/fb11", SEC_V4L2_EMUL_FB, &config);
+}
+
+// one message, the socketpair keeps the frame boundaries
+static int transact(int fd, const unsigned char *msg, int size,
+                    unsigned char *reply, int timeoutMs)
+{
+    struct pollfd pfd;
+
+    if (write(fd, msg, size) != size)
+        return -1;
+
+    pfd.fd      = fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeoutMs) <= 0)
+        return 0;
+
+    return read(fd, reply, CEC_MAX_FRAME_SIZE);
+}
+
+static void test_replies(int fd)
+{
+    unsigned char reply[CEC_MAX_FRAME_SIZE];
+    const unsigned char dst = (TEST_PEER << 4) | TEST_LADDR;
+    const unsigned char from = (TEST_LADDR << 4) | TEST_PEER;
+
+    // physical address goes out broadcast, with the device type
+    {
+        const unsigned char msg[] = { dst, CEC_OPCODE_GIVE_PHYSICAL_ADDRESS };
+        CHECK(transact(fd, msg, sizeof(msg), reply, REPLY_TIMEOUT_MS) == 5);
+        CHECK(reply[0] == ((TEST_LADDR << 4) | CEC_MSG_BROADCAST));
+        CHECK(reply[1] == CEC_OPCODE_REPORT_PHYSICAL_ADDRESS);
+        CHECK(reply[2] == (TEST_PADDR >> 8));
+        CHECK(reply[3] == (TEST_PADDR & 0xFF));
+        CHECK(reply[4] == CEC_DEVICE_PLAYER);
+    }
+
+    {
+        const unsigned char msg[] = { dst, CEC_OPCODE_GET_CEC_VERSION };
+        CHECK(transact(fd, msg, sizeof(msg), reply, REPLY_TIMEOUT_MS) == 3);
+        CHECK(reply[0] == from);
+        CHECK(reply[1] == CEC_OPCODE_CEC_VERSION);
+        CHECK(reply[2] == CEC_VERSION_1_3A);
+    }
+
+    {
+        const unsigned char msg[] = { dst, CEC_OPCODE_GIVE_DEVICE_POWER_STATUS };
+        CHECK(transact(fd, msg, sizeof(msg), reply, REPLY_TIMEOUT_MS) == 3);
+        CHECK(reply[0] == from);
+        CHECK(reply[1] == CEC_OPCODE_REPORT_POWER_STATUS);
+        CHECK(reply[2] == CEC_POWER_STATUS_ON);
+    }
+
+    {
+        const unsigned char msg[] = { dst, CEC_OPCODE_ABORT };
+        CHECK(transact(fd, msg, sizeof(msg), reply, REPLY_TIMEOUT_MS) == 4);
+        CHECK(reply[0] == from);
+        CHECK(reply[1] == CEC_OPCODE_FEATURE_ABORT);
+        CHECK(reply[2] == CEC_OPCODE_ABORT);
+        CHECK(reply[3] == CEC_ABORT_REFUSED);
+    }
+
+    // a directed opcode nobody handles is refused as unrecognized
+    {
+        const unsigned char msg[] = { dst, 0x46 /* GIVE_OSD_NAME */ };
+        CHECK(transact(fd, msg, sizeof(msg), reply, REPLY_TIMEOUT_MS) == 4);
+        CHECK(reply[0] == from);
+        CHECK(reply[1] == CEC_OPCODE_FEATURE_ABORT);
+        CHECK(reply[2] == 0x46);
+        CHECK(reply[3] == CEC_ABORT_UNRECOGNIZED);
+    }
+}
+
+static void test_silence(int fd)
+{
+    unsigned char reply[CEC_MAX_FRAME_SIZE];
+
+    // unknown broadcasts are not answered
+    {
+        const unsigned char msg[] = { (TEST_PEER << 4) | CEC_MSG_BROADCAST, 0x46 };
+        CHECK(transact(fd, msg, sizeof(msg), reply, NO_REPLY_MS) == 0);
+    }
+
+    // nor is our own echo
+    {
+        const unsigned char msg[] = { (TEST_LADDR << 4) | TEST_PEER,
+                                      CEC_OPCODE_GET_CEC_VERSION };
+        CHECK(transact(fd, msg, sizeof(msg), reply, NO_REPLY_MS) == 0);
+    }
+
+    // nor a directed-only opcode that came broadcast
+    {
+        const unsigned char msg[] = { (TEST_PEER << 4) | CEC_MSG_BROADCAST,
+                                      CEC_OPCODE_GIVE_PHYSICAL_ADDRESS };
+        CHECK(transact(fd, msg, sizeof(msg), reply, NO_REPLY_MS) == 0);
+    }
+
+    // polling message
+    {
+        const unsigned char msg[] = { (TEST_PEER << 4) | TEST_LADDR };
+        CHECK(transact(fd, msg, sizeof(msg), reply, NO_REPLY_MS) == 0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int sv[2];
+
+    add_nodes();
+    sec_v4l2_emul_install();
+
+    sp<SecHdmi> hdmi = new SecHdmi;
+    CHECK(hdmi->create() == true);
+
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    CHECK(hdmi->startCEC(sv[0], TEST_LADDR, TEST_PADDR) == true);
+
+    test_replies(sv[1]);
+    test_silence(sv[1]);
+
+    // the seam owns sv[0] from here, stopCEC() closes it
+    CHECK(hdmi->stopCEC() == true);
+    close(sv[1]);
+
+    CHECK(hdmi->destroy() == true);
+    hdmi.clear();
+
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Feeds a corpus of sink EDIDs to libedid without DDC and checks the
+ * capabilities hdmi_policy reads from them and the output mode it picks
+ * for usual content. Returns 0 when every check passes.
+ */
+
+#define LOG_TAG "hdmi_edid_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hdmi_policy.h"
+#include "../../libsForhdmi/libedid/libedid.h"
+
+#define REQUESTED_MODE      (1080960)   // what the user asked for, the ceiling
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            g_failures++;                                               \
+        }                                                               \
+    } while (0)
+
+// full HD TV : every mode, deep colour, xvYCC, native 1080p60
+static const unsigned char edid_tv_1080p[] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x4c, 0x2d, 0x5c, 0x0a, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x14, 0x01, 0x03, 0x80, 0x50, 0x2d, 0x78, 0x0a, 0x0d, 0xc9, 0xa0, 0x57, 0x47, 0x98, 0x27,
+    0x12, 0x48, 0x4c, 0x20, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x3a, 0x80, 0x18, 0x71, 0x38, 0x2d, 0x40, 0x58, 0x2c,
+    0x45, 0x00, 0xbc, 0x86, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0xfc, 0x00, 0x46, 0x55, 0x4c,
+    0x4c, 0x48, 0x44, 0x20, 0x54, 0x56, 0x0a, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x17,
+    0x3d, 0x0f, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x31,
+    0x02, 0x03, 0x22, 0x71, 0x23, 0x09, 0x07, 0x07, 0x4d, 0x90, 0x1f, 0x22, 0x20, 0x05, 0x14, 0x04,
+    0x13, 0x03, 0x02, 0x12, 0x11, 0x01, 0x67, 0x03, 0x0c, 0x00, 0x10, 0x00, 0xb8, 0x2d, 0xe3, 0x05,
+    0x03, 0x01, 0x01, 0x1d, 0x00, 0x72, 0x51, 0xd0, 0x1e, 0x20, 0x6e, 0x28, 0x55, 0x00, 0xbc, 0x86,
+    0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe5,
+};
+
+// HD ready TV for 50Hz markets : no 1080p, VSDB without deep colour
+static const unsigned char edid_tv_720p_eu[] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x30, 0xe4, 0x10, 0x05, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x14, 0x01, 0x03, 0x80, 0x50, 0x2d, 0x78, 0x0a, 0x0d, 0xc9, 0xa0, 0x57, 0x47, 0x98, 0x27,
+    0x12, 0x48, 0x4c, 0x20, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x1d, 0x00, 0xbc, 0x52, 0xd0, 0x1e, 0x20, 0xb8, 0x28,
+    0x55, 0x40, 0xbc, 0x86, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0xfc, 0x00, 0x48, 0x44, 0x20,
+    0x52, 0x45, 0x41, 0x44, 0x59, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x17,
+    0x3d, 0x0f, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x33,
+    0x02, 0x03, 0x18, 0x61, 0x23, 0x09, 0x07, 0x07, 0x49, 0x93, 0x04, 0x14, 0x05, 0x12, 0x11, 0x03,
+    0x02, 0x01, 0x65, 0x03, 0x0c, 0x00, 0x20, 0x00, 0x01, 0x1d, 0x00, 0x72, 0x51, 0xd0, 0x1e, 0x20,
+    0x6e, 0x28, 0x55, 0x00, 0xbc, 0x86, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x37,
+};
+
+// DVI monitor : no extension block, its only timing is 720p60
+static const unsigned char edid_dvi_720p[] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x10, 0xac, 0x7b, 0xa0, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x14, 0x01, 0x03, 0x80, 0x50, 0x2d, 0x78, 0x0a, 0x0d, 0xc9, 0xa0, 0x57, 0x47, 0x98, 0x27,
+    0x12, 0x48, 0x4c, 0x20, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x1d, 0x00, 0x72, 0x51, 0xd0, 0x1e, 0x20, 0x6e, 0x28,
+    0x55, 0x00, 0xbc, 0x86, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0xfc, 0x00, 0x44, 0x56, 0x49,
+    0x20, 0x37, 0x32, 0x30, 0x50, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x17,
+    0x3d, 0x0f, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90,
+};
+
+// 4:3 SD set behind an HDMI receiver, 480p in its detailed timing
+static const unsigned char edid_sd_4_3[] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x4d, 0xd9, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x14, 0x01, 0x03, 0x80, 0x50, 0x2d, 0x78, 0x0a, 0x0d, 0xc9, 0xa0, 0x57, 0x47, 0x98, 0x27,
+    0x12, 0x48, 0x4c, 0x20, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x8c, 0x0a, 0xd0, 0x8a, 0x20, 0xe0, 0x2d, 0x10, 0x10, 0x3e,
+    0x96, 0x00, 0xa0, 0x5a, 0x00, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0xfc, 0x00, 0x53, 0x44, 0x20,
+    0x52, 0x45, 0x43, 0x45, 0x49, 0x56, 0x45, 0x52, 0x0a, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x17,
+    0x3d, 0x0f, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xb0,
+    0x02, 0x03, 0x12, 0x00, 0x23, 0x09, 0x07, 0x07, 0x43, 0x82, 0x11, 0x01, 0x65, 0x03, 0x0c, 0x00,
+    0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x43,
+};
+
+struct content
+{
+    int          w;
+    int          h;
+    int          fps;
+    unsigned int mode;      // expected output mode
+};
+
+struct sink
+{
+    const char          *name;
+    const unsigned char *edid;
+    int                  size;
+    int                  hdmi;
+    int                  ycbcr444;
+    int                  ycbcr422;
+    int                  dc30;
+    int                  dc36;
+    int                  xvycc;     // both xvYCC601 and xvYCC709
+    unsigned int         modes;     // bit n : hdmi_policy_mode(n)
+    struct content       choice[6];
+};
+
+#define SINK(n) #n, edid_##n, sizeof(edid_##n)
+
+static const struct sink corpus[] =
+{
+    // 24/30 fps judder on every mode, the requested one stays
+    { SINK(tv_1080p),   1, 1, 1, 1, 1, 1, 0x7ff,
+      { {    0,    0,  0, 1080960 }, { 1920, 1080, 24, 1080960 },
+        { 1920, 1080, 25, 1080950 }, { 1280,  720, 50,  720950 },
+        {  720,  576, 25, 5769502 }, {  720,  480, 30, 4809602 } } },
+    { SINK(tv_720p_eu), 1, 1, 0, 0, 0, 0, 0x7f8,
+      { {    0,    0,  0, 1080160 }, { 1920, 1080, 24, 1080160 },
+        { 1920, 1080, 25, 1080150 }, { 1280,  720, 50,  720950 },
+        {  720,  576, 25, 5769502 }, {  720,  480, 30, 4809602 } } },
+    { SINK(dvi_720p),   0, 0, 0, 0, 0, 0, 0x020,
+      { {    0,    0,  0,  720960 }, { 1920, 1080, 24,  720960 },
+        { 1920, 1080, 25,  720960 }, { 1280,  720, 50,  720960 },
+        {  720,  576, 25,  720960 }, {  720,  480, 30,  720960 } } },
+    // a detailed timing counts for both aspect ratios
+    { SINK(sd_4_3),     1, 0, 0, 0, 0, 0, 0x700,
+      { {    0,    0,  0, 4809601 }, { 1920, 1080, 24, 4809601 },
+        { 1920, 1080, 25, 5769502 }, { 1280,  720, 50, 5769502 },
+        {  720,  576, 25, 5769502 }, {  720,  480, 30, 4809602 } } },
+};
+
+static void test_sink(const struct sink *s)
+{
+    struct hdmi_sink_caps caps;
+    unsigned int modes = 0;
+
+    CHECK(EDIDLoad(s->edid, s->size) == 1);
+    CHECK(hdmi_policy_read_caps(&caps) == 0);
+
+    CHECK(caps.valid == 1);
+    CHECK(caps.hdmi == s->hdmi);
+    CHECK(caps.ycbcr444 == s->ycbcr444);
+    CHECK(caps.ycbcr422 == s->ycbcr422);
+    CHECK(caps.dc30 == s->dc30);
+    CHECK(caps.dc36 == s->dc36);
+    CHECK(caps.xvycc601 == s->xvycc);
+    CHECK(caps.xvycc709 == s->xvycc);
+    CHECK(caps.modes == s->modes);
+
+    for (int i = 0; i < hdmi_policy_num_modes(); i++) {
+        if (hdmi_policy_mode_supported(&caps, hdmi_policy_mode(i)->resolution_value))
+            modes |= 1 << i;
+    }
+    CHECK(modes == s->modes);
+
+    for (unsigned int i = 0; i < sizeof(s->choice) / sizeof(s->choice[0]); i++) {
+        const struct content *c = &s->choice[i];
+        unsigned int mode = hdmi_policy_choose_mode(&caps, REQUESTED_MODE,
+                                                    c->w, c->h, c->fps);
+        if (mode != c->mode)
+            fprintf(stderr, "%s : %dx%d@%d -> %u, expected %u\n",
+                    s->name, c->w, c->h, c->fps, mode, c->mode);
+        CHECK(mode == c->mode);
+    }
+}
+
+// EDIDs a sink may really send that must not be believed
+static void test_broken(void)
+{
+    unsigned char edid[sizeof(edid_tv_1080p)];
+
+    // a flipped bit in the extension
+    memcpy(edid, edid_tv_1080p, sizeof(edid));
+    edid[128 + 10] ^= 0x01;
+    CHECK(EDIDLoad(edid, sizeof(edid)) == 0);
+
+    // the extension it announces is missing
+    CHECK(EDIDLoad(edid_tv_1080p, 128) == 0);
+
+    // nothing loaded, the policy keeps what the user asked for
+    struct hdmi_sink_caps caps;
+    hdmi_policy_reset_caps(&caps);
+    CHECK(caps.valid == 0);
+    CHECK(hdmi_policy_choose_mode(&caps, REQUESTED_MODE, 1280, 720, 50) == REQUESTED_MODE);
+}
+
+int main(int argc, char **argv)
+{
+    for (unsigned int i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++)
+        test_sink(&corpus[i]);
+
+    test_broken();
+    EDIDReset();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}
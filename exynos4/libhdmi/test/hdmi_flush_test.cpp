@@ -0,0 +1,158 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Mirrors frames through SecHdmi::flush with the tvout and FIMC nodes on
+ * the userspace emulator, which records every ioctl, and checks the
+ * ioctl count per mirrored frame. Returns 0 when every check passes.
+ */
+
+#define LOG_TAG "hdmi_flush_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SecHdmi.h"
+#include "sec_v4l2_shim.h"
+
+using namespace android;
+
+#define TEST_FRAMES           (60)
+#define SRC_W                 (1280)
+#define SRC_H                 (720)
+#define SRC_BASE              (0x40000000)
+#define SRC_FLIP              (0x01000000)
+
+// video : the tvout source address only
+#define VIDEO_FRAME_IOCTLS    (1)
+// UI : FIMC destination (rotation, G/S_FBUF, fmt), FIMC one shot
+// (STREAMON, QBUF, DQBUF, STREAMOFF) and the tvout source address
+#define UI_FRAME_IOCTLS       (4 + 4 + 1)
+#define VSYNC_INTERVAL_US     (16667)
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            g_failures++;                                               \
+        }                                                               \
+    } while (0)
+
+static void add_nodes(void)
+{
+    struct sec_v4l2_emul_config config;
+    char path[32];
+
+    memset(&config, 0, sizeof(config));
+
+    for (int i = 0; i < 4; i++) {
+        config.phys_base = 0x50000000 + (i << 24);
+        snprintf(path, sizeof(path), "/dev/video%d", i);
+        sec_v4l2_emul_add_node(path, SEC_V4L2_EMUL_OUTPUT, &config);
+    }
+
+    config.phys_base = 0x60000000;
+    sec_v4l2_emul_add_node(TVOUT_DEV,   SEC_V4L2_EMUL_OUTPUT, &config);
+    sec_v4l2_emul_add_node(TVOUT_DEV_V, SEC_V4L2_EMUL_OUTPUT, &config);
+    sec_v4l2_emul_add_node(HPD_DEV,     SEC_V4L2_EMUL_HPD,    &config);
+
+    config.width  = 1920;
+    config.height = 1080;
+    config.bpp    = 32;
+    config.frame_interval_us = VSYNC_INTERVAL_US;
+    config.phys_base = 0x70000000;
+    sec_v4l2_emul_add_node("/dev/graphics/fb0",  SEC_V4L2_EMUL_FB, &config);
+    sec_v4l2_emul_add_node("/dev/graphics/fb10", SEC_V4L2_EMUL_FB, &config);
+    sec_v4l2_emul_add_node("/dev/graphics/fb11", SEC_V4L2_EMUL_FB, &config);
+}
+
+// worst frame of the flush path. the vsync thread waits on the mixer
+// in the background, its S5PTVFB_WAITFORVSYNC is not part of a frame
+static unsigned int flush_calls_max(const struct sec_v4l2_shim_trace *trace)
+{
+    unsigned int calls = 0;
+
+    for (int i = 0; i < trace->num_entries; i++) {
+        if ((unsigned int)trace->entries[i].request == S5PTVFB_WAITFORVSYNC)
+            continue;
+        calls += trace->entries[i].frame_calls_max;
+    }
+
+    return calls;
+}
+
+// the first frame programs the layer, the rest must stay within budget
+static void mirror(SecHdmi *hdmi, int colorFormat, unsigned int budget)
+{
+    unsigned int y = SRC_BASE;
+    unsigned int c = y + SRC_W * SRC_H;
+
+    CHECK(hdmi->flush(SRC_W, SRC_H, colorFormat, y, c,
+                      0, 0, HDMI_LAYER_VIDEO) == true);
+
+    sec_v4l2_shim_trace_reset();
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        unsigned int offset = (i & 1) ? 0 : SRC_FLIP;
+
+        CHECK(hdmi->flush(SRC_W, SRC_H, colorFormat, y + offset, c + offset,
+                          0, 0, HDMI_LAYER_VIDEO) == true);
+        sec_v4l2_shim_trace_frame();
+    }
+
+    struct sec_v4l2_shim_trace trace;
+    sec_v4l2_shim_trace_get(&trace);
+    CHECK(trace.frames == TEST_FRAMES);
+    CHECK(flush_calls_max(&trace) <= budget);
+    sec_v4l2_shim_trace_dump();
+}
+
+int main(int argc, char **argv)
+{
+    add_nodes();
+    sec_v4l2_emul_install();
+    sec_v4l2_shim_trace_enable(1);
+
+    sp<SecHdmi> hdmi = new SecHdmi;
+    CHECK(hdmi->create() == true);
+    CHECK(hdmi->connect() == true);
+
+    // video straight from the decoder
+    mirror(hdmi.get(), HAL_PIXEL_FORMAT_YCrCb_420_SP, VIDEO_FRAME_IOCTLS);
+
+    // UI, converted by FIMC into the mirror buffers
+    mirror(hdmi.get(), HAL_PIXEL_FORMAT_RGBA_8888, UI_FRAME_IOCTLS);
+
+    CHECK(hdmi->clear(HDMI_LAYER_VIDEO) == true);
+    CHECK(hdmi->disconnect() == true);
+    CHECK(hdmi->destroy() == true);
+    hdmi.clear();
+
+    sec_v4l2_shim_trace_enable(0);
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}
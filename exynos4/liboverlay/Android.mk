@@ -41,4 +41,11 @@ ifeq ($(BOARD_USES_HDMI_SUBTITLES),true)
 endif
 endif
 
+ifeq ($(BOARD_USES_V4L2_SHIM),true)
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM
+LOCAL_SHARED_LIBRARIES += libv4l2shim
+endif
+
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -29,6 +29,7 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <time.h>
 #include <linux/videodev.h>
 
 #include <cutils/log.h>
@@ -41,6 +42,7 @@
 #include "hdmiservice.h"
 #include "sec_base.h"
 #endif
+#include "sec_v4l2_shim.h"
 
 /*****************************************************************************/
 
@@ -60,6 +62,12 @@ unsigned int g_lcd_bpp = 32;
 /* shared with Camera/Video Playback HAL */
 #define ALL_BUFFERS_FLUSHED -66
 
+/*
+ * A data side which queued a frame within this period is playing, so
+ * geometry changes needing a stream restart are left to its next frame.
+ */
+#define OVERLAY_DATA_IDLE_MS           (100)
+
 uint32_t phyAddr;
 s5p_fimc_t g_s5p_fimc;
 
@@ -94,17 +102,38 @@ typedef struct
 
     volatile int32_t refCnt;
 
-    uint32_t controlReady; /* Only updated by the control side */
-    uint32_t dataReady;    /* Only updated by the data side */
+    /*
+     * The flags below are written with release stores, under the lock, and
+     * read with acquire loads. The per-frame data path never takes the lock
+     * unless seq moved since its last frame.
+     */
+    volatile int32_t seq;          /* bumped when the data side must react */
+
+    volatile int32_t controlReady; /* Only updated by the control side */
+    volatile int32_t dataReady;    /* Only updated by the data side */
 
     pthread_mutex_t lock;
     pthread_mutexattr_t attr;
 
-    uint32_t streamEn;
-    uint32_t streamingReset;
+    volatile int32_t streamEn;
+    volatile int32_t streamingReset;
 
     uint32_t dispW;
     uint32_t dispH;
+    uint32_t dispBpp;
+
+    /* Set by the control side, applied by the data side at its next frame */
+    volatile int32_t geometryPending;
+    overlay_ctrl_t geometry;
+
+    /* Only updated by the data side, advisory for the control side */
+    volatile int32_t lastQueueMs;  /* overlay_now_ms(), read back as uint32_t */
+    volatile int32_t qdBufCount;
+
+    /* frames lost per geometry change */
+    uint32_t geometryChanges;
+    uint32_t geometryRestarts;
+    uint32_t framesLost;
 
 } overlay_shared_t;
 
@@ -138,9 +167,19 @@ struct overlay_data_context_t {
     /* Need to count Qd buffers
        to be sure we don't block DQ'ing when exiting */
     int qd_buf_count;
+    /* shown buffers taken back from the driver before a geometry change,
+       dequeueBuffer() hands them out first */
+    int *drained;
+    int num_drained;
     int cacheable_buffers;
+    /* last shared->seq handled by the data path */
+    int32_t seq;
 
     bool zerocopy;
+
+#if defined(BOARD_USES_HDMI)
+    struct hdmi_mirror_t *hdmi_mirror;
+#endif
 };
 
 static int  create_shared_data(overlay_shared_t **shared);
@@ -383,19 +422,28 @@ static void close_shared_data(overlay_data_context_t *ctx)
     ctx->shared = NULL;
 }
 
+#define SHARED_LOAD(field)          android_atomic_acquire_load(&(field))
+#define SHARED_STORE(field, value)  android_atomic_release_store((value), &(field))
+
+/* Makes the data side leave its lock-free path at its next call */
+static void notify_data_locked(overlay_shared_t *shared)
+{
+    android_atomic_inc(&shared->seq);
+}
+
 static int enable_streaming_locked(overlay_shared_t *shared, int ovly_fd)
 {
     int rc = 0;
 
-    if (!shared->controlReady || !shared->dataReady) {
+    if (!SHARED_LOAD(shared->controlReady) || !SHARED_LOAD(shared->dataReady)) {
         LOGI("Postponing Stream Enable/%d/%d\n", shared->controlReady,
                 shared->dataReady);
     } else {
-        shared->streamEn = 1;
+        SHARED_STORE(shared->streamEn, 1);
         rc = v4l2_overlay_stream_on(ovly_fd);
         if (rc) {
             LOGE("Stream Enable Failed!/%d\n", rc);
-            shared->streamEn = 0;
+            SHARED_STORE(shared->streamEn, 0);
         }
     }
 
@@ -412,6 +460,19 @@ static int enable_streaming(overlay_shared_t *shared, int ovly_fd)
     return ret;
 }
 
+static int64_t overlay_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* wraps every 49 days : only compare the unsigned difference of two readings */
+static uint32_t overlay_now_ms(void)
+{
+    return (uint32_t)(overlay_now() / 1000000LL);
+}
+
 static int disable_streaming_locked(overlay_shared_t *shared, int ovly_fd)
 {
     int ret = 0;
@@ -421,14 +482,56 @@ static int disable_streaming_locked(overlay_shared_t *shared, int ovly_fd)
         if (ret) {
             LOGE("Stream Off Failed!/%d\n", ret);
         } else {
-            shared->streamingReset = 1;
-            shared->streamEn = 0;
+            SHARED_STORE(shared->streamingReset, 1);
+            SHARED_STORE(shared->streamEn, 0);
+            notify_data_locked(shared);
         }
     }
 
     return ret;
 }
 
+/* Programs flip, rotation and window. The stream must be off. */
+static int apply_geometry_locked(int ovly_fd, const overlay_ctrl_t *geometry)
+{
+    int ret;
+
+    ret = v4l2_overlay_set_flip(ovly_fd, geometry->flip);
+    if (ret) {
+        LOGE("Set Flip Failed!/%d\n", ret);
+        return ret;
+    }
+
+    ret = v4l2_overlay_set_rotation(ovly_fd, geometry->rotation, 0);
+    if (ret) {
+        LOGE("Set Rotation Failed!/%d\n", ret);
+        return ret;
+    }
+    v4l2_overlay_s_fbuf(ovly_fd, geometry->rotation);
+
+    ret = v4l2_overlay_set_position(ovly_fd, geometry->posX, geometry->posY,
+            geometry->posW, geometry->posH, geometry->rotation);
+    if (ret) {
+        LOGE("Set Position Failed!/%d\n", ret);
+        return ret;
+    }
+
+    return 0;
+}
+
+static void count_geometry_change_locked(overlay_shared_t *shared,
+        uint32_t lost, bool restart)
+{
+    shared->geometryChanges++;
+    shared->framesLost += lost;
+    if (restart)
+        shared->geometryRestarts++;
+
+    LOGV("Geometry change/%s/lost %d/total %d changes, %d restarts, %d lost\n",
+            restart ? "restart" : "live", lost, shared->geometryChanges,
+            shared->geometryRestarts, shared->framesLost);
+}
+
 static void set_color_space(unsigned int overlay_color_format, unsigned int *v4l2_color_format)
 {
     switch (overlay_color_format) {
@@ -628,9 +731,9 @@ static overlay_t* overlay_createOverlay(struct overlay_control_device_t *dev,
 
     overlay->setShared(shared);
 
-    shared->controlReady = 0;
-    shared->streamEn = 0;
-    shared->streamingReset = 0;
+    SHARED_STORE(shared->controlReady, 0);
+    SHARED_STORE(shared->streamEn, 0);
+    SHARED_STORE(shared->streamingReset, 0);
 
     /* get lcd size from kernel framebuffer */
     if(get_fb_var_screeninfo(&info) == 0) {
@@ -643,6 +746,7 @@ static overlay_t* overlay_createOverlay(struct overlay_control_device_t *dev,
         shared->dispW = g_lcd_width; /* Need to determine this properly */
         shared->dispH = g_lcd_height; /* Need to determine this properly */
     }
+    shared->dispBpp = g_lcd_bpp;
 
     LOGI("Opened video1/fd=%d/obj=%08lx/shm=%d/size=%d", fd,
             (unsigned long)overlay, shared_fd, shared->size);
@@ -863,7 +967,7 @@ static int overlay_commit(struct overlay_control_device_t *dev,
 
     if (!shared->controlReady) {
         if (stage->posW_org >= 8) {
-            shared->controlReady = 1;
+            SHARED_STORE(shared->controlReady, 1);
         }
     }
 
@@ -887,6 +991,8 @@ static int overlay_commit(struct overlay_control_device_t *dev,
             stage->posW = g_s5p_fimc.params.dst.width;
             stage->posH = g_s5p_fimc.params.dst.height;
         }
+        /* an adjusted size is no error */
+        ret = 0;
     }
 
     if (data->posX == stage->posX && data->posY == stage->posY &&
@@ -903,39 +1009,49 @@ static int overlay_commit(struct overlay_control_device_t *dev,
             stage->posW, stage->posH);
     LOGV("Rotation/%d\n", stage->rotation );
 
-    if ((ret = disable_streaming_locked(shared, fd)))
-        goto end;
+    if (shared->streamEn) {
+        /* A move keeps the FIMC setup : update the window on the fly */
+        if (!shared->geometryPending &&
+                data->posW == stage->posW && data->posH == stage->posH &&
+                data->rotation == stage->rotation &&
+                data->flip == stage->flip) {
+            if (v4l2_overlay_set_position(fd, stage->posX, stage->posY,
+                        stage->posW, stage->posH, stage->rotation) == 0) {
+                *data = *stage;
+                count_geometry_change_locked(shared, 0, false);
+                goto end;
+            }
+            LOGI("Position update refused while streaming, restarting\n");
+        }
 
-    if (stage->flip != data->flip) {
-        ret = v4l2_overlay_set_flip(fd, stage->flip);
-        if (ret) {
-            LOGE("Set Flip Failed!/%d\n", ret);
+        /* Let the playing data side restart the stream between two frames */
+        if (overlay_now_ms() - (uint32_t)SHARED_LOAD(shared->lastQueueMs) <
+                OVERLAY_DATA_IDLE_MS) {
+            shared->geometry = *stage;
+            SHARED_STORE(shared->geometryPending, 1);
+            notify_data_locked(shared);
+            *data = *stage;
             goto end;
         }
     }
 
-    if (stage->rotation != data->rotation) {
-        ret = v4l2_overlay_set_rotation(fd, stage->rotation, 0);
-        if (ret) {
-            LOGE("Set Rotation Failed!/%d\n", ret);
+    {
+        uint32_t lost = shared->streamEn ? SHARED_LOAD(shared->qdBufCount) : 0;
+        bool restart = shared->streamEn;
+
+        if ((ret = disable_streaming_locked(shared, fd)))
             goto end;
-        }
-        v4l2_overlay_s_fbuf(fd, stage->rotation);
-    }
 
-    ret = v4l2_overlay_set_position(fd, stage->posX, stage->posY,
-            stage->posW, stage->posH, stage->rotation);
-    if (ret) {
-        LOGE("Set Position Failed!/%d\n", ret);
-        goto end;
-    }
+        SHARED_STORE(shared->geometryPending, 0);
+
+        ret = apply_geometry_locked(fd, stage);
+        if (ret)
+            goto end;
 
-    data->posX = stage->posX;
-    data->posY = stage->posY;
-    data->posW = stage->posW;
-    data->posH = stage->posH;
-    data->rotation = stage->rotation;
-    data->flip = stage->flip;
+        *data = *stage;
+
+        count_geometry_change_locked(shared, lost, restart);
+    }
 
     ret = enable_streaming_locked(shared, fd);
 
@@ -956,8 +1072,10 @@ static int overlay_control_close(struct hw_device_t *dev)
     if (ctx) {
         overlay_v1 = static_cast<overlay_object *>(ctx->overlay_video1);
 
-        overlay_destroyOverlay((struct overlay_control_device_t *)ctx,
-                overlay_v1);
+        /* the client may have destroyed it already */
+        if (overlay_v1)
+            overlay_destroyOverlay((struct overlay_control_device_t *)ctx,
+                    overlay_v1);
 
         free(ctx);
     }
@@ -1076,6 +1194,8 @@ int overlay_initialize(struct overlay_data_device_t *dev,
     ctx->shared_size  = handle_shared_size(handle);
     ctx->shared       = NULL;
     ctx->qd_buf_count = 0;
+    ctx->drained      = NULL;
+    ctx->num_drained  = 0;
     ctx->cacheable_buffers = 0;
 
     if (ctx->format >= HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP
@@ -1093,16 +1213,25 @@ int overlay_initialize(struct overlay_data_device_t *dev,
         return -1;
     }
 
-    ctx->shared->dataReady = 0;
+    SHARED_STORE(ctx->shared->dataReady, 0);
+    /* look at the control block once before the first frame */
+    ctx->seq = SHARED_LOAD(ctx->shared->seq) - 1;
+
+    /* the window is programmed from this process on geometry changes */
+    g_lcd_width  = ctx->shared->dispW;
+    g_lcd_height = ctx->shared->dispH;
+    if (ctx->shared->dispBpp)
+        g_lcd_bpp = ctx->shared->dispBpp;
 
     ctx->mapping_data = new struct mapping_data;
     ctx->buffers     = new void* [ctx->num_buffers];
     ctx->phyYbuffers  = new void* [ctx->num_buffers];
     ctx->phyCbuffers  = new void* [ctx->num_buffers];
     ctx->buffers_len = new size_t[ctx->num_buffers];
+    ctx->drained     = new int[ctx->num_buffers];
 
     if (!ctx->buffers || !ctx->phyYbuffers ||!ctx->phyCbuffers ||
-            !ctx->buffers_len || !ctx->mapping_data) {
+            !ctx->buffers_len || !ctx->drained || !ctx->mapping_data) {
         LOGE("Failed alloc'ing buffer arrays\n");
         goto error;
     } else {
@@ -1153,6 +1282,8 @@ error:
         delete [] ctx->phyCbuffers;
     if(ctx->buffers_len)
         delete [] ctx->buffers_len;
+    if(ctx->drained)
+        delete [] ctx->drained;
 
     close_shared_data( ctx );
 
@@ -1289,7 +1420,7 @@ static int overlay_setCrop(struct overlay_data_device_t *dev, uint32_t x,
 
     pthread_mutex_lock(&ctx->shared->lock);
 
-    ctx->shared->dataReady = 1;
+    SHARED_STORE(ctx->shared->dataReady, 1);
 
     if (ctx->data.cropX == x && ctx->data.cropY == y && ctx->data.cropW == w
             && ctx->data.cropH == h) {
@@ -1325,6 +1456,249 @@ static int overlay_getCrop(struct overlay_data_device_t *dev , uint32_t* x,
     return v4l2_overlay_get_crop(ctx->ctl_fd, x, y, w, h);
 }
 
+#if defined(BOARD_USES_HDMI)
+/*
+ * HDMI mirroring runs on its own thread so the local overlay never waits
+ * on the TV-out colour conversion. The mailbox holds only the latest
+ * frame : a frame not taken by the thread yet is overwritten and counted
+ * as dropped, the decoder is never back-pressured.
+ * The thread reads the frame through its physical addresses, so a buffer
+ * coming back from the overlay is held in dequeue until the thread is
+ * done with it, see hdmi_mirror_release().
+ */
+#define HDMI_MIRROR_STATS_PERIOD_NS (1000000000LL)
+
+struct hdmi_mirror_frame_t {
+    int          width;
+    int          height;
+    unsigned int color_space;
+    unsigned int addr_y;
+    unsigned int addr_cbcr;
+    int          buf_idx;       // overlay buffer, as VIDIOC_DQBUF returns it
+};
+
+struct hdmi_mirror_t {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_cond_t  done_cond;
+    bool            exit;
+
+    bool                 pending;
+    hdmi_mirror_frame_t  frame;
+    int                  busy_idx;  // buffer being converted, -1 : none
+
+    int64_t         stats_start;
+    unsigned int    num_posted;
+    unsigned int    num_dropped;
+};
+
+static void *hdmi_mirror_thread(void *arg)
+{
+    struct hdmi_mirror_t *mirror = (struct hdmi_mirror_t *)arg;
+    android::HdmiService * hdmiService = android::HdmiService::getInstance();
+    hdmi_mirror_frame_t frame;
+
+    pthread_mutex_lock(&mirror->lock);
+
+    while (1) {
+        while (!mirror->pending && !mirror->exit)
+            pthread_cond_wait(&mirror->cond, &mirror->lock);
+
+        if (mirror->exit)
+            break;
+
+        frame = mirror->frame;
+        mirror->pending  = false;
+        mirror->busy_idx = frame.buf_idx;
+
+        pthread_mutex_unlock(&mirror->lock);
+
+        hdmiService->postVideo2HDMI(frame.width,
+                               frame.height,
+                               frame.color_space,
+                               frame.addr_y,
+                               frame.addr_cbcr,
+                               0,0);
+
+        pthread_mutex_lock(&mirror->lock);
+
+        mirror->busy_idx = -1;
+        pthread_cond_broadcast(&mirror->done_cond);
+
+        mirror->num_posted++;
+
+        int64_t now = overlay_now();
+        if (HDMI_MIRROR_STATS_PERIOD_NS <= now - mirror->stats_start) {
+            LOGV("HDMI mirror: %lld fps, %d dropped",
+                 (int64_t)mirror->num_posted * 1000000000LL / (now - mirror->stats_start),
+                 mirror->num_dropped);
+            mirror->stats_start = now;
+            mirror->num_posted  = 0;
+            mirror->num_dropped = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&mirror->lock);
+
+    return NULL;
+}
+
+static struct hdmi_mirror_t *hdmi_mirror_create(void)
+{
+    struct hdmi_mirror_t *mirror =
+        (struct hdmi_mirror_t *)calloc(1, sizeof(struct hdmi_mirror_t));
+
+    if (mirror == NULL)
+        return NULL;
+
+    pthread_mutex_init(&mirror->lock, NULL);
+    pthread_cond_init(&mirror->cond, NULL);
+    pthread_cond_init(&mirror->done_cond, NULL);
+    mirror->busy_idx    = -1;
+    mirror->stats_start = overlay_now();
+
+    if (pthread_create(&mirror->thread, NULL, hdmi_mirror_thread, mirror) != 0) {
+        LOGE("%s::pthread_create fail", __func__);
+        pthread_cond_destroy(&mirror->done_cond);
+        pthread_cond_destroy(&mirror->cond);
+        pthread_mutex_destroy(&mirror->lock);
+        free(mirror);
+        return NULL;
+    }
+
+    return mirror;
+}
+
+static void hdmi_mirror_destroy(struct hdmi_mirror_t *mirror)
+{
+    if (mirror == NULL)
+        return;
+
+    pthread_mutex_lock(&mirror->lock);
+    mirror->exit = true;
+    pthread_cond_signal(&mirror->cond);
+    pthread_mutex_unlock(&mirror->lock);
+
+    pthread_join(mirror->thread, NULL);
+
+    pthread_cond_destroy(&mirror->done_cond);
+    pthread_cond_destroy(&mirror->cond);
+    pthread_mutex_destroy(&mirror->lock);
+    free(mirror);
+}
+
+static void hdmi_mirror_post(struct hdmi_mirror_t *mirror,
+                             const hdmi_mirror_frame_t *frame)
+{
+    pthread_mutex_lock(&mirror->lock);
+
+    if (mirror->pending)
+        mirror->num_dropped++;
+
+    mirror->frame   = *frame;
+    mirror->pending = true;
+
+    pthread_cond_signal(&mirror->cond);
+    pthread_mutex_unlock(&mirror->lock);
+}
+
+/* buf_idx goes back to the decoder : no conversion may read it any more.
+ * buf_idx -1 : every buffer, on a flush */
+static void hdmi_mirror_release(struct hdmi_mirror_t *mirror, int buf_idx)
+{
+    pthread_mutex_lock(&mirror->lock);
+
+    if (mirror->pending && (buf_idx < 0 || mirror->frame.buf_idx == buf_idx)) {
+        mirror->pending = false;
+        mirror->num_dropped++;
+    }
+
+    while (0 <= mirror->busy_idx && (buf_idx < 0 || mirror->busy_idx == buf_idx))
+        pthread_cond_wait(&mirror->done_cond, &mirror->lock);
+
+    pthread_mutex_unlock(&mirror->lock);
+}
+#endif // BOARD_USES_HDMI
+
+/*
+ * Slow path of the data side, taken only when shared->seq moved.
+ * The geometry staged by the control side stays pending while buffers are
+ * queued to the driver. Once none is, the stream is turned off, the
+ * geometry applied and the stream turned on again, so no frame is lost.
+ * ALL_BUFFERS_FLUSHED is only returned when the control side itself turned
+ * the stream off, which already gave every queued buffer back.
+ */
+static int sync_shared_data(struct overlay_data_context_t *ctx)
+{
+    overlay_shared_t *shared = ctx->shared;
+    int rc = 0;
+
+    pthread_mutex_lock(&shared->lock);
+
+    ctx->seq = shared->seq;
+
+    if (shared->streamingReset) {
+        SHARED_STORE(shared->streamingReset, 0);
+        ctx->qd_buf_count = 0;
+        ctx->num_drained  = 0;
+        SHARED_STORE(shared->qdBufCount, 0);
+        rc = ALL_BUFFERS_FLUSHED;
+    } else if (shared->geometryPending && ctx->qd_buf_count == 0) {
+        bool restart = shared->streamEn;
+
+        if (disable_streaming_locked(shared, ctx->ctl_fd) == 0) {
+            /* nothing was queued : this stream off flushed nothing */
+            SHARED_STORE(shared->streamingReset, 0);
+            apply_geometry_locked(ctx->ctl_fd, &shared->geometry);
+            enable_streaming_locked(shared, ctx->ctl_fd);
+            count_geometry_change_locked(shared, 0, restart);
+            SHARED_STORE(shared->geometryPending, 0);
+        }
+
+        ctx->seq = shared->seq;
+    }
+
+    /* come back here until the staged geometry is applied */
+    if (shared->geometryPending)
+        ctx->seq = shared->seq - 1;
+
+    pthread_mutex_unlock(&shared->lock);
+
+#if defined(BOARD_USES_HDMI)
+    if (rc == ALL_BUFFERS_FLUSHED && ctx->hdmi_mirror != NULL)
+        hdmi_mirror_release(ctx->hdmi_mirror, -1);
+#endif
+
+    return rc;
+}
+
+/*
+ * Takes the queued buffers back from the driver as they are shown, for a
+ * staged geometry change to find the queue empty. The client gets them
+ * from dequeueBuffer() before any the driver gives back later.
+ */
+static void drain_queued_buffers(struct overlay_data_context_t *ctx)
+{
+    int i;
+
+    while (ctx->qd_buf_count && ctx->num_drained < ctx->num_buffers &&
+            SHARED_LOAD(ctx->shared->streamEn)) {
+        if (v4l2_overlay_dq_buf(ctx->ctl_fd, &i, ctx->zerocopy) != 0 ||
+                i < 0 || i >= ctx->num_buffers) {
+            LOGE("Failed to drain the queue, geometry change waits\n");
+            return;
+        }
+#if defined(BOARD_USES_HDMI)
+        if (ctx->hdmi_mirror != NULL)
+            hdmi_mirror_release(ctx->hdmi_mirror, i);
+#endif
+        ctx->drained[ctx->num_drained++] = i;
+        ctx->qd_buf_count --;
+        SHARED_STORE(ctx->shared->qdBufCount, ctx->qd_buf_count);
+    }
+}
+
 int overlay_dequeueBuffer(struct overlay_data_device_t *dev,
         overlay_buffer_t *buffer) {
     /* blocks until a buffer is available and return an opaque structure
@@ -1338,25 +1712,34 @@ int overlay_dequeueBuffer(struct overlay_data_device_t *dev,
     uint32_t num = 0;
     int cnt = 0;
 
-    pthread_mutex_lock(&ctx->shared->lock);
-    if ( ctx->shared->streamingReset ) {
-        ctx->shared->streamingReset = 0;
-        pthread_mutex_unlock(&ctx->shared->lock);
+    if (SHARED_LOAD(ctx->shared->seq) != ctx->seq &&
+            sync_shared_data(ctx) == ALL_BUFFERS_FLUSHED)
         return ALL_BUFFERS_FLUSHED;
+
+    /* shown before a geometry change, oldest first */
+    if (ctx->num_drained) {
+        *((int *)buffer) = ctx->drained[0];
+        ctx->num_drained --;
+        memmove(ctx->drained, ctx->drained + 1, ctx->num_drained * sizeof(int));
+        return 0;
     }
-    pthread_mutex_unlock(&ctx->shared->lock);
 
     /* If we are not streaming dequeue will fail,
        skip to prevent error printouts */
-    if (ctx->shared->streamEn && ctx->qd_buf_count) {
+    if (SHARED_LOAD(ctx->shared->streamEn) && ctx->qd_buf_count) {
         if ((rc = v4l2_overlay_dq_buf( ctx->ctl_fd, &i ,ctx->zerocopy)) != 0) {
             LOGE("Failed to DQ/%d\n", rc);
         }
         else if (i < 0 || i > ctx->num_buffers) {
             rc = -EINVAL;
         } else {
+#if defined(BOARD_USES_HDMI)
+            if (ctx->hdmi_mirror != NULL)
+                hdmi_mirror_release(ctx->hdmi_mirror, i);
+#endif
             *((int *)buffer) = i;
             ctx->qd_buf_count --;
+            SHARED_STORE(ctx->shared->qdBufCount, ctx->qd_buf_count);
         }
     } else {
         rc = -1;
@@ -1371,43 +1754,45 @@ int overlay_queueBuffer(struct overlay_data_device_t *dev,
 
     int cnt = 0;
 
-    pthread_mutex_lock(&ctx->shared->lock);
-    if ( ctx->shared->streamingReset ) {
-        ctx->shared->streamingReset = 0;
-        pthread_mutex_unlock(&ctx->shared->lock);
-        return ALL_BUFFERS_FLUSHED;
+    if (SHARED_LOAD(ctx->shared->seq) != ctx->seq) {
+        /* between two frames : let the staged geometry find the queue empty */
+        if (SHARED_LOAD(ctx->shared->geometryPending))
+            drain_queued_buffers(ctx);
+        if (sync_shared_data(ctx) == ALL_BUFFERS_FLUSHED)
+            return ALL_BUFFERS_FLUSHED;
     }
-    pthread_mutex_unlock(&ctx->shared->lock);
 
     /* Catch the case where the data side had no need to set the crop window */
-    if (!ctx->shared->dataReady) {
-        ctx->shared->dataReady = 1;
+    if (!SHARED_LOAD(ctx->shared->dataReady)) {
+        SHARED_STORE(ctx->shared->dataReady, 1);
         enable_streaming(ctx->shared, ctx->ctl_fd);
     }
 
-    if (!ctx->shared->controlReady) return -1;
+    if (!SHARED_LOAD(ctx->shared->controlReady)) return -1;
     int rc = v4l2_overlay_q_buf( ctx->ctl_fd, (int)buffer, (int) ctx->zerocopy );
     if (rc == 0 && ctx->qd_buf_count < ctx->num_buffers) {
         ctx->qd_buf_count ++;
     }
+    SHARED_STORE(ctx->shared->qdBufCount, ctx->qd_buf_count);
+    SHARED_STORE(ctx->shared->lastQueueMs, (int32_t)overlay_now_ms());
 
 #if defined(BOARD_USES_HDMI)
 
     struct ADDRS * ptrAddr = (struct ADDRS *) buffer;
+    hdmi_mirror_frame_t frame;
 
-    unsigned int color_space = 0;
+    if (ctx->hdmi_mirror == NULL)
+        ctx->hdmi_mirror = hdmi_mirror_create();
 
-    android::HdmiService * hdmiService = android::HdmiService::getInstance();
-
-    set_color_space(ctx->format, &color_space);
+    frame.width     = ctx->width;
+    frame.height    = ctx->height;
+    frame.addr_y    = (unsigned int)ptrAddr->addr_y;
+    frame.addr_cbcr = (unsigned int)ptrAddr->addr_cbcr;
+    frame.buf_idx   = (uint8_t)ptrAddr->buf_idx;   /* the index v4l2_overlay_q_buf() queues */
+    set_color_space(ctx->format, &frame.color_space);
 
-    hdmiService->postVideo2HDMI(ctx->width,
-                           ctx->height,
-                           color_space, //ctx->format, //HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP,
-                           /*android::SecHdmiService::HDMI_MODE_VIDEO,*/
-                           (unsigned int)ptrAddr->addr_y,
-                           (unsigned int)ptrAddr->addr_cbcr,
-                           0,0);
+    if (ctx->hdmi_mirror != NULL)
+        hdmi_mirror_post(ctx->hdmi_mirror, &frame);
 
 #endif // BOARD_USES_HDMI
 
@@ -1468,6 +1853,12 @@ static int overlay_data_close(struct hw_device_t *dev) {
         int buf;
         int i;
 
+#if defined(BOARD_USES_HDMI)
+        /* no TV-out conversion may touch the buffers past this point */
+        hdmi_mirror_destroy(ctx->hdmi_mirror);
+        ctx->hdmi_mirror = NULL;
+#endif
+
         pthread_mutex_lock(&ctx->shared->lock);
 
         if (!ctx->zerocopy)
@@ -1485,10 +1876,11 @@ static int overlay_data_close(struct hw_device_t *dev) {
         delete [] ctx->phyYbuffers;
         delete [] ctx->phyCbuffers;
         delete [] ctx->buffers_len;
+        delete [] ctx->drained;
 
         pthread_mutex_unlock(&ctx->shared->lock);
 
-        ctx->shared->dataReady = 0;
+        SHARED_STORE(ctx->shared->dataReady, 0);
         close_shared_data( ctx );
 
         free(ctx);
@@ -0,0 +1,300 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the overlay control side in this process and the data side in a
+ * forked one, the two sharing the control block like the surface flinger
+ * and the media server. The control side moves, resizes and rotates the
+ * overlay while the data side queues frames, with and without pauses
+ * longer than the idle period. Checks that no call fails, that neither
+ * side blocks and that every frame goes out. The emulated FIMC node lives
+ * in shared memory, so both processes see the same queue like they would
+ * on the driver. Returns 0 when every check passes.
+ */
+
+#define LOG_TAG "overlay_stress_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <hardware/hardware.h>
+#include <hardware/overlay.h>
+#include "sec_v4l2_shim.h"
+
+#define TEST_LCD_W          (800)
+#define TEST_LCD_H          (480)
+#define TEST_SRC_W          (640)
+#define TEST_SRC_H          (480)
+#define TEST_FORMAT         (HAL_PIXEL_FORMAT_YCbCr_420_P)  // mapped buffers
+#define TEST_ROUNDS         (3)
+#define TEST_FRAMES         (300)
+#define TEST_COMMITS        (200)
+#define FRAME_US            (16667)
+#define PAUSE_EVERY         (50)      // frames between two data side pauses
+#define PAUSE_US            (150000)  // longer than OVERLAY_DATA_IDLE_MS
+#define DQ_RETRIES          (100)
+#define TEST_TIMEOUT_S      (60)
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            g_failures++;                                               \
+        }                                                               \
+    } while (0)
+
+/* shared with the Camera/Video Playback HAL, see overlay.cpp */
+#define ALL_BUFFERS_FLUSHED (-66)
+
+struct window {
+    int      x;
+    int      y;
+    uint32_t w;
+    uint32_t h;
+};
+
+static const struct window g_windows[] = {
+    {   0,   0, 800, 480 },
+    {  80,  60, 640, 360 },
+    { 160, 104, 480, 272 },
+    { 400, 240, 320, 240 },
+    {  16,  16, 256, 192 },
+};
+
+static const int g_transforms[] = {
+    0,
+    OVERLAY_TRANSFORM_ROT_90,
+    OVERLAY_TRANSFORM_ROT_180,
+    OVERLAY_TRANSFORM_ROT_270,
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+extern struct overlay_module_t HAL_MODULE_INFO_SYM;
+
+static void add_nodes(void)
+{
+    struct sec_v4l2_emul_config config;
+
+    memset(&config, 0, sizeof(config));
+    config.width  = TEST_LCD_W;
+    config.height = TEST_LCD_H;
+    config.bpp    = 32;
+    config.frame_interval_us = FRAME_US;
+
+    config.phys_base = 0x51000000;
+    sec_v4l2_emul_add_node("/dev/video1", SEC_V4L2_EMUL_OUTPUT, &config);
+    config.phys_base = 0x70000000;
+    sec_v4l2_emul_add_node("/dev/graphics/fb0", SEC_V4L2_EMUL_FB, &config);
+}
+
+static hw_device_t *open_device(const char *name)
+{
+    hw_device_t *device = NULL;
+
+    // parenthesized, the shim maps open() and close() to the emulator
+    if ((HAL_MODULE_INFO_SYM.common.methods->open)(&HAL_MODULE_INFO_SYM.common,
+                                                   name, &device) != 0)
+        return NULL;
+
+    return device;
+}
+
+/* the media server side, runs in the child */
+static int run_data_side(overlay_handle_t handle)
+{
+    overlay_data_device_t *data =
+        (overlay_data_device_t *)open_device(OVERLAY_HARDWARE_DATA);
+    int owned[32];
+    int num_owned = 0;
+    int queued = 0;
+    int frames = 0;
+    int flushes = 0;
+
+    CHECK(data != NULL);
+    if (data == NULL)
+        return 1;
+
+    CHECK(data->initialize(data, handle) == 0);
+
+    int num_buffers = data->getBufferCount(data);
+    CHECK(0 < num_buffers && num_buffers <= (int)ARRAY_SIZE(owned));
+    if (num_buffers <= 0 || (int)ARRAY_SIZE(owned) < num_buffers)
+        return 1;
+
+    for (int i = 0; i < num_buffers; i++)
+        owned[num_owned++] = i;
+
+    while (frames < TEST_FRAMES && g_failures == 0) {
+        overlay_buffer_t buffer;
+        int rc = 0;
+
+        // the driver shows the previous frame meanwhile
+        for (int retry = 0; num_owned == 0; retry++) {
+            rc = data->dequeueBuffer(data, &buffer);
+            if (rc == ALL_BUFFERS_FLUSHED) {
+                flushes++;
+                break;
+            }
+            if (rc == 0) {
+                owned[num_owned++] = *(int *)&buffer;
+                queued--;
+                break;
+            }
+            CHECK(retry < DQ_RETRIES);
+            if (DQ_RETRIES <= retry)
+                break;
+            usleep(FRAME_US / 4);
+        }
+
+        if (rc == ALL_BUFFERS_FLUSHED || num_owned == 0) {
+            // the stream restarted : every buffer is ours again
+            num_owned = 0;
+            queued    = 0;
+            for (int i = 0; i < num_buffers; i++)
+                owned[num_owned++] = i;
+            continue;
+        }
+
+        int index = owned[--num_owned];
+
+        rc = data->queueBuffer(data, (overlay_buffer_t)(intptr_t)index);
+        if (rc == ALL_BUFFERS_FLUSHED) {
+            flushes++;
+            num_owned = 0;
+            queued    = 0;
+            for (int i = 0; i < num_buffers; i++)
+                owned[num_owned++] = i;
+            continue;
+        }
+        CHECK(rc == 0);
+
+        queued++;
+        frames++;
+
+        // keep one frame on screen, like a player
+        if (1 < queued) {
+            rc = data->dequeueBuffer(data, &buffer);
+            if (rc == 0) {
+                owned[num_owned++] = *(int *)&buffer;
+                queued--;
+            } else if (rc == ALL_BUFFERS_FLUSHED) {
+                flushes++;
+                num_owned = 0;
+                queued    = 0;
+                for (int i = 0; i < num_buffers; i++)
+                    owned[num_owned++] = i;
+            }
+        }
+
+        // an idle data side leaves geometry changes to the control side
+        usleep((frames % PAUSE_EVERY) ? FRAME_US : PAUSE_US);
+    }
+
+    CHECK(frames == TEST_FRAMES);
+    printf("data side : %d frames, %d flushes\n", frames, flushes);
+    fflush(stdout);
+
+    (data->common.close)(&data->common);
+
+    return g_failures ? 1 : 0;
+}
+
+static void run_round(overlay_control_device_t *control, unsigned int seed)
+{
+    overlay_t *overlay = control->createOverlay(control, TEST_SRC_W, TEST_SRC_H,
+                                                TEST_FORMAT);
+    int status = 0;
+
+    CHECK(overlay != NULL);
+    if (overlay == NULL)
+        return;
+
+    // a first position makes the control side ready
+    CHECK(control->setPosition(control, overlay, g_windows[0].x, g_windows[0].y,
+                               g_windows[0].w, g_windows[0].h) == 0);
+    CHECK(control->commit(control, overlay) == 0);
+
+    pid_t pid = fork();
+    CHECK(0 <= pid);
+    if (pid < 0) {
+        control->destroyOverlay(control, overlay);
+        return;
+    }
+
+    if (pid == 0) {
+        g_failures = 0;
+        _exit(run_data_side(overlay->getHandleRef(overlay)));
+    }
+
+    for (int i = 0; i < TEST_COMMITS; i++) {
+        const struct window *win = &g_windows[rand_r(&seed) % ARRAY_SIZE(g_windows)];
+        int transform = g_transforms[rand_r(&seed) % ARRAY_SIZE(g_transforms)];
+
+        CHECK(control->setPosition(control, overlay, win->x, win->y,
+                                   win->w, win->h) == 0);
+        CHECK(control->setParameter(control, overlay, OVERLAY_TRANSFORM,
+                                    transform) == 0);
+        CHECK(control->stage(control, overlay) == 0);
+        CHECK(control->commit(control, overlay) == 0);
+
+        usleep(rand_r(&seed) % (2 * FRAME_US));
+    }
+
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    control->destroyOverlay(control, overlay);
+}
+
+int main(int argc, char **argv)
+{
+    add_nodes();
+    sec_v4l2_emul_install();
+
+    // a side blocked on the shared lock fails the test instead of hanging it
+    alarm(TEST_TIMEOUT_S);
+
+    overlay_control_device_t *control =
+        (overlay_control_device_t *)open_device(OVERLAY_HARDWARE_CONTROL);
+    CHECK(control != NULL);
+
+    if (control != NULL) {
+        for (int round = 0; round < TEST_ROUNDS; round++)
+            run_round(control, round + 1);
+
+        (control->common.close)(&control->common);
+    }
+
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include "v4l2_utils.h"
+#include "sec_v4l2_shim.h"
 
 
 #define LOG_FUNCTION_NAME    LOGV("%s: %s",  __FILE__, __func__);
@@ -12,9 +12,10 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
+LOCAL_PATH:= $(call my-dir)
+
 ifeq ($(BOARD_USE_JPEG),true)
 
-LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 
@@ -29,6 +30,11 @@ LOCAL_SRC_FILES:= \
 LOCAL_SHARED_LIBRARIES:= liblog
 LOCAL_SHARED_LIBRARIES+= libdl
 
+ifeq ($(BOARD_USES_V4L2_SHIM),true)
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM
+LOCAL_SHARED_LIBRARIES += libv4l2shim
+endif
+
 LOCAL_MODULE_TAGS := eng
 
 LOCAL_MODULE:= libs5pjpeg
@@ -39,3 +45,4 @@ include $(BUILD_SHARED_LIBRARY)
 
 endif
 
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -13,17 +13,47 @@
 #include <signal.h>
 #include <math.h>
 #include <sys/poll.h>
+#include <sys/file.h>
+#include <pthread.h>
 
 #ifdef S5P_VMEM
 #include "s5p_vmem_api.h"
 #endif
 #include "jpeg_api.h"
-
-static struct jpeg_lib  *jpeg_ctx = NULL;
+#include "sec_v4l2_shim.h"
+
+enum jpeg_request_type {
+	JPEG_REQ_NONE,
+	JPEG_REQ_ENCODE,
+	JPEG_REQ_DECODE,
+};
+
+struct jpeg_lib {
+	int  jpeg_fd;
+	struct jpeg_args args;
+	struct jpeg_dec_param dec_param;
+	struct jpeg_enc_param enc_param;
 #ifdef S5P_VMEM
-static int mem_fp;
-unsigned int cookie;
-#endif /* S5P_VMEM */
+	int mem_fp;
+#endif
+	/* the device is ours between api_jpeg_lock() and api_jpeg_unlock() */
+	int locked;
+
+	/* request queue, protected by queue_lock */
+	enum jpeg_request_type	req;
+	int			req_pending;
+	enum jpeg_ret_type	req_ret;
+	jpeg_done_cb		req_done;
+	void			*req_cookie;
+	struct jpeg_lib		*req_next;
+};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_cond = PTHREAD_COND_INITIALIZER; /* new request */
+static pthread_cond_t  done_cond  = PTHREAD_COND_INITIALIZER; /* request done */
+static struct jpeg_lib *queue_head = NULL;
+static struct jpeg_lib *queue_tail = NULL;
+static int queue_thread_started = 0;
 
 static unsigned int get_yuv_size(enum jpeg_frame_format out_format,
 				unsigned int width, unsigned int height)
@@ -68,243 +98,265 @@ static int check_input_size(unsigned int width, unsigned int height)
 	return 0;
 }
 
-static void init_decode_param(void)
+/*
+ * flock() on the device : every open is its own lock owner, so it keeps
+ * out the other opens of this process as well as the other processes
+ */
+static int jpeg_flock(struct jpeg_lib *ctx, int operation)
 {
-	jpeg_ctx = (struct jpeg_lib *)malloc(sizeof(struct jpeg_lib));
-	memset(jpeg_ctx, 0x00, sizeof(struct jpeg_lib));
+	int ret;
+
+	do {
+		ret = flock(ctx->jpeg_fd, operation);
+	} while (ret < 0 && errno == EINTR);
 
-	jpeg_ctx->args.dec_param = (struct jpeg_dec_param *)malloc(sizeof(struct jpeg_dec_param));
-	memset(jpeg_ctx->args.dec_param, 0x00, sizeof(struct jpeg_dec_param));
+	if (ret < 0)
+		printf("JPEG flock(%d) failed %d\n", operation, errno);
 
+	return ret;
 }
 
-static void init_encode_param(void)
+static struct jpeg_lib *jpeg_open(void)
 {
-	jpeg_ctx = (struct jpeg_lib *)malloc(sizeof(struct jpeg_lib));
-	memset(jpeg_ctx, 0x00, sizeof(struct jpeg_lib));
+	struct jpeg_lib *ctx;
 
-	jpeg_ctx->args.enc_param = (struct jpeg_enc_param *)malloc(sizeof(struct jpeg_enc_param));
-	memset(jpeg_ctx->args.enc_param, 0x00, sizeof(struct jpeg_enc_param));
-
-}
+	ctx = (struct jpeg_lib *)malloc(sizeof(struct jpeg_lib));
+	if (ctx == NULL)
+		return NULL;
+	memset(ctx, 0x00, sizeof(struct jpeg_lib));
 
-int api_jpeg_decode_init()
-{
-	init_decode_param();
-	jpeg_ctx->jpeg_fd = open(JPEG_DRIVER_NAME, O_RDWR);
+	ctx->args.dec_param = &ctx->dec_param;
+	ctx->args.enc_param = &ctx->enc_param;
 
-	if (jpeg_ctx->jpeg_fd < 0) {
-		printf("JPEG driver open failed\n");
-		return -1;
+	ctx->jpeg_fd = open(JPEG_DRIVER_NAME, O_RDWR);
+	if (ctx->jpeg_fd < 0) {
+		printf("JPEG driver open failed %d\n", ctx->jpeg_fd);
+		free(ctx);
+		return NULL;
 	}
 
 #ifdef S5P_VMEM
-	mem_fp = s5p_vmem_open();
+	ctx->mem_fp = s5p_vmem_open();
 	printf("s5p_vmem_open\n");
 #else
-	jpeg_ctx->args.mmapped_addr = (char *) mmap(0, 
-			JPEG_TOTAL_BUF_SIZE, 
+	ctx->args.mmapped_addr = (char *) mmap(0,
+			JPEG_TOTAL_BUF_SIZE,
 			PROT_READ | PROT_WRITE,
 			MAP_SHARED,
-			jpeg_ctx->jpeg_fd, 0);
+			ctx->jpeg_fd, 0);
 
-	if (jpeg_ctx->args.mmapped_addr == NULL) {
+	if (ctx->args.mmapped_addr == MAP_FAILED) {
 		printf("JPEG mmap failed\n");
-		return -1;
+		close(ctx->jpeg_fd);
+		free(ctx);
+		return NULL;
 	}
-	/*
-	printf("api_jpeg_decode_init jpeg_ctx->args.mmapped_addr 0x%08x\n",
-						jpeg_ctx->args.mmapped_addr);
-	*/
 #endif /* S5P_VMEM */
-	
-	return jpeg_ctx->jpeg_fd;
+
+	return ctx;
 }
 
-int api_jpeg_encode_init()
+static int jpeg_close(struct jpeg_lib *ctx)
 {
-	init_encode_param();
-	jpeg_ctx->jpeg_fd = open(JPEG_DRIVER_NAME, O_RDWR);
-
-	if (jpeg_ctx->jpeg_fd < 0) {
-		printf("JPEG driver open failed %d\n", jpeg_ctx->jpeg_fd);
-		return -1;
-	}
-
-#ifdef S5P_VMEM
-	mem_fp = s5p_vmem_open();
-	printf("s5p_vmem_open\n");
-#else
-
-	jpeg_ctx->args.mmapped_addr = (char *) mmap(0, 
-			JPEG_TOTAL_BUF_SIZE, 
-			PROT_READ | PROT_WRITE,
-			MAP_SHARED,
-			jpeg_ctx->jpeg_fd, 0);
+	if (ctx == NULL)
+		return JPEG_FAIL;
 
-	if (jpeg_ctx->args.mmapped_addr == NULL) {
-		printf("JPEG mmap failed\n");
-		return -1;
-	}
-	/*
-	printf("api_jpeg_encode_init jpeg_ctx->args.mmapped_addr 0x%08x\n",
-						jpeg_ctx->args.mmapped_addr);
-	*/
-#endif /* S5P_VMEM */
-	return jpeg_ctx->jpeg_fd;
-}
+	/* a queued request still uses the buffers */
+	api_jpeg_unlock(ctx);
 
-int api_jpeg_decode_deinit(int dev_fd)
-{
-if (jpeg_ctx->args.mmapped_addr != NULL)
-	munmap(jpeg_ctx->args.mmapped_addr, JPEG_TOTAL_BUF_SIZE);
+	if (ctx->args.mmapped_addr != NULL)
+		munmap(ctx->args.mmapped_addr, JPEG_TOTAL_BUF_SIZE);
 
 #ifdef S5P_VMEM
-	s5p_free_share(mem_fp, jpeg_ctx->args.in_cookie, jpeg_ctx->args.in_buf);
-	s5p_free_share(mem_fp, jpeg_ctx->args.out_cookie, jpeg_ctx->args.out_buf);
-	s5p_vmem_close(mem_fp);
+	s5p_free_share(ctx->mem_fp, ctx->args.in_cookie, ctx->args.in_buf);
+	s5p_free_share(ctx->mem_fp, ctx->args.out_cookie, ctx->args.out_buf);
+	s5p_vmem_close(ctx->mem_fp);
 #endif
 
-	close(jpeg_ctx->jpeg_fd);
+	close(ctx->jpeg_fd);
 
-	if (jpeg_ctx->args.dec_param != NULL)
-		free(jpeg_ctx->args.dec_param);
-
-
-	free(jpeg_ctx);
+	free(ctx);
 
 	return JPEG_OK;
 }
 
-int api_jpeg_encode_deinit(int dev_fd)
+struct jpeg_lib *api_jpeg_decode_init(void)
 {
-if (jpeg_ctx->args.mmapped_addr != NULL)
-	munmap(jpeg_ctx->args.mmapped_addr, JPEG_TOTAL_BUF_SIZE);
-
-#ifdef S5P_VMEM
-	s5p_free_share(mem_fp, jpeg_ctx->args.in_cookie, jpeg_ctx->args.in_buf);
-	s5p_free_share(mem_fp, jpeg_ctx->args.out_cookie, jpeg_ctx->args.out_buf);
-	s5p_vmem_close(mem_fp);
-#endif
-	close(jpeg_ctx->jpeg_fd);
+	return jpeg_open();
+}
 
-	if (jpeg_ctx->args.enc_param != NULL)
-		free(jpeg_ctx->args.enc_param);
+struct jpeg_lib *api_jpeg_encode_init(void)
+{
+	return jpeg_open();
+}
 
+int api_jpeg_decode_deinit(struct jpeg_lib *ctx)
+{
+	return jpeg_close(ctx);
+}
 
-	free(jpeg_ctx);
+int api_jpeg_encode_deinit(struct jpeg_lib *ctx)
+{
+	return jpeg_close(ctx);
+}
 
-	return JPEG_OK;
+int api_jpeg_get_fd(struct jpeg_lib *ctx)
+{
+	return ctx->jpeg_fd;
 }
 
-void *api_jpeg_get_decode_in_buf(int dev_fd, unsigned int size)
+void *api_jpeg_get_decode_in_buf(struct jpeg_lib *ctx, unsigned int size)
 {
 	if (size < 0 || size > MAX_JPEG_RES) {
 		printf("Invalid decode input buffer size\r\n");
 		return NULL;
 	}
 #ifdef S5P_VMEM
-	jpeg_ctx->args.in_cookie = (unsigned int)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.in_cookie = (unsigned int)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_DEC_IN_BUF, size);
-	jpeg_ctx->args.in_buf = s5p_malloc_share(mem_fp,
-					jpeg_ctx->args.in_cookie,
-					&jpeg_ctx->args.in_buf_size);
+	ctx->args.in_buf = s5p_malloc_share(ctx->mem_fp,
+					ctx->args.in_cookie,
+					&ctx->args.in_buf_size);
 #else
-	jpeg_ctx->args.in_buf = (char *)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.in_buf = (char *)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_DEC_IN_BUF,
-				jpeg_ctx->args.mmapped_addr);
+				ctx->args.mmapped_addr);
 #endif /* S5P_VMEM */
-	return (void *)(jpeg_ctx->args.in_buf);
+	return (void *)(ctx->args.in_buf);
 }
 
-void *api_jpeg_get_encode_in_buf(int dev_fd, unsigned int size)
+void *api_jpeg_get_encode_in_buf(struct jpeg_lib *ctx, unsigned int size)
 {
 #ifdef S5P_VMEM
-	jpeg_ctx->args.in_cookie = (unsigned int)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.in_cookie = (unsigned int)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_ENC_IN_BUF, (size*3));
-	jpeg_ctx->args.in_buf = s5p_malloc_share(mem_fp,
-					jpeg_ctx->args.in_cookie,
-					&jpeg_ctx->args.in_buf_size);
+	ctx->args.in_buf = s5p_malloc_share(ctx->mem_fp,
+					ctx->args.in_cookie,
+					&ctx->args.in_buf_size);
 #else
-	jpeg_ctx->args.enc_param->size = size;
-	jpeg_ctx->args.in_buf = (char *)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.enc_param->size = size;
+	ctx->args.in_buf = (char *)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_ENC_IN_BUF,
-				jpeg_ctx->args.mmapped_addr);
+				ctx->args.mmapped_addr);
 #endif
-	
-	printf("api_jpeg_get_encode_in_buf: 0x%x\n",
-			jpeg_ctx->args.in_buf);
-	
-	return (void *)(jpeg_ctx->args.in_buf);
+
+	printf("api_jpeg_get_encode_in_buf: %p\n",
+			ctx->args.in_buf);
+
+	return (void *)(ctx->args.in_buf);
 }
 
-void *api_jpeg_get_decode_out_buf(int dev_fd)
+void *api_jpeg_get_decode_out_buf(struct jpeg_lib *ctx)
 {
 #ifdef S5P_VMEM
-	jpeg_ctx->args.out_cookie = (unsigned int)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.out_cookie = (unsigned int)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_DEC_OUT_BUF, JPEG_FRAME_BUF_SIZE);
-	jpeg_ctx->args.out_buf = s5p_malloc_share(mem_fp,
-					jpeg_ctx->args.out_cookie,
-					&jpeg_ctx->args.out_buf_size);
+	ctx->args.out_buf = s5p_malloc_share(ctx->mem_fp,
+					ctx->args.out_cookie,
+					&ctx->args.out_buf_size);
 #else
-	jpeg_ctx->args.out_buf = (char *)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.out_buf = (char *)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_DEC_OUT_BUF,
-				jpeg_ctx->args.mmapped_addr);
+				ctx->args.mmapped_addr);
 #endif /* S5P_VMEM */
-	/*
-	printf("api_jpeg_get_decode_out_buf: 0x%x\n",
-			jpeg_ctx->args.out_buf);
-	*/
-	return (void *)(jpeg_ctx->args.out_buf);
+	return (void *)(ctx->args.out_buf);
 }
 
-void *api_jpeg_get_encode_out_buf(int dev_fd)
+void *api_jpeg_get_encode_out_buf(struct jpeg_lib *ctx)
 {
 #ifdef S5P_VMEM
-	jpeg_ctx->args.out_cookie = (unsigned int)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.out_cookie = (unsigned int)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_ENC_OUT_BUF, JPEG_STREAM_BUF_SIZE);
-	jpeg_ctx->args.out_buf = s5p_malloc_share(mem_fp,
-					jpeg_ctx->args.out_cookie,
-					&jpeg_ctx->args.out_buf_size);
+	ctx->args.out_buf = s5p_malloc_share(ctx->mem_fp,
+					ctx->args.out_cookie,
+					&ctx->args.out_buf_size);
 #else
-	jpeg_ctx->args.out_buf = (char *)ioctl(jpeg_ctx->jpeg_fd,
+	ctx->args.out_buf = (char *)ioctl(ctx->jpeg_fd,
 				IOCTL_GET_ENC_OUT_BUF,
-				jpeg_ctx->args.mmapped_addr);
+				ctx->args.mmapped_addr);
 #endif /* S5P_VMEM */
 
-	printf("api_jpeg_get_encode_out_buf: 0x%x\n",
-			jpeg_ctx->args.out_buf);
+	printf("api_jpeg_get_encode_out_buf: %p\n",
+			ctx->args.out_buf);
+
+	return (void *)(ctx->args.out_buf);
+}
+
+void *api_jpeg_get_encode_base(struct jpeg_lib *ctx)
+{
+#ifdef S5P_VMEM
+	return NULL;
+#else
+	if (ctx == NULL)
+		return NULL;
+
+	return (void *)(ctx->args.mmapped_addr);
+#endif /* S5P_VMEM */
+}
+
+int api_jpeg_lock(struct jpeg_lib *ctx)
+{
+	/* a request queued before runs unlocked, it must not unlock us */
+	api_jpeg_wait(ctx);
+
+	if (ctx->locked)
+		return 0;
+
+	if (jpeg_flock(ctx, LOCK_EX) < 0)
+		return -1;
+
+	ctx->locked = 1;
+	return 0;
+}
 
-	return (void *)(jpeg_ctx->args.out_buf);
+void api_jpeg_unlock(struct jpeg_lib *ctx)
+{
+	/* a queued request still runs under the lock */
+	api_jpeg_wait(ctx);
+
+	if (!ctx->locked)
+		return;
+
+	ctx->locked = 0;
+	jpeg_flock(ctx, LOCK_UN);
 }
 
-void api_jpeg_set_decode_param(struct jpeg_dec_param *param)
-{	
-	memcpy(jpeg_ctx->args.dec_param, param, sizeof(struct jpeg_dec_param));			
-	ioctl(jpeg_ctx->jpeg_fd, IOCTL_SET_DEC_PARAM, jpeg_ctx->args.dec_param);
+void api_jpeg_set_decode_param(struct jpeg_lib *ctx, struct jpeg_dec_param *param)
+{
+	memcpy(ctx->args.dec_param, param, sizeof(struct jpeg_dec_param));
+	ioctl(ctx->jpeg_fd, IOCTL_SET_DEC_PARAM, ctx->args.dec_param);
 }
 
-void api_jpeg_set_encode_param(struct jpeg_enc_param *param)
-{	
-	memcpy(jpeg_ctx->args.enc_param, param, sizeof(struct jpeg_enc_param));
-	ioctl(jpeg_ctx->jpeg_fd, IOCTL_SET_ENC_PARAM, jpeg_ctx->args.enc_param);
+void api_jpeg_set_encode_param(struct jpeg_lib *ctx, struct jpeg_enc_param *param)
+{
+	memcpy(ctx->args.enc_param, param, sizeof(struct jpeg_enc_param));
+	ioctl(ctx->jpeg_fd, IOCTL_SET_ENC_PARAM, ctx->args.enc_param);
 }
 
-enum jpeg_ret_type api_jpeg_decode_exe(int dev_fd,
+enum jpeg_ret_type api_jpeg_decode_exe(struct jpeg_lib *ctx,
 					struct jpeg_dec_param *dec_param)
 {
 	struct jpeg_args *arg;
-	
-	arg = &(jpeg_ctx->args);
+	int ret;
+
+	arg = &(ctx->args);
 
-	ioctl(jpeg_ctx->jpeg_fd, IOCTL_JPEG_DEC_EXE, arg->dec_param);
 	/*
-	printf("api_jpeg_decode_exe dec_param->out_fmt :%d \
-			dec_param->width : %d dec_param->height : %d\n",
-			arg->dec_param->out_fmt,
-			arg->dec_param->width,
-			arg->dec_param->height);
-	*/
+	 * another open may have set its parameters since, so they are
+	 * set again while the codec is ours
+	 */
+	if (!ctx->locked && jpeg_flock(ctx, LOCK_EX) < 0)
+		return JPEG_DECODE_FAIL;
+	ioctl(ctx->jpeg_fd, IOCTL_SET_DEC_PARAM, arg->dec_param);
+	ret = ioctl(ctx->jpeg_fd, IOCTL_JPEG_DEC_EXE, arg->dec_param);
+	if (!ctx->locked)
+		jpeg_flock(ctx, LOCK_UN);
+
+	if (ret < 0) {
+		printf("JPEG decode failed\n");
+		return JPEG_DECODE_FAIL;
+	}
+
 	dec_param->width = arg->dec_param->width;
 	dec_param->height = arg->dec_param->height;
 	dec_param->size = get_yuv_size(arg->dec_param->out_fmt,
@@ -314,23 +366,153 @@ enum jpeg_ret_type api_jpeg_decode_exe(int dev_fd,
 	return JPEG_DECODE_OK;
 }
 
-enum jpeg_ret_type api_jpeg_encode_exe(int dev_fd,
+enum jpeg_ret_type api_jpeg_encode_exe(struct jpeg_lib *ctx,
 					struct jpeg_enc_param *enc_param)
 {
 	struct jpeg_args 	*arg;
-	arg = &(jpeg_ctx->args);
+	int ret;
+
+	arg = &(ctx->args);
 
 	// check MCU validation width & height & sampling mode
-	if (check_input_size(jpeg_ctx->args.enc_param->width,
-				jpeg_ctx->args.enc_param->height) < 0) {
+	if (check_input_size(arg->enc_param->width,
+				arg->enc_param->height) < 0) {
 		printf("width/height doesn't match with MCU\r\n");
 		return JPEG_FAIL;
 	}
-	
-	ioctl(jpeg_ctx->jpeg_fd, IOCTL_JPEG_ENC_EXE, arg->enc_param);
+
+	if (!ctx->locked && jpeg_flock(ctx, LOCK_EX) < 0)
+		return JPEG_ENCODE_FAIL;
+	ioctl(ctx->jpeg_fd, IOCTL_SET_ENC_PARAM, arg->enc_param);
+	ret = ioctl(ctx->jpeg_fd, IOCTL_JPEG_ENC_EXE, arg->enc_param);
+	if (!ctx->locked)
+		jpeg_flock(ctx, LOCK_UN);
+
+	if (ret < 0) {
+		printf("JPEG encode failed\n");
+		return JPEG_ENCODE_FAIL;
+	}
 
 	enc_param->size = arg->enc_param->size;
-	
+
 	return JPEG_ENCODE_OK;
 }
 
+static void *queue_thread(void *unused)
+{
+	struct jpeg_lib *ctx;
+	enum jpeg_ret_type ret;
+
+	pthread_mutex_lock(&queue_lock);
+
+	for (;;) {
+		while (queue_head == NULL)
+			pthread_cond_wait(&queue_cond, &queue_lock);
+
+		ctx = queue_head;
+		queue_head = ctx->req_next;
+		if (queue_head == NULL)
+			queue_tail = NULL;
+		ctx->req_next = NULL;
+
+		pthread_mutex_unlock(&queue_lock);
+
+		if (ctx->req == JPEG_REQ_ENCODE)
+			ret = api_jpeg_encode_exe(ctx, ctx->args.enc_param);
+		else
+			ret = api_jpeg_decode_exe(ctx, ctx->args.dec_param);
+
+		/* api_jpeg_wait() returns after the callback, the context is still busy in it */
+		if (ctx->req_done != NULL)
+			ctx->req_done(ctx, ret, ctx->req_cookie);
+
+		pthread_mutex_lock(&queue_lock);
+		ctx->req_ret     = ret;
+		ctx->req_pending = 0;
+		pthread_cond_broadcast(&done_cond);
+	}
+
+	return NULL;
+}
+
+static int queue_request(struct jpeg_lib *ctx, enum jpeg_request_type req,
+				jpeg_done_cb done, void *cookie)
+{
+	pthread_t thread;
+
+	pthread_mutex_lock(&queue_lock);
+
+	if (ctx->req_pending) {
+		pthread_mutex_unlock(&queue_lock);
+		printf("JPEG request already queued on this context\n");
+		return -1;
+	}
+
+	if (!queue_thread_started) {
+		if (pthread_create(&thread, NULL, queue_thread, NULL) != 0) {
+			pthread_mutex_unlock(&queue_lock);
+			printf("JPEG queue thread creation failed\n");
+			return -1;
+		}
+		pthread_detach(thread);
+		queue_thread_started = 1;
+	}
+
+	ctx->req         = req;
+	ctx->req_pending = 1;
+	ctx->req_done    = done;
+	ctx->req_cookie  = cookie;
+	ctx->req_next    = NULL;
+
+	if (queue_tail != NULL)
+		queue_tail->req_next = ctx;
+	else
+		queue_head = ctx;
+	queue_tail = ctx;
+
+	pthread_cond_signal(&queue_cond);
+	pthread_mutex_unlock(&queue_lock);
+
+	return 0;
+}
+
+int api_jpeg_queue_encode(struct jpeg_lib *ctx, struct jpeg_enc_param *enc_param,
+				jpeg_done_cb done, void *cookie)
+{
+	if (ctx->req_pending)
+		return -1;
+
+	memcpy(ctx->args.enc_param, enc_param, sizeof(struct jpeg_enc_param));
+	return queue_request(ctx, JPEG_REQ_ENCODE, done, cookie);
+}
+
+int api_jpeg_queue_decode(struct jpeg_lib *ctx, struct jpeg_dec_param *dec_param,
+				jpeg_done_cb done, void *cookie)
+{
+	if (ctx->req_pending)
+		return -1;
+
+	memcpy(ctx->args.dec_param, dec_param, sizeof(struct jpeg_dec_param));
+	return queue_request(ctx, JPEG_REQ_DECODE, done, cookie);
+}
+
+enum jpeg_ret_type api_jpeg_wait(struct jpeg_lib *ctx)
+{
+	enum jpeg_ret_type ret;
+
+	pthread_mutex_lock(&queue_lock);
+
+	while (ctx->req_pending)
+		pthread_cond_wait(&done_cond, &queue_lock);
+
+	ret = ctx->req_ret;
+
+	pthread_mutex_unlock(&queue_lock);
+
+	return ret;
+}
+
+unsigned int api_jpeg_get_encode_size(struct jpeg_lib *ctx)
+{
+	return ctx->args.enc_param->size;
+}
@@ -0,0 +1,33 @@
+# Copyright (C) 2008 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# the library under test is built in, routed to the emulated codec
+LOCAL_SRC_FILES := \
+	jpeg_api_test.c \
+	../jpeg_api.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM
+
+LOCAL_STATIC_LIBRARIES := libv4l2shim_static
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+
+LOCAL_MODULE := jpeg_api_test
+include $(BUILD_EXECUTABLE)
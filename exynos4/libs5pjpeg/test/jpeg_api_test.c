@@ -0,0 +1,212 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs libs5pjpeg on the emulated codec (SEC_V4L2_EMUL_JPEG) : two
+ * contexts share the codec buffers from two threads, each filling the
+ * input, coding and reading the output back under api_jpeg_lock().
+ * The emulator writes a checksum of the input into every stream, so a
+ * picture coded from the other thread's input is caught.
+ * Returns 0 when every check passes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "jpeg_api.h"
+#include "sec_v4l2_shim.h"
+
+#define TEST_WIDTH      (320)
+#define TEST_HEIGHT     (240)
+#define TEST_FRAME_SIZE (TEST_WIDTH * TEST_HEIGHT * 2)
+#define TEST_PICTURES   (20)
+#define TEST_CODE_US    (2000)  // emulated coding time, leaves room to interleave
+
+static int g_failures = 0;
+static pthread_mutex_t g_failures_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            pthread_mutex_lock(&g_failures_lock);                       \
+            g_failures++;                                               \
+            pthread_mutex_unlock(&g_failures_lock);                     \
+        }                                                               \
+    } while (0)
+
+/* same as the emulator */
+static unsigned int checksum(const unsigned char *data, unsigned int size)
+{
+    unsigned int sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < size; i++)
+        sum = (sum << 5) + sum + data[i];
+    return sum;
+}
+
+/* checksum of the input the stream was coded from, from its COM segment */
+static int stream_checksum(const unsigned char *stream, unsigned int size, unsigned int *sum)
+{
+    unsigned int width, height;
+    int fmt, quality;
+    char com[64];
+    int len;
+
+    if (size < 8 || stream[0] != 0xFF || stream[1] != 0xD8 || stream[2] != 0xFF || stream[3] != 0xFE)
+        return -1;
+
+    len = (stream[4] << 8 | stream[5]) - 2;
+    if (len <= 0 || (int)sizeof(com) <= len)
+        return -1;
+
+    memcpy(com, stream + 6, len);
+    com[len] = 0;
+    if (sscanf(com, "emul %u %u %d %d %08x", &width, &height, &fmt, &quality, sum) != 5)
+        return -1;
+
+    return 0;
+}
+
+struct coder
+{
+    int          id;
+    int          queued;     // through api_jpeg_queue_encode()
+    unsigned int pictures;
+};
+
+static void *coder_thread(void *arg)
+{
+    struct coder *coder = (struct coder *)arg;
+    struct jpeg_enc_param param;
+    struct jpeg_lib *ctx;
+    unsigned char *in, *out;
+    int i;
+
+    ctx = api_jpeg_encode_init();
+    CHECK(ctx != NULL);
+    if (ctx == NULL)
+        return NULL;
+
+    in  = (unsigned char *)api_jpeg_get_encode_in_buf(ctx, TEST_FRAME_SIZE);
+    out = (unsigned char *)api_jpeg_get_encode_out_buf(ctx);
+    CHECK(in != NULL && out != NULL);
+
+    memset(&param, 0, sizeof(param));
+    param.width   = TEST_WIDTH;
+    param.height  = TEST_HEIGHT;
+    param.in_fmt  = YUV_422;
+    param.out_fmt = JPEG_422;
+    param.quality = QUALITY_LEVEL_1;
+
+    for (i = 0; in != NULL && out != NULL && i < TEST_PICTURES; i++) {
+        unsigned int expected, coded = 0;
+        enum jpeg_ret_type ret;
+
+        CHECK(api_jpeg_lock(ctx) == 0);
+
+        memset(in, (coder->id << 6) | i, TEST_FRAME_SIZE);
+        expected = checksum(in, TEST_FRAME_SIZE);
+
+        api_jpeg_set_encode_param(ctx, &param);
+        if (coder->queued) {
+            CHECK(api_jpeg_queue_encode(ctx, &param, NULL, NULL) == 0);
+            ret = api_jpeg_wait(ctx);
+        } else {
+            ret = api_jpeg_encode_exe(ctx, &param);
+        }
+        CHECK(ret == JPEG_ENCODE_OK);
+
+        CHECK(stream_checksum(out, api_jpeg_get_encode_size(ctx), &coded) == 0);
+        CHECK(coded == expected);
+
+        api_jpeg_unlock(ctx);
+        coder->pictures++;
+    }
+
+    CHECK(api_jpeg_encode_deinit(ctx) == JPEG_OK);
+    return NULL;
+}
+
+/* a second open must wait for the lock, and get it once it is dropped or closed */
+static void test_lock_excludes(void)
+{
+    struct jpeg_lib *a = api_jpeg_encode_init();
+    struct jpeg_lib *b = api_jpeg_encode_init();
+
+    CHECK(a != NULL && b != NULL);
+    if (a == NULL || b == NULL)
+        return;
+
+    CHECK(api_jpeg_lock(a) == 0);
+    CHECK(flock(api_jpeg_get_fd(b), LOCK_EX | LOCK_NB) < 0);
+    api_jpeg_unlock(a);
+    CHECK(flock(api_jpeg_get_fd(b), LOCK_EX | LOCK_NB) == 0);
+    CHECK(flock(api_jpeg_get_fd(b), LOCK_UN) == 0);
+
+    CHECK(api_jpeg_lock(a) == 0);
+    CHECK(api_jpeg_encode_deinit(a) == JPEG_OK);
+    CHECK(api_jpeg_lock(b) == 0);
+    api_jpeg_unlock(b);
+    CHECK(api_jpeg_encode_deinit(b) == JPEG_OK);
+}
+
+static void test_shared_buffers(void)
+{
+    struct coder coders[2];
+    pthread_t threads[2];
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        coders[i].id       = i + 1;
+        coders[i].queued   = i;
+        coders[i].pictures = 0;
+        pthread_create(&threads[i], NULL, coder_thread, &coders[i]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(coders[i].pictures == TEST_PICTURES);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct sec_v4l2_emul_config config;
+
+    memset(&config, 0, sizeof(config));
+    config.frame_interval_us = TEST_CODE_US;
+    sec_v4l2_emul_add_node(JPEG_DRIVER_NAME, SEC_V4L2_EMUL_JPEG, &config);
+    sec_v4l2_emul_install();
+
+    test_lock_excludes();
+    test_shared_buffers();
+
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}
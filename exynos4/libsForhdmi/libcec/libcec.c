@@ -84,6 +84,38 @@ int CECOpen()
     return res;
 }
 
+/**
+ * Use an already opened file descriptor as CEC device.
+ * The descriptor is owned by libcec afterwards, CECClose() closes it.
+ * Lets a socketpair stand in for the CEC driver.
+ *
+ * @param newFd   [in] CEC file descriptor.
+ *
+ * @return  If success to assign CEC file descriptor, return 1; otherwise, return 0.
+ */
+int CECOpenFd(int newFd)
+{
+    if (newFd < 0)
+        return 0;
+
+    if (fd != -1)
+        CECClose();
+
+    fd = newFd;
+
+    return 1;
+}
+
+/**
+ * Get CEC file descriptor, to wait for messages with poll()/epoll().
+ *
+ * @return  CEC file descriptor, or -1 if CEC device is not opened.
+ */
+int CECGetFd()
+{
+    return fd;
+}
+
 /**
  * Close CEC file descriptor.
  *
@@ -179,6 +179,8 @@ enum CECDeviceType {
 };
 
 int CECOpen();
+int CECOpenFd(int newFd);
+int CECGetFd();
 int CECClose();
 int CECAllocLogicalAddress(int paddr, enum CECDeviceType devtype);
 int CECSendMessage(unsigned char *buffer, int size);
@@ -184,6 +184,71 @@ static int ReadEDIDBlock(const unsigned int blockNum, unsigned char* const outBu
     return 1;
 }
 
+//! Maximum number of DTDs kept in the model
+#define EDID_MAX_DTD_NUM                                (32)
+//! Maximum number of Short Audio Descriptors kept in the model
+#define EDID_MAX_SAD_NUM                                (32)
+//! Number of entries in aVideoParams
+#define EDID_VIDEO_FORMAT_NUM                           ((int)(sizeof(aVideoParams)/sizeof(aVideoParams[0])))
+
+//! Detailed Timing Descriptor
+struct edid_dtd
+{
+    int pixelclock;
+    int hblank;
+    int hactive;
+    int vblank;
+    int vactive;
+    int interlaced;
+};
+
+//! Short Audio Descriptor
+struct edid_sad
+{
+    int format;
+    int channels;
+    int sampleFreq;
+    int wordLen;
+};
+
+/**
+ * @var gEdidModel
+ * EDID parsed once by EDIDRead(), queried by every EDIDxxxSupport()
+ */
+static struct edid_model
+{
+    /** 640x480p\@60Hz in Established Timings */
+    int ET640x480p;
+
+    /** VICs of all Short Video Descriptors */
+    unsigned char vic[128/SIZEOFBYTE];
+
+    /** DTDs of block 0 and of the timing extensions */
+    struct edid_dtd dtd[EDID_MAX_DTD_NUM];
+    int dtdNum;
+
+    /** supported video formats, bit 0 : 4:3 VIC, bit 1 : 16:9 VIC */
+    unsigned char format[64];
+
+    /** HDMI VSDB found */
+    int hdmi;
+    /** CEC physical address, valid if hdmi */
+    int cecPhyAddr;
+    /** Deep color byte of VSDB, -1 if VSDB is too short */
+    int deepColor;
+
+    /** OR of the color space bits of the timing extensions */
+    int colorSpace;
+
+    /** first colorimetry data block, -1 if none */
+    int colorimetry;
+    int metadata;
+
+    /** Short Audio Descriptors */
+    struct edid_sad sad[EDID_MAX_SAD_NUM];
+    int sadNum;
+} gEdidModel;
+
 /**
  * Check if EDID data is valid or not.
  * @return if EDID data is valid, return 1; Otherwise, return 0.
@@ -195,260 +260,309 @@ static inline int EDIDValid(void)
 
 /**
  * Check if EDID extension block is timing extension block or not.
- * @param   extension   [in] The number of EDID extension block to check
+ * @param   block   [in] Pointer to EDID extension block
  * @return  If the block is timing extension, return 1; Otherwise, return 0.
  */
-static int IsTimingExtension(const int extension)
+static int IsTimingExtension(const unsigned char* const block)
 {
-    if (!EDIDValid() || (extension > gExtensions) ){
-        DPRINTF("EDID Data is not available\n");
-        return 0;
-    }
-
-    if (gEdidData[extension*SIZEOFEDIDBLOCK] == EDID_TIMING_EXT_TAG_VAL
-      && gEdidData[extension*SIZEOFEDIDBLOCK + EDID_TIMING_EXT_REV_NUMBER_POS] >= 1)
+    if (block[EDID_TIMING_EXT_TAG_ADDR_POS] == EDID_TIMING_EXT_TAG_VAL
+      && block[EDID_TIMING_EXT_REV_NUMBER_POS] >= 1)
         return 1;
     return 0;
 }
 
 /**
- * Search Vender Specific Data Block(VSDB) in EDID extension block.
- * @param   extension   [in] the number of EDID extension block to check
- * @return  if there is a VSDB, return the its offset from start of @n
- *          EDID extension block. if there is no VSDB, return 0.
+ * Get the end of the data block collection of a timing extension block.
+ * The DTD offset comes from the sink, so it is clamped to the block.
+ * @param   block   [in] Pointer to EDID extension block
+ * @return  Offset of the first DTD from start of the block.
  */
-static int GetVSDBOffset(const int extension)
+static unsigned int GetDTDOffset(const unsigned char* const block)
 {
-    unsigned int BlockOffset = extension*SIZEOFEDIDBLOCK;
-    unsigned int offset = BlockOffset + EDID_DATA_BLOCK_START_POS;
-    unsigned int tag,blockLen,DTDOffset;
-
-    if (!EDIDValid() || (extension > gExtensions) ){
-        DPRINTF("EDID Data is not available\n");
-        return 0;
-    }
-
-    DTDOffset = gEdidData[BlockOffset + EDID_DETAILED_TIMING_OFFSET_POS];
+    unsigned int DTDOffset = block[EDID_DETAILED_TIMING_OFFSET_POS];
 
-    // check if there is HDMI VSDB
-    while ( offset < BlockOffset + DTDOffset )
-    {
-        // find the block tag and length
-        // tag
-        tag = gEdidData[offset] & EDID_TAG_CODE_MASK;
-        // block len
-        blockLen = (gEdidData[offset] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
-
-        // check if it is HDMI VSDB
-        // if so, check identifier value, if it's hdmi vsbd - return offset
-        if (tag == EDID_VSDB_TAG_VAL &&
-            gEdidData[offset+1] == 0x03 &&
-            gEdidData[offset+2] == 0x0C &&
-            gEdidData[offset+3] == 0x0 &&
-            blockLen > EDID_VSDB_MIN_LENGTH_VAL )
-        {
-            return offset;
-        }
-        // else find next block
-        offset += blockLen;
-    } // while()
-
-    // return error
-    return 0;
+    if (DTDOffset < EDID_DATA_BLOCK_START_POS || DTDOffset > SIZEOFEDIDBLOCK - 1)
+        return EDID_DATA_BLOCK_START_POS;
+    return DTDOffset;
 }
 
 /**
- * Check if the video format is contained in - @n
- * Detailed Timing Descriptor(DTD) of EDID extension block.
- * @param   extension   [in]    Number of EDID extension block to check
- * @param   videoFormat [in]    Video format to check
- * @return  If the video format is contained in DTD of EDID extension block, -@n
- *          return 1; Otherwise, return 0.
+ * Parse Detailed Timing Descriptors.
+ * @param   buffer  [in] Pointer to the first DTD
+ * @param   size    [in] Bytes available from buffer
  */
-static int IsContainVideoDTD(const int extension,const enum VideoFormat videoFormat)
+static void ParseDTD(const unsigned char* const buffer, const unsigned int size)
 {
-    int i,StartAddr,EndAddr;
-
-    if (!EDIDValid() || (extension > gExtensions) ){
-        DPRINTF("EDID Data is not available\n");
-        return 0;
-    }
-
-    // if edid block( 0th block )
-    if (extension == 0)
-    {
-        StartAddr = EDID_DTD_START_ADDR;
-        EndAddr = StartAddr + EDID_DTD_TOTAL_LENGTH;
-    }
-    else // if edid extension block
-    {
-        StartAddr = extension*SIZEOFEDIDBLOCK + gEdidData[extension*SIZEOFEDIDBLOCK + EDID_DETAILED_TIMING_OFFSET_POS];
-        EndAddr = (extension+1)*SIZEOFEDIDBLOCK;
-    }
+    unsigned int i;
 
-    // check DTD(Detailed Timing Description)
-    for (i = StartAddr; i < EndAddr; i+= EDID_DTD_BYTE_LENGTH)
+    for (i = 0; i + EDID_DTD_BYTE_LENGTH <= size; i += EDID_DTD_BYTE_LENGTH)
     {
-        int hblank = 0, hactive = 0, vblank = 0, vactive = 0, interlaced = 0, pixelclock = 0;
-        int vHActive = 0, vVActive = 0, vVBlank;
+        const unsigned char* const d = buffer + i;
+        struct edid_dtd *dtd;
+        int pixelclock;
 
         // get pixel clock
-        pixelclock = (gEdidData[i+EDID_DTD_PIXELCLOCK_POS2] << SIZEOFBYTE);
-        pixelclock |= gEdidData[i+EDID_DTD_PIXELCLOCK_POS1];
+        pixelclock = (d[EDID_DTD_PIXELCLOCK_POS2] << SIZEOFBYTE);
+        pixelclock |= d[EDID_DTD_PIXELCLOCK_POS1];
 
+        // monitor descriptor
         if (!pixelclock)
-        {
             continue;
-        }
+
+        if (gEdidModel.dtdNum >= EDID_MAX_DTD_NUM)
+            return;
+
+        dtd = &gEdidModel.dtd[gEdidModel.dtdNum++];
+        dtd->pixelclock = pixelclock;
 
         // get HBLANK value in pixels
-        hblank = gEdidData[i+EDID_DTD_HBLANK_POS2] & EDID_DTD_HBLANK_POS2_MASK;
-        hblank <<= SIZEOFBYTE; // lower 4 bits
-        hblank |= gEdidData[i+EDID_DTD_HBLANK_POS1];
+        dtd->hblank = (d[EDID_DTD_HBLANK_POS2] & EDID_DTD_HBLANK_POS2_MASK) << SIZEOFBYTE;
+        dtd->hblank |= d[EDID_DTD_HBLANK_POS1];
 
         // get HACTIVE value in pixels
-        hactive = gEdidData[i+EDID_DTD_HACTIVE_POS2] & EDID_DTD_HACTIVE_POS2_MASK;
-        hactive <<= (SIZEOFBYTE/2); // upper 4 bits
-        hactive |= gEdidData[i+EDID_DTD_HACTIVE_POS1];
+        dtd->hactive = (d[EDID_DTD_HACTIVE_POS2] & EDID_DTD_HACTIVE_POS2_MASK) << (SIZEOFBYTE/2);
+        dtd->hactive |= d[EDID_DTD_HACTIVE_POS1];
 
         // get VBLANK value in pixels
-        vblank = gEdidData[i+EDID_DTD_VBLANK_POS2] & EDID_DTD_VBLANK_POS2_MASK;
-        vblank <<= SIZEOFBYTE; // lower 4 bits
-        vblank |= gEdidData[i+EDID_DTD_VBLANK_POS1];
+        dtd->vblank = (d[EDID_DTD_VBLANK_POS2] & EDID_DTD_VBLANK_POS2_MASK) << SIZEOFBYTE;
+        dtd->vblank |= d[EDID_DTD_VBLANK_POS1];
 
         // get VACTIVE value in pixels
-        vactive = gEdidData[i+EDID_DTD_VACTIVE_POS2] & EDID_DTD_VACTIVE_POS2_MASK;
-        vactive <<= (SIZEOFBYTE/2); // upper 4 bits
-        vactive |= gEdidData[i+EDID_DTD_VACTIVE_POS1];
-
-        vHActive = ((aVideoParams[videoFormat].vHVLine & 0xFFF000)>>12) - aVideoParams[videoFormat].vHBlank;
-        vVActive = (aVideoParams[videoFormat].vVBlank & 0x3FF);
-        vVBlank = (aVideoParams[videoFormat].vVBlank & 0xFFC00) >> 11;
-        vVActive -= vVBlank;
+        dtd->vactive = (d[EDID_DTD_VACTIVE_POS2] & EDID_DTD_VACTIVE_POS2_MASK) << (SIZEOFBYTE/2);
+        dtd->vactive |= d[EDID_DTD_VACTIVE_POS1];
 
         // get Interlaced Mode Value
-        interlaced = (int)(gEdidData[i+EDID_DTD_INTERLACE_POS] & EDID_DTD_INTERLACE_MASK);
-        if (interlaced) interlaced = 1;
-
-        if (hblank == aVideoParams[videoFormat].vHBlank && vblank == vVBlank // blank
-            && hactive == vHActive && vactive == vVActive ) //line
-        {
-            int EDIDpixelclock = aVideoParams[videoFormat].PixelClock;
-            EDIDpixelclock /= 100; pixelclock /= 100;
+        dtd->interlaced = (d[EDID_DTD_INTERLACE_POS] & EDID_DTD_INTERLACE_MASK) ? 1 : 0;
 
-            if (pixelclock == EDIDpixelclock)
-            {
-                DPRINTF("Sink Support the Video mode\n");
-                return 1;
-            }
-        }
-    } // for
-    return 0;
+        DPRINTF("DTD %dx%d blank %dx%d clock %d\n", dtd->hactive, dtd->vactive,
+                dtd->hblank, dtd->vblank, dtd->pixelclock);
+    }
 }
 
 /**
- * Check if a VIC(Video Identification Code) is contained in -@n
- * EDID extension block.
- * @param   extension   [in]    Number of EDID extension block to check
- * @param   VIC         [in]    VIC to check
- * @return  If the VIC is contained in contained in EDID extension block, -@n
- *          return 1; Otherwise, return 0.
+ * Parse the data block collection of a timing extension block.
+ * Fills VICs, VSDB fields, colorimetry and audio descriptors of the model.
+ * @param   block   [in] Pointer to EDID extension block
  */
-static int IsContainVIC(const int extension, const int VIC)
+static void ParseDataBlocks(const unsigned char* const block)
 {
-    unsigned int StartAddr = extension*SIZEOFEDIDBLOCK;
-    unsigned int ExtAddr = StartAddr + EDID_DATA_BLOCK_START_POS;
-    unsigned int tag,blockLen;
-    unsigned int DTDStartAddr = gEdidData[StartAddr + EDID_DETAILED_TIMING_OFFSET_POS];
-
-    if (!EDIDValid() || (extension > gExtensions)){
-        DPRINTF("EDID Data is not available\n");
-        return 0;
-    }
+    unsigned int offset = EDID_DATA_BLOCK_START_POS;
+    unsigned int end = GetDTDOffset(block);
+    unsigned int tag, blockLen, i;
 
-    // while
-    while ( ExtAddr < StartAddr + DTDStartAddr )
+    while (offset < end)
     {
         // find the block tag and length
-        // tag
-        tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
-        // block len
-        blockLen = (gEdidData[ExtAddr] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
+        tag = block[offset] & EDID_TAG_CODE_MASK;
+        blockLen = (block[offset] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
+
         DPRINTF("tag = %d\n",tag);
         DPRINTF("blockLen = %d\n",blockLen-1);
 
-        // check if it is short video description
-        if (tag == EDID_SHORT_VID_DEC_TAG_VAL)
+        // a block running over the DTDs is broken, ignore the rest
+        if (offset + blockLen > end)
+            break;
+
+        switch (tag)
         {
-            // if so, check SVD
-            int index;
-            for (index=1; index < blockLen;index++)
-            {
-                DPRINTF("EDIDVIC = %d\n",gEdidData[ExtAddr+index] & EDID_SVD_VIC_MASK);
-                DPRINTF("VIC = %d\n",VIC);
+            case EDID_SHORT_VID_DEC_TAG_VAL:
+                for (i = 1; i < blockLen; i++)
+                {
+                    int vic = block[offset+i] & EDID_SVD_VIC_MASK;
+                    gEdidModel.vic[vic / SIZEOFBYTE] |= 1 << (vic % SIZEOFBYTE);
+                }
+                break;
 
-                // check VIC with SVDB
-                if (VIC == (gEdidData[ExtAddr+index] & EDID_SVD_VIC_MASK) )
+            case EDID_SHORT_AUD_DEC_TAG_VAL:
+                for (i = 1; i + 2 < blockLen; i += 3)
                 {
-                    DPRINTF("Sink Device supports requested video mode\n");
-                    return 1;
+                    struct edid_sad *sad;
+
+                    if (gEdidModel.sadNum >= EDID_MAX_SAD_NUM)
+                        break;
+
+                    sad = &gEdidModel.sad[gEdidModel.sadNum++];
+                    sad->format     = block[offset+i] & EDID_SAD_CODE_MASK;
+                    sad->channels   = block[offset+i] & EDID_SAD_CHANNEL_MASK;
+                    sad->sampleFreq = block[offset+i+1];
+                    sad->wordLen    = block[offset+i+2];
                 }
-            } // for
-        } // if tag
-        // else find next block
-        ExtAddr += blockLen;
-    } // while()
+                break;
+
+            case EDID_VSDB_TAG_VAL:
+                // HDMI VSDB : IEEE registration identifier 0x000C03
+                if (!gEdidModel.hdmi &&
+                    block[offset+1] == 0x03 &&
+                    block[offset+2] == 0x0C &&
+                    block[offset+3] == 0x0 &&
+                    blockLen > EDID_VSDB_MIN_LENGTH_VAL)
+                {
+                    gEdidModel.hdmi = 1;
+                    gEdidModel.cecPhyAddr = block[offset + EDID_CEC_PHYICAL_ADDR] << 8;
+                    gEdidModel.cecPhyAddr |= block[offset + EDID_CEC_PHYICAL_ADDR + 1];
 
-    return 0;
+                    if (blockLen - 1 >= EDID_DC_POS)
+                        gEdidModel.deepColor = block[offset + EDID_DC_POS] & EDID_DC_MASK;
+                }
+                break;
+
+            case EDID_EXTENDED_TAG_VAL:
+                if (gEdidModel.colorimetry < 0 &&
+                    block[offset+1] == EDID_EXTENDED_COLORIMETRY_VAL &&
+                    (blockLen-1) == EDID_EXTENDED_COLORIMETRY_BLOCK_LEN)
+                {
+                    gEdidModel.colorimetry = block[offset+2];
+                    gEdidModel.metadata = block[offset+3];
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        // find next block
+        offset += blockLen;
+    }
 }
 
 /**
- * Check if EDID contains the video format.
+ * Check if the video format is contained in DTDs of the model.
  * @param   videoFormat [in]    Video format to check
- * @param   pixelRatio  [in]    Pixel aspect ratio of video format to check
- * @return  if EDID contains the video format, return 1; Otherwise, return 0.
+ * @return  If the video format is contained in DTDs, return 1; Otherwise, return 0.
  */
-static int CheckResolution(const enum VideoFormat videoFormat,
-                            const enum PixelAspectRatio pixelRatio)
+static int IsContainVideoDTD(const int videoFormat)
 {
-    int index,vic;
+    int i;
+    int vHActive, vVActive, vVBlank;
+    int EDIDpixelclock = aVideoParams[videoFormat].PixelClock / 100;
 
-    // read EDID
-    if(!EDIDRead())
+    vHActive = ((aVideoParams[videoFormat].vHVLine & 0xFFF000)>>12) - aVideoParams[videoFormat].vHBlank;
+    vVActive = (aVideoParams[videoFormat].vVBlank & 0x3FF);
+    vVBlank = (aVideoParams[videoFormat].vVBlank & 0xFFC00) >> 11;
+    vVActive -= vVBlank;
+
+    for (i = 0; i < gEdidModel.dtdNum; i++)
     {
-        return 0;
+        const struct edid_dtd *dtd = &gEdidModel.dtd[i];
+
+        if (dtd->hblank == (int)aVideoParams[videoFormat].vHBlank && dtd->vblank == vVBlank // blank
+            && dtd->hactive == vHActive && dtd->vactive == vVActive // line
+            && dtd->pixelclock / 100 == EDIDpixelclock)
+        {
+            return 1;
+        }
     }
+    return 0;
+}
+
+/**
+ * Check if a VIC(Video Identification Code) is in the Short Video Descriptors.
+ * @param   VIC [in]    VIC to check
+ * @return  If the VIC is contained, return 1; Otherwise, return 0.
+ */
+static inline int IsContainVIC(const int VIC)
+{
+    return (gEdidModel.vic[(VIC & EDID_SVD_VIC_MASK) / SIZEOFBYTE] >> (VIC % SIZEOFBYTE)) & 1;
+}
+
+/**
+ * Parse EDID data into gEdidModel.
+ * @param   data        [in] EDID data, (extensions + 1) blocks
+ * @param   extensions  [in] Number of EDID extension blocks
+ */
+static void ParseEDID(const unsigned char* const data, const int extensions)
+{
+    int index;
+
+    memset(&gEdidModel, 0, sizeof(gEdidModel));
+    gEdidModel.deepColor = -1;
+    gEdidModel.colorimetry = -1;
 
     // check ET(Established Timings) for 640x480p@60Hz
-    if ( videoFormat == v640x480p_60Hz // if it's 640x480p@60Hz
-        && (gEdidData[EDID_ET_POS] & EDID_ET_640x480p_VAL) ) // it support
+    gEdidModel.ET640x480p = (data[EDID_ET_POS] & EDID_ET_640x480p_VAL) ? 1 : 0;
+
+    // check DTD(Detailed Timing Description) of EDID block(0th)
+    ParseDTD(data + EDID_DTD_START_ADDR, EDID_DTD_TOTAL_LENGTH);
+
+    for (index = 1; index <= extensions; index++)
+    {
+        const unsigned char* const block = data + index*SIZEOFEDIDBLOCK;
+
+        if (!IsTimingExtension(block))
+            continue;
+
+        gEdidModel.colorSpace |= block[EDID_COLOR_SPACE_POS];
+
+        // no data block and no DTD
+        if (block[EDID_DETAILED_TIMING_OFFSET_POS] == 0)
+            continue;
+
+        ParseDataBlocks(block);
+        ParseDTD(block + GetDTDOffset(block), SIZEOFEDIDBLOCK - 1 - GetDTDOffset(block));
+    }
+
+    // resolve every video format once
+    for (index = 0; index < EDID_VIDEO_FORMAT_NUM && index < (int)sizeof(gEdidModel.format); index++)
     {
-         return 1;
+        int common = IsContainVideoDTD(index)
+            || (index == v640x480p_60Hz && gEdidModel.ET640x480p);
+
+        if (common || IsContainVIC(aVideoParams[index].VIC))
+            gEdidModel.format[index] |= 1 << HDMI_PIXEL_RATIO_4_3;
+        if (common || IsContainVIC(aVideoParams[index].VIC16_9))
+            gEdidModel.format[index] |= 1 << HDMI_PIXEL_RATIO_16_9;
     }
 
-    // check STI(Standard Timing Identification)
-    // do not need
+    DPRINTF("EDID parsed : hdmi %d, dtd %d, sad %d\n",
+            gEdidModel.hdmi, gEdidModel.dtdNum, gEdidModel.sadNum);
+}
 
-    // check DTD(Detailed Timing Description) of EDID block(0th)
-    if (IsContainVideoDTD(0,videoFormat))
+/**
+ * Check and keep EDID data, then parse it.
+ * @param   data    [in] EDID data, (extensions + 1) blocks, owned by libedid
+ * @return  If EDID data is usable, return 1; Otherwise, return 0.
+ */
+static int SetEDIDData(unsigned char* const data)
+{
+    int extensions = data[EDID_EXTENSION_NUMBER_POS];
+
+    // check if extension is more than 1, and first extension block is not block map.
+    if (extensions > 1 && data[SIZEOFEDIDBLOCK] != EDID_BLOCK_MAP_EXT_TAG_VAL)
     {
-        return 1;
+        DPRINTF("EDID has more than 1 extension but, first extension block is not block map\n");
+        free(data);
+        return 0;
     }
 
-    // check EDID Extension
-    vic = (pixelRatio == HDMI_PIXEL_RATIO_16_9) ? aVideoParams[videoFormat].VIC16_9 : aVideoParams[videoFormat].VIC;
+    gEdidData = data;
+    gExtensions = extensions;
 
-    // find VSDB
-    for ( index = 1 ; index <= gExtensions ; index++ )
+    ParseEDID(gEdidData, gExtensions);
+
+    return 1;
+}
+
+/**
+ * Check if EDID contains the video format.
+ * @param   videoFormat [in]    Video format to check
+ * @param   pixelRatio  [in]    Pixel aspect ratio of video format to check
+ * @return  if EDID contains the video format, return 1; Otherwise, return 0.
+ */
+static int CheckResolution(const enum VideoFormat videoFormat,
+                            const enum PixelAspectRatio pixelRatio)
+{
+    // read EDID
+    if(!EDIDRead())
     {
-        if ( IsTimingExtension(index) ) // if it's timing block
-        {
-            if (IsContainVIC(index,vic) || IsContainVideoDTD(index,videoFormat))
-                return 1;
-        }
+        return 0;
     }
 
-    return 0;
+    if ((int)videoFormat < 0 || (int)videoFormat >= EDID_VIDEO_FORMAT_NUM)
+        return 0;
+
+    if (pixelRatio == HDMI_PIXEL_RATIO_16_9)
+        return (gEdidModel.format[videoFormat] >> HDMI_PIXEL_RATIO_16_9) & 1;
+    return (gEdidModel.format[videoFormat] >> HDMI_PIXEL_RATIO_4_3) & 1;
 }
 
 /**
@@ -459,72 +573,37 @@ static int CheckResolution(const enum VideoFormat videoFormat,
  */
 static int CheckColorDepth(const enum ColorDepth depth,const enum ColorSpace space)
 {
-    int index;
-    unsigned int StartAddr;
+    int deepColor;
 
     // if color depth == 24 bit, no need to check
     if ( depth == HDMI_CD_24 )
         return 1;
 
-    // check EDID data is valid or not
     // read EDID
     if(!EDIDRead())
     {
         return 0;
     }
 
-    // find VSDB
-    for ( index = 1 ; index <= gExtensions ; index++ )
-    {
-        if ( IsTimingExtension(index) // if it's timing block
-            && ((StartAddr = GetVSDBOffset(index)) > 0) )   // check block
-        {
-            int blockLength = gEdidData[StartAddr] & EDID_DATA_BLOCK_SIZE_MASK;
-            if (blockLength >= EDID_DC_POS)
-            {
-                // get supported DC value
-                int deepColor = gEdidData[StartAddr + EDID_DC_POS] & EDID_DC_MASK;
-                DPRINTF("EDID deepColor = %x\n",deepColor);
-                // check supported DeepColor
-
-                // if YCBCR444
-                if (space == HDMI_CS_YCBCR444)
-                {
-                    if ( !(deepColor & EDID_DC_YCBCR_VAL))
-                        return 0;
-                }
+    deepColor = gEdidModel.deepColor;
+    DPRINTF("EDID deepColor = %x\n",deepColor);
+    if (deepColor < 0)
+        return 0;
 
-                // check colorDepth
-                switch (depth)
-                {
-                    case HDMI_CD_36:
-                    {
-                        deepColor &= EDID_DC_36_VAL;
-                        break;
-                    }
-                    case HDMI_CD_30:
-                    {
-                        deepColor &= EDID_DC_30_VAL;
-                        break;
-                    }
-                    case HDMI_CD_24:
-                    {
-                        deepColor = 1;
-                        break;
-                    }
-                    default :
-                        deepColor = 0;
-                } // switch
-
-                if (deepColor)
-                    return 1;
-                else
-                    return 0;
-            } // if
-        } // if
-    } // for
+    // if YCBCR444
+    if (space == HDMI_CS_YCBCR444 && !(deepColor & EDID_DC_YCBCR_VAL))
+        return 0;
 
-    return 0;
+    // check colorDepth
+    switch (depth)
+    {
+        case HDMI_CD_36:
+            return (deepColor & EDID_DC_36_VAL) ? 1 : 0;
+        case HDMI_CD_30:
+            return (deepColor & EDID_DC_30_VAL) ? 1 : 0;
+        default :
+            return 0;
+    }
 }
 
 /**
@@ -534,34 +613,21 @@ static int CheckColorDepth(const enum ColorDepth depth,const enum ColorSpace spa
  */
 static int CheckColorSpace(const enum ColorSpace space)
 {
-    int index;
-
     // RGB is default
     if (space == HDMI_CS_RGB)
         return 1;
 
-    // check EDID data is valid or not
     // read EDID
     if(!EDIDRead())
     {
         return 0;
     }
 
-    // find VSDB
-    for ( index = 1 ; index <= gExtensions ; index++ )
+    if ( (space == HDMI_CS_YCBCR444 && (gEdidModel.colorSpace & EDID_YCBCR444_CS_MASK)) || // YCBCR444
+            (space == HDMI_CS_YCBCR422 && (gEdidModel.colorSpace & EDID_YCBCR422_CS_MASK)) ) // YCBCR422
     {
-        if (IsTimingExtension(index))  // if it's timing block
-        {
-            // read Color Space
-            int CS = gEdidData[index*SIZEOFEDIDBLOCK + EDID_COLOR_SPACE_POS];
-
-            if ( (space == HDMI_CS_YCBCR444 && (CS & EDID_YCBCR444_CS_MASK)) || // YCBCR444
-                    (space == HDMI_CS_YCBCR422 && (CS & EDID_YCBCR422_CS_MASK)) ) // YCBCR422
-            {
-                return 1;
-            }
-        } // if
-    } // for
+        return 1;
+    }
     return 0;
 }
 
@@ -572,8 +638,6 @@ static int CheckColorSpace(const enum ColorSpace space)
  */
 static int CheckColorimetry(const enum HDMIColorimetry color)
 {
-    int index;
-
     // do not need to parse if not extended colorimetry
     if (color == HDMI_COLORIMETRY_NO_DATA || color == HDMI_COLORIMETRY_ITU601 || color == HDMI_COLORIMETRY_ITU709)
         return 1;
@@ -584,60 +648,21 @@ static int CheckColorimetry(const enum HDMIColorimetry color)
        return 0;
     }
 
-    // find VSDB
-    for ( index = 1 ; index <= gExtensions ; index++ )
-    {
-        if ( IsTimingExtension(index) ) // if it's timing block
-        {
-            // check address
-            unsigned int ExtAddr = index*SIZEOFEDIDBLOCK + EDID_DATA_BLOCK_START_POS;
-            unsigned int EndAddr = index*SIZEOFEDIDBLOCK + gEdidData[index*SIZEOFEDIDBLOCK + EDID_DETAILED_TIMING_OFFSET_POS];
-            unsigned int tag,blockLen;
+    if (gEdidModel.colorimetry < 0)
+        return 0;
 
-            // while
-            while ( ExtAddr < EndAddr )
-            {
-                // find the block tag and length
-                // tag
-                tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
-                // block len
-                blockLen = (gEdidData[ExtAddr] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
-
-                // check if it is colorimetry block
-                if (tag == EDID_EXTENDED_TAG_VAL && // extended tag
-                    gEdidData[ExtAddr+1] == EDID_EXTENDED_COLORIMETRY_VAL && // colorimetry block
-                    (blockLen-1) == EDID_EXTENDED_COLORIMETRY_BLOCK_LEN )// check length
-                {
-                    // get supported DC value
-                    int colorimetry = (gEdidData[ExtAddr + 2]);
-                    int metadata = (gEdidData[ExtAddr + 3]);
-
-                    DPRINTF("EDID extened colorimetry = %x\n",colorimetry);
-                    DPRINTF("EDID gamut metadata profile = %x\n",metadata);
-
-                    // check colorDepth
-                    switch (color)
-                    {
-                        case HDMI_COLORIMETRY_EXTENDED_xvYCC601:
-                            if (colorimetry & EDID_XVYCC601_MASK && metadata)
-                                return 1;
-                            break;
-                        case HDMI_COLORIMETRY_EXTENDED_xvYCC709:
-                            if (colorimetry & EDID_XVYCC709_MASK && metadata)
-                                return 1;
-                            break;
-                        default:
-                            break;
-                    }
-                    return 0;
-                } // if VSDB block
-                // else find next block
-                ExtAddr += blockLen;
-            } // while()
-        } // if
-    } // for
+    DPRINTF("EDID extened colorimetry = %x\n",gEdidModel.colorimetry);
+    DPRINTF("EDID gamut metadata profile = %x\n",gEdidModel.metadata);
 
-    return 0;
+    switch (color)
+    {
+        case HDMI_COLORIMETRY_EXTENDED_xvYCC601:
+            return (gEdidModel.colorimetry & EDID_XVYCC601_MASK && gEdidModel.metadata) ? 1 : 0;
+        case HDMI_COLORIMETRY_EXTENDED_xvYCC709:
+            return (gEdidModel.colorimetry & EDID_XVYCC709_MASK && gEdidModel.metadata) ? 1 : 0;
+        default:
+            return 0;
+    }
 }
 
 /**
@@ -646,24 +671,14 @@ static int CheckColorimetry(const enum HDMIColorimetry color)
  */
 static int CheckHDMIMode(void)
 {
-    int index;
-
     // read EDID
     if(!EDIDRead())
     {
         return 0;
     }
 
-    // find VSDB
-    for ( index = 1 ; index <= gExtensions ; index++ )
-    {
-        if ( IsTimingExtension(index) ) // if it's timing extension block
-        {
-            if (GetVSDBOffset(index) > 0) // if there is a VSDB, it means RX support HDMI mode
-                return 1;
-        }
-    }
-    return 0;
+    // if there is a VSDB, it means RX support HDMI mode
+    return gEdidModel.hdmi;
 }
 
 /**
@@ -695,8 +710,9 @@ int EDIDClose()
  */
 int EDIDRead()
 {
-    int block,dataPtr;
+    int block,dataPtr,extensions;
     unsigned char temp[SIZEOFEDIDBLOCK];
+    unsigned char* data;
 
     // if already read??
     if (EDIDValid())
@@ -709,38 +725,110 @@ int EDIDRead()
         return 0;
     }
     // get extension
-    gExtensions = temp[EDID_EXTENSION_NUMBER_POS];
+    extensions = temp[EDID_EXTENSION_NUMBER_POS];
 
     // prepare buffer
-    gEdidData = (unsigned char*)malloc((gExtensions+1)*SIZEOFEDIDBLOCK);
-    if (!gEdidData)
+    data = (unsigned char*)malloc((extensions+1)*SIZEOFEDIDBLOCK);
+    if (!data)
         return 0;
 
     // copy EDID Block 0
-    memcpy(gEdidData,temp,SIZEOFEDIDBLOCK);
+    memcpy(data,temp,SIZEOFEDIDBLOCK);
 
     // read EDID Extension
-    for ( block = 1,dataPtr = SIZEOFEDIDBLOCK; block <= gExtensions; block++,dataPtr+=SIZEOFEDIDBLOCK )
+    for ( block = 1,dataPtr = SIZEOFEDIDBLOCK; block <= extensions; block++,dataPtr+=SIZEOFEDIDBLOCK )
     {
-        // read extension 1~gExtensions
-        if (!ReadEDIDBlock(block, gEdidData+dataPtr))
+        // read extension 1~extensions
+        if (!ReadEDIDBlock(block, data+dataPtr))
         {
             // reset buffer
-            EDIDReset();
+            free(data);
             return 0;
         }
     }
 
-    // check if extension is more than 1, and first extension block is not block map.
-    if (gExtensions > 1 && gEdidData[SIZEOFEDIDBLOCK] != EDID_BLOCK_MAP_EXT_TAG_VAL)
+    return SetEDIDData(data);
+}
+
+/**
+ * Use EDID data from memory instead of reading Rx. @n
+ * Lets the parser run without DDC, for test or benchmark.
+ * @param   data    [in]    EDID data, 128 bytes per block
+ * @param   size    [in]    Size of data
+ * @return  If EDID data is valid, return 1; Otherwise, return 0.
+ */
+int EDIDLoad(const unsigned char* const data, const int size)
+{
+    int block, extensions;
+    unsigned char* buffer;
+
+    if (data == NULL || size < SIZEOFEDIDBLOCK)
     {
-        // reset buffer
-        DPRINTF("EDID has more than 1 extension but, first extension block is not block map\n");
-        EDIDReset();
+        DPRINTF("invalid parameter : data\n");
         return 0;
     }
 
-    return 1;
+    EDIDReset();
+
+    extensions = data[EDID_EXTENSION_NUMBER_POS];
+    if ((extensions+1)*SIZEOFEDIDBLOCK > size)
+    {
+        DPRINTF("EDID has %d extensions but only %d bytes\n", extensions, size);
+        return 0;
+    }
+
+    for (block = 0; block <= extensions; block++)
+    {
+        if (!CalcChecksum(data + block*SIZEOFEDIDBLOCK, SIZEOFEDIDBLOCK))
+        {
+            DPRINTF("CheckSum fail : %dth EDID Block\n", block);
+            return 0;
+        }
+    }
+
+    buffer = (unsigned char*)malloc((extensions+1)*SIZEOFEDIDBLOCK);
+    if (!buffer)
+        return 0;
+
+    memcpy(buffer, data, (extensions+1)*SIZEOFEDIDBLOCK);
+
+    return SetEDIDData(buffer);
+}
+
+/**
+ * Use EDID data from a file (raw binary dump) instead of reading Rx.
+ * @param   path    [in]    Path of EDID dump
+ * @return  If EDID data is valid, return 1; Otherwise, return 0.
+ */
+int EDIDLoadFile(const char* const path)
+{
+    // block map allows up to 254 extensions
+    const int maxSize = SIZEOFEDIDBLOCK*256;
+    unsigned char* buffer;
+    FILE* fp;
+    int size, ret;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        LOGE("%s::fopen(%s) fail\n", __func__, path);
+        return 0;
+    }
+
+    buffer = (unsigned char*)malloc(maxSize);
+    if (!buffer)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    size = fread(buffer, 1, maxSize, fp);
+    fclose(fp);
+
+    ret = EDIDLoad(buffer, size);
+    free(buffer);
+
+    return ret;
 }
 
 /**
@@ -752,6 +840,8 @@ void EDIDReset()
     {
         free(gEdidData);
         gEdidData = NULL;
+        gExtensions = 0;
+        memset(&gEdidModel, 0, sizeof(gEdidModel));
         DPRINTF("                                   EDID is reset!!!\n");
     }
 }
@@ -763,36 +853,20 @@ void EDIDReset()
  */
 int EDIDGetCECPhysicalAddress(int* const outAddr)
 {
-    int index;
-    unsigned int StartAddr;
-
-    // check EDID data is valid or not
     // read EDID
     if(!EDIDRead())
     {
         return 0;
     }
 
-    // find VSDB
-    for ( index = 1 ; index <= gExtensions ; index++ )
-    {
-        if ( IsTimingExtension(index) // if it's timing block
-            && (StartAddr = GetVSDBOffset(index)) > 0 )   // check block
-        {
-            // get supported DC value
-            // int tempDC1 = (int)(gEdidData[tempAddr+EDID_DC_POS]);
-            int phyAddr = gEdidData[StartAddr + EDID_CEC_PHYICAL_ADDR] << 8;
-            phyAddr |= gEdidData[StartAddr + EDID_CEC_PHYICAL_ADDR+1];
-
-            DPRINTF("phyAddr = %x\n",phyAddr);
+    if (!gEdidModel.hdmi)
+        return 0;
 
-            *outAddr = phyAddr;
+    DPRINTF("phyAddr = %x\n",gEdidModel.cecPhyAddr);
 
-            return 1;
-        } // if
-    } // for
+    *outAddr = gEdidModel.cecPhyAddr;
 
-    return 0;
+    return 1;
 }
 
 /**
@@ -924,7 +998,7 @@ int EDIDColorimetrySupport(struct HDMIVideoParameter * const video)
  */
 int EDIDAudioModeSupport(struct HDMIAudioParameter * const audio)
 {
-    int index;
+    int i;
 
     // read EDID
     if(!EDIDRead())
@@ -933,85 +1007,45 @@ int EDIDAudioModeSupport(struct HDMIAudioParameter * const audio)
         return 0;
     }
 
-    // check EDID Extension
-
-    // find timing block
-    for ( index = 1 ; index <= gExtensions ; index++ )
+    for (i = 0; i < gEdidModel.sadNum; i++)
     {
-        if ( IsTimingExtension(index) ) // if it's timing block
+        const struct edid_sad *sad = &gEdidModel.sad[i];
+
+        DPRINTF("request = %d, EDIDAudioFormatCode = %d\n",(audio->formatCode)<<3, sad->format);
+        DPRINTF("request = %d, EDIDChannelNumber= %d\n",(audio->channelNum)-1, sad->channels);
+        DPRINTF("request = %d, EDIDSampleFreq= %d\n",1<<(audio->sampleFreq), sad->sampleFreq);
+        DPRINTF("request = %d, EDIDWordLeng= %d\n",1<<(audio->wordLength), sad->wordLen);
+
+        // check parameter
+        // check audioFormat
+        if ( sad->format == ( (audio->formatCode) << 3)     &&  // format code
+                sad->channels >= ( (audio->channelNum) -1)  &&  // channel number
+                ( sad->sampleFreq & (1<<(audio->sampleFreq)) ) ) // sample frequency
         {
-            // find Short Audio Description
-            unsigned int StartAddr = index*SIZEOFEDIDBLOCK;
-            unsigned int ExtAddr = StartAddr + EDID_DATA_BLOCK_START_POS;
-            unsigned int tag,blockLen;
-            unsigned int DTDStartAddr = gEdidData[StartAddr + EDID_DETAILED_TIMING_OFFSET_POS];
-
-            // while
-            while ( ExtAddr < StartAddr + DTDStartAddr )
+            if (sad->format == LPCM_FORMAT) // check wordLen
             {
-                // find the block tag and length
-                // tag
-                tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
-                // block len
-                blockLen = (gEdidData[ExtAddr] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
-
-                DPRINTF("tag = %d\n",tag);
-                DPRINTF("blockLen = %d\n",blockLen-1);
-
-                // check if it is short video description
-                if (tag == EDID_SHORT_AUD_DEC_TAG_VAL)
+                int ret = 0;
+                switch ( audio->wordLength )
                 {
-                    // if so, check SAD
-                    int i;
-                    int audioFormat,channelNum,sampleFreq,wordLen;
-                    for (i=1; i < blockLen; i+=3)
-                    {
-                        audioFormat = gEdidData[ExtAddr+i] & EDID_SAD_CODE_MASK;
-                        channelNum = gEdidData[ExtAddr+i] & EDID_SAD_CHANNEL_MASK;
-                        sampleFreq = gEdidData[ExtAddr+i+1];
-                        wordLen = gEdidData[ExtAddr+i+2];
-
-                        DPRINTF("request = %d, EDIDAudioFormatCode = %d\n",(audio->formatCode)<<3, audioFormat);
-                        DPRINTF("request = %d, EDIDChannelNumber= %d\n",(audio->channelNum)-1, channelNum);
-                        DPRINTF("request = %d, EDIDSampleFreq= %d\n",1<<(audio->sampleFreq), sampleFreq);
-                        DPRINTF("request = %d, EDIDWordLeng= %d\n",1<<(audio->wordLength), wordLen);
-
-                        // check parameter
-                        // check audioFormat
-                        if ( audioFormat == ( (audio->formatCode) << 3)     &&  // format code
-                                channelNum >= ( (audio->channelNum) -1)         &&  // channel number
-                                ( sampleFreq & (1<<(audio->sampleFreq)) )      ) // sample frequency
-                        {
-                            if (audioFormat == LPCM_FORMAT) // check wordLen
-                            {
-                                int ret = 0;
-                                switch ( audio->wordLength )
-                                {
-                                    case WORD_16:
-                                    case WORD_17:
-                                    case WORD_18:
-                                    case WORD_19:
-                                    case WORD_20:
-                                        ret = wordLen & (1<<1);
-                                        break;
-                                    case WORD_21:
-                                    case WORD_22:
-                                    case WORD_23:
-                                    case WORD_24:
-                                        ret = wordLen & (1<<2);
-                                        break;
-                                }
-                                return ret;
-                            }
-                            return 1; // if not LPCM
-                        }
-                    } // for
-                } // if tag
-                // else find next block
-                ExtAddr += blockLen;
-            } // while()
-        } // if
-    } // for
+                    case WORD_16:
+                    case WORD_17:
+                    case WORD_18:
+                    case WORD_19:
+                    case WORD_20:
+                        ret = sad->wordLen & (1<<1);
+                        break;
+                    case WORD_21:
+                    case WORD_22:
+                    case WORD_23:
+                    case WORD_24:
+                        ret = sad->wordLen & (1<<2);
+                        break;
+                }
+                return ret;
+            }
+            return 1; // if not LPCM
+        }
+    }
 
     return 0;
 }
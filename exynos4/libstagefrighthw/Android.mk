@@ -20,6 +20,10 @@ ifeq ($(BOARD_USES_COPYBIT),true)
 LOCAL_CFLAGS += -DBOARD_USES_COPYBIT
 endif
 
+ifneq ($(BOARD_STAGEFRIGHT_RENDERER_BUFFER_NUM),)
+LOCAL_CFLAGS += -DSEC_RENDERER_BUFFER_NUM=$(BOARD_STAGEFRIGHT_RENDERER_BUFFER_NUM)
+endif
+
 LOCAL_C_INCLUDES:= \
       $(TOP)/frameworks/base/include/media/stagefright/openmax \
       $(LOCAL_PATH)/../include \
@@ -35,13 +35,19 @@
 
 #define CACHEABLE_BUFFERS 0x1
 
-#define USE_ZERO_COPY
 //#define SEC_DEBUG
 
 #ifdef USE_SAMSUNG_COLORFORMAT
 #define OMX_SEC_COLOR_FormatNV12TPhysicalAddress        0x7F000001
 #endif
 
+// frames posted in turn through ISurface when the overlay is not used
+#ifndef SEC_RENDERER_BUFFER_NUM
+#define SEC_RENDERER_BUFFER_NUM 4
+#endif
+
+#define SEC_RENDERER_STAT_FRAMES 300
+
 namespace android {
 
 
@@ -66,9 +72,13 @@ SecHardwareRenderer::SecHardwareRenderer(
       mInitCheck(NO_INIT),
       mFrameSize(mDecodedWidth * mDecodedHeight * 2),
       mIsFirstFrame(true),
+      mNumBuf(SEC_RENDERER_BUFFER_NUM),
       mCustomFormat(fromHardwareDecoder),
+      mZeroCopy(false),
       mUseOverlay(true),
-      mIndex(0) {
+      mIndex(0),
+      mFramesRendered(0),
+      mBytesCopied(0) {
 
     status_t ret;
 
@@ -86,6 +96,14 @@ SecHardwareRenderer::SecHardwareRenderer(
         return;
     }
 
+    // hardware decoders hand over the physical addresses of their
+    // NV12T output, which the overlay and FIMC can read directly.
+    // software decoder output is copied once into the display buffer.
+    if (mCustomFormat && colorFormat != OMX_COLOR_FormatCbYCrY)
+        mZeroCopy = true;
+    else if (colorFormat != OMX_COLOR_FormatCbYCrY)
+        mFrameSize = (mDecodedWidth * mDecodedHeight * 3) / 2;
+
     switch (rotationDegrees) {
         case 0: mOrientation = ISurface::BufferHeap::ROT_0; break;
         case 90: mOrientation = ISurface::BufferHeap::ROT_90; break;
@@ -109,45 +127,60 @@ SecHardwareRenderer::SecHardwareRenderer(
     mInitCheck = OK;
 }
 
+int SecHardwareRenderer::getHalPixelFormat(bool forOverlay) const {
+
+    if (mZeroCopy)
+        return HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP;
+
+    switch (mColorFormat) {
+    case OMX_COLOR_FormatYUV420Planar:
+        return HAL_PIXEL_FORMAT_YCbCr_420_P;
+    case OMX_COLOR_FormatYUV420SemiPlanar:
+        return HAL_PIXEL_FORMAT_YCbCr_420_SP;
+    case OMX_COLOR_FormatCbYCrY:
+        // copybit has no linear UYVY source
+        if (forOverlay)
+            return OVERLAY_FORMAT_CbYCrY_422_I;
+        break;
+    default:
+        break;
+    }
+
+    return -1;
+}
+
 status_t SecHardwareRenderer::initializeOverlaySource() {
     sp<OverlayRef> ref;
+    int format = getHalPixelFormat(true);
 
-#if defined (USE_ZERO_COPY)
-    if (mCustomFormat == true ) {
-        ref = mISurface->createOverlay(
-                mDecodedWidth, mDecodedHeight,
-                HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP, mOrientation);
-    } else
-#else
+    if (format >= 0)
         ref = mISurface->createOverlay(
-                mDecodedWidth, mDecodedHeight, HAL_PIXEL_FORMAT_YCbCr_420_P,
-                mOrientation);
-#endif
+                mDecodedWidth, mDecodedHeight, format, mOrientation);
 
-        if (ref.get() == NULL) {
-            LOGE("Unable to create the overlay!");
-            pthread_mutex_lock(&lock);
-            mNumOfPlayingContents--;
-            pthread_mutex_unlock(&lock);
-            return FAILED_TRANSACTION;
-        }
+    if (ref.get() == NULL) {
+        LOGE("Unable to create the overlay!");
+        pthread_mutex_lock(&lock);
+        mNumOfPlayingContents--;
+        pthread_mutex_unlock(&lock);
+        return FAILED_TRANSACTION;
+    }
 
-        mOverlay = new Overlay(ref);
-        mOverlay->setParameter(CACHEABLE_BUFFERS, 0);
+    mOverlay = new Overlay(ref);
+    mOverlay->setParameter(CACHEABLE_BUFFERS, 0);
 
-        mNumBuf = mOverlay->getBufferCount();
+    mNumBuf = mOverlay->getBufferCount();
 
-        if (mCustomFormat) {
-            mFrameSize = sizeof(struct ADDRS);
-            mMemoryHeap = new MemoryHeapBase(mFrameSize * mNumBuf);
-        } else {
-            for (size_t i = 0; i < (size_t)mNumBuf; ++i) {
-                void *addr = mOverlay->getBufferAddress((void *)i);
-                mOverlayAddresses.push(addr);
-            }
+    if (mZeroCopy) {
+        mFrameSize = sizeof(struct ADDRS);
+        mMemoryHeap = new MemoryHeapBase(mFrameSize * mNumBuf);
+    } else {
+        for (size_t i = 0; i < (size_t)mNumBuf; ++i) {
+            void *addr = mOverlay->getBufferAddress((void *)i);
+            mOverlayAddresses.push(addr);
         }
+    }
 
-     mIndex = 0;
+    mIndex = 0;
 
     return OK;
 }
@@ -159,8 +192,17 @@ status_t SecHardwareRenderer::initializeBufferSource() {
     return INVALID_OPERATION;
 #endif
 
-    if (!mCustomFormat) {
-        mMemoryHeap = new MemoryHeapBase("/dev/pmem_adsp", 2 * mFrameSize);
+    int format = getHalPixelFormat(false);
+
+    if (format < 0) {
+        LOGE("colorFormat (0x%x) can not be posted to ISurface", mColorFormat);
+        return INVALID_OPERATION;
+    }
+
+    mNumBuf = SEC_RENDERER_BUFFER_NUM;
+
+    if (!mZeroCopy) {
+        mMemoryHeap = new MemoryHeapBase("/dev/pmem_adsp", mNumBuf * mFrameSize);
         if (mMemoryHeap->heapID() >= 0) {
             sp<MemoryHeapPmem> pmemHeap = new MemoryHeapPmem(mMemoryHeap);
             pmemHeap->slap();
@@ -168,21 +210,21 @@ status_t SecHardwareRenderer::initializeBufferSource() {
             mMemoryHeap = pmemHeap;
         }
     } else
-            mFrameSize = 32;
+        mFrameSize = 32;
 
     if (mMemoryHeap.get() == NULL || mMemoryHeap->heapID() < 0)
-            mMemoryHeap = new MemoryHeapBase(2 * mFrameSize);
+        mMemoryHeap = new MemoryHeapBase(mNumBuf * mFrameSize);
 
     CHECK(mMemoryHeap->heapID() >= 0);
 
-        ISurface::BufferHeap bufferHeap(
-                mDisplayWidth, mDisplayHeight,
-                mDecodedWidth, mDecodedHeight,
-            mCustomFormat?HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:HAL_PIXEL_FORMAT_YCbCr_420_P,
+    ISurface::BufferHeap bufferHeap(
+            mDisplayWidth, mDisplayHeight,
+            mDecodedWidth, mDecodedHeight,
+            format,
             mOrientation, 0,
-                mMemoryHeap);
+            mMemoryHeap);
 
-        status_t err = mISurface->registerBuffers(bufferHeap);
+    status_t err = mISurface->registerBuffers(bufferHeap);
     if (err != OK) {
         LOGE("ISurface failed to register buffers (0x%08x)", err);
         pthread_mutex_lock(&lock);
@@ -246,82 +288,100 @@ void SecHardwareRenderer::handleYUV420Planar(
     dst_addrs->buf_idx   = mIndex;
 }
 
+void SecHardwareRenderer::copyFrame(
+        void *dst_data, const void *src_data, size_t size) {
+
+    // never run past the display buffer
+    if (size > mFrameSize)
+        size = mFrameSize;
+
+    memcpy(dst_data, src_data, size);
+    mBytesCopied += size;
+}
+
 void SecHardwareRenderer::render(
         const void *data, size_t size, void *platformPrivate) {
 
-     status_t ret = OK;
+    status_t ret = OK;
 
     if (mInitCheck != OK)
-            return;
+        return;
 
     if (mUseOverlay == true && mOverlay.get() == NULL)
         return;
 
-  if (mNumOfPlayingContents > 1 && mUseOverlay == true) {
+    // the overlay can only show one video : every content goes
+    // through ISurface once another one is playing.
+    if (mNumOfPlayingContents > 1 && mUseOverlay == true) {
         mUseOverlay = false;
 
         deinitializeOverlaySource();
 
         ret = initializeBufferSource();
-        if (ret != OK)
-                    return;
+        if (ret != OK) {
+            mInitCheck = ret;
+            return;
+        }
 
-                    mIsFirstFrame = true;
-                }
+        mIsFirstFrame = true;
+    }
 
     if (mUseOverlay) {
         overlay_buffer_t dst;
 
-    if (mCustomFormat) {
-        /* zero copy solution case */
-        dst = (uint8_t *)mMemoryHeap->getBase() + (mFrameSize * mIndex);
-
-        if (mColorFormat == OMX_COLOR_FormatYUV420Planar ||
-#ifdef USE_SAMSUNG_COLORFORMAT
-            mColorFormat == OMX_SEC_COLOR_FormatNV12TPhysicalAddress ||
-#endif
-            mColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
+        if (mZeroCopy) {
+            /* zero copy solution case */
+            dst = (uint8_t *)mMemoryHeap->getBase() + (mFrameSize * mIndex);
             handleYUV420Planar(data, dst, size);
-            }
         } else {
             /* normal frame case */
             dst = (void *)mIndex;
-                memcpy(mOverlayAddresses[mIndex], data, size);
-            }
+            copyFrame(mOverlayAddresses[mIndex], data, size);
+        }
 
         if (mOverlay->queueBuffer(dst) == ALL_BUFFERS_FLUSHED) {
-                mIsFirstFrame = true;
-           if (mOverlay->queueBuffer((void *)dst) != 0) {
-                    return;
-                }
+            mIsFirstFrame = true;
+            if (mOverlay->queueBuffer((void *)dst) != 0) {
+                return;
             }
+        }
 
-            if (++mIndex == mNumBuf) {
-                mIndex = 0;
-            }
+        if (++mIndex == (size_t)mNumBuf) {
+            mIndex = 0;
+        }
 
-            overlay_buffer_t overlay_buffer;
-            if (!mIsFirstFrame) {
-                status_t err = mOverlay->dequeueBuffer(&overlay_buffer);
-                if (err == ALL_BUFFERS_FLUSHED) {
-                    mIsFirstFrame = true;
-                } else {
-                    return;
-                }
-            } else {
-                mIsFirstFrame = false;
+        overlay_buffer_t overlay_buffer;
+        if (!mIsFirstFrame) {
+            status_t err = mOverlay->dequeueBuffer(&overlay_buffer);
+            if (err == ALL_BUFFERS_FLUSHED) {
+                mIsFirstFrame = true;
             }
+        } else {
+            mIsFirstFrame = false;
+        }
     } else {
         size_t offset = mIndex * mFrameSize;
         void *dst = (uint8_t *)mMemoryHeap->getBase() + offset;
 
-        if (mCustomFormat)
-               handleYUV420Planar(data, dst, size);
+        if (mZeroCopy)
+            handleYUV420Planar(data, dst, size);
         else
-            memcpy(dst, data, size);
+            copyFrame(dst, data, size);
 
         mISurface->postBuffer(offset);
-        mIndex = 1 - mIndex;
+
+        if (++mIndex == (size_t)mNumBuf) {
+            mIndex = 0;
+        }
+    }
+
+    if (++mFramesRendered == SEC_RENDERER_STAT_FRAMES) {
+        LOGV("%s %s : %d bytes copied per frame",
+                mUseOverlay ? "overlay" : "surface",
+                mZeroCopy ? "zero copy" : "copy",
+                (int)(mBytesCopied / mFramesRendered));
+        mFramesRendered = 0;
+        mBytesCopied = 0;
     }
 }
 
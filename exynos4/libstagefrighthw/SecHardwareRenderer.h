@@ -63,14 +63,20 @@ private:
     int mNumBuf;
 
     bool mCustomFormat;
+    bool mZeroCopy;
 	bool mUseOverlay;
 	uint32_t mOrientation;
     size_t mIndex;
 
+    uint32_t mFramesRendered;
+    uint64_t mBytesCopied;
+
     SecHardwareRenderer(const SecHardwareRenderer &);
     SecHardwareRenderer &operator=(const SecHardwareRenderer &);
 
     void handleYUV420Planar(const void *src_data, void *dst_data, size_t size);
+    void copyFrame(void *dst_data, const void *src_data, size_t size);
+    int getHalPixelFormat(bool forOverlay) const;
     status_t initializeOverlaySource(void);
 	void deinitializeOverlaySource(void);
 	status_t initializeBufferSource(void); 
@@ -0,0 +1,48 @@
+# Copyright (C) 2008 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+
+ifeq ($(BOARD_USES_V4L2_SHIM),true)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := eng
+
+LOCAL_PRELINK_MODULE := false
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_SRC_FILES := sec_v4l2_shim.c sec_v4l2_emul.c
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/../include
+
+LOCAL_MODULE := libv4l2shim
+include $(BUILD_SHARED_LIBRARY)
+
+endif
+
+# the tests link the shim in statically, on any board
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := sec_v4l2_shim.c sec_v4l2_emul.c
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/../include
+
+LOCAL_MODULE := libv4l2shim_static
+include $(BUILD_STATIC_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -0,0 +1,1372 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Userspace emulation of the camera, FIMC, tvout, fimd and G2D nodes.
+ *
+ * Only the ioctls used by libcamera, libfimc, liboverlay and libhdmi are
+ * implemented, with the state they read back. Buffers are anonymous
+ * shared memory, physical addresses are fake but unique per node.
+ * fb, g2d and jpeg memory is a fixed reservation per node, shared by
+ * every open like the drivers' reserved regions, and stays mapped until
+ * the node is removed. Driver specific ioctls
+ * the libraries rely on are accepted explicitly, anything else fails
+ * with ENOTTY like on the real device; it still shows up in the trace
+ * recorder.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "libv4l2shim"
+#include <cutils/log.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <linux/fb.h>
+#include <linux/videodev2.h>
+
+#undef BOARD_USES_V4L2_SHIM
+#include "sec_v4l2_shim.h"
+#include "s5p_tvout.h"
+#include "s3c_lcd.h"
+#include "sec_g2d.h"
+#include "jpeg_api.h"
+
+#define EMUL_MAX_NODES      (16)
+#define EMUL_MAX_FILES      (32)
+#define EMUL_MAX_BUFFERS    (VIDEO_MAX_FRAME)
+#define EMUL_MAX_CTRLS      (64)
+#define EMUL_PATH_LEN       (64)
+#define EMUL_MAX_BUF_TYPE   (V4L2_BUF_TYPE_VIDEO_OVERLAY)
+
+#define EMUL_DEFAULT_WIDTH  (800)
+#define EMUL_DEFAULT_HEIGHT (480)
+#define EMUL_DEFAULT_BPP    (32)
+#define EMUL_G2D_MEM_SIZE   (8 * 1024 * 1024)
+#define EMUL_FB_MEM_SIZE    (32 * 1024 * 1024)
+
+#define EMUL_PAGE_ALIGN(x)  (((x) + 4095) & ~4095)
+
+struct emul_ctrl
+{
+    unsigned int id;
+    int          value;
+};
+
+struct emul_node
+{
+    int                         used;
+    char                        path[EMUL_PATH_LEN];
+    enum SEC_V4L2_EMUL_NODE     type;
+    struct sec_v4l2_emul_config config;
+
+    struct emul_ctrl            ctrls[EMUL_MAX_CTRLS];
+    int                         num_ctrls;
+
+    struct fb_var_screeninfo    var;
+    void                       *mem;     // fb / g2d / jpeg memory, shared by all opens
+    size_t                      mem_size;
+    long long                   last_vsync_us;
+    unsigned int                lock_owner; // serial of the file holding flock(), 0 : none
+};
+
+struct emul_buffer
+{
+    void         *mem;
+    size_t        length;
+    int           queued;
+    unsigned int  bytesused;
+};
+
+struct emul_file
+{
+    int                       fd;        // real fd on /dev/null, keeps the number unique
+    int                       flags;
+    struct emul_node         *node;
+    unsigned int              serial;    // changes on every open, a reused slot is not the same file
+
+    struct v4l2_format        fmt[EMUL_MAX_BUF_TYPE + 1];
+    struct v4l2_format        fmt_priv;  // tvout video layer source, V4L2_BUF_TYPE_PRIVATE
+    struct v4l2_crop          crop;
+    struct v4l2_framebuffer   fbuf;
+    struct v4l2_streamparm    parm;
+    v4l2_std_id               std;
+    int                       input;
+    int                       output;
+    int                       overlay;
+
+    enum v4l2_buf_type        buf_type;
+    enum v4l2_memory          memory;
+    struct emul_buffer        bufs[EMUL_MAX_BUFFERS];
+    int                       num_bufs;
+    int                       queue[EMUL_MAX_BUFFERS];
+    int                       queue_head;
+    int                       queue_count;
+    int                       streaming;
+    unsigned int              stream_gen;// bumped by STREAMON / STREAMOFF
+    unsigned int              sequence;
+    long long                 last_frame_us;
+
+    struct jpeg_enc_param     jpeg_enc;
+    struct jpeg_dec_param     jpeg_dec;
+};
+
+// what the drivers keep, in shared memory : a child forked after the
+// nodes were opened and mapped sees the same queues, like two processes
+// on one driver. files are found by fd number, so open before forking.
+struct emul_state
+{
+    pthread_mutex_t  lock;
+    pthread_cond_t   flock_cond;    // a node lock was released
+    // one emulated jpeg codec, shared by all opens like the real one
+    pthread_mutex_t  jpeg_hw_lock;
+    struct emul_node nodes[EMUL_MAX_NODES];
+    struct emul_file files[EMUL_MAX_FILES];
+    int              hpd_state;
+    unsigned int     serial;
+};
+
+static struct emul_state *emul;
+static pthread_once_t emul_once = PTHREAD_ONCE_INIT;
+
+// FIMC reports the first one, tvout is searched for its output type
+static const unsigned int emul_outputs[] =
+{
+    V4L2_OUTPUT_TYPE_ANALOG,
+    V4L2_OUTPUT_TYPE_COMPOSITE,
+    V4L2_OUTPUT_TYPE_SVIDEO,
+    V4L2_OUTPUT_TYPE_YPBPR_INERLACED,
+    V4L2_OUTPUT_TYPE_YPBPR_PROGRESSIVE,
+    V4L2_OUTPUT_TYPE_RGB_PROGRESSIVE,
+    V4L2_OUTPUT_TYPE_DIGITAL,
+    V4L2_OUTPUT_TYPE_HDMI_RGB,
+    V4L2_OUTPUT_TYPE_DVI,
+};
+
+static const unsigned int emul_formats[] =
+{
+    V4L2_PIX_FMT_NV12,
+    V4L2_PIX_FMT_NV21,
+    V4L2_PIX_FMT_YUV420,
+    V4L2_PIX_FMT_YUYV,
+    V4L2_PIX_FMT_RGB565,
+    V4L2_PIX_FMT_RGB32,
+};
+
+static long long emul_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void emul_sleep_us(long long us)
+{
+    struct timespec ts;
+
+    if (us <= 0)
+        return;
+
+    ts.tv_sec  = us / 1000000LL;
+    ts.tv_nsec = (us % 1000000LL) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+// how long to wait from 'last' for the next tick of 'interval'
+static long long emul_pace(long long *last, int interval)
+{
+    long long now = emul_now_us();
+    long long wait = 0;
+
+    if (0 < interval && *last != 0 && now < *last + interval)
+        wait = *last + interval - now;
+
+    *last = now + wait;
+    return wait;
+}
+
+static void emul_init_state(void)
+{
+    pthread_mutexattr_t mattr;
+    pthread_condattr_t cattr;
+
+    emul = (struct emul_state *)mmap(NULL, EMUL_PAGE_ALIGN(sizeof(*emul)),
+                                     PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (emul == MAP_FAILED) {
+        LOGE("%s::no shared memory, the state stays in this process\n", __func__);
+        emul = (struct emul_state *)malloc(sizeof(*emul));
+    }
+    memset(emul, 0, sizeof(*emul));
+
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&emul->lock, &mattr);
+    pthread_mutex_init(&emul->jpeg_hw_lock, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&emul->flock_cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    emul->hpd_state = 1;
+}
+
+static void emul_init(void)
+{
+    pthread_once(&emul_once, emul_init_state);
+}
+
+static struct emul_node *emul_find_node(const char *path)
+{
+    int i;
+
+    for (i = 0; i < EMUL_MAX_NODES; i++) {
+        if (emul->nodes[i].used && strcmp(emul->nodes[i].path, path) == 0)
+            return &emul->nodes[i];
+    }
+    return NULL;
+}
+
+static struct emul_file *emul_find_file(int fd)
+{
+    int i;
+
+    if (fd < 0)
+        return NULL;
+
+    for (i = 0; i < EMUL_MAX_FILES; i++) {
+        if (emul->files[i].node != NULL && emul->files[i].fd == fd)
+            return &emul->files[i];
+    }
+    return NULL;
+}
+
+static void *emul_alloc(size_t size)
+{
+    void *mem = mmap(NULL, EMUL_PAGE_ALIGN(size), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    return (mem == MAP_FAILED) ? NULL : mem;
+}
+
+static void emul_free(void *mem, size_t size)
+{
+    if (mem != NULL)
+        munmap(mem, EMUL_PAGE_ALIGN(size));
+}
+
+// the jpeg driver returns buffer addresses as the ioctl return value,
+// so on a 64 bit host the memory has to sit below 2GB
+static void *emul_alloc_low(size_t size)
+{
+#ifdef MAP_32BIT
+    void *mem = mmap(NULL, EMUL_PAGE_ALIGN(size), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+    return (mem == MAP_FAILED) ? NULL : mem;
+#else
+    return emul_alloc(size);
+#endif
+}
+
+static unsigned int emul_bpp(unsigned int pixelformat)
+{
+    switch (pixelformat) {
+    case V4L2_PIX_FMT_RGB32:
+        return 32;
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_RGB565:
+        return 16;
+    default:
+        return 12;
+    }
+}
+
+static void emul_free_buffers(struct emul_file *file)
+{
+    int i;
+
+    for (i = 0; i < file->num_bufs; i++) {
+        if (file->memory == V4L2_MEMORY_MMAP)
+            emul_free(file->bufs[i].mem, file->bufs[i].length);
+    }
+
+    memset(file->bufs, 0, sizeof(file->bufs));
+    file->num_bufs    = 0;
+    file->queue_head  = 0;
+    file->queue_count = 0;
+}
+
+static int *emul_ctrl(struct emul_node *node, unsigned int id, int create)
+{
+    int i;
+
+    for (i = 0; i < node->num_ctrls; i++) {
+        if (node->ctrls[i].id == id)
+            return &node->ctrls[i].value;
+    }
+
+    if (!create || node->num_ctrls == EMUL_MAX_CTRLS)
+        return NULL;
+
+    node->ctrls[i].id    = id;
+    node->ctrls[i].value = 0;
+    node->num_ctrls++;
+    return &node->ctrls[i].value;
+}
+
+static int emul_buf_type_ok(struct emul_file *file, enum v4l2_buf_type type)
+{
+    if (file->node->type == SEC_V4L2_EMUL_CAPTURE)
+        return type == V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    return type == V4L2_BUF_TYPE_VIDEO_OUTPUT || type == V4L2_BUF_TYPE_VIDEO_OVERLAY;
+}
+
+static int emul_reqbufs(struct emul_file *file, struct v4l2_requestbuffers *req)
+{
+    struct v4l2_pix_format *pix;
+    size_t length;
+    int i;
+
+    if (!emul_buf_type_ok(file, req->type) || file->streaming)
+        return -EINVAL;
+
+    emul_free_buffers(file);
+
+    if (EMUL_MAX_BUFFERS < req->count)
+        req->count = EMUL_MAX_BUFFERS;
+
+    pix    = &file->fmt[req->type].fmt.pix;
+    length = pix->sizeimage;
+    if (length == 0)
+        length = (size_t)pix->width * pix->height * emul_bpp(pix->pixelformat) / 8;
+    if (length == 0)
+        length = (size_t)file->node->config.width * file->node->config.height * 2;
+
+    for (i = 0; i < (int)req->count; i++) {
+        file->bufs[i].length = length;
+        if (req->memory == V4L2_MEMORY_MMAP) {
+            file->bufs[i].mem = emul_alloc(length);
+            if (file->bufs[i].mem == NULL) {
+                req->count = i;
+                break;
+            }
+        }
+    }
+
+    file->buf_type = req->type;
+    file->memory   = req->memory;
+    file->num_bufs = req->count;
+    return 0;
+}
+
+static int emul_querybuf(struct emul_file *file, struct v4l2_buffer *buf)
+{
+    if (buf->index >= (unsigned int)file->num_bufs)
+        return -EINVAL;
+
+    buf->length   = file->bufs[buf->index].length;
+    buf->m.offset = buf->index * EMUL_PAGE_ALIGN(buf->length);
+    buf->flags    = file->bufs[buf->index].queued ? V4L2_BUF_FLAG_QUEUED : 0;
+    buf->memory   = file->memory;
+    return 0;
+}
+
+static int emul_qbuf(struct emul_file *file, struct v4l2_buffer *buf)
+{
+    struct emul_buffer *b;
+
+    if (buf->index >= (unsigned int)file->num_bufs)
+        return -EINVAL;
+
+    b = &file->bufs[buf->index];
+    if (b->queued)
+        return -EINVAL;
+
+    b->queued    = 1;
+    b->bytesused = buf->bytesused;
+    file->queue[(file->queue_head + file->queue_count) % EMUL_MAX_BUFFERS] = buf->index;
+    file->queue_count++;
+    return 0;
+}
+
+// after emul->lock was dropped : the slot may have been closed, reopened or restarted
+static int emul_file_same(struct emul_file *file, struct emul_node *node,
+                          unsigned int serial, unsigned int stream_gen)
+{
+    return file->node == node && file->serial == serial && file->stream_gen == stream_gen;
+}
+
+static int emul_dqbuf(struct emul_file *file, struct v4l2_buffer *buf)
+{
+    struct emul_node *node = file->node;
+    unsigned int serial = file->serial;
+    unsigned int stream_gen = file->stream_gen;
+    struct emul_buffer *b;
+    long long wait;
+    int index;
+
+    if (!file->streaming || file->queue_count == 0)
+        return -EAGAIN;
+
+    // the device finishes one buffer per frame interval
+    wait = emul_pace(&file->last_frame_us, node->config.frame_interval_us);
+    pthread_mutex_unlock(&emul->lock);
+    emul_sleep_us(wait);
+    pthread_mutex_lock(&emul->lock);
+
+    // closed, reopened, restarted or drained while waiting
+    if (!emul_file_same(file, node, serial, stream_gen)
+        || !file->streaming || file->queue_count == 0)
+        return -EAGAIN;
+
+    index = file->queue[file->queue_head];
+    file->queue_head = (file->queue_head + 1) % EMUL_MAX_BUFFERS;
+    file->queue_count--;
+
+    b = &file->bufs[index];
+    b->queued = 0;
+
+    buf->index     = index;
+    buf->memory    = file->memory;
+    buf->length    = b->length;
+    buf->bytesused = (file->node->type == SEC_V4L2_EMUL_CAPTURE) ? b->length : b->bytesused;
+    buf->sequence  = file->sequence++;
+    buf->flags     = V4L2_BUF_FLAG_DONE;
+    buf->timestamp.tv_sec  = file->last_frame_us / 1000000LL;
+    buf->timestamp.tv_usec = file->last_frame_us % 1000000LL;
+    return 0;
+}
+
+static int emul_streamoff(struct emul_file *file)
+{
+    int i;
+
+    file->streaming   = 0;
+    file->stream_gen++;
+    file->queue_head  = 0;
+    file->queue_count = 0;
+    for (i = 0; i < file->num_bufs; i++)
+        file->bufs[i].queued = 0;
+    return 0;
+}
+
+static int emul_ext_ctrls(struct emul_file *file, struct v4l2_ext_controls *ctrls, int set)
+{
+    unsigned int i;
+
+    // as v4l2-ioctl.c : every control must be of ctrl_class
+    for (i = 0; ctrls->ctrl_class != 0 && i < ctrls->count; i++) {
+        if (V4L2_CTRL_ID2CLASS(ctrls->controls[i].id) != ctrls->ctrl_class) {
+            ctrls->error_idx = ctrls->count;
+            return -EINVAL;
+        }
+    }
+
+    for (i = 0; i < ctrls->count; i++) {
+        int *value = emul_ctrl(file->node, ctrls->controls[i].id, set);
+
+        if (value == NULL && set) {
+            ctrls->error_idx = i;
+            return -ENOMEM;
+        }
+
+        if (set)
+            *value = ctrls->controls[i].value;
+        else
+            ctrls->controls[i].value = (value != NULL) ? *value : 0;
+    }
+    return 0;
+}
+
+static int emul_v4l2_ioctl(struct emul_file *file, unsigned int request, void *arg)
+{
+    struct emul_node *node = file->node;
+
+    switch (request) {
+    case VIDIOC_QUERYCAP:
+    {
+        struct v4l2_capability *cap = (struct v4l2_capability *)arg;
+
+        memset(cap, 0, sizeof(*cap));
+        strncpy((char *)cap->driver, "sec_v4l2_emul", sizeof(cap->driver) - 1);
+        strncpy((char *)cap->card, node->path, sizeof(cap->card) - 1);
+        if (node->type == SEC_V4L2_EMUL_CAPTURE)
+            cap->capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+        else
+            cap->capabilities = V4L2_CAP_VIDEO_OUTPUT | V4L2_CAP_VIDEO_OVERLAY | V4L2_CAP_STREAMING;
+        return 0;
+    }
+    case VIDIOC_ENUM_FMT:
+    {
+        struct v4l2_fmtdesc *desc = (struct v4l2_fmtdesc *)arg;
+
+        if (desc->index >= sizeof(emul_formats) / sizeof(emul_formats[0]))
+            return -EINVAL;
+        desc->pixelformat = emul_formats[desc->index];
+        snprintf((char *)desc->description, sizeof(desc->description), "fmt%d", desc->index);
+        return 0;
+    }
+    case VIDIOC_S_FMT:
+    case VIDIOC_G_FMT:
+    case VIDIOC_TRY_FMT:
+    {
+        struct v4l2_format *fmt = (struct v4l2_format *)arg;
+
+        if (fmt->type == V4L2_BUF_TYPE_PRIVATE) {
+            if (request == VIDIOC_G_FMT)
+                memcpy(fmt, &file->fmt_priv, sizeof(*fmt));
+            else if (request == VIDIOC_S_FMT)
+                memcpy(&file->fmt_priv, fmt, sizeof(*fmt));
+            return 0;
+        }
+
+        if (fmt->type > EMUL_MAX_BUF_TYPE)
+            return -EINVAL;
+
+        if (request == VIDIOC_G_FMT) {
+            memcpy(fmt, &file->fmt[fmt->type], sizeof(*fmt));
+            return 0;
+        }
+
+        if (fmt->type != V4L2_BUF_TYPE_VIDEO_OVERLAY && fmt->fmt.pix.sizeimage == 0)
+            fmt->fmt.pix.sizeimage = fmt->fmt.pix.width * fmt->fmt.pix.height
+                                     * emul_bpp(fmt->fmt.pix.pixelformat) / 8;
+
+        if (request == VIDIOC_S_FMT)
+            memcpy(&file->fmt[fmt->type], fmt, sizeof(*fmt));
+        return 0;
+    }
+    case VIDIOC_CROPCAP:
+    {
+        struct v4l2_cropcap *cropcap = (struct v4l2_cropcap *)arg;
+        struct v4l2_pix_format *pix;
+
+        if (cropcap->type > EMUL_MAX_BUF_TYPE)
+            return -EINVAL;
+
+        pix = &file->fmt[cropcap->type].fmt.pix;
+        cropcap->bounds.left   = 0;
+        cropcap->bounds.top    = 0;
+        cropcap->bounds.width  = pix->width  ? pix->width  : (unsigned int)node->config.width;
+        cropcap->bounds.height = pix->height ? pix->height : (unsigned int)node->config.height;
+        cropcap->defrect = cropcap->bounds;
+        cropcap->pixelaspect.numerator   = 1;
+        cropcap->pixelaspect.denominator = 1;
+        return 0;
+    }
+    case VIDIOC_S_CROP:
+        memcpy(&file->crop, arg, sizeof(file->crop));
+        return 0;
+    case VIDIOC_G_CROP:
+    {
+        struct v4l2_crop *crop = (struct v4l2_crop *)arg;
+        enum v4l2_buf_type type = crop->type;
+
+        memcpy(crop, &file->crop, sizeof(*crop));
+        crop->type = type;
+        return 0;
+    }
+    case VIDIOC_S_FBUF:
+        memcpy(&file->fbuf, arg, sizeof(file->fbuf));
+        return 0;
+    case VIDIOC_G_FBUF:
+        memcpy(arg, &file->fbuf, sizeof(file->fbuf));
+        return 0;
+    case VIDIOC_S_CTRL:
+    case VIDIOC_G_CTRL:
+    {
+        struct v4l2_control *ctrl = (struct v4l2_control *)arg;
+        int *value = emul_ctrl(node, ctrl->id, request == VIDIOC_S_CTRL);
+
+        if (request == VIDIOC_S_CTRL) {
+            if (value == NULL)
+                return -ENOMEM;
+            *value = ctrl->value;
+        } else {
+            ctrl->value = (value != NULL) ? *value : 0;
+        }
+        return 0;
+    }
+    case VIDIOC_S_EXT_CTRLS:
+    case VIDIOC_G_EXT_CTRLS:
+        return emul_ext_ctrls(file, (struct v4l2_ext_controls *)arg, request == VIDIOC_S_EXT_CTRLS);
+    case VIDIOC_S_PARM:
+        memcpy(&file->parm, arg, sizeof(file->parm));
+        return 0;
+    case VIDIOC_G_PARM:
+        memcpy(arg, &file->parm, sizeof(file->parm));
+        return 0;
+    case VIDIOC_ENUMINPUT:
+    {
+        struct v4l2_input *input = (struct v4l2_input *)arg;
+
+        if (node->type != SEC_V4L2_EMUL_CAPTURE || input->index != 0)
+            return -EINVAL;
+        strncpy((char *)input->name, "emul camera", sizeof(input->name) - 1);
+        input->type = V4L2_INPUT_TYPE_CAMERA;
+        return 0;
+    }
+    case VIDIOC_S_INPUT:
+        file->input = *(int *)arg;
+        return 0;
+    case VIDIOC_G_INPUT:
+        *(int *)arg = file->input;
+        return 0;
+    case VIDIOC_ENUMOUTPUT:
+    {
+        struct v4l2_output *output = (struct v4l2_output *)arg;
+
+        if (node->type != SEC_V4L2_EMUL_OUTPUT ||
+            output->index >= sizeof(emul_outputs) / sizeof(emul_outputs[0]))
+            return -EINVAL;
+        snprintf((char *)output->name, sizeof(output->name), "emul output%d", output->index);
+        output->type = emul_outputs[output->index];
+        return 0;
+    }
+    case VIDIOC_S_OUTPUT:
+        file->output = *(int *)arg;
+        return 0;
+    case VIDIOC_G_OUTPUT:
+        *(int *)arg = file->output;
+        return 0;
+    case VIDIOC_S_STD:
+        file->std = *(v4l2_std_id *)arg;
+        return 0;
+    case VIDIOC_G_STD:
+        *(v4l2_std_id *)arg = file->std;
+        return 0;
+    case VIDIOC_OVERLAY:
+        file->overlay = *(int *)arg;
+        return 0;
+    case VIDIOC_REQBUFS:
+        return emul_reqbufs(file, (struct v4l2_requestbuffers *)arg);
+    case VIDIOC_QUERYBUF:
+        return emul_querybuf(file, (struct v4l2_buffer *)arg);
+    case VIDIOC_QBUF:
+        return emul_qbuf(file, (struct v4l2_buffer *)arg);
+    case VIDIOC_DQBUF:
+        return emul_dqbuf(file, (struct v4l2_buffer *)arg);
+    case VIDIOC_STREAMON:
+        file->streaming     = 1;
+        file->stream_gen++;
+        file->last_frame_us = emul_now_us();
+        return 0;
+    case VIDIOC_STREAMOFF:
+        return emul_streamoff(file);
+    case VIDIOC_ENUMSTD:
+        // no standard table : ends the enumeration loop right away
+        return -EINVAL;
+    case VIDIOC_HDCP_STATUS:
+    case VIDIOC_HDCP_PROT_STATUS:
+        *(unsigned int *)arg = 1;
+        return 0;
+    case VIDIOC_HDCP_ENABLE:
+    case VIDIOC_INIT_AUDIO:
+        return 0;
+    default:
+        LOGV("%s::%s : ioctl(0x%08x) not supported\n", __func__, node->path, request);
+        return -ENOTTY;
+    }
+}
+
+static int emul_fb_ioctl(struct emul_file *file, unsigned int request, void *arg)
+{
+    struct emul_node *node = file->node;
+
+    switch (request) {
+    case FBIOGET_VSCREENINFO:
+        memcpy(arg, &node->var, sizeof(node->var));
+        return 0;
+    case FBIOPUT_VSCREENINFO:
+        memcpy(&node->var, arg, sizeof(node->var));
+        return 0;
+    case FBIOGET_FSCREENINFO:
+    {
+        struct fb_fix_screeninfo *fix = (struct fb_fix_screeninfo *)arg;
+
+        memset(fix, 0, sizeof(*fix));
+        strncpy(fix->id, "emul fb", sizeof(fix->id) - 1);
+        fix->smem_start  = node->config.phys_base;
+        fix->line_length = node->var.xres_virtual * node->var.bits_per_pixel / 8;
+        fix->smem_len    = fix->line_length * node->var.yres_virtual;
+        if (node->mem_size < fix->smem_len)
+            fix->smem_len = node->mem_size;
+        fix->type        = FB_TYPE_PACKED_PIXELS;
+        fix->visual      = FB_VISUAL_TRUECOLOR;
+        return 0;
+    }
+    case S3CFB_GET_FB_PHY_ADDR:
+        *(unsigned int *)arg = node->config.phys_base;
+        return 0;
+    case S3CFB_GET_LCD_WIDTH:
+        *(int *)arg = node->var.xres;
+        return 0;
+    case S3CFB_GET_LCD_HEIGHT:
+        *(int *)arg = node->var.yres;
+        return 0;
+    case S5PTVFB_WAITFORVSYNC: // == FBIO_WAITFORVSYNC
+    {
+        long long wait = emul_pace(&node->last_vsync_us, node->config.frame_interval_us);
+
+        pthread_mutex_unlock(&emul->lock);
+        emul_sleep_us(wait);
+        pthread_mutex_lock(&emul->lock);
+        return 0;
+    }
+    case FBIOBLANK:
+    case FBIOPAN_DISPLAY:
+    case S3CFB_SET_VSYNC_INT:
+    case S5PTVFB_SET_VSYNC_INT:
+    case S5PTVFB_WIN_POSITION:
+    case S5PTVFB_WIN_SET_ADDR:
+    case S5PTVFB_WIN_SET_PLANE_ALPHA:
+    case S5PTVFB_WIN_SET_CHROMA:
+    case S5PTVFB_SET_WIN_ON:
+    case S5PTVFB_SET_WIN_OFF:
+    case S5PTVFB_SCALING:
+        return 0;
+    default:
+        LOGV("%s::%s : ioctl(0x%08x) not supported\n", __func__, node->path, request);
+        return -ENOTTY;
+    }
+}
+
+static int emul_g2d_ioctl(struct emul_file *file, unsigned int request, void *arg)
+{
+    switch (request) {
+    case G2D_GET_MEMORY:
+        *(unsigned int *)arg = file->node->config.phys_base;
+        return 0;
+    case G2D_GET_MEMORY_SIZE:
+        *(unsigned int *)arg = file->node->mem_size;
+        return 0;
+    case G2D_BLIT:
+    case G2D_SYNC:
+    case G2D_RESET:
+    case G2D_GET_VERSION:
+    case G2D_DMA_CACHE_CLEAN:
+    case G2D_DMA_CACHE_FLUSH:
+        // only cost ioctl_latency_us
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
+/*
+ * Software stand-in for the codec. The "jpeg" is SOI, a COM segment
+ * holding the geometry, format, quality and a checksum of the frame,
+ * then EOI. Decoding it gives the geometry back. Coding takes
+ * frame_interval_us, one picture at a time over all opens.
+ */
+#define EMUL_JPEG_COM_FMT "emul %u %u %d %d %08x"
+
+static unsigned int emul_jpeg_checksum(const unsigned char *data, unsigned int size)
+{
+    unsigned int sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < size; i++)
+        sum = (sum << 5) + sum + data[i];
+    return sum;
+}
+
+static int emul_jpeg_exe(struct emul_file *file, unsigned int request, void *arg)
+{
+    struct emul_node *node = file->node;
+    unsigned int serial = file->serial;
+    unsigned int stream_gen = file->stream_gen;
+    unsigned char *stream = (unsigned char *)node->mem;
+    unsigned char *frame  = stream + JPEG_STREAM_BUF_SIZE;
+    int interval = node->config.frame_interval_us;
+
+    if (node->mem == NULL)
+        return -EINVAL;
+
+    // wait for the codec without blocking the other emulated nodes
+    pthread_mutex_unlock(&emul->lock);
+    pthread_mutex_lock(&emul->jpeg_hw_lock);
+    pthread_mutex_lock(&emul->lock);
+
+    // closed while waiting for the codec : its buffers are gone
+    if (!emul_file_same(file, node, serial, stream_gen)) {
+        pthread_mutex_unlock(&emul->jpeg_hw_lock);
+        return -EBADF;
+    }
+
+    if (request == IOCTL_JPEG_ENC_EXE) {
+        struct jpeg_enc_param *enc = (struct jpeg_enc_param *)arg;
+        unsigned int frame_size = enc->width * enc->height
+                                  * (enc->in_fmt == YUV_422 ? 2 : 1);
+        char com[64];
+        int len;
+
+        if (JPEG_FRAME_BUF_SIZE < frame_size) {
+            pthread_mutex_unlock(&emul->jpeg_hw_lock);
+            return -EINVAL;
+        }
+
+        len = snprintf(com, sizeof(com), EMUL_JPEG_COM_FMT, enc->width, enc->height,
+                       enc->out_fmt, enc->quality, emul_jpeg_checksum(frame, frame_size));
+
+        stream[0] = 0xFF; stream[1] = 0xD8;                   // SOI
+        stream[2] = 0xFF; stream[3] = 0xFE;                   // COM
+        stream[4] = (len + 2) >> 8; stream[5] = (len + 2) & 0xFF;
+        memcpy(stream + 6, com, len);
+        stream[6 + len] = 0xFF; stream[7 + len] = 0xD9;       // EOI
+        enc->size = 8 + len;
+        file->jpeg_enc = *enc;
+    } else {
+        struct jpeg_dec_param *dec = (struct jpeg_dec_param *)arg;
+        unsigned int width, height;
+        int fmt, quality;
+        unsigned int sum;
+        char com[64];
+        int len = (stream[4] << 8 | stream[5]) - 2;
+
+        if (stream[0] != 0xFF || stream[1] != 0xD8 || stream[2] != 0xFF || stream[3] != 0xFE
+            || len <= 0 || (int)sizeof(com) <= len) {
+            pthread_mutex_unlock(&emul->jpeg_hw_lock);
+            return -EINVAL;
+        }
+
+        memcpy(com, stream + 6, len);
+        com[len] = 0;
+        if (sscanf(com, EMUL_JPEG_COM_FMT, &width, &height, &fmt, &quality, &sum) != 5) {
+            pthread_mutex_unlock(&emul->jpeg_hw_lock);
+            return -EINVAL;
+        }
+
+        dec->width  = width;
+        dec->height = height;
+        dec->in_fmt = (enum jpeg_stream_format)fmt;
+        memset(frame, 0x80, dec->out_fmt == YUV_422 ? width * height * 2 : width * height * 3 / 2);
+        file->jpeg_dec = *dec;
+    }
+
+    pthread_mutex_unlock(&emul->lock);
+    emul_sleep_us(interval);
+    pthread_mutex_unlock(&emul->jpeg_hw_lock);
+    pthread_mutex_lock(&emul->lock);
+
+    return 0;
+}
+
+static int emul_jpeg_ioctl(struct emul_file *file, unsigned int request, void *arg)
+{
+    switch (request) {
+    case IOCTL_GET_ENC_OUT_BUF:
+    case IOCTL_GET_DEC_IN_BUF:
+        return (int)(intptr_t)((char *)arg);
+    case IOCTL_GET_ENC_IN_BUF:
+    case IOCTL_GET_DEC_OUT_BUF:
+        return (int)(intptr_t)((char *)arg + JPEG_STREAM_BUF_SIZE);
+    case IOCTL_SET_ENC_PARAM:
+        file->jpeg_enc = *(struct jpeg_enc_param *)arg;
+        return 0;
+    case IOCTL_SET_DEC_PARAM:
+        file->jpeg_dec = *(struct jpeg_dec_param *)arg;
+        return 0;
+    case IOCTL_JPEG_ENC_EXE:
+    case IOCTL_JPEG_DEC_EXE:
+        return emul_jpeg_exe(file, request, arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
+static int emul_open(const char *path, int flags, int mode)
+{
+    const struct sec_v4l2_shim_ops *real = sec_v4l2_shim_real_ops();
+    struct emul_node *node;
+    struct emul_file *file = NULL;
+    int i;
+
+    pthread_mutex_lock(&emul->lock);
+
+    node = emul_find_node(path);
+    if (node == NULL) {
+        pthread_mutex_unlock(&emul->lock);
+        return real->open(path, flags, mode);
+    }
+
+    for (i = 0; i < EMUL_MAX_FILES; i++) {
+        if (emul->files[i].node == NULL) {
+            file = &emul->files[i];
+            break;
+        }
+    }
+
+    if (file == NULL) {
+        pthread_mutex_unlock(&emul->lock);
+        errno = EMFILE;
+        return -1;
+    }
+
+    memset(file, 0, sizeof(*file));
+    file->fd = real->open("/dev/null", O_RDWR, 0);
+    if (file->fd < 0) {
+        pthread_mutex_unlock(&emul->lock);
+        return -1;
+    }
+    file->flags  = flags;
+    file->node   = node;
+    file->serial = ++emul->serial;
+
+    pthread_mutex_unlock(&emul->lock);
+
+    return file->fd;
+}
+
+static int emul_close(int fd)
+{
+    const struct sec_v4l2_shim_ops *real = sec_v4l2_shim_real_ops();
+    struct emul_file *file;
+
+    pthread_mutex_lock(&emul->lock);
+
+    file = emul_find_file(fd);
+    if (file != NULL) {
+        // like the last close of a real file, drops its flock()
+        if (file->node->lock_owner == file->serial) {
+            file->node->lock_owner = 0;
+            pthread_cond_broadcast(&emul->flock_cond);
+        }
+
+        emul_free_buffers(file);
+        memset(file, 0, sizeof(*file));
+        file->fd = -1;
+    }
+
+    pthread_mutex_unlock(&emul->lock);
+
+    return real->close(fd);
+}
+
+static int emul_ioctl(int fd, int request, void *arg)
+{
+    struct emul_file *file;
+    int latency;
+    int ret;
+
+    pthread_mutex_lock(&emul->lock);
+
+    file = emul_find_file(fd);
+    if (file == NULL) {
+        pthread_mutex_unlock(&emul->lock);
+        return sec_v4l2_shim_real_ops()->ioctl(fd, request, arg);
+    }
+
+    latency = file->node->config.ioctl_latency_us;
+
+    switch (file->node->type) {
+    case SEC_V4L2_EMUL_CAPTURE:
+    case SEC_V4L2_EMUL_OUTPUT:
+        ret = emul_v4l2_ioctl(file, request, arg);
+        break;
+    case SEC_V4L2_EMUL_FB:
+        ret = emul_fb_ioctl(file, request, arg);
+        break;
+    case SEC_V4L2_EMUL_G2D:
+        ret = emul_g2d_ioctl(file, request, arg);
+        break;
+    case SEC_V4L2_EMUL_HPD:
+        if ((unsigned int)request == HPD_GET_STATE) {
+            *(unsigned int *)arg = emul->hpd_state;
+            ret = 0;
+        } else {
+            ret = -ENOTTY;
+        }
+        break;
+    case SEC_V4L2_EMUL_JPEG:
+        ret = emul_jpeg_ioctl(file, request, arg);
+        break;
+    default:
+        ret = -ENOTTY;
+        break;
+    }
+
+    pthread_mutex_unlock(&emul->lock);
+
+    emul_sleep_us(latency);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+static void *emul_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+    struct emul_file *file;
+    void *mem = MAP_FAILED;
+
+    pthread_mutex_lock(&emul->lock);
+
+    file = emul_find_file(fd);
+    if (file == NULL) {
+        pthread_mutex_unlock(&emul->lock);
+        return sec_v4l2_shim_real_ops()->mmap(addr, len, prot, flags, fd, offset);
+    }
+
+    switch (file->node->type) {
+    case SEC_V4L2_EMUL_CAPTURE:
+    case SEC_V4L2_EMUL_OUTPUT:
+    {
+        int i;
+
+        for (i = 0; i < file->num_bufs; i++) {
+            if ((off_t)(i * EMUL_PAGE_ALIGN(file->bufs[i].length)) == offset
+                && len <= file->bufs[i].length && file->bufs[i].mem != NULL) {
+                mem = file->bufs[i].mem;
+                break;
+            }
+        }
+        break;
+    }
+    case SEC_V4L2_EMUL_FB:
+    case SEC_V4L2_EMUL_G2D:
+    {
+        struct emul_node *node = file->node;
+
+        // earlier mappings point into node->mem : never move it, refuse what does not fit
+        if (offset < 0 || node->mem_size < (size_t)offset + len)
+            break;
+        if (node->mem == NULL)
+            node->mem = emul_alloc(node->mem_size);
+        if (node->mem != NULL)
+            mem = (char *)node->mem + offset;
+        break;
+    }
+    case SEC_V4L2_EMUL_JPEG:
+        // one reserved region for every open, like the driver
+        if (offset != 0 || file->node->mem_size < len)
+            break;
+        if (file->node->mem == NULL)
+            file->node->mem = emul_alloc_low(file->node->mem_size);
+        if (file->node->mem != NULL)
+            mem = file->node->mem;
+        break;
+    default:
+        break;
+    }
+
+    pthread_mutex_unlock(&emul->lock);
+
+    if (mem == MAP_FAILED)
+        errno = EINVAL;
+    return mem;
+}
+
+static int emul_owns(void *addr)
+{
+    int i, j;
+
+    for (i = 0; i < EMUL_MAX_FILES; i++) {
+        struct emul_file *file = &emul->files[i];
+
+        if (file->node == NULL)
+            continue;
+
+        for (j = 0; j < file->num_bufs; j++) {
+            if (file->bufs[j].mem == addr)
+                return 1;
+        }
+    }
+
+    for (i = 0; i < EMUL_MAX_NODES; i++) {
+        struct emul_node *node = &emul->nodes[i];
+
+        if (node->mem != NULL && (char *)node->mem <= (char *)addr
+            && (char *)addr < (char *)node->mem + node->mem_size)
+            return 1;
+    }
+    return 0;
+}
+
+static int emul_munmap(void *addr, size_t len)
+{
+    int owned;
+
+    pthread_mutex_lock(&emul->lock);
+    owned = emul_owns(addr);
+    pthread_mutex_unlock(&emul->lock);
+
+    // emulated memory lives until REQBUFS(0), close or remove_all
+    if (owned)
+        return 0;
+
+    return sec_v4l2_shim_real_ops()->munmap(addr, len);
+}
+
+static int emul_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    const struct sec_v4l2_shim_ops *real = sec_v4l2_shim_real_ops();
+    long long wait = -1;
+    int ready = 0;
+    int emulated = 0;
+    nfds_t i;
+
+    pthread_mutex_lock(&emul->lock);
+
+    for (i = 0; i < nfds; i++) {
+        struct emul_file *file = emul_find_file(fds[i].fd);
+
+        if (file == NULL)
+            continue;
+
+        emulated++;
+        fds[i].revents = 0;
+
+        if (file->streaming && file->queue_count) {
+            long long next = file->last_frame_us + file->node->config.frame_interval_us
+                             - emul_now_us();
+
+            if (next < 0)
+                next = 0;
+            // the next frame is not done within the timeout
+            if (0 <= timeout && (long long)timeout * 1000 < next)
+                continue;
+            if (wait < 0 || next < wait)
+                wait = next;
+
+            fds[i].revents = fds[i].events & (POLLIN | POLLOUT);
+            ready++;
+        }
+    }
+
+    pthread_mutex_unlock(&emul->lock);
+
+    if (emulated == 0)
+        return real->poll(fds, nfds, timeout);
+
+    // nothing queued : a real device would sleep until the timeout
+    if (ready == 0)
+        wait = (timeout < 0) ? 0 : (long long)timeout * 1000;
+
+    emul_sleep_us(wait);
+
+    for (i = 0; i < nfds; i++) {
+        if (emul_find_file(fds[i].fd) == NULL) {
+            fds[i].revents = 0;
+            if (real->poll(&fds[i], 1, 0) > 0)
+                ready++;
+        }
+    }
+
+    return ready;
+}
+
+/*
+ * flock() per node : every open is its own owner, shared locks are taken
+ * as exclusive. The fds are all on /dev/null, so the real call would make
+ * every node one lock.
+ */
+static int emul_flock(int fd, int operation)
+{
+    struct emul_file *file;
+    struct emul_node *node;
+    unsigned int serial;
+
+    pthread_mutex_lock(&emul->lock);
+
+    file = emul_find_file(fd);
+    if (file == NULL) {
+        pthread_mutex_unlock(&emul->lock);
+        return sec_v4l2_shim_real_ops()->flock(fd, operation);
+    }
+
+    node   = file->node;
+    serial = file->serial;
+
+    if (operation & LOCK_UN) {
+        if (node->lock_owner == serial) {
+            node->lock_owner = 0;
+            pthread_cond_broadcast(&emul->flock_cond);
+        }
+        pthread_mutex_unlock(&emul->lock);
+        return 0;
+    }
+
+    while (node->lock_owner != 0 && node->lock_owner != serial) {
+        if (operation & LOCK_NB) {
+            pthread_mutex_unlock(&emul->lock);
+            errno = EWOULDBLOCK;
+            return -1;
+        }
+
+        pthread_cond_wait(&emul->flock_cond, &emul->lock);
+
+        // closed while waiting
+        if (file->node != node || file->serial != serial) {
+            pthread_mutex_unlock(&emul->lock);
+            errno = EBADF;
+            return -1;
+        }
+    }
+
+    node->lock_owner = serial;
+
+    pthread_mutex_unlock(&emul->lock);
+
+    return 0;
+}
+
+static const struct sec_v4l2_shim_ops emul_ops =
+{
+    emul_open,
+    emul_close,
+    emul_ioctl,
+    emul_mmap,
+    emul_munmap,
+    emul_poll,
+    emul_flock,
+};
+
+void sec_v4l2_emul_install(void)
+{
+    emul_init();
+    sec_v4l2_shim_set_ops(&emul_ops);
+}
+
+void sec_v4l2_emul_uninstall(void)
+{
+    sec_v4l2_shim_set_ops(NULL);
+}
+
+/**
+ * Register an emulated device node.
+ *
+ * @param path    [in] device path the libraries open, e.g. "/dev/video0".
+ * @param type    [in] which driver to emulate.
+ * @param config  [in] latency and geometry, NULL for defaults.
+ *
+ * @return 0 on success, -1 if the node table is full.
+ */
+int sec_v4l2_emul_add_node(const char *path, enum SEC_V4L2_EMUL_NODE type,
+                           const struct sec_v4l2_emul_config *config)
+{
+    struct emul_node *node;
+    int i;
+
+    emul_init();
+    pthread_mutex_lock(&emul->lock);
+
+    node = emul_find_node(path);
+    for (i = 0; node == NULL && i < EMUL_MAX_NODES; i++) {
+        if (!emul->nodes[i].used)
+            node = &emul->nodes[i];
+    }
+
+    if (node == NULL) {
+        pthread_mutex_unlock(&emul->lock);
+        LOGE("%s::too many nodes, %s not added\n", __func__, path);
+        return -1;
+    }
+
+    emul_free(node->mem, node->mem_size);
+    memset(node, 0, sizeof(*node));
+
+    node->used = 1;
+    node->type = type;
+    strncpy(node->path, path, EMUL_PATH_LEN - 1);
+
+    if (config != NULL)
+        node->config = *config;
+    if (node->config.width <= 0 || node->config.height <= 0) {
+        node->config.width  = EMUL_DEFAULT_WIDTH;
+        node->config.height = EMUL_DEFAULT_HEIGHT;
+    }
+    if (node->config.bpp <= 0)
+        node->config.bpp = EMUL_DEFAULT_BPP;
+    if (node->config.phys_base == 0)
+        node->config.phys_base = 0x40000000 + (unsigned int)(node - emul->nodes) * 0x01000000;
+
+    node->var.xres           = node->config.width;
+    node->var.yres           = node->config.height;
+    node->var.xres_virtual   = node->config.width;
+    node->var.yres_virtual   = node->config.height * 2;
+    node->var.bits_per_pixel = node->config.bpp;
+
+    if (type == SEC_V4L2_EMUL_G2D)
+        node->mem_size = EMUL_G2D_MEM_SIZE;
+    else if (type == SEC_V4L2_EMUL_FB)
+        node->mem_size = EMUL_FB_MEM_SIZE;
+    else if (type == SEC_V4L2_EMUL_JPEG)
+        node->mem_size = JPEG_TOTAL_BUF_SIZE;
+
+    pthread_mutex_unlock(&emul->lock);
+
+    return 0;
+}
+
+void sec_v4l2_emul_remove_all(void)
+{
+    int i;
+
+    emul_init();
+    pthread_mutex_lock(&emul->lock);
+
+    for (i = 0; i < EMUL_MAX_FILES; i++) {
+        if (emul->files[i].node != NULL)
+            emul_free_buffers(&emul->files[i]);
+    }
+
+    for (i = 0; i < EMUL_MAX_NODES; i++)
+        emul_free(emul->nodes[i].mem, emul->nodes[i].mem_size);
+
+    // files keep their /dev/null fd until the library closes it
+    memset(emul->files, 0, sizeof(emul->files));
+    memset(emul->nodes, 0, sizeof(emul->nodes));
+    pthread_cond_broadcast(&emul->flock_cond);
+
+    pthread_mutex_unlock(&emul->lock);
+}
+
+int sec_v4l2_emul_set_ctrl(const char *path, unsigned int id, int value)
+{
+    struct emul_node *node;
+    int *ctrl = NULL;
+
+    emul_init();
+    pthread_mutex_lock(&emul->lock);
+
+    node = emul_find_node(path);
+    if (node != NULL)
+        ctrl = emul_ctrl(node, id, 1);
+    if (ctrl != NULL)
+        *ctrl = value;
+
+    pthread_mutex_unlock(&emul->lock);
+
+    return (ctrl != NULL) ? 0 : -1;
+}
+
+void sec_v4l2_emul_set_hpd(int state)
+{
+    emul_init();
+    emul->hpd_state = state;
+}
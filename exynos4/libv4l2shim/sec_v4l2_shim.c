@@ -0,0 +1,302 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "libv4l2shim"
+#include <cutils/log.h>
+
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+// this file calls the real syscalls
+#undef BOARD_USES_V4L2_SHIM
+#include "sec_v4l2_shim.h"
+
+static int real_open(const char *path, int flags, int mode)
+{
+    return open(path, flags, mode);
+}
+
+static int real_close(int fd)
+{
+    return close(fd);
+}
+
+static int real_ioctl(int fd, int request, void *arg)
+{
+    return ioctl(fd, request, arg);
+}
+
+static void *real_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+    return mmap(addr, len, prot, flags, fd, offset);
+}
+
+static int real_munmap(void *addr, size_t len)
+{
+    return munmap(addr, len);
+}
+
+static int real_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    return poll(fds, nfds, timeout);
+}
+
+static int real_flock(int fd, int operation)
+{
+    return flock(fd, operation);
+}
+
+static const struct sec_v4l2_shim_ops real_ops =
+{
+    real_open,
+    real_close,
+    real_ioctl,
+    real_mmap,
+    real_munmap,
+    real_poll,
+    real_flock,
+};
+
+static const struct sec_v4l2_shim_ops *cur_ops = &real_ops;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_enabled = 0;
+static struct sec_v4l2_shim_trace trace;
+
+static long long shim_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void sec_v4l2_shim_set_ops(const struct sec_v4l2_shim_ops *ops)
+{
+    cur_ops = (ops != NULL) ? ops : &real_ops;
+}
+
+const struct sec_v4l2_shim_ops *sec_v4l2_shim_real_ops(void)
+{
+    return &real_ops;
+}
+
+int sec_v4l2_shim_open(const char *path, int flags, ...)
+{
+    int mode = 0;
+    int fd;
+
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+
+    fd = cur_ops->open(path, flags, mode);
+
+    if (trace_enabled) {
+        pthread_mutex_lock(&trace_lock);
+        trace.opens++;
+        pthread_mutex_unlock(&trace_lock);
+    }
+    return fd;
+}
+
+int sec_v4l2_shim_close(int fd)
+{
+    return cur_ops->close(fd);
+}
+
+static struct sec_v4l2_shim_trace_entry *trace_entry(int request)
+{
+    int i;
+
+    for (i = 0; i < trace.num_entries; i++) {
+        if (trace.entries[i].request == request)
+            return &trace.entries[i];
+    }
+
+    if (trace.num_entries == SEC_V4L2_SHIM_TRACE_MAX_REQUESTS)
+        return NULL;
+
+    memset(&trace.entries[i], 0, sizeof(trace.entries[i]));
+    trace.entries[i].request = request;
+    trace.num_entries++;
+    return &trace.entries[i];
+}
+
+int sec_v4l2_shim_ioctl(int fd, int request, ...)
+{
+    struct sec_v4l2_shim_trace_entry *entry;
+    long long start, elapsed;
+    void *arg;
+    va_list ap;
+    int ret;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (!trace_enabled)
+        return cur_ops->ioctl(fd, request, arg);
+
+    start   = shim_now_us();
+    ret     = cur_ops->ioctl(fd, request, arg);
+    elapsed = shim_now_us() - start;
+
+    pthread_mutex_lock(&trace_lock);
+
+    entry = trace_entry(request);
+    if (entry != NULL) {
+        entry->calls++;
+        if (ret < 0)
+            entry->errors++;
+        entry->total_us += elapsed;
+        if (entry->max_us < elapsed)
+            entry->max_us = elapsed;
+        entry->frame_calls++;
+    } else {
+        LOGE("%s::too many ioctl requests, 0x%08x not recorded\n", __func__, request);
+    }
+
+    trace.frame_calls++;
+    trace.frame_us += elapsed;
+
+    pthread_mutex_unlock(&trace_lock);
+
+    return ret;
+}
+
+void *sec_v4l2_shim_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+    if (trace_enabled) {
+        pthread_mutex_lock(&trace_lock);
+        trace.mmaps++;
+        pthread_mutex_unlock(&trace_lock);
+    }
+    return cur_ops->mmap(addr, len, prot, flags, fd, offset);
+}
+
+int sec_v4l2_shim_munmap(void *addr, size_t len)
+{
+    return cur_ops->munmap(addr, len);
+}
+
+int sec_v4l2_shim_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    if (trace_enabled) {
+        pthread_mutex_lock(&trace_lock);
+        trace.polls++;
+        pthread_mutex_unlock(&trace_lock);
+    }
+    return cur_ops->poll(fds, nfds, timeout);
+}
+
+int sec_v4l2_shim_flock(int fd, int operation)
+{
+    return cur_ops->flock(fd, operation);
+}
+
+void sec_v4l2_shim_trace_enable(int enable)
+{
+    trace_enabled = enable;
+}
+
+void sec_v4l2_shim_trace_reset(void)
+{
+    pthread_mutex_lock(&trace_lock);
+    memset(&trace, 0, sizeof(trace));
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void sec_v4l2_shim_trace_frame(void)
+{
+    int i;
+
+    pthread_mutex_lock(&trace_lock);
+
+    for (i = 0; i < trace.num_entries; i++) {
+        struct sec_v4l2_shim_trace_entry *entry = &trace.entries[i];
+
+        if (entry->frame_calls_max < entry->frame_calls)
+            entry->frame_calls_max = entry->frame_calls;
+        entry->frame_calls = 0;
+    }
+
+    if (trace.frame_calls_max < trace.frame_calls)
+        trace.frame_calls_max = trace.frame_calls;
+    if (trace.frame_us_max < trace.frame_us)
+        trace.frame_us_max = trace.frame_us;
+
+    trace.frame_calls = 0;
+    trace.frame_us    = 0;
+    trace.frames++;
+
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void sec_v4l2_shim_trace_get(struct sec_v4l2_shim_trace *out)
+{
+    pthread_mutex_lock(&trace_lock);
+    memcpy(out, &trace, sizeof(trace));
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void sec_v4l2_shim_trace_dump(void)
+{
+    struct sec_v4l2_shim_trace t;
+    int i;
+
+    sec_v4l2_shim_trace_get(&t);
+
+    LOGD("frames(%u) opens(%u) mmaps(%u) polls(%u) worst frame(%u ioctls, %lld us)\n",
+         t.frames, t.opens, t.mmaps, t.polls, t.frame_calls_max, t.frame_us_max);
+
+    for (i = 0; i < t.num_entries; i++) {
+        struct sec_v4l2_shim_trace_entry *entry = &t.entries[i];
+
+        LOGD("ioctl(0x%08x '%c' %3d) calls(%6u) errors(%4u) avg(%5lld us) max(%6lld us) per frame(%u)\n",
+             entry->request, _IOC_TYPE(entry->request), _IOC_NR(entry->request),
+             entry->calls, entry->errors,
+             entry->calls ? entry->total_us / entry->calls : 0,
+             entry->max_us, entry->frame_calls_max);
+    }
+}
+
+int sec_v4l2_shim_trace_check_budget(unsigned int max_calls, long long max_us)
+{
+    struct sec_v4l2_shim_trace t;
+    int ret = 0;
+
+    sec_v4l2_shim_trace_get(&t);
+
+    if (0 < max_calls && max_calls < t.frame_calls_max) {
+        LOGE("%s::%u ioctls in a frame, budget is %u\n", __func__, t.frame_calls_max, max_calls);
+        ret = -1;
+    }
+
+    if (0 < max_us && max_us < t.frame_us_max) {
+        LOGE("%s::%lld us of ioctls in a frame, budget is %lld us\n", __func__, t.frame_us_max, max_us);
+        ret = -1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,44 @@
+# Copyright (C) 2008 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := tests
+
+# the libraries under test are built in, routed to the emulator
+LOCAL_SRC_FILES := \
+        sec_v4l2_emul_test.cpp \
+        ../../libfimc/SecFimc.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/../../include
+
+LOCAL_CFLAGS += -DBOARD_USES_V4L2_SHIM -DSLSI_S5PC210
+LOCAL_CFLAGS += -DDEFAULT_FB_NUM=$(DEFAULT_FB_NUM)
+
+LOCAL_STATIC_LIBRARIES := libv4l2shim_static
+LOCAL_SHARED_LIBRARIES := liblog libutils libcutils
+
+ifeq ($(BOARD_USES_HDMI),true)
+LOCAL_SRC_FILES += \
+        ../../libhdmi/SecHdmi.cpp \
+        ../../libhdmi/fimd_api.c \
+        ../../libhdmi/hdmi_policy.c
+LOCAL_CFLAGS += -DBOARD_USES_HDMI
+LOCAL_SHARED_LIBRARIES += libedid libcec
+endif
+
+LOCAL_MODULE := sec_v4l2_emul_test
+include $(BUILD_EXECUTABLE)
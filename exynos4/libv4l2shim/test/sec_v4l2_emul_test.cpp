@@ -0,0 +1,176 @@
+/*
+ * Copyright@ Samsung Electronics Co. LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs libfimc and, on HDMI boards, the libhdmi tvout layer on the
+ * userspace device emulator and checks their per-frame ioctl budgets.
+ * No hardware is touched, returns 0 when every check passes.
+ */
+
+#define LOG_TAG "sec_v4l2_emul_test"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SecFimc.h"
+#include "SecHdmi.h"
+#include "sec_v4l2_shim.h"
+
+using namespace android;
+
+#define TEST_FRAMES           (60)
+
+// FIMC one shot : STREAMON, QBUF, DQBUF, STREAMOFF
+#define FIMC_ONESHOT_IOCTLS   (4)
+// tvout video layer, steady state : the source address only
+#define TVOUT_FRAME_IOCTLS    (1)
+// tvout video layer, geometry change : src fmt, crop, fbuf, window
+#define TVOUT_RESET_IOCTLS    (4)
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed : %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            g_failures++;                                               \
+        }                                                               \
+    } while (0)
+
+static void add_nodes(void)
+{
+    struct sec_v4l2_emul_config config;
+    char path[32];
+
+    memset(&config, 0, sizeof(config));
+
+    for (int i = 0; i < 4; i++) {
+        config.phys_base = 0x50000000 + (i << 24);
+        snprintf(path, sizeof(path), "/dev/video%d", i);
+        sec_v4l2_emul_add_node(path, SEC_V4L2_EMUL_OUTPUT, &config);
+    }
+
+    config.phys_base = 0x60000000;
+    sec_v4l2_emul_add_node(TVOUT_DEV,   SEC_V4L2_EMUL_OUTPUT, &config);
+    sec_v4l2_emul_add_node(TVOUT_DEV_V, SEC_V4L2_EMUL_OUTPUT, &config);
+    sec_v4l2_emul_add_node(HPD_DEV,     SEC_V4L2_EMUL_HPD,    &config);
+
+    config.width  = 1920;
+    config.height = 1080;
+    config.bpp    = 32;
+    config.phys_base = 0x70000000;
+    sec_v4l2_emul_add_node("/dev/graphics/fb0",  SEC_V4L2_EMUL_FB, &config);
+    sec_v4l2_emul_add_node("/dev/graphics/fb10", SEC_V4L2_EMUL_FB, &config);
+    sec_v4l2_emul_add_node("/dev/graphics/fb11", SEC_V4L2_EMUL_FB, &config);
+}
+
+static void test_fimc_oneshot(void)
+{
+    SecFimc fimc;
+    unsigned int srcCropW = 640, srcCropH = 480;
+    unsigned int dstCropW = 1280, dstCropH = 720;
+
+    CHECK(fimc.create(SecFimc::FIMC_DEV1, FIMC_OVLY_NONE_SINGLE_BUF, 1) == true);
+    CHECK(fimc.setSrcParams(640, 480, 0, 0, &srcCropW, &srcCropH,
+                            HAL_PIXEL_FORMAT_YCbCr_420_SP) == true);
+    CHECK(fimc.setSrcPhyAddr(0x40000000, 0x40000000 + 640 * 480) == true);
+    CHECK(fimc.setDstParams(1280, 720, 0, 0, &dstCropW, &dstCropH,
+                            HAL_PIXEL_FORMAT_YCbCr_420_SP) == true);
+    CHECK(fimc.setDstPhyAddr(0x48000000, 0x48000000 + 1280 * 720) == true);
+
+    sec_v4l2_shim_trace_reset();
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        CHECK(fimc.handleOneShot() == true);
+        sec_v4l2_shim_trace_frame();
+    }
+
+    struct sec_v4l2_shim_trace trace;
+    sec_v4l2_shim_trace_get(&trace);
+    CHECK(trace.frames == TEST_FRAMES);
+    CHECK(sec_v4l2_shim_trace_check_budget(FIMC_ONESHOT_IOCTLS, 0) == 0);
+    sec_v4l2_shim_trace_dump();
+
+    CHECK(fimc.destroy() == true);
+}
+
+#if defined(BOARD_USES_HDMI)
+static void test_tvout_video(void)
+{
+    unsigned int y = 0x48000000;
+    unsigned int c = y + 1280 * 720;
+
+    CHECK(0 < tvout_init(V4L2_STD_1080P_30));
+    CHECK(hdmi_init_layer(HDMI_LAYER_VIDEO) == 0);
+
+    // first frame programs the layer
+    sec_v4l2_shim_trace_reset();
+    CHECK(hdmi_set_v_param(HDMI_LAYER_VIDEO, 1280, 720, V4L2_PIX_FMT_NV12,
+                           y, c, 1920, 1080) == 0);
+    sec_v4l2_shim_trace_frame();
+    CHECK(sec_v4l2_shim_trace_check_budget(TVOUT_RESET_IOCTLS, 0) == 0);
+
+    // steady state : two buffers flipping, nothing but the address
+    sec_v4l2_shim_trace_reset();
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        unsigned int offset = (i & 1) ? 0x01000000 : 0;
+
+        CHECK(hdmi_set_v_param(HDMI_LAYER_VIDEO, 1280, 720, V4L2_PIX_FMT_NV12,
+                               y + offset, c + offset, 1920, 1080) == 0);
+        sec_v4l2_shim_trace_frame();
+    }
+    CHECK(sec_v4l2_shim_trace_check_budget(TVOUT_FRAME_IOCTLS, 0) == 0);
+    sec_v4l2_shim_trace_dump();
+
+    // the same buffer again costs nothing
+    sec_v4l2_shim_trace_reset();
+    CHECK(hdmi_set_v_param(HDMI_LAYER_VIDEO, 1280, 720, V4L2_PIX_FMT_NV12,
+                           y + 0x01000000, c + 0x01000000, 1920, 1080) == 0);
+    sec_v4l2_shim_trace_frame();
+
+    struct sec_v4l2_shim_trace trace;
+    sec_v4l2_shim_trace_get(&trace);
+    CHECK(trace.frame_calls_max == 0);
+
+    CHECK(hdmi_deinit_layer(HDMI_LAYER_VIDEO) == 0);
+    CHECK(tvout_deinit() == 0);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    add_nodes();
+    sec_v4l2_emul_install();
+    sec_v4l2_shim_trace_enable(1);
+
+    test_fimc_oneshot();
+#if defined(BOARD_USES_HDMI)
+    test_tvout_video();
+#endif
+
+    sec_v4l2_shim_trace_enable(0);
+    sec_v4l2_emul_uninstall();
+    sec_v4l2_emul_remove_all();
+
+    if (g_failures) {
+        fprintf(stderr, "%s : %d check(s) failed\n", argv[0], g_failures);
+        return 1;
+    }
+
+    printf("%s : all checks passed\n", argv[0]);
+    return 0;
+}